@@ -1190,6 +1190,7 @@ RC CLI::load() {
 
     string line, token;
     char *tokenizer;
+    vector<vector<char>> batch;
     while (ifs.good()) {
         getline(ifs, line);
         if (line.compare("") == 0)
@@ -1242,7 +1243,8 @@ RC CLI::load() {
             if (keyIndex == attributes.size())
                 keyIndex = 0;
         }
-        if (this->insertTupleToDB(tableName, attributes, buffer, indexMap) != 0) {
+        batch.emplace_back((char *) buffer, (char *) buffer + offset);
+        if (batch.size() >= LOAD_BATCH_ROWS && this->insertTuplesToDB(tableName, batch) != 0) {
             return error("error while inserting tuple");
         }
 
@@ -1251,6 +1253,9 @@ RC CLI::load() {
         // for (std::vector<Attribute>::iterator it = attrs.begin() ; it != attrs.end(); ++it)
         // totalLength += it->length;
     }
+    if (!batch.empty() && this->insertTuplesToDB(tableName, batch) != 0) {
+        return error("error while inserting tuple");
+    }
     // clear up indexMap
     for (auto it = indexMap.begin(); it != indexMap.end(); ++it) {
         free(it->second);
@@ -1371,6 +1376,20 @@ RC CLI::insertTupleToDB(const string tableName, const vector<Attribute> attribut
     return 0;
 }
 
+RC CLI::insertTuplesToDB(const string tableName, vector<vector<char>> &batch) {
+    vector<const void *> tuples;
+    vector<RID> rids;
+    for (auto &tuple: batch)
+        tuples.push_back(tuple.data());
+
+    // insert the rows and their index entries at once
+    if (rm.insertTuples(tableName, tuples, rids) != 0)
+        return error("error CLI::load in rm.insertTuples");
+
+    batch.clear();
+    return 0;
+}
+
 RC CLI::printAttributes() {
     char *tokenizer = next();
     if (tokenizer == NULL) {
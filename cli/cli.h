@@ -28,6 +28,8 @@ typedef enum {
 // Return code
 typedef int RC;
 
+#define LOAD_BATCH_ROWS 4096 // rows "load" hands to insertTuples at once
+
 struct Table {
     std::string tableName;
     std::vector<Attribute> columns;
@@ -155,6 +157,8 @@ private:
     RC insertTupleToDB(const std::string tableName, const std::vector<Attribute> attributes, const void *data,
                        std::unordered_map<int, void *> indexMap);
 
+    RC insertTuplesToDB(const std::string tableName, std::vector<std::vector<char>> &batch);
+
     RC getAttribute(const std::string name, const std::vector<Attribute> pool, Attribute &attr);
 
     RelationManager &rm = RelationManager::instance();
@@ -3,6 +3,15 @@
 #include <vector>
 #include <memory.h>
 #include <float.h>
+#include <algorithm>
+#include <queue>
+#include <map>
+#include <thread>
+#include <cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_SIMD_KERNELS 1
+#endif
 /* ========== compare functions ============== */
 int compareRID(const RID& a, const RID& b){
     if(a.pageNum < b.pageNum) return -1;
@@ -11,12 +20,9 @@ int compareRID(const RID& a, const RID& b){
     else if(a.slotNum > b.slotNum) return 1;
     return 0;
 }
-template<typename T>
-int compareNumIndexItem(const IndexItem& a, const IndexItem& b){
-    T v1 = *(T*)a.value.data(), v2 = *(T*)b.value.data();
-    if(v1 == v2) return 0;
-    else if(v1 < v2) return -1;
-    else return 1;
+// the RID of an entry owning a posting list stands for every RID of its key
+static inline int compareEntryRID(const RID& k, const RID& entry){
+    return PostingPage::isPosting(entry) ? 0 : compareRID(k, entry);
 }
 template<typename T>
 int compareNumIndexItemWithRID(const IndexItem& a, const IndexItem& b){
@@ -27,15 +33,60 @@ int compareNumIndexItemWithRID(const IndexItem& a, const IndexItem& b){
     else if(v1 < v2) return -1;
     else return 1;
 }
-int compareVarcharIndexItem(const IndexItem& a, const IndexItem& b){
-    if(a.value < b.value) return -1;
-    else if(a.value == b.value) return 0;
-    else return 1;
+// varchar keys are ordered as unsigned bytes, so a memcmp decides
+int compareVarcharBytes(const char* a, int alen, const char* b, int blen){
+    int res = memcmp(a, b, std::min(alen, blen));
+    if(res != 0) return res < 0 ? -1 : 1;
+    return alen == blen ? 0 : (alen < blen ? -1 : 1);
 }
 int compareVarcharIndexItemWithRID(const IndexItem& a, const IndexItem& b){
-    if(a.value < b.value) return -1;
-    else if(a.value == b.value) return compareRID(a.rid, b.rid);
-    else return 1;
+    int res = compareVarcharBytes(a.value.data(), a.value.size(), b.value.data(), b.value.size());
+    return res != 0 ? res : compareRID(a.rid, b.rid);
+}
+/* ========== compare against page slots in place ============== */
+// a composite key to look up, pointing into an IndexItem or a page
+struct KeyRef {
+    const char* key; // varchar without its length
+    int len;
+    RID rid;
+};
+static inline KeyRef makeKeyRef(const IndexItem& item){
+    return KeyRef{item.value.data(), (int)item.value.size(), item.rid};
+}
+// same order as the IndexItem comparators above
+template<AttrType T>
+inline int compareKey(const char* a, int alen, const char* b, int blen);
+template<>
+inline int compareKey<TypeInt>(const char* a, int, const char* b, int){
+    int v1 = *(const int*)a, v2 = *(const int*)b;
+    return v1 == v2 ? 0 : (v1 < v2 ? -1 : 1);
+}
+template<>
+inline int compareKey<TypeReal>(const char* a, int, const char* b, int){
+    float v1 = *(const float*)a, v2 = *(const float*)b;
+    return v1 == v2 ? 0 : (v1 < v2 ? -1 : 1);
+}
+template<>
+inline int compareKey<TypeVarChar>(const char* a, int alen, const char* b, int blen){
+    return compareVarcharBytes(a, alen, b, blen);
+}
+// compare k with a leaf key stored as the page prefix and a suffix
+static inline int comparePrefixed(const KeyRef& k, const char* prefix, int plen, const char* suffix, int slen){
+    int res = memcmp(k.key, prefix, std::min(k.len, plen));
+    if(res != 0) return res < 0 ? -1 : 1;
+    if(k.len < plen) return -1;
+    return compareVarcharBytes(k.key + plen, k.len - plen, suffix, slen);
+}
+// compare k with the composite key in slot i; with WithRID, equal keys are ordered by RID
+template<AttrType T, bool WithRID>
+inline int compareSlot(const KeyRef& k, const char* page, int i){
+    const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+    const char* data = page + slotref.offset + sizeof(int);
+    int len = slotref.data_size - sizeof(int) - sizeof(RID);
+    int plen = T == TypeVarChar ? IndexPage::getPrefixLen(page) : 0;
+    int res = plen > 0 ? comparePrefixed(k, IndexPage::getPrefix(page), plen, data, len) : compareKey<T>(k.key, k.len, data, len);
+    if(res != 0 || !WithRID) return res;
+    return compareEntryRID(k.rid, *(const RID*)(data + len));
 }
 /* ========== functions ============== */
 IndexItem makeCompositeIndex(const Attribute& attr, const void* key, const RID& rid){
@@ -50,60 +101,475 @@ IndexItem makeCompositeIndex(const Attribute& attr, const void* key, const RID&
     res.rid = rid;
     return res;
 }
-int binarySearchUpperBound(char* page, const IndexItem& indexValue, CompFunc comp) {
+template<AttrType T, bool WithRID>
+int binarySearchUpperBound(const char* page, const KeyRef& indexValue) {
     // return the index of the first item > indexValue
     int a = 0, b = IndexPage::getSlotCount(page) - 2, mid; // omit the final child-only record
     if(b < 0) return 0;
     while(a < b){
         mid = a + (b-a) / 2;
-        if(comp(indexValue,IndexPage::readIndexItem(page, mid)) < 0){
+        if(compareSlot<T, WithRID>(indexValue, page, mid) < 0){
             b = mid;
         } else{
             a = mid + 1;
         }
     }
-    if(comp(indexValue, IndexPage::readIndexItem(page, a)) >= 0)
+    if(compareSlot<T, WithRID>(indexValue, page, a) >= 0)
         return a + 1;
     return a;
 }
-int binarySearchLowerBound(char* page,  const IndexItem& indexValue, CompFunc comp) {
+template<AttrType T, bool WithRID>
+int binarySearchLowerBound(const char* page, const KeyRef& indexValue) {
     // return the index of the first item >= indexValue
     int a = 0, b = IndexPage::getSlotCount(page) - 2, mid; // omit the final child-only record
     if(b < 0) return 0; 
     while(a < b){
         mid = a + (b-a) / 2;
-        if(comp(indexValue,IndexPage::readIndexItem(page, mid)) > 0){
+        if(compareSlot<T, WithRID>(indexValue, page, mid) > 0){
             a = mid + 1;
         } else{
             b = mid;
         }
     }
-    if(comp(indexValue, IndexPage::readIndexItem(page, a)) > 0)
+    if(compareSlot<T, WithRID>(indexValue, page, a) > 0)
         return a + 1;
     return a;
 }
 
-bool recursiveInsert(IXFileHandle& ixFileHandle, int parPageNum, int currPageNum, IndexItem& indexitem, 
-    int& leftAddPageNum, int& rightAddPageNum, std::vector<char>& upflowIndexValue, CompFunc comp, bool& valid_insertion){
+/* ========== key search kernels of FixedPage ============== */
+template<AttrType T> struct FixedKey;
+template<> struct FixedKey<TypeInt> { typedef int type; };
+template<> struct FixedKey<TypeReal> { typedef float type; };
+template<> struct FixedKey<TypeVarChar> { typedef int type; }; // only compiled in branches VarChar never takes
+
+// number of the sorted keys[0, n) below key, or not above it with orEqual
+typedef int (*CountKeysFunc)(const char* keys, int n, const char* key, bool orEqual);
+
+template<AttrType T>
+static int countKeysScalar(const char* keys, int n, const char* key, bool orEqual) {
+    typedef typename FixedKey<T>::type K;
+    const K* k = (const K*)keys;
+    K v = *(const K*)key;
+    int a = 0, b = n, mid;
+    while(a < b){
+        mid = a + (b-a) / 2;
+        if(orEqual ? k[mid] <= v : k[mid] < v) a = mid + 1;
+        else b = mid;
+    }
+    return a;
+}
+
+#ifdef HAS_SIMD_KERNELS
+// The keys are sorted, so the keys below key form a prefix. A binary search over blocks of one
+// vector finds the first block whose last key is not below, and the movemask of that block counts
+// the rest. Each kernel is compiled for its own instruction set and only picked when the CPU
+// reports it.
+template<AttrType T>
+static int findKeyBlock(const char* keys, int n, int width, const char* key, bool orEqual) {
+    typedef typename FixedKey<T>::type K;
+    const K* k = (const K*)keys;
+    K v = *(const K*)key;
+    int a = 0, b = n / width, mid;
+    while(a < b){
+        mid = a + (b-a) / 2;
+        K last = k[mid * width + width - 1];
+        if(orEqual ? last <= v : last < v) a = mid + 1;
+        else b = mid;
+    }
+    return a * width;
+}
+
+template<AttrType T>
+static int countKeysTail(const char* keys, int i, int n, const char* key, bool orEqual) {
+    return i + countKeysScalar<T>(keys + i * FixedPage::KEYSIZE, n - i, key, orEqual);
+}
+
+__attribute__((target("sse2")))
+static int countIntKeysSSE2(const char* keys, int n, const char* key, bool orEqual) {
+    int i = findKeyBlock<TypeInt>(keys, n, 4, key, orEqual);
+    if(i + 4 > n) return countKeysTail<TypeInt>(keys, i, n, key, orEqual);
+    __m128i pivot = _mm_set1_epi32(*(const int*)key);
+    __m128i x = _mm_loadu_si128((const __m128i*)(keys + i * FixedPage::KEYSIZE));
+    __m128i below = orEqual ? _mm_xor_si128(_mm_cmpgt_epi32(x, pivot), _mm_set1_epi32(-1)) : _mm_cmplt_epi32(x, pivot);
+    return i + __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(below)));
+}
+
+__attribute__((target("sse2")))
+static int countRealKeysSSE2(const char* keys, int n, const char* key, bool orEqual) {
+    int i = findKeyBlock<TypeReal>(keys, n, 4, key, orEqual);
+    if(i + 4 > n) return countKeysTail<TypeReal>(keys, i, n, key, orEqual);
+    __m128 pivot = _mm_set1_ps(*(const float*)key);
+    __m128 x = _mm_loadu_ps((const float*)(keys + i * FixedPage::KEYSIZE));
+    return i + __builtin_popcount(_mm_movemask_ps(orEqual ? _mm_cmple_ps(x, pivot) : _mm_cmplt_ps(x, pivot)));
+}
+
+__attribute__((target("avx2")))
+static int countIntKeysAVX2(const char* keys, int n, const char* key, bool orEqual) {
+    int i = findKeyBlock<TypeInt>(keys, n, 8, key, orEqual);
+    if(i + 8 > n) return countKeysTail<TypeInt>(keys, i, n, key, orEqual);
+    __m256i pivot = _mm256_set1_epi32(*(const int*)key);
+    __m256i x = _mm256_loadu_si256((const __m256i*)(keys + i * FixedPage::KEYSIZE));
+    __m256i below = orEqual ? _mm256_xor_si256(_mm256_cmpgt_epi32(x, pivot), _mm256_set1_epi32(-1)) : _mm256_cmpgt_epi32(pivot, x);
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(below));
+    _mm256_zeroupper(); // an unoptimized build doesn't add it, and SSE code after it would stall
+    return i + __builtin_popcount(mask);
+}
+
+__attribute__((target("avx2")))
+static int countRealKeysAVX2(const char* keys, int n, const char* key, bool orEqual) {
+    int i = findKeyBlock<TypeReal>(keys, n, 8, key, orEqual);
+    if(i + 8 > n) return countKeysTail<TypeReal>(keys, i, n, key, orEqual);
+    __m256 pivot = _mm256_set1_ps(*(const float*)key);
+    __m256 x = _mm256_loadu_ps((const float*)(keys + i * FixedPage::KEYSIZE));
+    int mask = _mm256_movemask_ps(orEqual ? _mm256_cmp_ps(x, pivot, _CMP_LE_OQ) : _mm256_cmp_ps(x, pivot, _CMP_LT_OQ));
+    _mm256_zeroupper();
+    return i + __builtin_popcount(mask);
+}
+#endif
+
+static bool kernelSupported(KeySearchKernel kernel) {
+    switch(kernel) {
+        case KeySearchKernel::SCALAR: return true;
+#ifdef HAS_SIMD_KERNELS
+        case KeySearchKernel::SSE2: __builtin_cpu_init(); return __builtin_cpu_supports("sse2");
+        case KeySearchKernel::AVX2: __builtin_cpu_init(); return __builtin_cpu_supports("avx2");
+#endif
+        default: return false;
+    }
+}
+
+struct KeyCounters {
+    KeySearchKernel kernel;
+    CountKeysFunc intKeys, realKeys;
+};
+
+static KeyCounters makeKeyCounters(KeySearchKernel kernel) {
+    switch(kernel) {
+#ifdef HAS_SIMD_KERNELS
+        case KeySearchKernel::AVX2: return KeyCounters{kernel, countIntKeysAVX2, countRealKeysAVX2};
+        case KeySearchKernel::SSE2: return KeyCounters{kernel, countIntKeysSSE2, countRealKeysSSE2};
+#endif
+        default: return KeyCounters{KeySearchKernel::SCALAR, countKeysScalar<TypeInt>, countKeysScalar<TypeReal>};
+    }
+}
+
+// the best kernel the CPU runs, picked at the first search
+static KeyCounters &keyCounters() {
+    static KeyCounters counters = makeKeyCounters(
+            kernelSupported(KeySearchKernel::AVX2) ? KeySearchKernel::AVX2 :
+            kernelSupported(KeySearchKernel::SSE2) ? KeySearchKernel::SSE2 : KeySearchKernel::SCALAR);
+    return counters;
+}
+
+template<AttrType T>
+inline int countKeys(const char* page, const KeyRef& k, bool orEqual) {
+    KeyCounters &counters = keyCounters();
+    return (T == TypeInt ? counters.intKeys : counters.realKeys)(FixedPage::keyAt(page, 0), FixedPage::getCount(page), k.key, orEqual);
+}
+
+// compare k with the i-th entry of a FixedPage
+template<AttrType T, bool WithRID>
+inline int compareFixed(const KeyRef& k, const char* page, int i){
+    int res = compareKey<T>(k.key, k.len, FixedPage::keyAt(page, i), FixedPage::KEYSIZE);
+    if(res != 0 || !WithRID) return res;
+    return compareEntryRID(k.rid, FixedPage::getRID(page, i));
+}
+// the kernels find the run of equal keys, the RIDs decide inside it
+template<AttrType T, bool WithRID>
+int fixedUpperBound(const char* page, const KeyRef& indexValue) {
+    // return the index of the first key > indexValue
+    int b = countKeys<T>(page, indexValue, true), a, mid;
+    if(!WithRID) return b;
+    a = countKeys<T>(page, indexValue, false);
+    while(a < b){
+        mid = a + (b-a) / 2;
+        if(compareEntryRID(indexValue.rid, FixedPage::getRID(page, mid)) < 0) b = mid;
+        else a = mid + 1;
+    }
+    return a;
+}
+template<AttrType T, bool WithRID>
+int fixedLowerBound(const char* page, const KeyRef& indexValue) {
+    // return the index of the first key >= indexValue
+    int a = countKeys<T>(page, indexValue, false), b, mid;
+    if(!WithRID) return a;
+    b = countKeys<T>(page, indexValue, true);
+    while(a < b){
+        mid = a + (b-a) / 2;
+        if(compareEntryRID(indexValue.rid, FixedPage::getRID(page, mid)) > 0) a = mid + 1;
+        else b = mid;
+    }
+    return a;
+}
+
+/* ========== latches ============== */
+// what changing a leaf on its own came to
+enum LeafResult {
+    LEAF_DONE,      // written, or there was nothing to write
+    LEAF_FAILED,    // the entry to insert is already there, or the one to delete is not
+    LEAF_SPLIT,     // split, its right half went to a new page
+    LEAF_UNDERFLOW, // written, less than 1/UNDERFLOW_FILL full
+    LEAF_SMO        // it needs a split or a merge which was not allowed, nothing was written
+};
+
+// A split or merge. They run one at a time and latch each page they change until they are done, so
+// readers see a page either before or after the whole change. Inner nodes change nowhere else, so
+// they are read without a latch; leaves also change under their own latch and are latched first.
+// Pages freed on the way join the idle list afterwards, once nobody can be waiting for their latch.
+class SmoGuard {
+public:
+    explicit SmoGuard(IXFileHandle &ixFileHandle)
+        : fh_(ixFileHandle), lock_(ixFileHandle.latches().smoMutex) {}
+    // path: the pages copied by the descent which found the split or merge necessary
+    SmoGuard(IXFileHandle &ixFileHandle, PathCopy &path)
+        : fh_(ixFileHandle), lock_(ixFileHandle.latches().smoMutex) {
+        std::swap(ixFileHandle.latches().path, path);
+    }
+    ~SmoGuard() {
+        IndexLatches &latches = fh_.latches();
+        for (int pageNum: latches.held) latches.writeUnlock(pageNum);
+        latches.held.clear();
+        latches.path = PathCopy();
+        for (int pageNum: latches.freed) fh_.freePage(pageNum);
+        latches.freed.clear();
+    }
+private:
+    IXFileHandle &fh_;
+    std::lock_guard<std::mutex> lock_;
+};
+
+// latch pageNum until the running split or merge is done
+static void holdPage(IXFileHandle& ixFileHandle, int pageNum){
+    IndexLatches& latches = ixFileHandle.latches();
+    if(std::find(latches.held.begin(), latches.held.end(), pageNum) != latches.held.end()) return;
+    latches.writeLock(pageNum);
+    latches.held.push_back(pageNum);
+}
+// page reads and writes of a split or merge. A page copied at a version it still has is not read
+// again, and a leaf is latched at that version; a writer changing it meanwhile takes another read.
+static RC readHeld(IXFileHandle& ixFileHandle, int pageNum, char* page){
+    IndexLatches& latches = ixFileHandle.latches();
+    uint64_t version;
+    bool held = std::find(latches.held.begin(), latches.held.end(), pageNum) != latches.held.end();
+    const PathCopy& path = latches.path;
+    for(size_t i = 0; !held && i < path.pageNums.size(); ++i) {
+        if(path.pageNums[i] != pageNum) continue;
+        const char* copy = path.pages.data() + i * PAGE_SIZE;
+        bool inner = IndexPage::getNextLeafId(copy) < -1;
+        if(inner ? !latches.validate(pageNum, path.versions[i]) : !latches.upgrade(pageNum, path.versions[i])) break;
+        if(!inner) latches.held.push_back(pageNum);
+        memcpy(page, copy, PAGE_SIZE);
+        return 0;
+    }
+    // ours already, or a leaf being written: inner nodes are written by splits and merges only
+    if(held || !latches.readLock(pageNum, version)) {
+        holdPage(ixFileHandle, pageNum);
+        return ixFileHandle.readPage(pageNum, page);
+    }
+    if(ixFileHandle.readPage(pageNum, page) < 0) return -1;
+    if(IndexPage::getNextLeafId(page) < -1) return 0; // an inner node
+    if(latches.upgrade(pageNum, version)) {
+        latches.held.push_back(pageNum);
+        return 0;
+    }
+    holdPage(ixFileHandle, pageNum);
+    return ixFileHandle.readPage(pageNum, page);
+}
+static RC writeHeld(IXFileHandle& ixFileHandle, int pageNum, const char* page){
+    holdPage(ixFileHandle, pageNum);
+    return ixFileHandle.writePage(pageNum, page);
+}
+static RC setRootHeld(IXFileHandle& ixFileHandle, int pageNum){
+    holdPage(ixFileHandle, IndexLatches::META);
+    return ixFileHandle.setRootPageNum(pageNum);
+}
+static void freeHeld(IXFileHandle& ixFileHandle, int pageNum){
+    holdPage(ixFileHandle, pageNum);
+    ixFileHandle.latches().freed.push_back(pageNum);
+}
+
+// the child of an inner node to descend to for k: by upper bound with RIDs, or by lower bound of the
+// key alone where a scan starts; no k takes the first child
+template<AttrType T>
+static int childFor(const char* page, const KeyRef* k, bool withRID){
+    int i = 0;
+    if(FixedPage::usedFor(T)){
+        if(k != nullptr) i = withRID ? fixedUpperBound<T, true>(page, *k) : fixedLowerBound<T, false>(page, *k);
+        return FixedPage::getChild(page, i);
+    }
+    if(k != nullptr) i = withRID ? binarySearchUpperBound<T, true>(page, *k) : binarySearchLowerBound<T, false>(page, *k);
+    const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+    return *(const int*)(page + slotref.offset);
+}
+
+// a leaf copied at version; parent is the page it was reached from, META for the root
+struct LeafRef {
+    int pageNum, parent;
+    uint64_t version, parentVersion;
+};
+
+// Descend to the leaf of k without latches. Each page is copied into page and checked against its
+// version, and a child's version is taken before its parent is checked once more, so no split or
+// merge can slip in between. Returns 1 with the leaf in page, 0 when a writer got in the way and
+// -1 for an empty tree or a page that cannot be read. path keeps a copy of every page on the way.
+template<AttrType T>
+static int findLeaf(IXFileHandle& ixFileHandle, const KeyRef* k, bool withRID, char* page, LeafRef& leaf,
+    PathCopy* path = nullptr){
+    IndexLatches& latches = ixFileHandle.latches();
+    uint64_t version, parentVersion;
+    int pageNum, parent = IndexLatches::META;
+    if(!latches.readLock(parent, parentVersion)) return 0;
+    pageNum = latches.root;
+    if(pageNum == -1) return latches.validate(parent, parentVersion) ? -1 : 0;
+    if(!latches.readLock(pageNum, version) || !latches.validate(parent, parentVersion)) return 0;
+    while(true){
+        if(ixFileHandle.readPage(pageNum, page) < 0) return latches.validate(pageNum, version) ? -1 : 0;
+        if(!latches.validate(pageNum, version)) return 0;
+        if(path != nullptr) {
+            path->pageNums.push_back(pageNum);
+            path->versions.push_back(version);
+            path->pages.insert(path->pages.end(), page, page + PAGE_SIZE);
+        }
+        if(IndexPage::getNextLeafId(page) >= -1) break;
+        int child = childFor<T>(page, k, withRID);
+        parent = pageNum;
+        parentVersion = version;
+        if(!latches.readLock(child, version) || !latches.validate(parent, parentVersion)) return 0;
+        pageNum = child;
+    }
+    leaf = LeafRef{pageNum, parent, version, parentVersion};
+    return 1;
+}
+
+// bytes[j]: what values[0, j) take together
+static std::vector<int> valueBytes(const std::vector<std::vector<char>>& values){
+    std::vector<int> bytes(values.size() + 1, 0);
+    for(size_t j = 0; j < values.size(); ++j) bytes[j + 1] = bytes[j] + values[j].size();
+    return bytes;
+}
+
+// split a leaf where both halves fit and take about the same space. With maxSeparator only where
+// neither half underflows and their separator takes at most that many bytes, -1 if there is no such place.
+static int leafSplitPoint(const std::vector<std::vector<char>>& values, int maxSeparator = PAGE_SIZE){
+    int n = values.size(), best = maxSeparator < PAGE_SIZE ? -1 : n / 2, bestDiff = PAGE_SIZE * 2;
+    std::vector<int> bytes = valueBytes(values);
+    for(int m = 1; m < n; ++m){
+        // the keys are sorted, so the ends of each half tell its prefix
+        int left = IndexPage::leafSize(m, bytes[m], IndexPage::commonPrefixLen(values[0], values[m-1]));
+        int right = IndexPage::leafSize(n - m, bytes[n] - bytes[m], IndexPage::commonPrefixLen(values[m], values[n-1]));
+        if(left > PAGE_SIZE || right > PAGE_SIZE) continue;
+        if(std::abs(left - right) < bestDiff){
+            if(maxSeparator < PAGE_SIZE && (std::min(left, right) * UNDERFLOW_FILL < PAGE_SIZE ||
+                (int)IndexPage::separator(values[m-1], values[m]).size() > maxSeparator)) continue;
+            bestDiff = std::abs(left - right);
+            best = m;
+        }
+    }
+    return best;
+}
+
+// When the entries of k in a leaf take POSTING_MIN_BYTES together with the new one, they move to a
+// posting list and the first of them becomes the entry owning it. i is where k would be inserted.
+template<AttrType T>
+static bool foldIntoPosting(IXFileHandle& ixFileHandle, char* page, int i, const KeyRef& k){
+    int a = i, b = i, last = IndexPage::getSlotCount(page) - 1; // omit the final child-only record
+    while(a > 0 && compareSlot<T, false>(k, page, a - 1) == 0) --a;
+    while(b < last && compareSlot<T, false>(k, page, b) == 0) ++b;
+    int bytes = sizeof(SlotItem) + sizeof(int) + k.len + sizeof(RID);
+    for(int j = a; j < b; ++j)
+        bytes += sizeof(SlotItem) + ((const SlotItem*)(page + IndexPage::PAGEHEADSIZE + j * sizeof(SlotItem)))->data_size;
+    if(a == b || bytes < POSTING_MIN_BYTES) return false;
+    std::vector<RID> rids;
+    for(int j = a; j < b; ++j) rids.push_back(IndexPage::getRID(page, j));
+    rids.insert(rids.begin() + (i - a), k.rid);
+    int head = PostingPage::create(ixFileHandle, rids);
+    if(head < 0) return false;
+    IndexPage::setRID(page, a, PostingPage::marker(head));
+    for(int j = a + 1; j < b; ++j)
+        ((SlotItem*)(page + IndexPage::PAGEHEADSIZE + j * sizeof(SlotItem)))->metadata_size = -1;
+    IndexPage::setEmptySlotFlag(page, true);
+    IndexPage::garbageSlotCollection(page);
+    return true;
+}
+
+// Insert into the leaf pageNum copied in pagebuf and write it. A full leaf only splits within a split
+// or merge (smo): its right half goes to a new page rightAddPageNum and upflowIndexValue separates the two.
+template<AttrType T>
+static LeafResult insertIntoLeaf(IXFileHandle& ixFileHandle, int pageNum, char* pagebuf, const KeyRef& indexitem,
+    bool smo, int& rightAddPageNum, std::vector<char>& upflowIndexValue){
+    IndexPage::garbageSlotCollection(pagebuf);
+    int i = binarySearchLowerBound<T, true>(pagebuf, indexitem);
+    SlotItem& slotref = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+    // the key owns a posting list, or reinsert a same index
+    if(slotref.metadata_size != -1 && i < IndexPage::getSlotCount(pagebuf) - 1 && compareSlot<T, true>(indexitem, pagebuf, i) == 0){
+        RID rid = IndexPage::getRID(pagebuf, i);
+        if(!PostingPage::isPosting(rid) || PostingPage::insert(ixFileHandle, rid.pageNum, indexitem.rid) < 0)
+            return LEAF_FAILED;
+        return LEAF_DONE;
+    }
+    if(foldIntoPosting<T>(ixFileHandle, pagebuf, i, indexitem)){
+        ixFileHandle.writePage(pageNum, pagebuf);
+        return LEAF_DONE;
+    }
+    // a key with the page prefix only stores the rest of it
+    int plen = IndexPage::getPrefixLen(pagebuf);
+    if(indexitem.len >= plen && memcmp(indexitem.key, IndexPage::getPrefix(pagebuf), plen) == 0){
+        std::vector<char> indexValue;
+        pushBackTo(indexValue, indexitem.key + plen, indexitem.len - plen);
+        pushBackTo(indexValue, (const char*)&(indexitem.rid), sizeof(RID));
+        // sizeof( composite key + slot + childPageNum)
+        if(indexValue.size() + sizeof(SlotItem) + sizeof(int) <= IndexPage::getEmptySize(pagebuf)){ // has enough space
+            IndexPage::insertValueTo(pagebuf, -1, indexValue, i);
+            ixFileHandle.writePage(pageNum, pagebuf);
+            return LEAF_DONE;
+        }
+    }
+    // otherwise lay the leaf out again with a new prefix, or as two leaves
+    std::vector<std::vector<char>> values = IndexPage::readLeafValues(pagebuf);
+    std::vector<char> indexValue;
+    pushBackTo(indexValue, indexitem.key, indexitem.len);
+    pushBackTo(indexValue, (const char*)&(indexitem.rid), sizeof(RID));
+    values.insert(values.begin() + i, std::move(indexValue));
+    int n = values.size(), leafid = IndexPage::getNextLeafId(pagebuf);
+    if(IndexPage::leafSize(values, 0, n) <= PAGE_SIZE){
+        IndexPage::buildLeaf(pagebuf, values, 0, n, leafid);
+        ixFileHandle.writePage(pageNum, pagebuf);
+        return LEAF_DONE;
+    }
+    if(!smo) return LEAF_SMO;
+    char newpage[PAGE_SIZE];
+    int m = leafSplitPoint(values);
+    // the right leaf is written first, nothing links to it yet
+    IndexPage::buildLeaf(newpage, values, m, n, leafid);
+    if((rightAddPageNum = ixFileHandle.newPage(newpage)) < 0) return LEAF_FAILED;
+    IndexPage::buildLeaf(pagebuf, values, 0, m, rightAddPageNum);
+    upflowIndexValue = IndexPage::separator(values[m-1], values[m]);
+    ixFileHandle.writePage(pageNum, pagebuf);
+    return LEAF_SPLIT;
+}
+
+template<AttrType T>
+bool recursiveInsert(IXFileHandle& ixFileHandle, int parPageNum, int currPageNum, const KeyRef& indexitem,
+    int& leftAddPageNum, int& rightAddPageNum, std::vector<char>& upflowIndexValue, bool& valid_insertion){
     /* return true: if page overflow */
     char pagebuf[PAGE_SIZE];
-    if(ixFileHandle.readPage(currPageNum, pagebuf) < 0){
+    if(readHeld(ixFileHandle, currPageNum, pagebuf) < 0){
         std::cerr << "[insertError] " << parPageNum<<" "<<currPageNum << " " << ixFileHandle.getNumberOfPages() << std::endl;
         valid_insertion = false;
         return false;
     }
     
     if(IndexPage::getNextLeafId(pagebuf) < -1){ // is not leaf
-        int i = binarySearchUpperBound(pagebuf, indexitem, comp);
+        int i = binarySearchUpperBound<T, true>(pagebuf, indexitem);
         SlotItem& slotref = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
         int leftChildPageNum = *(int*)(pagebuf+slotref.offset);
-        if(recursiveInsert(ixFileHandle, currPageNum, leftChildPageNum, indexitem, leftAddPageNum, rightAddPageNum, upflowIndexValue, comp, valid_insertion)){ // child page overflow
+        if(recursiveInsert<T>(ixFileHandle, currPageNum, leftChildPageNum, indexitem, leftAddPageNum, rightAddPageNum, upflowIndexValue, valid_insertion)){ // child page overflow
             // if(leftAddPageNum == -1 || rightAddPageNum == -1) std::cerr << "[InsertError] leftPage and rightPage"<<std::endl;
             // sizeof( composite key + slot + childPageNum)
             if(upflowIndexValue.size() + sizeof(SlotItem) + sizeof(int) <= IndexPage::getEmptySize(pagebuf)){ // has enough space
                 IndexPage::insertValueTo(pagebuf, leftAddPageNum, upflowIndexValue, i);
                 IndexPage::setChildPageNum(pagebuf, rightAddPageNum, i + 1);
-                ixFileHandle.writePage(currPageNum, pagebuf);
+                writeHeld(ixFileHandle, currPageNum, pagebuf);
                 return false;
             } else {
                 char newpage[PAGE_SIZE];
@@ -111,7 +577,10 @@ bool recursiveInsert(IXFileHandle& ixFileHandle, int parPageNum, int currPageNum
                 IndexPage::insertValueAndSplitPage(pagebuf, newpage, leftAddPageNum, upflowIndexValue, i);
                 IndexPage::setNextLeafId(newpage, NONLEAF); // non leaf node !!!
                 leftAddPageNum = currPageNum;
-                rightAddPageNum = ixFileHandle.getNumberOfPages();
+                if((rightAddPageNum = ixFileHandle.newPage(newpage)) < 0){
+                    valid_insertion = false;
+                    return false;
+                }
                 // non leaf split, uplift left page
                 int oldSlotn = IndexPage::getSlotCount(pagebuf);
                 upflowIndexValue = IndexPage::readRawIndex(pagebuf, oldSlotn-2); // the second last value
@@ -123,279 +592,360 @@ bool recursiveInsert(IXFileHandle& ixFileHandle, int parPageNum, int currPageNum
                 secondlast->data_size = sizeof(child); secondlast->field_num = 1;
                 IndexPage::setSlotTableLen(pagebuf, (oldSlotn-1) * sizeof(SlotItem));
                 // flush to disk
-                ixFileHandle.appendPage(newpage);
-                ixFileHandle.writePage(currPageNum, pagebuf);
+                writeHeld(ixFileHandle, currPageNum, pagebuf);
                 return true;
             }
         }
     } else { // leaf
-        IndexPage::garbageSlotCollection(pagebuf);
-        int i = binarySearchLowerBound(pagebuf, indexitem, comp);
-        SlotItem& slotref = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
-        // reinsert a same index
-        if(slotref.metadata_size != -1 && i < IndexPage::getSlotCount(pagebuf) - 1 && comp(indexitem, IndexPage::readIndexItem(pagebuf, i)) == 0){
-            valid_insertion = false; return false;
+        LeafResult res = insertIntoLeaf<T>(ixFileHandle, currPageNum, pagebuf, indexitem, true, rightAddPageNum, upflowIndexValue);
+        if(res == LEAF_FAILED) valid_insertion = false;
+        leftAddPageNum = currPageNum;
+        return res == LEAF_SPLIT;
+    }
+    return false;
+}
+
+// leafSplitPoint for the values of an inner node, values[m] goes up to the parent
+static int innerSplitPoint(const std::vector<std::vector<char>>& values, int maxSeparator = PAGE_SIZE){
+    int n = values.size(), best = maxSeparator < PAGE_SIZE ? -1 : n / 2, bestDiff = PAGE_SIZE * 2;
+    std::vector<int> bytes = valueBytes(values);
+    for(int m = 1; m < n - 1; ++m){
+        int left = IndexPage::innerSize(m, bytes[m]), right = IndexPage::innerSize(n - m - 1, bytes[n] - bytes[m + 1]);
+        if(left > PAGE_SIZE || right > PAGE_SIZE) continue;
+        if(maxSeparator < PAGE_SIZE && (std::min(left, right) * UNDERFLOW_FILL < PAGE_SIZE ||
+            (int)values[m].size() > maxSeparator)) continue;
+        if(std::abs(left - right) < bestDiff){
+            bestDiff = std::abs(left - right);
+            best = m;
         }
-        std::vector<char> indexValue = indexitem.value; 
-        pushBackTo(indexValue, (const char*)&(indexitem.rid), sizeof(RID));
-        // sizeof( composite key + slot + childPageNum)
-        if(indexValue.size() + sizeof(SlotItem) + sizeof(int) <= IndexPage::getEmptySize(pagebuf)){ // has enough space
-            IndexPage::insertValueTo(pagebuf, -1, indexValue, i);
-            ixFileHandle.writePage(currPageNum, pagebuf);
-            return false;
+    }
+    return best;
+}
+
+static const RC REBALANCE_SKIPPED = 1; // rebalanceChild found no sibling to rebalance with
+
+// Children l and l + 1 of the node with entries and children merge when both fit on one page,
+// otherwise they share their entries evenly, with a separator that still fits in the node. The right
+// page of the two is freed after a merge. 1 when done, 0 when the separator would not fit.
+static RC rebalancePair(IXFileHandle& ixFileHandle, std::vector<std::vector<char>>& entries, std::vector<int>& children, int l){
+    int leftPageNum = children[l], rightPageNum = children[l + 1];
+    // how long the separator of the two may get with the node still fitting on its page
+    int maxSeparator = PAGE_SIZE - IndexPage::innerSize(entries, 0, entries.size()) + entries[l].size();
+    char left[PAGE_SIZE], right[PAGE_SIZE];
+    if(readHeld(ixFileHandle, leftPageNum, left) < 0 || readHeld(ixFileHandle, rightPageNum, right) < 0) return -1;
+    bool merged;
+    if(IndexPage::getNextLeafId(left) >= -1){ // leaves
+        std::vector<std::vector<char>> values = IndexPage::readLeafValues(left), more = IndexPage::readLeafValues(right);
+        std::move(more.begin(), more.end(), std::back_inserter(values));
+        int m = values.size(), nextLeafId = IndexPage::getNextLeafId(right);
+        merged = IndexPage::leafSize(values, 0, m) <= PAGE_SIZE;
+        if(merged){
+            IndexPage::buildLeaf(left, values, 0, m, nextLeafId);
         } else {
-            char newpage[PAGE_SIZE];
-            int leafid = IndexPage::getNextLeafId(pagebuf);
-            IndexPage::insertValueAndSplitPage(pagebuf, newpage, -1, indexValue, i);
-            leftAddPageNum = currPageNum;
-            rightAddPageNum = ixFileHandle.getNumberOfPages();
-            upflowIndexValue = IndexPage::readRawIndex(newpage, 0);
-            // link leaf node
-            IndexPage::setNextLeafId(newpage, leafid);
-            IndexPage::setNextLeafId(pagebuf, rightAddPageNum);
-            // flush to disk
-            ixFileHandle.writePage(currPageNum, pagebuf);
-            ixFileHandle.appendPage(newpage);
-            return true;
+            int k = leafSplitPoint(values, maxSeparator);
+            if(k < 0) return 0;
+            entries[l] = IndexPage::separator(values[k-1], values[k]);
+            IndexPage::buildLeaf(left, values, 0, k, rightPageNum);
+            IndexPage::buildLeaf(right, values, k, m, nextLeafId);
+        }
+    } else {
+        // the separator comes down between the entries of the two nodes
+        std::vector<int> leftChildren, rightChildren;
+        std::vector<std::vector<char>> values = IndexPage::readInnerValues(left, leftChildren);
+        std::vector<std::vector<char>> more = IndexPage::readInnerValues(right, rightChildren);
+        values.push_back(entries[l]);
+        std::move(more.begin(), more.end(), std::back_inserter(values));
+        leftChildren.insert(leftChildren.end(), rightChildren.begin(), rightChildren.end());
+        int m = values.size();
+        merged = IndexPage::innerSize(values, 0, m) <= PAGE_SIZE;
+        if(merged){
+            IndexPage::buildInner(left, values, leftChildren, 0, m);
+        } else {
+            int k = innerSplitPoint(values, maxSeparator);
+            if(k < 0) return 0;
+            entries[l] = values[k];
+            IndexPage::buildInner(left, values, leftChildren, 0, k);
+            IndexPage::buildInner(right, values, leftChildren, k + 1, m);
         }
     }
-    return false;
+    if(merged){
+        entries.erase(entries.begin() + l);
+        children.erase(children.begin() + l + 1);
+    }
+    if(writeHeld(ixFileHandle, leftPageNum, left) < 0) return -1;
+    if(!merged) return writeHeld(ixFileHandle, rightPageNum, right) < 0 ? -1 : 1;
+    freeHeld(ixFileHandle, rightPageNum);
+    return 1;
 }
 
-RC recursiveDelete (IXFileHandle& ixFileHandle,int currPageNum, IndexItem& indexitem, CompFunc comp){
-    char pagebuf[PAGE_SIZE];
-    if(ixFileHandle.readPage(currPageNum, pagebuf) < 0) return -1;
+// Child i of parent underflowed: rebalancePair with its right sibling, or with its left one when the
+// right one is missing or the new separator would not fit. parent is only changed in memory. Returns
+// REBALANCE_SKIPPED when neither sibling works, the child then stays underflowed and a later delete
+// under it tries again.
+static RC rebalanceChild(IXFileHandle& ixFileHandle, char* parent, int i){
+    std::vector<int> children;
+    std::vector<std::vector<char>> entries = IndexPage::readInnerValues(parent, children);
+    int n = entries.size();
+    if(n == 0) return 0;
+    RC rc = 0;
+    if(i < n) rc = rebalancePair(ixFileHandle, entries, children, i);
+    if(rc == 0 && i > 0) rc = rebalancePair(ixFileHandle, entries, children, i - 1);
+    if(rc < 0) return -1;
+    if(rc == 0) return REBALANCE_SKIPPED;
+    IndexPage::buildInner(parent, entries, children, 0, entries.size());
+    return 0;
+}
 
-    while(IndexPage::getNextLeafId(pagebuf) < -1) {
-        // is not leaf
-        int i = binarySearchUpperBound(pagebuf, indexitem, comp);
-        SlotItem &slotref = *(SlotItem *) (pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
-        currPageNum = *(int *) (pagebuf + slotref.offset);
-        if(ixFileHandle.readPage(currPageNum, pagebuf) < 0) return -1;
-    }
-    //is leaf
-    int i = binarySearchLowerBound(pagebuf, indexitem, comp);
+// number of RIDs in the posting list of head
+static int postingTotal(IXFileHandle& ixFileHandle, int head){
+    char page[PAGE_SIZE];
+    return ixFileHandle.readPage(head, page) < 0 ? 0 : PostingPage::getTotal(page);
+}
+
+// Delete from the leaf pageNum copied in pagebuf and write it. Without mayUnderflow a delete that
+// would leave it underflowed is not done.
+template<AttrType T>
+static LeafResult deleteFromLeaf(IXFileHandle& ixFileHandle, int pageNum, char* pagebuf, const KeyRef& indexitem,
+    bool mayUnderflow){
+    int i = binarySearchLowerBound<T, true>(pagebuf, indexitem);
     SlotItem& dSlotref = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
-    if(i == IndexPage::getSlotCount(pagebuf) - 1 || dSlotref.metadata_size == -1 || comp(indexitem, IndexPage::readIndexItem(pagebuf, i)) != 0) {
+    if(i == IndexPage::getSlotCount(pagebuf) - 1 || dSlotref.metadata_size == -1 || compareSlot<T, true>(indexitem, pagebuf, i) != 0) {
         // want to delete a nonexsit key
-        return -1;
+        return LEAF_FAILED;
     }
-    // IndexPage::deleteIndexFrom(pagebuf, i);
+    // a posting list loses one RID, its entry goes with the last one
+    RID rid = IndexPage::getRID(pagebuf, i);
     dSlotref.metadata_size = -1;
     IndexPage::setEmptySlotFlag(pagebuf, true);
-    ixFileHandle.writePage(currPageNum, pagebuf);
+    IndexPage::garbageSlotCollection(pagebuf);
+    bool underflow = IndexPage::underflows(pagebuf);
+    if(underflow && !mayUnderflow && (!PostingPage::isPosting(rid) || postingTotal(ixFileHandle, rid.pageNum) <= 1))
+        return LEAF_SMO;
+    if(PostingPage::isPosting(rid)){
+        bool empty;
+        if(PostingPage::remove(ixFileHandle, rid.pageNum, indexitem.rid, empty) < 0) return LEAF_FAILED;
+        if(!empty) return LEAF_DONE;
+        if(PostingPage::release(ixFileHandle, rid.pageNum) < 0) return LEAF_FAILED;
+    }
+    if(ixFileHandle.writePage(pageNum, pagebuf) < 0) return LEAF_FAILED;
+    return underflow ? LEAF_UNDERFLOW : LEAF_DONE;
+}
+
+// underflow returns whether currPageNum is left less than 1/UNDERFLOW_FILL full
+template<AttrType T>
+RC recursiveDelete(IXFileHandle& ixFileHandle, int currPageNum, const KeyRef& indexitem, bool& underflow){
+    char pagebuf[PAGE_SIZE];
+    underflow = false;
+    if(readHeld(ixFileHandle, currPageNum, pagebuf) < 0) return -1;
+
+    if(IndexPage::getNextLeafId(pagebuf) < -1) { // is not leaf
+        int i = binarySearchUpperBound<T, true>(pagebuf, indexitem);
+        SlotItem &slotref = *(SlotItem *) (pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+        bool childUnderflow;
+        if(recursiveDelete<T>(ixFileHandle, *(int *) (pagebuf + slotref.offset), indexitem, childUnderflow) < 0) return -1;
+        if(!childUnderflow) return 0;
+        RC rc = rebalanceChild(ixFileHandle, pagebuf, i);
+        if(rc < 0) return -1;
+        if(rc == REBALANCE_SKIPPED) return 0; // parent unchanged
+        underflow = IndexPage::underflows(pagebuf);
+        return writeHeld(ixFileHandle, currPageNum, pagebuf);
+    }
+    //is leaf
+    LeafResult res = deleteFromLeaf<T>(ixFileHandle, currPageNum, pagebuf, indexitem, true);
+    underflow = res == LEAF_UNDERFLOW;
+    return res == LEAF_FAILED ? -1 : 0;
+}
+
+// foldIntoPosting for a FixedPage leaf
+template<AttrType T>
+static bool foldIntoPostingFixed(IXFileHandle& ixFileHandle, char* page, int i, const KeyRef& k){
+    int a = i, b = i, n = FixedPage::getCount(page);
+    while(a > 0 && compareFixed<T, false>(k, page, a - 1) == 0) --a;
+    while(b < n && compareFixed<T, false>(k, page, b) == 0) ++b;
+    if(a == b || (b - a + 1) * (FixedPage::KEYSIZE + sizeof(RID)) < POSTING_MIN_BYTES) return false;
+    std::vector<RID> rids;
+    for(int j = a; j < b; ++j) rids.push_back(FixedPage::getRID(page, j));
+    rids.insert(rids.begin() + (i - a), k.rid);
+    int head = PostingPage::create(ixFileHandle, rids);
+    if(head < 0) return false;
+    char value[FixedPage::KEYSIZE + sizeof(RID)];
+    RID marker = PostingPage::marker(head);
+    memcpy(value, FixedPage::keyAt(page, a), FixedPage::KEYSIZE);
+    memcpy(value + FixedPage::KEYSIZE, &marker, sizeof(RID));
+    FixedPage::setEntry(page, a, value);
+    for(int j = a + 1; j < b; ++j) FixedPage::setDeleted(page, j, true);
+    FixedPage::garbageSlotCollection(page);
+    return true;
+}
+
+// Insert value at i of the FixedPage pageNum copied in pagebuf, on an inner node with rightChild right
+// of it, and write it. Within a split or merge (smo) a full page splits: its upper half goes to a new
+// page rightAddPageNum and value returns the entry going up. Otherwise a full page is left alone.
+static LeafResult insertFixedAt(IXFileHandle& ixFileHandle, int pageNum, char* pagebuf, int i, std::vector<char>& value,
+    int rightChild, bool smo, int& rightAddPageNum){
+    if(FixedPage::getCount(pagebuf) < FixedPage::getCapacity(pagebuf)){ // has enough space
+        FixedPage::insertAt(pagebuf, i, value.data(), rightChild);
+        if(smo) writeHeld(ixFileHandle, pageNum, pagebuf);
+        else ixFileHandle.writePage(pageNum, pagebuf);
+        return LEAF_DONE;
+    }
+    if(!smo) return LEAF_SMO;
+    char newpage[PAGE_SIZE];
+    FixedPage::insertAndSplit(pagebuf, newpage, i, value, rightChild);
+    if((rightAddPageNum = ixFileHandle.newPage(newpage)) < 0) return LEAF_FAILED;
+    if(FixedPage::isLeaf(pagebuf)) IndexPage::setNextLeafId(pagebuf, rightAddPageNum); // link leaf node
+    writeHeld(ixFileHandle, pageNum, pagebuf);
+    return LEAF_SPLIT;
+}
+
+// insertIntoLeaf for a FixedPage leaf
+template<AttrType T>
+static LeafResult insertIntoFixedLeaf(IXFileHandle& ixFileHandle, int pageNum, char* pagebuf, const KeyRef& indexitem,
+    bool smo, int& rightAddPageNum, std::vector<char>& upflowIndexValue){
+    FixedPage::garbageSlotCollection(pagebuf);
+    int i = fixedLowerBound<T, true>(pagebuf, indexitem);
+    // the key owns a posting list, or reinsert a same index
+    if(i < FixedPage::getCount(pagebuf) && compareFixed<T, true>(indexitem, pagebuf, i) == 0){
+        RID rid = FixedPage::getRID(pagebuf, i);
+        if(!PostingPage::isPosting(rid) || PostingPage::insert(ixFileHandle, rid.pageNum, indexitem.rid) < 0)
+            return LEAF_FAILED;
+        return LEAF_DONE;
+    }
+    if(foldIntoPostingFixed<T>(ixFileHandle, pagebuf, i, indexitem)){
+        ixFileHandle.writePage(pageNum, pagebuf);
+        return LEAF_DONE;
+    }
+    upflowIndexValue.clear();
+    pushBackTo(upflowIndexValue, indexitem.key, indexitem.len);
+    pushBackTo(upflowIndexValue, (const char*)&(indexitem.rid), sizeof(RID));
+    return insertFixedAt(ixFileHandle, pageNum, pagebuf, i, upflowIndexValue, -1, smo, rightAddPageNum);
+}
+
+template<AttrType T>
+bool recursiveInsertFixed(IXFileHandle& ixFileHandle, int currPageNum, const KeyRef& indexitem,
+    int& leftAddPageNum, int& rightAddPageNum, std::vector<char>& upflowIndexValue, bool& valid_insertion){
+    /* return true: if page overflow */
+    char pagebuf[PAGE_SIZE];
+    if(readHeld(ixFileHandle, currPageNum, pagebuf) < 0){
+        valid_insertion = false;
+        return false;
+    }
+    LeafResult res;
+    if(!FixedPage::isLeaf(pagebuf)){
+        int i = fixedUpperBound<T, true>(pagebuf, indexitem);
+        if(!recursiveInsertFixed<T>(ixFileHandle, FixedPage::getChild(pagebuf, i), indexitem, leftAddPageNum, rightAddPageNum, upflowIndexValue, valid_insertion))
+            return false;
+        // child page overflow: its upflow value goes to i with the new page right of it
+        res = insertFixedAt(ixFileHandle, currPageNum, pagebuf, i, upflowIndexValue, rightAddPageNum, true, rightAddPageNum);
+    } else {
+        res = insertIntoFixedLeaf<T>(ixFileHandle, currPageNum, pagebuf, indexitem, true, rightAddPageNum, upflowIndexValue);
+    }
+    if(res == LEAF_FAILED) valid_insertion = false;
+    leftAddPageNum = currPageNum;
+    return res == LEAF_SPLIT;
+}
+
+// rebalanceChild for FixedPage; a leaf split copies the first key of the right page up, so does this
+static RC rebalanceFixedChild(IXFileHandle& ixFileHandle, char* parent, int i){
+    int n = FixedPage::getCount(parent);
+    if(n == 0) return 0;
+    int l = i < n ? i : i - 1, leftPageNum = FixedPage::getChild(parent, l), rightPageNum = FixedPage::getChild(parent, l + 1);
+    char left[PAGE_SIZE], right[PAGE_SIZE];
+    if(readHeld(ixFileHandle, leftPageNum, left) < 0 || readHeld(ixFileHandle, rightPageNum, right) < 0) return -1;
+    FixedPage::garbageSlotCollection(left);
+    FixedPage::garbageSlotCollection(right);
+    // entries of both pages in order, the separator from parent between those of inner nodes
+    const int entrySize = FixedPage::KEYSIZE + sizeof(RID);
+    bool leaf = FixedPage::isLeaf(left);
+    std::vector<char> entries;
+    std::vector<int> children;
+    auto collect = [&](const char* page){
+        for(int j = 0; j < FixedPage::getCount(page); ++j){
+            RID rid = FixedPage::getRID(page, j);
+            pushBackTo(entries, FixedPage::keyAt(page, j), FixedPage::KEYSIZE);
+            pushBackTo(entries, (const char*)&rid, sizeof(RID));
+            if(!leaf) children.push_back(FixedPage::getChild(page, j));
+        }
+        if(!leaf) children.push_back(FixedPage::getChild(page, FixedPage::getCount(page)));
+    };
+    collect(left);
+    if(!leaf){
+        RID rid = FixedPage::getRID(parent, l);
+        pushBackTo(entries, FixedPage::keyAt(parent, l), FixedPage::KEYSIZE);
+        pushBackTo(entries, (const char*)&rid, sizeof(RID));
+    }
+    collect(right);
+    int total = entries.size() / entrySize, nextLeafId = IndexPage::getNextLeafId(right);
+    bool merged = total <= FixedPage::getCapacity(left);
+    int k = merged ? total : total / 2, r = leaf ? k : k + 1;
+    FixedPage::InitializePage(left, !leaf ? NONLEAF : merged ? nextLeafId : rightPageNum);
+    for(int j = 0; j < k; ++j) FixedPage::setEntry(left, j, entries.data() + j * entrySize);
+    FixedPage::setCount(left, k);
+    if(!leaf) for(int j = 0; j <= k; ++j) FixedPage::setChild(left, j, children[j]);
+    if(merged){
+        FixedPage::removeAt(parent, l);
+    } else {
+        FixedPage::InitializePage(right, leaf ? nextLeafId : NONLEAF);
+        for(int j = r; j < total; ++j) FixedPage::setEntry(right, j - r, entries.data() + j * entrySize);
+        FixedPage::setCount(right, total - r);
+        if(!leaf) for(int j = r; j <= total; ++j) FixedPage::setChild(right, j - r, children[j]);
+        FixedPage::setEntry(parent, l, entries.data() + k * entrySize);
+    }
+    if(writeHeld(ixFileHandle, leftPageNum, left) < 0) return -1;
+    if(!merged) return writeHeld(ixFileHandle, rightPageNum, right);
+    freeHeld(ixFileHandle, rightPageNum);
     return 0;
+}
+
+// deleteFromLeaf for a FixedPage leaf
+template<AttrType T>
+static LeafResult deleteFromFixedLeaf(IXFileHandle& ixFileHandle, int pageNum, char* pagebuf, const KeyRef& indexitem,
+    bool mayUnderflow){
+    FixedPage::garbageSlotCollection(pagebuf);
+    int i = fixedLowerBound<T, true>(pagebuf, indexitem);
+    if(i == FixedPage::getCount(pagebuf) || compareFixed<T, true>(indexitem, pagebuf, i) != 0) {
+        // want to delete a nonexsit key
+        return LEAF_FAILED;
+    }
+    // a posting list loses one RID, its entry goes with the last one
+    RID rid = FixedPage::getRID(pagebuf, i);
+    FixedPage::removeAt(pagebuf, i);
+    bool underflow = FixedPage::underflows(pagebuf);
+    if(underflow && !mayUnderflow && (!PostingPage::isPosting(rid) || postingTotal(ixFileHandle, rid.pageNum) <= 1))
+        return LEAF_SMO;
+    if(PostingPage::isPosting(rid)){
+        bool empty;
+        if(PostingPage::remove(ixFileHandle, rid.pageNum, indexitem.rid, empty) < 0) return LEAF_FAILED;
+        if(!empty) return LEAF_DONE;
+        if(PostingPage::release(ixFileHandle, rid.pageNum) < 0) return LEAF_FAILED;
+    }
+    if(ixFileHandle.writePage(pageNum, pagebuf) < 0) return LEAF_FAILED;
+    return underflow ? LEAF_UNDERFLOW : LEAF_DONE;
+}
 
-    //        if(recursiveDelete(ixFileHandle, currPageNum, leftChildPageNum, indexitem, mergeDirection, i, comp, valid_deletion)) {
-    //
-    //
-    //
-    //            //子节点存在merge
-    //            /* if (mergeDirection<0){
-    //                //子节点与左兄弟merge
-    //                SlotItem& tmpslot = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + (i-1) * sizeof(SlotItem));
-    //                if(sizeof(SlotItem) + tmpslot.data_size + IndexPage::getEmptySize(pagebuf) <= PAGE_SIZE/2 ){
-    //                    //size >= 50%
-    //                    // move index part
-    //                    SlotItem& startslot = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + (i-1) * sizeof(SlotItem));
-    //                    SlotItem& endslot = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE +  IndexPage::getSlotTableLen(pagebuf) - sizeof(SlotItem));
-    //                    TypeOffset movestart = endslot.offset;
-    //                    TypeOffset moveend = startslot.offset;
-    //                    int len = startslot.data_size;
-    //                    IndexPage::compress(pagebuf, movestart, moveend, len);
-    //                    // move slot table part
-    //                    movestart = IndexPage::PAGEHEADSIZE + (i+1) * sizeof(SlotItem);
-    //                    moveend = IndexPage::PAGEHEADSIZE + IndexPage::getSlotTableLen(pagebuf);
-    //                    IndexPage::compress(pagebuf, movestart, moveend, -sizeof(SlotItem));
-    //                    ixFileHandle.writePage(currPageNum, pagebuf);
-    //                    return false;
-    //                }
-    //                else {
-    //                    //size<50%
-    //                    //借
-    //                    char tmpPage[PAGE_SIZE];
-    //
-    //                    if(parIndex>0) {
-    //                        //有左兄弟
-    //                        if (ixFileHandle.readPage(parPageNum, tmpPage) < 0) return -1;
-    //                        SlotItem& tmpslot = *(SlotItem*)(tmpPage + IndexPage::PAGEHEADSIZE + (parIndex-1) * sizeof(SlotItem));
-    //                        int leftPageNum = *(int *) (tmpPage + tmpslot.offset);
-    //                        if (ixFileHandle.readPage(leftPageNum, tmpPage) < 0) return -1;
-    //                        SlotItem& moveslot = *(SlotItem*)(tmpPage + IndexPage::PAGEHEADSIZE+IndexPage::getSlotTableLen(tmpPage)-sizeof(SlotItem));
-    //                        if (IndexPage::getEmptySize(tmpPage)+sizeof(SlotItem)+moveslot.data_size <= PAGE_SIZE/2) {
-    //                            //可从左借 借最后个
-    //                            int slotIndex = IndexPage::getSlotCount(tmpPage)-1;
-    //                            std::vector<char> moveindex = IndexPage::readRawIndex(tmpPage,slotIndex);
-    //                            int childPageNum = *(int*)(tmpPage+moveslot.data_size);
-    //                            ixFileHandle.writePage(leftPageNum,tmpPage);
-    //                            IndexPage::insertValueTo(pagebuf,childPageNum,moveindex,IndexPage::getSlotCount(pagebuf));
-    //                            ixFileHandle.writePage(currPageNum,pagebuf);
-    //                            return false;
-    //                        }
-    //                    }
-    //
-    //                    if (ixFileHandle.readPage(parPageNum, tmpPage) < 0) return -1;
-    //                    if(IndexPage::getSlotCount(tmpPage)>parIndex+1){
-    //                        //有右兄弟
-    //                        SlotItem& tmpslot = *(SlotItem*)(tmpPage + IndexPage::PAGEHEADSIZE + (parIndex+1) * sizeof(SlotItem));
-    //                        int rightPageNum = *(int *) (tmpPage + tmpslot.offset);
-    //                        if (ixFileHandle.readPage(rightPageNum, tmpPage) < 0) return -1;
-    //                        SlotItem &moveslot = *(SlotItem *) (tmpPage + IndexPage::PAGEHEADSIZE);
-    //                        if (IndexPage::getEmptySize(tmpPage) + sizeof(SlotItem) + moveslot.data_size <= PAGE_SIZE / 2) {
-    //                            //可从右借 借第一个
-    //                            int slotIndex = 0;
-    //                            std::vector<char> moveindex = IndexPage::readRawIndex(tmpPage, slotIndex);
-    //                            int childPageNum = *(int *) (tmpPage + moveslot.data_size);
-    //                            ixFileHandle.writePage(rightPageNum, tmpPage);
-    //                            IndexPage::insertValueTo(pagebuf, childPageNum, moveindex, IndexPage::getSlotCount(pagebuf));
-    //                            ixFileHandle.writePage(currPageNum, pagebuf);
-    //                            return false;
-    //                        }
-    //                    }
-    //
-    //                    //merge
-    //                    if (ixFileHandle.readPage(parPageNum, tmpPage) < 0) return -1;
-    //                    if(IndexPage::getSlotCount(tmpPage)>parIndex+1){
-    //                        //有右兄弟
-    //                        SlotItem& tmpslot = *(SlotItem*)(tmpPage + IndexPage::PAGEHEADSIZE + (parIndex+1) * sizeof(SlotItem));
-    //                        int rightPageNum = *(int *) (tmpPage + tmpslot.offset);
-    //                        if (ixFileHandle.readPage(rightPageNum, tmpPage) < 0) return -1;
-    //                        if (IndexPage::getEmptySize(tmpPage)>=PAGE_SIZE-IndexPage::getEmptySize(pagebuf)-IndexPage::PAGEHEADSIZE) {
-    //                            //右兄弟够merge
-    //                            for(int j=0;j<IndexPage::getSlotCount(pagebuf);j++) {
-    //                                SlotItem& sloti = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
-    //                                std::vector<char> moveindex ;
-    //                                int len = slotref.data_size - sizeof(int);
-    //                                pushBackTo(moveindex, pagebuf + slotref.offset + sizeof(int), len);
-    //                                int childpage = *(int *)(pagebuf + slotref.offset);
-    //                                //待完善 我猜有函数能在中间节点插入
-    //                                //IndexPage::insertValueTo(tmpPage,childpage,moveindex,IndexPage::getSlotCount(tmpPage));
-    //                            }
-    //                            ixFileHandle.writePage(rightPageNum,tmpPage);
-    //                            //待完善 改链表和元数据页空页头结点，设置mergedChildPageNum 返回
-    //                        }
-    //
-    //                    }
-    //
-    //                    if(parIndex>0) {
-    //                        //有左兄弟
-    //                        if (ixFileHandle.readPage(parPageNum, tmpPage) < 0) return -1;
-    //                        SlotItem& tmpslot = *(SlotItem*)(tmpPage + IndexPage::PAGEHEADSIZE + (parIndex-1) * sizeof(SlotItem));
-    //                        int leftPageNum = *(int *) (tmpPage + tmpslot.offset);
-    //                        if (ixFileHandle.readPage(leftPageNum, tmpPage) < 0) return -1;
-    //                        if (IndexPage::getEmptySize(tmpPage)>=PAGE_SIZE-IndexPage::getEmptySize(pagebuf)-IndexPage::PAGEHEADSIZE) {
-    //                            //左兄弟够merge
-    //                            for(int j=0;j<IndexPage::getSlotCount(pagebuf);j++) {
-    //                                SlotItem& sloti = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
-    //                                std::vector<char> moveindex ;
-    //                                int len = slotref.data_size - sizeof(int);
-    //                                pushBackTo(moveindex, pagebuf + slotref.offset + sizeof(int), len);
-    //                                int childpage = *(int *)(pagebuf + slotref.offset);
-    //                                //待完善 我猜有函数能在中间节点插入
-    //                                //IndexPage::insertValueTo(tmpPage,childpage,moveindex,IndexPage::getSlotCount(tmpPage));
-    //                            }
-    //                            ixFileHandle.writePage(leftPageNum,tmpPage);
-    //                            //待完善 改链表和元数据页空页头结点，设置mergedChildPageNum 返回
-    //                        }
-    //                    }
-    //
-    //
-    //                    //都不能merge, 直接删
-    //                    // move index part
-    //                    SlotItem& startslot = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE + (i-1) * sizeof(SlotItem));
-    //                    SlotItem& endslot = *(SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE +  IndexPage::getSlotTableLen(pagebuf) - sizeof(SlotItem));
-    //                    TypeOffset movestart = endslot.offset;
-    //                    TypeOffset moveend = startslot.offset;
-    //                    int len = startslot.data_size;
-    //                    IndexPage::compress(pagebuf, movestart, moveend, len);
-    //                    // move slot table part
-    //                    movestart = IndexPage::PAGEHEADSIZE + (i+1) * sizeof(SlotItem);
-    //                    moveend = IndexPage::PAGEHEADSIZE + IndexPage::getSlotTableLen(pagebuf);
-    //                    IndexPage::compress(pagebuf, movestart, moveend, -sizeof(SlotItem));
-    //                    ixFileHandle.writePage(currPageNum, pagebuf);
-    //                    return false;
-    //                }
-    //            } */
-    //        }
-    //    } else {// leaf
-    //        int i = binarySearchLowerBound(pagebuf, indexitem, comp);
-    //        if(i == IndexPage::getSlotCount(pagebuf) - 1 || comp(indexitem, IndexPage::readIndexItem(pagebuf, i)) != 0) { // want to delete a nonexsit key
-    //            valid_deletion = false;
-    //            return false;
-    //        }
-    //        if((indexitem.value.size() + sizeof(RID) + sizeof(SlotItem) + sizeof(int) + IndexPage::getEmptySize(pagebuf)) * 2 <= PAGE_SIZE ){
-    //            //size >= 50%
-    //            // move index part
-    //            IndexPage::deleteIndexFrom(pagebuf, i);
-    //            ixFileHandle.writePage(currPageNum, pagebuf);
-    //            return false;
-    //        } else {
-    //            //size < 50%
-    //            /*
-    //            char tmpPage[PAGE_SIZE];
-    //            //借
-    //            int siblingId;
-    //            if((siblingId = IndexPage::getNextLeafId(pagebuf)) != -1) {
-    //                //有右兄弟
-    //                if (ixFileHandle.readPage(siblingId, tmpPage) < 0) return -1;
-    //                SlotItem &moveslot = *(SlotItem *) (tmpPage + IndexPage::PAGEHEADSIZE);
-    //                if (IndexPage::getEmptySize(tmpPage) + sizeof(SlotItem) + moveslot.data_size <= PAGE_SIZE / 2) {
-    //                    //可从右借 借第一个
-    //                    int slotIndex = 0;
-    //                    std::vector<char> moveindex = IndexPage::readRawIndex(tmpPage, slotIndex);
-    //                    int childPageNum = *(int *) (tmpPage + moveslot.data_size);
-    //                    ixFileHandle.writePage(currPageNum + 1, tmpPage);
-    //                    IndexPage::insertValueTo(pagebuf, childPageNum, moveindex, IndexPage::getSlotCount(pagebuf));
-    //                    ixFileHandle.writePage(currPageNum, pagebuf);
-    //                    return false;
-    //                }
-    //            }
-    //
-    //            if (ixFileHandle.readPage(currPageNum-1, tmpPage) == 1 && IndexPage::getNextLeafId(tmpPage)>=-1) {
-    //                //有左兄弟
-    //                SlotItem& moveslot = *(SlotItem*)(tmpPage + IndexPage::PAGEHEADSIZE+IndexPage::getSlotTableLen(tmpPage)-
-    //                                                  sizeof(SlotItem));
-    //                if (IndexPage::getEmptySize(tmpPage)+sizeof(SlotItem)+moveslot.data_size <= PAGE_SIZE/2) {
-    //                    //可从左借 借最后个
-    //                    int slotIndex = IndexPage::getSlotCount(tmpPage)-1;
-    //                    std::vector<char> moveindex = IndexPage::readRawIndex(tmpPage,slotIndex);
-    //                    int childPageNum = *(int*)(tmpPage+moveslot.data_size);
-    //                    ixFileHandle.writePage(currPageNum-1,tmpPage);
-    //                    IndexPage::insertValueTo(pagebuf,childPageNum,moveindex,IndexPage::getSlotCount(pagebuf));
-    //                    ixFileHandle.writePage(currPageNum,pagebuf);
-    //                    return false;
-    //                }
-    //            }
-    //
-    //            //merge
-    //            if(ixFileHandle.readPage(currPageNum+1, tmpPage) == 1 && IndexPage::getEmptySize(tmpPage)>=PAGE_SIZE-IndexPage::getEmptySize(pagebuf)-IndexPage::PAGEHEADSIZE) {
-    //                //右兄弟够merge
-    //                for(int j=0;j<IndexPage::getSlotCount(pagebuf);j++) {
-    //                    std::vector<char> moveindex = IndexPage::readRawIndex(pagebuf,j);
-    //                    IndexPage::insertValueTo(tmpPage,-1,moveindex,IndexPage::getSlotCount(tmpPage));
-    //                }
-    //                ixFileHandle.writePage(currPageNum+1,tmpPage);
-    //                //待完善 改链表和元数据页空页头结点，设置mergedChildPageNum 返回
-    //            }
-    //
-    //            if(ixFileHandle.readPage(currPageNum-1, tmpPage) == 1 && IndexPage::getEmptySize(tmpPage)>=PAGE_SIZE-IndexPage::getEmptySize(pagebuf)-IndexPage::PAGEHEADSIZE) {
-    //                //左兄弟够merge
-    //                for(int j=0;j<IndexPage::getSlotCount(pagebuf);j++) {
-    //                    std::vector<char> moveindex = IndexPage::readRawIndex(pagebuf,j);
-    //                    IndexPage::insertValueTo(tmpPage,-1,moveindex,IndexPage::getSlotCount(tmpPage));
-    //                }
-    //                ixFileHandle.writePage(currPageNum-1,tmpPage);
-    //                //待完善 改链表和元数据页空页头结点，设置mergedChildPageNum 返回
-    //            } */
-    //
-    //            //都不能merge, 直接删
-    //            // move index part
-    //            IndexPage::deleteIndexFrom(pagebuf, i);
-    //            ixFileHandle.writePage(currPageNum, pagebuf);
-    //            return false;
-    //        }
-    //    }
-    //    return false;
+template<AttrType T>
+RC deleteFixed(IXFileHandle& ixFileHandle, int currPageNum, const KeyRef& indexitem, bool& underflow){
+    char pagebuf[PAGE_SIZE];
+    underflow = false;
+    if(readHeld(ixFileHandle, currPageNum, pagebuf) < 0) return -1;
+    if(!FixedPage::isLeaf(pagebuf)) {
+        int i = fixedUpperBound<T, true>(pagebuf, indexitem);
+        bool childUnderflow;
+        if(deleteFixed<T>(ixFileHandle, FixedPage::getChild(pagebuf, i), indexitem, childUnderflow) < 0) return -1;
+        if(!childUnderflow) return 0;
+        if(rebalanceFixedChild(ixFileHandle, pagebuf, i) < 0) return -1;
+        underflow = FixedPage::underflows(pagebuf);
+        return writeHeld(ixFileHandle, currPageNum, pagebuf);
+    }
+    LeafResult res = deleteFromFixedLeaf<T>(ixFileHandle, currPageNum, pagebuf, indexitem, true);
+    underflow = res == LEAF_UNDERFLOW;
+    return res == LEAF_FAILED ? -1 : 0;
+}
+
+// the RIDs an entry stands for
+static std::vector<RID> entryRIDs(IXFileHandle &ixFileHandle, const RID &rid) {
+    if(!PostingPage::isPosting(rid)) return std::vector<RID>(1, rid);
+    return PostingPage::readAll(ixFileHandle, rid.pageNum);
 }
 
 void printPage(IXFileHandle &ixFileHandle, int currPageNum, std::function<std::string(char*, const SlotItem&)> p) {
@@ -425,22 +975,23 @@ void printPage(IXFileHandle &ixFileHandle, int currPageNum, std::function<std::s
         std::cout<<"]}";
     } else {//leaf node
         int slotCount = IndexPage::getSlotCount(pagebuf) - 1; // don't print the child-only one
+        std::string prefix(IndexPage::getPrefix(pagebuf), IndexPage::getPrefixLen(pagebuf));
         std::cout<<"{\"keys\":[";
         std::string s = "";
         for(int i=0;i <slotCount;i++ ) {
             SlotItem &slot = *(SlotItem *) (pagebuf + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
             if(slot.metadata_size==-1) continue;
             char *key_start = pagebuf + slot.offset + sizeof(int);
-            std::string key = p(key_start, slot);
-            if(key != s) {
-                if(s!="") std::cout<<"]\",";
-                std::cout<<("\""+key+":[");
-                char *RID_start = pagebuf + slot.offset+slot.data_size- sizeof(RID);
-                std::cout<<"("<<*(unsigned*)RID_start<<","<<*(unsigned*)(RID_start+ sizeof(unsigned)) <<")";
-                s=key;
-            } else {
-                char *RID_start = pagebuf + slot.offset+slot.data_size- sizeof(RID);
-                std::cout<<",("<<*(unsigned*)RID_start<<","<<*(unsigned*)(RID_start+ sizeof(unsigned))<<")";
+            std::string key = prefix + p(key_start, slot);
+            for(const RID& rid: entryRIDs(ixFileHandle, IndexPage::getRID(pagebuf, i))) {
+                if(key != s) {
+                    if(s!="") std::cout<<"]\",";
+                    std::cout<<("\""+key+":[");
+                    std::cout<<"("<<rid.pageNum<<","<<rid.slotNum <<")";
+                    s=key;
+                } else {
+                    std::cout<<",("<<rid.pageNum<<","<<rid.slotNum<<")";
+                }
             }
 
             if(i == slotCount - 1) std::cout <<"]\"";
@@ -449,6 +1000,46 @@ void printPage(IXFileHandle &ixFileHandle, int currPageNum, std::function<std::s
     }
 }
 
+void printFixedPage(IXFileHandle &ixFileHandle, int currPageNum, std::function<std::string(char*, const SlotItem&)> p) {
+    char pagebuf[PAGE_SIZE];
+    if(ixFileHandle.readPage(currPageNum, pagebuf) < 0) return;
+    int count = FixedPage::getCount(pagebuf);
+    SlotItem slot; // only varchar keys need their slot
+    if(!FixedPage::isLeaf(pagebuf)) {
+        std::cout<<"{\"keys\":[";
+        for(int i = 0; i < count; i++) {
+            std::cout << "\""<<p((char*)FixedPage::keyAt(pagebuf, i), slot)<<"\"";
+            if(i != count - 1) std::cout <<",";
+        }
+        std::cout << "],"<<std::endl;
+        std::cout<<"\"children\": ["<<std::endl;
+        for(int i = 0; i <= count; i++) {
+            printFixedPage(ixFileHandle, FixedPage::getChild(pagebuf, i), p);
+            if(i != count) std::cout <<","<<std::endl;
+        }
+        std::cout<<"]}";
+    } else {
+        std::cout<<"{\"keys\":[";
+        std::string s = "";
+        for(int i = 0; i < count; i++) {
+            if(FixedPage::isDeleted(pagebuf, i)) continue;
+            std::string key = p((char*)FixedPage::keyAt(pagebuf, i), slot);
+            for(const RID& rid: entryRIDs(ixFileHandle, FixedPage::getRID(pagebuf, i))) {
+                if(key != s) {
+                    if(s!="") std::cout<<"]\",";
+                    std::cout<<("\""+key+":[");
+                    std::cout<<"("<<rid.pageNum<<","<<rid.slotNum<<")";
+                    s=key;
+                } else {
+                    std::cout<<",("<<rid.pageNum<<","<<rid.slotNum<<")";
+                }
+            }
+        }
+        if(s!="") std::cout<<"]\"";
+        std::cout << "]}"<<std::endl;
+    }
+}
+
 std::string printInt(char* start, const SlotItem& s){
     return std::to_string(*(int*)(start));
 }
@@ -464,87 +1055,862 @@ std::string printVarChar(char* start, const SlotItem& slot){
     return s;
 }
 
+/* ========== hash index ============== */
+// the header field after the idle page
+static const int INDEX_KIND_OFFSET = 3 * sizeof(unsigned) + 2 * sizeof(int);
+
+template<AttrType T>
+static int compareKeyOf(const char* a, int alen, const char* b, int blen){
+    return compareKey<T>(a, alen, b, blen);
+}
+static int compareKeyOf(AttrType type, const char* a, int alen, const char* b, int blen){
+    switch(type) {
+        case TypeInt: return compareKeyOf<TypeInt>(a, alen, b, blen);
+        case TypeReal: return compareKeyOf<TypeReal>(a, alen, b, blen);
+        case TypeVarChar: return compareKeyOf<TypeVarChar>(a, alen, b, blen);
+    }
+    return 0;
+}
+
+// equal keys must have equal bytes to share a hash, so -0.0 is stored as 0.0
+static unsigned hashOf(AttrType type, IndexItem& item){
+    if(type == TypeReal && *(float*)item.value.data() == 0) *(float*)item.value.data() = 0;
+    return HashPage::hash(item.value.data(), item.value.size());
+}
+
+// the bucket of hash h and its version, and the number of directory slots; false when a writer holds
+// the bucket or the directory changed meanwhile
+static bool findBucket(IndexLatches& latches, unsigned h, int& pageNum, uint64_t& version, unsigned& slots){
+    uint64_t dirVersion;
+    if(!latches.readLock(IndexLatches::META, dirVersion)) return false;
+    {
+        std::lock_guard<std::mutex> lock(latches.dirMutex);
+        slots = latches.dir.size();
+        pageNum = latches.dir[h & (slots - 1)];
+    }
+    return latches.readLock(pageNum, version) && latches.validate(IndexLatches::META, dirVersion);
+}
+
+// Copy a bucket and its overflow pages, pages holds one copy per page of pageNums. Unless the bucket is
+// held, its version is checked after each page, so a next pointer is only followed while the chain is
+// unchanged. 1: read, 0: the bucket changed, -1: a page could not be read
+static int readBucket(IXFileHandle& ixFileHandle, int head, const uint64_t* version,
+                      std::vector<int>& pageNums, std::vector<char>& pages){
+    IndexLatches& latches = ixFileHandle.latches();
+    pageNums.clear();
+    pages.clear();
+    for(int pageNum = head; pageNum != -1; pageNum = HashPage::getNextPage(pages.data() + pages.size() - PAGE_SIZE)) {
+        pages.resize(pages.size() + PAGE_SIZE);
+        RC rc = ixFileHandle.readPage(pageNum, pages.data() + pages.size() - PAGE_SIZE);
+        if(version != nullptr && !latches.validate(head, *version)) return 0;
+        if(rc < 0) return -1;
+        pageNums.push_back(pageNum);
+    }
+    return 1;
+}
+
+// page and offset of the entry of item in a bucket copy
+static bool findInBucket(std::vector<char>& pages, unsigned h, const IndexItem& item, int& index, int& offset){
+    for(size_t i = 0; i < pages.size() / PAGE_SIZE; ++i) {
+        const char* page = pages.data() + i * PAGE_SIZE;
+        for(int off = HashPage::HEADSIZE, end = off + HashPage::getUsed(page); off < end; off += HashPage::entrySize(page + off)) {
+            if(HashPage::matches(page + off, h, item.value.data(), item.value.size()) &&
+               compareRID(HashPage::getRID(page + off), item.rid) == 0) {
+                index = i;
+                offset = off;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// a split separates the entries of a bucket unless they all have hash h, or it is as deep as it may get
+static bool canSplit(const std::vector<char>& pages, unsigned h){
+    if(HashPage::getLocalDepth(pages.data()) >= HASH_MAX_DEPTH) return false;
+    for(size_t i = 0; i < pages.size() / PAGE_SIZE; ++i) {
+        const char* page = pages.data() + i * PAGE_SIZE;
+        for(int off = HashPage::HEADSIZE, end = off + HashPage::getUsed(page); off < end; off += HashPage::entrySize(page + off)) {
+            if(HashPage::getHash(page + off) != h) return true;
+        }
+    }
+    return false;
+}
+
+static LeafResult insertIntoBucket(IXFileHandle& ixFileHandle, unsigned h, const IndexItem& item,
+                                   const std::vector<int>& pageNums, std::vector<char>& pages){
+    int index, offset;
+    if(findInBucket(pages, h, item, index, offset)) return LEAF_FAILED;
+    const char* key = item.value.data();
+    int len = item.value.size();
+    for(size_t i = 0; i < pageNums.size(); ++i) {
+        char* page = pages.data() + i * PAGE_SIZE;
+        if(HashPage::append(page, h, key, len, item.rid))
+            return ixFileHandle.writePage(pageNums[i], page) < 0 ? LEAF_FAILED : LEAF_DONE;
+    }
+    if(canSplit(pages, h)) return LEAF_SMO;
+    // the entries can't be told apart by more bits: chain an overflow page
+    char newpage[PAGE_SIZE];
+    HashPage::InitializePage(newpage, 0);
+    if(!HashPage::append(newpage, h, key, len, item.rid)) return LEAF_FAILED;
+    int pageNum = ixFileHandle.newPage(newpage);
+    if(pageNum < 0) return LEAF_FAILED;
+    char* tail = pages.data() + pages.size() - PAGE_SIZE;
+    HashPage::setNextPage(tail, pageNum);
+    return ixFileHandle.writePage(pageNums.back(), tail) < 0 ? LEAF_FAILED : LEAF_DONE;
+}
+
+// buckets are not merged; an emptied overflow page leaves the chain
+static LeafResult deleteFromBucket(IXFileHandle& ixFileHandle, unsigned h, const IndexItem& item,
+                                   const std::vector<int>& pageNums, std::vector<char>& pages){
+    int index, offset;
+    if(!findInBucket(pages, h, item, index, offset)) return LEAF_FAILED;
+    char* page = pages.data() + index * PAGE_SIZE;
+    HashPage::removeAt(page, offset);
+    if(index > 0 && HashPage::getCount(page) == 0) {
+        char* prev = page - PAGE_SIZE;
+        HashPage::setNextPage(prev, HashPage::getNextPage(page));
+        if(ixFileHandle.writePage(pageNums[index - 1], prev) < 0) return LEAF_FAILED;
+        return ixFileHandle.freePage(pageNums[index]) < 0 ? LEAF_FAILED : LEAF_DONE;
+    }
+    return ixFileHandle.writePage(pageNums[index], page) < 0 ? LEAF_FAILED : LEAF_DONE;
+}
+
+// The optimistic path of hash inserts and deletes: latch the bucket alone and change it in place.
+// LEAF_SMO: the bucket is full and has to split first.
+static LeafResult changeBucket(IXFileHandle& ixFileHandle, unsigned h, const IndexItem& item, bool insert){
+    IndexLatches& latches = ixFileHandle.latches();
+    std::vector<int> pageNums;
+    std::vector<char> pages;
+    int head;
+    while(true) {
+        uint64_t version;
+        unsigned slots;
+        if(findBucket(latches, h, head, version, slots)) {
+            int read = readBucket(ixFileHandle, head, &version, pageNums, pages);
+            if(read < 0) return LEAF_FAILED;
+            // the copy is still the bucket if its version did not change; the bucket only stops
+            // being the one of h when it splits, which takes its latch
+            if(read > 0 && latches.upgrade(head, version)) break;
+        }
+        std::this_thread::yield();
+    }
+    LeafResult res = insert ? insertIntoBucket(ixFileHandle, h, item, pageNums, pages)
+                            : deleteFromBucket(ixFileHandle, h, item, pageNums, pages);
+    latches.writeUnlock(head);
+    return res;
+}
+
+// write the directory pages holding slots [from, to); each page keeps the next one and the global depth
+static RC writeDirectory(IXFileHandle& ixFileHandle, size_t from, size_t to){
+    IndexLatches& latches = ixFileHandle.latches();
+    const size_t cap = HashPage::DIR_CAPACITY;
+    size_t first = from / cap, last = (to - 1) / cap;
+    char page[PAGE_SIZE];
+    memset(page, 0, PAGE_SIZE);
+    while(latches.dirPages.size() * cap < latches.dir.size()) {
+        int pageNum = ixFileHandle.newPage(page);
+        if(pageNum < 0) return -1;
+        latches.dirPages.push_back(pageNum);
+        first = std::min(first, latches.dirPages.size() - 2); // the old last page links to it
+    }
+    for(size_t k = first; k <= last; ++k) {
+        memset(page, 0, PAGE_SIZE);
+        *(int*)page = k + 1 < latches.dirPages.size() ? latches.dirPages[k + 1] : -1;
+        *(int*)(page + sizeof(int)) = latches.globalDepth;
+        size_t begin = k * cap, end = std::min(latches.dir.size(), begin + cap);
+        memcpy(page + HashPage::DIR_HEADSIZE, latches.dir.data() + begin, (end - begin) * sizeof(int));
+        if(ixFileHandle.writePage(latches.dirPages[k], page) < 0) return -1;
+    }
+    return 0;
+}
+
+static RC loadDirectory(IXFileHandle& ixFileHandle, IndexLatches& latches){
+    char page[PAGE_SIZE];
+    for(int pageNum = ixFileHandle.getRootPageNum(); pageNum != -1; pageNum = *(int*)page) {
+        if(ixFileHandle.readPage(pageNum, page) < 0) return -1;
+        if(latches.dirPages.empty()) latches.globalDepth = *(int*)(page + sizeof(int));
+        latches.dirPages.push_back(pageNum);
+        const int* slots = (const int*)(page + HashPage::DIR_HEADSIZE);
+        latches.dir.insert(latches.dir.end(), slots, slots + HashPage::DIR_CAPACITY);
+    }
+    if(latches.dirPages.empty() || latches.globalDepth > HASH_MAX_DEPTH) return -1;
+    latches.dir.resize(1u << latches.globalDepth);
+    return 0;
+}
+
+// lay entries out on a bucket chain of the given local depth, on the pages of pageNums first; pages
+// left over are freed. Returns the first page.
+static int writeBucket(IXFileHandle& ixFileHandle, const std::vector<const char*>& entries, int depth,
+                       const std::vector<int>& pageNums){
+    std::vector<char> pages(PAGE_SIZE);
+    HashPage::InitializePage(pages.data(), depth);
+    for(const char* entry: entries) {
+        if(HashPage::appendEntry(pages.data() + pages.size() - PAGE_SIZE, entry)) continue;
+        pages.resize(pages.size() + PAGE_SIZE);
+        HashPage::InitializePage(pages.data() + pages.size() - PAGE_SIZE, 0);
+        HashPage::appendEntry(pages.data() + pages.size() - PAGE_SIZE, entry);
+    }
+    // from the last page on, so that each page knows the next one
+    int n = pages.size() / PAGE_SIZE, next = -1;
+    for(int i = n - 1; i >= 0; --i) {
+        char* page = pages.data() + i * PAGE_SIZE;
+        HashPage::setNextPage(page, next);
+        if(i < (int)pageNums.size()) {
+            if(ixFileHandle.writePage(pageNums[i], page) < 0) return -1;
+            next = pageNums[i];
+        } else if((next = ixFileHandle.newPage(page)) < 0) {
+            return -1;
+        }
+    }
+    for(size_t i = n; i < pageNums.size(); ++i) freeHeld(ixFileHandle, pageNums[i]);
+    return next;
+}
+
+// Split the bucket of h on its next bit, doubling the directory first when the bucket uses all of its
+// bits, unless another split made room for need bytes meanwhile. The caller holds the smoMutex, so
+// nobody else changes the directory.
+static RC splitBucket(IXFileHandle& ixFileHandle, unsigned h, int need){
+    IndexLatches& latches = ixFileHandle.latches();
+    int head = latches.dir[h & (latches.dir.size() - 1)];
+    holdPage(ixFileHandle, head);
+    std::vector<int> pageNums;
+    std::vector<char> pages;
+    if(readBucket(ixFileHandle, head, nullptr, pageNums, pages) < 0) return -1;
+    for(size_t i = 0; i < pageNums.size(); ++i) {
+        if(HashPage::HEADSIZE + HashPage::getUsed(pages.data() + i * PAGE_SIZE) + need <= PAGE_SIZE) return 0;
+    }
+    int depth = HashPage::getLocalDepth(pages.data());
+    if(depth >= HASH_MAX_DEPTH) return 0;
+    holdPage(ixFileHandle, IndexLatches::META);
+    if(depth == latches.globalDepth) {
+        // each new slot points where its twin in the lower half does
+        {
+            std::lock_guard<std::mutex> lock(latches.dirMutex);
+            size_t n = latches.dir.size();
+            latches.dir.resize(2 * n);
+            std::copy(latches.dir.begin(), latches.dir.begin() + n, latches.dir.begin() + n);
+            latches.globalDepth++;
+        }
+        if(writeDirectory(ixFileHandle, 0, latches.dir.size()) < 0) return -1;
+    }
+    // the entries with the bit set go to a new bucket
+    std::vector<const char*> stay, move;
+    for(size_t i = 0; i < pageNums.size(); ++i) {
+        const char* page = pages.data() + i * PAGE_SIZE;
+        for(int off = HashPage::HEADSIZE, end = off + HashPage::getUsed(page); off < end; off += HashPage::entrySize(page + off))
+            (HashPage::getHash(page + off) >> depth & 1 ? move : stay).push_back(page + off);
+    }
+    int sibling = writeBucket(ixFileHandle, move, depth + 1, std::vector<int>());
+    if(sibling < 0 || writeBucket(ixFileHandle, stay, depth + 1, pageNums) < 0) return -1;
+    // so do the slots that agree with the bucket on its bits and have the bit set
+    size_t first = (h & ((1u << depth) - 1)) | 1u << depth, last = first;
+    {
+        std::lock_guard<std::mutex> lock(latches.dirMutex);
+        for(size_t i = first; i < latches.dir.size(); i += 2u << depth) {
+            latches.dir[i] = sibling;
+            last = i;
+        }
+    }
+    return writeDirectory(ixFileHandle, first, last + 1);
+}
+
+static RC insertHashItem(IXFileHandle& ixFileHandle, IndexItem item, AttrType type){
+    unsigned h = hashOf(type, item);
+    while(true) {
+        LeafResult res = changeBucket(ixFileHandle, h, item, true);
+        if(res != LEAF_SMO) return res == LEAF_FAILED ? -1 : 0;
+        SmoGuard smo(ixFileHandle);
+        if(splitBucket(ixFileHandle, h, HashPage::ENTRY_HEADSIZE + item.value.size()) < 0) return -1;
+    }
+}
+
+static RC deleteHashItem(IXFileHandle& ixFileHandle, IndexItem item, AttrType type){
+    unsigned h = hashOf(type, item);
+    return changeBucket(ixFileHandle, h, item, false) == LEAF_DONE ? 0 : -1;
+}
+
 /* ========== IndexManager ========== */
 IndexManager &IndexManager::instance() {
     static IndexManager _index_manager = IndexManager();
     return _index_manager;
 }
 
-RC IndexManager::createFile(const std::string &fileName) {
-    return wCreateFile(fileName);
+RC IndexManager::createFile(const std::string &fileName, IndexKind kind) {
+    if(wCreateFile(fileName) < 0) return -1;
+    if(kind == IndexKind::BTREE) return 0;
+    // a hash index starts with an empty bucket on page 0 and a directory of one slot on page 1
+    IXFileHandle ixFileHandle;
+    if(PagedFileManager::instance().openFile(fileName, ixFileHandle) < 0) return -1;
+    char page[PAGE_SIZE];
+    HashPage::InitializePage(page, 0);
+    RC rc = ixFileHandle.appendPage(page);
+    memset(page, 0, PAGE_SIZE);
+    *(int*)page = -1;
+    if(rc == 0) rc = ixFileHandle.appendPage(page);
+    if(rc == 0) rc = ixFileHandle.setRootPageNum(1);
+    int k = (int)kind;
+    if(rc == 0) rc = ixFileHandle.shared_item_->writeHeader(INDEX_KIND_OFFSET, &k, sizeof(int));
+    ixFileHandle.releaseFile();
+    return rc;
 }
 
 RC IndexManager::destroyFile(const std::string &fileName) {
     return remove(fileName.c_str());
 }
 
+// the latches of each open index file, found by the shared item every handle on the file gets
+static std::shared_ptr<IndexLatches> latchesOf(IXFileHandle &ixFileHandle) {
+    static std::mutex mutex;
+    static std::map<const void *, std::weak_ptr<IndexLatches>> files;
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto it = files.begin(); it != files.end();) it = it->second.expired() ? files.erase(it) : std::next(it);
+    std::weak_ptr<IndexLatches> &entry = files[ixFileHandle.shared_item_.get()];
+    std::shared_ptr<IndexLatches> latches = entry.lock();
+    if(!latches) {
+        latches = std::make_shared<IndexLatches>(ixFileHandle.getRootPageNum(), ixFileHandle.getIdlePageNum());
+        latches->kind = ixFileHandle.getIndexKind();
+        if(latches->kind == IndexKind::HASH && loadDirectory(ixFileHandle, *latches) < 0) return nullptr;
+        entry = latches;
+    }
+    return latches;
+}
+
 RC IndexManager::openFile(const std::string &fileName, IXFileHandle &ixFileHandle) {
-    FILE *fPointer = NULL;
-    fPointer = fopen(fileName.c_str(), "r+");
-    if (fPointer == NULL) {
+    if(ixFileHandle.isOpen()) 
         return -1;
-    } else if(ixFileHandle.isOpen()) { 
+    ixFileHandle.latches_.reset();
+    if(PagedFileManager::instance().openFile(fileName, ixFileHandle) < 0) return -1;
+    // files written before the current page layout would read back wrong, version 0 predates the field
+    int version = 0;
+    if(ixFileHandle.shared_item_->readHeader(INDEX_FORMAT_OFFSET, &version, sizeof(int)) < 0 ||
+       version != INDEX_FORMAT_VERSION) {
+        ixFileHandle.releaseFile();
         return -1;
-    } else {
-        ixFileHandle.setFile(fPointer);
-        return 0;
     }
+    ixFileHandle.latches_ = latchesOf(ixFileHandle);
+    if(!ixFileHandle.latches_) {
+        ixFileHandle.releaseFile();
+        return -1;
+    }
+    return 0;
 }
 
 RC IndexManager::closeFile(IXFileHandle &ixFileHandle) {
+    ixFileHandle.latches_.reset();
     return ixFileHandle.releaseFile();
 }
 
-RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
-    if(!ixFileHandle.isOpen()) return -1;
+// The optimistic path of inserts and deletes: find the leaf without latches, then latch it alone and
+// change it, unless that takes a split or a merge. LEAF_SMO: it does, or the tree is empty; path then
+// holds the pages on the way to the leaf for the split or merge.
+template<AttrType T>
+static LeafResult changeLeaf(IXFileHandle &ixFileHandle, const KeyRef &indexitem, bool insert, PathCopy &path) {
+    IndexLatches &latches = ixFileHandle.latches();
+    char pagebuf[PAGE_SIZE];
+    LeafRef leaf;
+    while(true) {
+        path = PathCopy();
+        int found = findLeaf<T>(ixFileHandle, &indexitem, true, pagebuf, leaf, &path);
+        if(found < 0) return LEAF_SMO;
+        // the copy is still the leaf if its version did not change, and the leaf still covers the key
+        // if its parent did not
+        if(found > 0 && latches.upgrade(leaf.pageNum, leaf.version)) {
+            if(latches.validate(leaf.parent, leaf.parentVersion)) break;
+            latches.writeUnlock(leaf.pageNum);
+        }
+        std::this_thread::yield();
+    }
+    LeafResult res;
+    if(insert) {
+        int rightAddPageNum;
+        std::vector<char> upflowIndexValue;
+        if(FixedPage::usedFor(T))
+            res = insertIntoFixedLeaf<T>(ixFileHandle, leaf.pageNum, pagebuf, indexitem, false, rightAddPageNum, upflowIndexValue);
+        else
+            res = insertIntoLeaf<T>(ixFileHandle, leaf.pageNum, pagebuf, indexitem, false, rightAddPageNum, upflowIndexValue);
+    } else {
+        // only a root leaf may underflow
+        bool root = leaf.parent == IndexLatches::META;
+        if(FixedPage::usedFor(T)) res = deleteFromFixedLeaf<T>(ixFileHandle, leaf.pageNum, pagebuf, indexitem, root);
+        else res = deleteFromLeaf<T>(ixFileHandle, leaf.pageNum, pagebuf, indexitem, root);
+    }
+    latches.writeUnlock(leaf.pageNum);
+    // nothing was written, so the copy of the leaf stays good at the version the unlock left
+    if(res == LEAF_SMO) path.versions.back() = leaf.version + 2;
+    return res;
+}
+
+template<AttrType T>
+static RC insertIndexItem(IXFileHandle &ixFileHandle, const IndexItem &item) {
+    KeyRef indexitem = makeKeyRef(item);
+    PathCopy path;
+    LeafResult res = changeLeaf<T>(ixFileHandle, indexitem, true, path);
+    if(res != LEAF_SMO) return res == LEAF_FAILED ? -1 : 0;
+    SmoGuard smo(ixFileHandle, path);
     int currPageNum = ixFileHandle.getRootPageNum(), parPageNum = -1;
     char pagebuf[PAGE_SIZE];
     if(currPageNum == -1){
         IndexPage::InitializePage(pagebuf);
         IndexPage::appendTailChildPointer(pagebuf);
-        ixFileHandle.appendPage(pagebuf);
-        currPageNum = ixFileHandle.getNumberOfPages() - 1;
-        ixFileHandle.setRootPageNum(currPageNum);
+        if((currPageNum = ixFileHandle.newPage(pagebuf)) < 0) return -1;
+        setRootHeld(ixFileHandle, currPageNum);
     }
 
     int leftAddPageNum = -1, rightAddPageNum = -1;
-    std::vector<char> upflowIndexValue, indexValue;
-    IndexItem indexitem = makeCompositeIndex(attribute, key, rid);
-    CompFunc comp;
-    switch(attribute.type) {
-        case TypeInt: {comp = compareNumIndexItemWithRID<int>;break;}
-        case TypeReal: {comp = compareNumIndexItemWithRID<float>;break;}
-        case TypeVarChar:{comp = compareVarcharIndexItemWithRID;break;}
-    }
+    std::vector<char> upflowIndexValue;
     bool valid_insertion = true;
-    if(recursiveInsert(ixFileHandle, parPageNum, currPageNum, indexitem, leftAddPageNum, rightAddPageNum, upflowIndexValue, comp, valid_insertion)){
+    if(recursiveInsert<T>(ixFileHandle, parPageNum, currPageNum, indexitem, leftAddPageNum, rightAddPageNum, upflowIndexValue, valid_insertion)){
         // new root
         IndexPage::InitializePage(pagebuf);
         IndexPage::appendTailChildPointer(pagebuf);
         IndexPage::setNextLeafId(pagebuf, NONLEAF); // non leaf
         IndexPage::setChildPageNum(pagebuf, rightAddPageNum, 0);
         IndexPage::insertValueTo(pagebuf, leftAddPageNum, upflowIndexValue, 0);
-        ixFileHandle.appendPage(pagebuf);
+        if((currPageNum = ixFileHandle.newPage(pagebuf)) < 0) return -1;
         // update root page number
-        ixFileHandle.setRootPageNum(ixFileHandle.getNumberOfPages() - 1);
+        setRootHeld(ixFileHandle, currPageNum);
     }
     if(!valid_insertion) return -1;
     return 0;
 }
 
+template<AttrType T>
+static RC insertFixedItem(IXFileHandle &ixFileHandle, const IndexItem &item) {
+    KeyRef indexitem = makeKeyRef(item);
+    PathCopy path;
+    LeafResult res = changeLeaf<T>(ixFileHandle, indexitem, true, path);
+    if(res != LEAF_SMO) return res == LEAF_FAILED ? -1 : 0;
+    SmoGuard smo(ixFileHandle, path);
+    int currPageNum = ixFileHandle.getRootPageNum();
+    char pagebuf[PAGE_SIZE];
+    if(currPageNum == -1){
+        FixedPage::InitializePage(pagebuf, -1);
+        if((currPageNum = ixFileHandle.newPage(pagebuf)) < 0) return -1;
+        setRootHeld(ixFileHandle, currPageNum);
+    }
+
+    int leftAddPageNum = -1, rightAddPageNum = -1;
+    std::vector<char> upflowIndexValue;
+    bool valid_insertion = true;
+    if(recursiveInsertFixed<T>(ixFileHandle, currPageNum, indexitem, leftAddPageNum, rightAddPageNum, upflowIndexValue, valid_insertion)){
+        // new root
+        FixedPage::InitializePage(pagebuf, NONLEAF);
+        FixedPage::setChild(pagebuf, 0, leftAddPageNum);
+        FixedPage::insertAt(pagebuf, 0, upflowIndexValue.data(), rightAddPageNum);
+        if((currPageNum = ixFileHandle.newPage(pagebuf)) < 0) return -1;
+        // update root page number
+        setRootHeld(ixFileHandle, currPageNum);
+    }
+    if(!valid_insertion) return -1;
+    return 0;
+}
+
+static RC insertIndexItem(IXFileHandle &ixFileHandle, const IndexItem &item, AttrType type) {
+    if(ixFileHandle.getIndexKind() == IndexKind::HASH) return insertHashItem(ixFileHandle, item, type);
+    switch(type) {
+        case TypeInt: return insertFixedItem<TypeInt>(ixFileHandle, item);
+        case TypeReal: return insertFixedItem<TypeReal>(ixFileHandle, item);
+        case TypeVarChar: return insertIndexItem<TypeVarChar>(ixFileHandle, item);
+    }
+    return -1;
+}
+
+static CompFunc insertCompFunc(const Attribute &attribute) {
+    switch(attribute.type) {
+        case TypeInt: return compareNumIndexItemWithRID<int>;
+        case TypeReal: return compareNumIndexItemWithRID<float>;
+        case TypeVarChar: return compareVarcharIndexItemWithRID;
+    }
+    return compareVarcharIndexItemWithRID;
+}
+
+RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
+    if(!ixFileHandle.isOpen()) return -1;
+    return insertIndexItem(ixFileHandle, makeCompositeIndex(attribute, key, rid), attribute.type);
+}
+
+RC IndexManager::insertEntries(IXFileHandle &ixFileHandle, const Attribute &attribute,
+                               const std::vector<const void *> &keys, const std::vector<RID> &rids) {
+    if(!ixFileHandle.isOpen() || keys.size() != rids.size()) return -1;
+    CompFunc comp = insertCompFunc(attribute);
+    std::vector<IndexItem> items;
+    items.reserve(keys.size());
+    for(size_t i = 0; i < keys.size(); ++i)
+        items.push_back(makeCompositeIndex(attribute, keys[i], rids[i]));
+    std::sort(items.begin(), items.end(), [&comp](const IndexItem &a, const IndexItem &b){ return comp(a, b) < 0; });
+    RC rc = 0;
+    for(auto &item: items) {
+        if(insertIndexItem(ixFileHandle, item, attribute.type) < 0) rc = -1; // keep going like a loop of insertEntry
+    }
+    return rc;
+}
+
+/* ========== bulk loading ============== */
+// one entry of a page under construction: | leftChildPageNum | key | rid |
+struct LoadEntry {
+    int child;
+    std::vector<char> value;
+};
+
+// Writes the pages of a tree bottom-up. Pages get consecutive numbers from the end of the file
+// and are appended APPEND_BATCH_PAGES at a time.
+class TreeLoader {
+public:
+    TreeLoader(IXFileHandle &ixFileHandle, float fillFactor, AttrType type)
+        : fh_(ixFileHandle), type_(type), fixed_(FixedPage::usedFor(type)), nextPage_(ixFileHandle.getNumberOfPages()),
+          leafBytes_(0), prevLeaf_(-1) {
+        // a FixedPage is measured in entries, an IndexPage in bytes
+        if (fixed_) {
+            leafCapacity_ = FixedPage::LEAF_CAPACITY;
+            capacity_ = FixedPage::INNER_CAPACITY;
+        } else {
+            capacity_ = PAGE_SIZE - IndexPage::PAGEHEADSIZE - sizeof(SlotItem) - sizeof(int); // keep the tail slot
+            leafCapacity_ = capacity_;
+        }
+        if (fillFactor <= 0 || fillFactor > 1) fillFactor = 1;
+        target_ = std::max<size_t>(capacity_ * fillFactor, 1);
+        leafTarget_ = std::max<size_t>(leafCapacity_ * fillFactor, 1);
+    }
+
+    // entries must come in ascending order; the entries of one key are gathered first
+    RC addLeafEntry(const IndexItem &item) {
+        if (!runRids_.empty() && !_sameKey(runKey_, item.value) && _flushRun() < 0) return -1;
+        if (runRids_.empty()) runKey_ = item.value;
+        runRids_.push_back(item.rid);
+        return 0;
+    }
+
+    RC finish() {
+        if (!runRids_.empty() && _flushRun() < 0) return -1;
+        if (!leaf_.empty() && _closeLeaf() < 0) return -1;
+        while (level_.size() > 1) {
+            if (_buildInnerLevel() < 0) return -1;
+        }
+        if (_flush() < 0) return -1;
+        if (!level_.empty()) fh_.setRootPageNum(level_[0].first);
+        return 0;
+    }
+
+private:
+    IXFileHandle &fh_;
+    AttrType type_;
+    bool fixed_;
+    PageNum nextPage_;
+    size_t capacity_, target_, leafCapacity_, leafTarget_, leafBytes_; // inner and leaf limits
+    int prevLeaf_; // the leaf written last, it learns its next leaf when that one is written
+    std::vector<char> runKey_; // the key whose RIDs are being gathered
+    std::vector<RID> runRids_;
+    std::vector<LoadEntry> leaf_;
+    std::vector<char> prevLast_; // last entry of the previous leaf
+    std::vector<std::pair<int, std::vector<char>>> level_; // page and its smallest entry, of the level being built
+    std::vector<char> batch_;
+
+    bool _sameKey(const std::vector<char> &a, const std::vector<char> &b) const {
+        switch (type_) {
+            case TypeInt: return *(const int *)a.data() == *(const int *)b.data();
+            case TypeReal: return *(const float *)a.data() == *(const float *)b.data();
+            case TypeVarChar: return a == b;
+        }
+        return false;
+    }
+
+    // the RIDs of a key go to a posting list if their entries take POSTING_MIN_BYTES, like foldIntoPosting does
+    RC _flushRun() {
+        std::vector<char> value = runKey_;
+        pushBackTo(value, (const char *)&runRids_[0], sizeof(RID));
+        RC rc = 0;
+        if (runRids_.size() * (fixed_ ? FixedPage::KEYSIZE + sizeof(RID) : _entrySize(value)) >= POSTING_MIN_BYTES) {
+            std::vector<char> pages;
+            int head = nextPage_, count = PostingPage::buildChain(runRids_, head, pages);
+            for (int j = 0; j < count; ++j) {
+                if (_writePage(&pages[j * PAGE_SIZE]) < 0) return -1;
+            }
+            rc = _addEntry(runKey_, PostingPage::marker(head));
+        } else {
+            for (size_t j = 0; j < runRids_.size() && rc == 0; ++j) rc = _addEntry(runKey_, runRids_[j]);
+        }
+        runRids_.clear();
+        return rc;
+    }
+
+    RC _addEntry(const std::vector<char> &key, const RID &rid) {
+        LoadEntry e{-1, key};
+        pushBackTo(e.value, (const char *)&rid, sizeof(RID));
+        size_t size = _entrySize(e.value);
+        if (!leaf_.empty() && _leafBytesWith(e.value, size) > leafTarget_ && _closeLeaf() < 0) return -1;
+        leafBytes_ += size;
+        leaf_.push_back(std::move(e));
+        return 0;
+    }
+
+    size_t _entrySize(const std::vector<char> &value) const {
+        return fixed_ ? 1 : sizeof(SlotItem) + sizeof(int) + value.size();
+    }
+
+    // what the leaf takes once value joins it; a slotted leaf keeps the prefix of its keys once
+    size_t _leafBytesWith(const std::vector<char> &value, size_t size) const {
+        if (fixed_) return leafBytes_ + size;
+        size_t plen = IndexPage::commonPrefixLen(leaf_[0].value, value);
+        return leafBytes_ + size - leaf_.size() * plen;
+    }
+
+    // an IndexPage gets its entries in slot order followed by the tail child, the way insertValueTo expects them
+    void _fillPage(char *page, const std::vector<LoadEntry> &entries, int tailChild, int nextLeafId) const {
+        if (fixed_) {
+            FixedPage::InitializePage(page, nextLeafId);
+            for (size_t j = 0; j < entries.size(); ++j) {
+                FixedPage::setEntry(page, j, entries[j].value.data());
+                if (nextLeafId == NONLEAF) FixedPage::setChild(page, j, entries[j].child);
+            }
+            FixedPage::setCount(page, entries.size());
+            if (nextLeafId == NONLEAF) FixedPage::setChild(page, entries.size(), tailChild);
+            return;
+        }
+        IndexPage::InitializePage(page);
+        std::vector<char> data;
+        for (auto &e: entries) {
+            data.clear();
+            pushBackTo(data, (const char *)&e.child, sizeof(int));
+            data.insert(data.end(), e.value.begin(), e.value.end());
+            SlotItem slot;
+            slot.offset = IndexPage::appendData(page, data.data(), data.size());
+            slot.data_size = data.size();
+            slot.metadata_size = 0;
+            slot.field_num = 2;
+            IndexPage::writeSlot(page, IndexPage::appendSlot(page), slot);
+        }
+        IndexPage::appendTailChildPointer(page);
+        IndexPage::setChildPageNum(page, tailChild, entries.size());
+        IndexPage::setNextLeafId(page, nextLeafId);
+    }
+
+    int _writePage(const char *page) {
+        int pageNum = nextPage_++;
+        batch_.insert(batch_.end(), page, page + PAGE_SIZE);
+        if (batch_.size() >= APPEND_BATCH_PAGES * PAGE_SIZE && _flush() < 0) return -1;
+        return pageNum;
+    }
+
+    RC _flush() {
+        if (batch_.empty()) return 0;
+        unsigned count = batch_.size() / PAGE_SIZE;
+        PageNum first;
+        // the pages were numbered in advance, nobody else may append meanwhile
+        if (fh_.appendPages(batch_.data(), count, first) < 0 || first + count != nextPage_) return -1;
+        batch_.clear();
+        return 0;
+    }
+
+    // posting lists may sit between two leaves, so a leaf is linked to the next one when that is written
+    RC _closeLeaf() {
+        char page[PAGE_SIZE];
+        int pageNum = nextPage_;
+        if (fixed_) {
+            _fillPage(page, leaf_, -1, -1);
+            level_.emplace_back(pageNum, leaf_[0].value);
+        } else {
+            std::vector<std::vector<char>> values;
+            for (auto &e: leaf_) values.push_back(std::move(e.value));
+            IndexPage::buildLeaf(page, values, 0, values.size(), -1);
+            // the parent only needs a key between this leaf and the previous one
+            level_.emplace_back(pageNum, level_.empty() ? values[0] : IndexPage::separator(prevLast_, values[0]));
+            prevLast_ = std::move(values.back());
+        }
+        leaf_.clear();
+        leafBytes_ = 0;
+        if (_linkLeaf(pageNum) < 0) return -1;
+        return _writePage(page) < 0 ? -1 : 0;
+    }
+
+    // point the previous leaf at pageNum, in the batch or in the file
+    RC _linkLeaf(int pageNum) {
+        int prev = prevLeaf_;
+        prevLeaf_ = pageNum;
+        if (prev < 0) return 0;
+        PageNum batchFirst = nextPage_ - batch_.size() / PAGE_SIZE;
+        if ((PageNum)prev >= batchFirst) {
+            IndexPage::setNextLeafId(&batch_[(prev - batchFirst) * PAGE_SIZE], pageNum);
+            return 0;
+        }
+        char page[PAGE_SIZE];
+        if (fh_.readPage(prev, page) < 0) return -1;
+        IndexPage::setNextLeafId(page, pageNum);
+        return fh_.writePage(prev, page);
+    }
+
+    // node entries are (child j, smallest entry of child j + 1); the last child goes to the tail
+    RC _buildInnerLevel() {
+        std::vector<std::pair<int, std::vector<char>>> upper;
+        std::vector<LoadEntry> entries;
+        char page[PAGE_SIZE];
+        size_t j = 0, n = level_.size();
+        while (j < n) {
+            size_t first = j, bytes = 0;
+            entries.clear();
+            while (j + 1 < n) {
+                size_t size = _entrySize(level_[j + 1].second);
+                if (bytes + size > capacity_) break;
+                // stop at the fill factor, unless that leaves a single child for the next node
+                if (!entries.empty() && bytes + size > target_ && n - (j + 1) > 1) break;
+                entries.push_back(LoadEntry{level_[j].first, level_[j + 1].second});
+                bytes += size;
+                ++j;
+            }
+            _fillPage(page, entries, level_[j].first, NONLEAF);
+            int pageNum = _writePage(page);
+            if (pageNum < 0) return -1;
+            upper.emplace_back(pageNum, std::move(level_[first].second));
+            ++j;
+        }
+        level_.swap(upper);
+        return 0;
+    }
+};
+
+// a sorted run spilled to a temporary file: | int len | value | rid | per entry
+static FILE *spillRun(const std::vector<IndexItem> &items) {
+    FILE *f = tmpfile();
+    if (f == NULL) return NULL;
+    for (auto &item: items) {
+        int len = item.value.size();
+        if (fwrite(&len, sizeof(int), 1, f) != 1 || fwrite(item.value.data(), 1, len, f) != (size_t)len ||
+            fwrite(&item.rid, sizeof(RID), 1, f) != 1) {
+            fclose(f);
+            return NULL;
+        }
+    }
+    rewind(f);
+    return f;
+}
+
+static bool readRunItem(FILE *f, IndexItem &item) {
+    int len;
+    if (fread(&len, sizeof(int), 1, f) != 1) return false;
+    item.value.resize(len);
+    return fread(item.value.data(), 1, len, f) == (size_t)len && fread(&item.rid, sizeof(RID), 1, f) == 1;
+}
+
+RC IndexManager::bulkLoad(IXFileHandle &ixFileHandle, const Attribute &attribute,
+                          const std::function<bool(const void *&key, RID &rid)> &next,
+                          float fillFactor, size_t memoryLimit) {
+    if(!ixFileHandle.isOpen()) return -1;
+    if(ixFileHandle.getIndexKind() == IndexKind::HASH) {
+        // buckets have no order to build them in, the entries go in one by one
+        const void *key;
+        RID rid;
+        while(next(key, rid)) {
+            if(insertEntry(ixFileHandle, attribute, key, rid) < 0) return -1;
+        }
+        return 0;
+    }
+    SmoGuard smo(ixFileHandle);
+    if(ixFileHandle.getRootPageNum() != -1) return -1;
+    CompFunc comp = insertCompFunc(attribute);
+    auto less = [&comp](const IndexItem &a, const IndexItem &b){ return comp(a, b) < 0; };
+
+    // sort what fits in memory, spill the rest as sorted runs
+    std::vector<IndexItem> items;
+    std::vector<FILE *> runs;
+    size_t bytes = 0;
+    RC rc = 0;
+    const void *key;
+    RID rid;
+    while (rc == 0 && next(key, rid)) {
+        items.push_back(makeCompositeIndex(attribute, key, rid));
+        bytes += sizeof(IndexItem) + items.back().value.size();
+        if (bytes >= memoryLimit) {
+            std::sort(items.begin(), items.end(), less);
+            FILE *f = spillRun(items);
+            if (f == NULL) rc = -1;
+            else runs.push_back(f);
+            items.clear();
+            bytes = 0;
+        }
+    }
+    std::sort(items.begin(), items.end(), less);
+
+    TreeLoader loader(ixFileHandle, fillFactor, attribute.type);
+    IndexItem last;
+    bool first = true;
+    auto add = [&](const IndexItem &item) {
+        if (!first && comp(last, item) == 0) return 0; // the same entry twice
+        first = false;
+        last = item;
+        return loader.addLeafEntry(item);
+    };
+    if (rc == 0 && runs.empty()) {
+        for (auto &item: items) {
+            if (add(item) < 0) { rc = -1; break; }
+        }
+    } else if (rc == 0) {
+        // k-way merge of the runs and the in-memory rest
+        std::vector<IndexItem> heads(runs.size() + 1);
+        size_t memPos = 0;
+        auto refill = [&](size_t i) {
+            if (i < runs.size()) return readRunItem(runs[i], heads[i]);
+            if (memPos >= items.size()) return false;
+            heads[i] = std::move(items[memPos++]);
+            return true;
+        };
+        auto greater = [&](size_t a, size_t b){ return comp(heads[a], heads[b]) > 0; };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+        for (size_t i = 0; i < heads.size(); ++i) {
+            if (refill(i)) heap.push(i);
+        }
+        while (!heap.empty()) {
+            size_t i = heap.top();
+            heap.pop();
+            if (add(heads[i]) < 0) { rc = -1; break; }
+            if (refill(i)) heap.push(i);
+        }
+    }
+    for (FILE *f: runs) fclose(f);
+    if (rc < 0) return -1;
+    holdPage(ixFileHandle, IndexLatches::META); // the tree shows up once finish() sets the root
+    return loader.finish();
+}
+
 RC IndexManager::deleteEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
     if(!ixFileHandle.isOpen()) return -1;
-    int currPageNum = ixFileHandle.getRootPageNum(), parPageNum = -1;
-    if(currPageNum == -1) return -1;
+    IndexItem item = makeCompositeIndex(attribute, key, rid);
+    if(ixFileHandle.getIndexKind() == IndexKind::HASH) return deleteHashItem(ixFileHandle, item, attribute.type);
+    KeyRef indexitem = makeKeyRef(item);
+    LeafResult res = LEAF_SMO;
+    PathCopy path;
+    switch(attribute.type) {
+        case TypeInt: res = changeLeaf<TypeInt>(ixFileHandle, indexitem, false, path); break;
+        case TypeReal: res = changeLeaf<TypeReal>(ixFileHandle, indexitem, false, path); break;
+        case TypeVarChar: res = changeLeaf<TypeVarChar>(ixFileHandle, indexitem, false, path); break;
+    }
+    if(res != LEAF_SMO) return res == LEAF_FAILED ? -1 : 0;
 
-    IndexItem indexitem = makeCompositeIndex(attribute, key, rid);
-    CompFunc comp;
+    SmoGuard smo(ixFileHandle, path);
+    int currPageNum = ixFileHandle.getRootPageNum();
+    if(currPageNum == -1) return -1;
+    bool underflow = false;
+    RC rc = -1;
     switch(attribute.type) {
-        case TypeInt: {comp = compareNumIndexItemWithRID<int>;break;}
-        case TypeReal: {comp = compareNumIndexItemWithRID<float>;break;}
-        case TypeVarChar:{comp = compareVarcharIndexItemWithRID;break;}
+        case TypeInt: rc = deleteFixed<TypeInt>(ixFileHandle, currPageNum, indexitem, underflow); break;
+        case TypeReal: rc = deleteFixed<TypeReal>(ixFileHandle, currPageNum, indexitem, underflow); break;
+        case TypeVarChar: rc = recursiveDelete<TypeVarChar>(ixFileHandle, currPageNum, indexitem, underflow); break;
     }
-    return recursiveDelete(ixFileHandle,currPageNum, indexitem, comp);
+    if(rc < 0 || !underflow) return rc;
+    // a root left with a single child gives way to it
+    char pagebuf[PAGE_SIZE];
+    if(readHeld(ixFileHandle, currPageNum, pagebuf) < 0) return -1;
+    if(IndexPage::getNextLeafId(pagebuf) != NONLEAF) return 0;
+    int child;
+    if(FixedPage::usedFor(attribute.type)) {
+        if(FixedPage::getCount(pagebuf) > 0) return 0;
+        child = FixedPage::getChild(pagebuf, 0);
+    } else {
+        if(IndexPage::getSlotCount(pagebuf) > 1) return 0;
+        child = *(int*)(pagebuf + ((SlotItem*)(pagebuf + IndexPage::PAGEHEADSIZE))->offset);
+    }
+    if(setRootHeld(ixFileHandle, child) < 0) return -1;
+    freeHeld(ixFileHandle, currPageNum);
+    return 0;
 }
 
 RC IndexManager::scan(IXFileHandle &ixFileHandle,
@@ -565,7 +1931,7 @@ RC IndexManager::scan(IXFileHandle &ixFileHandle,
 void IndexManager::printBtree(IXFileHandle &ixFileHandle, const Attribute &attribute) const {
     if(!ixFileHandle.isOpen()) return;
     int currPageNum = ixFileHandle.getRootPageNum();
-    if (currPageNum == -1) return;
+    if (currPageNum == -1 || ixFileHandle.getIndexKind() == IndexKind::HASH) return; // a hash index is no tree
     AttrType type = attribute.type;
     std::function<std::string(char*, const SlotItem&)> p;
     switch(attribute.type) {
@@ -573,7 +1939,8 @@ void IndexManager::printBtree(IXFileHandle &ixFileHandle, const Attribute &attri
         case TypeReal: {p = printFloat;break;}
         case TypeVarChar:{p = printVarChar;break;}
     }
-    printPage(ixFileHandle,currPageNum,p);
+    if(FixedPage::usedFor(type)) printFixedPage(ixFileHandle,currPageNum,p);
+    else printPage(ixFileHandle,currPageNum,p);
 }
 
 /* ================= IX_ScanIterator ============== */
@@ -584,7 +1951,10 @@ IX_ScanIterator::~IX_ScanIterator() {}
 
 void IX_ScanIterator::setParams(IXFileHandle& ixFileHandle, const Attribute& attribute, const void* lowKey, const void* highKey, bool lowKeyInclusive, bool highKeyInclusive) {
      inited_ = false;
+     inPosting_ = false;
+     hasLast_ = false;
      fh_ = ixFileHandle;
+     fh_.adviseSequential();
      attr_ = attribute;
      lowKeyInclusive_ = lowKeyInclusive;
      highKeyInclusive_ = highKeyInclusive;
@@ -594,91 +1964,173 @@ void IX_ScanIterator::setParams(IXFileHandle& ixFileHandle, const Attribute& att
      RID dummy;
      if(!lowKeyNull_) lowKey_ = makeCompositeIndex(attribute, lowKey, dummy);
      if(!highKeyNull_) highKey_ = makeCompositeIndex(attribute, highKey, dummy);
-     switch(attr_.type) {
-        case TypeVarChar: comp_ = compareVarcharIndexItem; break;
-        case TypeInt: comp_ = compareNumIndexItem<int>;break;
-        case TypeReal: comp_ = compareNumIndexItem<float>;break;
-     }
- }
+     hash_ = fh_.getIndexKind() == IndexKind::HASH;
+}
 RC IX_ScanIterator::init() {
+    switch(attr_.type) {
+        case TypeInt: return _init<TypeInt>();
+        case TypeReal: return _init<TypeReal>();
+        case TypeVarChar: return _init<TypeVarChar>();
+    }
+    return -1;
+}
+template<AttrType T>
+RC IX_ScanIterator::_init() {
      // search the start leaf PageNum and SlotNum
      inited_ = true;
-    int pagenum = fh_.getRootPageNum();
-    if(fh_.readPage(pagenum, pagebuf_) < 0) return -1;
-
-    int i;
-    while(IndexPage::getNextLeafId(pagebuf_) < -1) {  // pagebuf_ is not a leaf node
-        if(lowKeyNull_) i = 0;
-        else i = binarySearchLowerBound(pagebuf_, lowKey_, comp_);
-
-        SlotItem& slotref = *(SlotItem*)(pagebuf_ + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
-        pagenum = *(int*)(pagebuf_+slotref.offset);
-        fh_.readPage(pagenum, pagebuf_);
-    }
-    currPageNum_ = pagenum;
-    loadedPageNum_ = currSlotNum_;
+    KeyRef low = makeKeyRef(lowKey_);
+    LeafRef leaf;
+    int found;
+    while((found = findLeaf<T>(fh_, lowKeyNull_ ? nullptr : &low, false, pagebuf_, leaf)) == 0)
+        std::this_thread::yield();
+    if(found < 0) return -1;
+    currPageNum_ = leaf.pageNum;
+    leafVersion_ = leaf.version;
     if(lowKeyNull_) {
         currSlotNum_ = 0;
+    } else if(FixedPage::usedFor(T)){
+        currSlotNum_ = lowKeyInclusive_ ? fixedLowerBound<T, false>(pagebuf_, low) : fixedUpperBound<T, false>(pagebuf_, low);
     } else if(lowKeyInclusive_){
-        currSlotNum_ = binarySearchLowerBound(pagebuf_, lowKey_, comp_);
+        currSlotNum_ = binarySearchLowerBound<T, false>(pagebuf_, low);
     } else {
-        currSlotNum_ = binarySearchUpperBound(pagebuf_, lowKey_, comp_);
+        currSlotNum_ = binarySearchUpperBound<T, false>(pagebuf_, low);
     }
     return 0;
  }
+// The leaf changed since it was copied, and writes may have moved entries or freed pages.
+// Find the last entry again and go on right after it.
+template<AttrType T>
+RC IX_ScanIterator::_reseek() {
+    inPosting_ = false;
+    if(!hasLast_) return _init<T>();
+    KeyRef last = makeKeyRef(last_);
+    while(true) {
+        LeafRef leaf;
+        int found = findLeaf<T>(fh_, &last, true, pagebuf_, leaf);
+        if(found < 0) return -1;
+        if(found == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        currPageNum_ = leaf.pageNum;
+        leafVersion_ = leaf.version;
+        RID rid;
+        if(FixedPage::usedFor(T)) {
+            currSlotNum_ = fixedLowerBound<T, true>(pagebuf_, last);
+            found = currSlotNum_ < FixedPage::getCount(pagebuf_) && !FixedPage::isDeleted(pagebuf_, currSlotNum_)
+                    && compareFixed<T, true>(last, pagebuf_, currSlotNum_) == 0;
+            if(found) rid = FixedPage::getRID(pagebuf_, currSlotNum_);
+        } else {
+            currSlotNum_ = binarySearchLowerBound<T, true>(pagebuf_, last);
+            const SlotItem& slotref = *(const SlotItem*)(pagebuf_ + IndexPage::PAGEHEADSIZE + currSlotNum_ * sizeof(SlotItem));
+            found = currSlotNum_ < IndexPage::getSlotCount(pagebuf_) - 1 && slotref.metadata_size != -1
+                    && compareSlot<T, true>(last, pagebuf_, currSlotNum_) == 0;
+            if(found) rid = IndexPage::getRID(pagebuf_, currSlotNum_);
+        }
+        if(!found) return 0;
+        // the entry is still there, or the posting list holding it; go past it
+        ScanCODE code = PostingPage::isPosting(rid) ? _seekPosting(rid.pageNum, last_.rid) : ScanCODE::INVALID_RECORD;
+        if(code == ScanCODE::RESTART) continue;
+        if(code != ScanCODE::SUCC) currSlotNum_++;
+        return 0;
+    }
+}
 
+template<AttrType T>
 ScanCODE IX_ScanIterator::_getNextEntry(RID& rid, void* key, int& nextLeafId) {
-    if(currPageNum_ == -1) return ScanCODE::OVERPAGE;
-    if(loadedPageNum_ != currPageNum_ ){
-        if(fh_.readPage(currPageNum_, pagebuf_) < 0) return ScanCODE::OVERPAGE;
-        loadedPageNum_ = currPageNum_;
+    const char* page = pagebuf_;
+    ScanCODE code;
+    if(FixedPage::usedFor(T)) {
+        if(currSlotNum_ >= FixedPage::getCount(page)){
+            nextLeafId = IndexPage::getNextLeafId(page);
+            return ScanCODE::OVERSLOT;
+        }
+        if(FixedPage::isDeleted(page, currSlotNum_))
+            return ScanCODE::INVALID_RECORD;
+        if(!highKeyNull_) {
+            int res = compareFixed<T, false>(makeKeyRef(highKey_), page, currSlotNum_);
+            if(res < 0 || (res == 0 && !highKeyInclusive_)) return ScanCODE::OVERPAGE;
+        }
+        rid = FixedPage::getRID(page, currSlotNum_);
+        if(PostingPage::isPosting(rid) && (code = _nextPosting(rid.pageNum, rid)) != ScanCODE::SUCC)
+            return code;
+        memcpy(key, FixedPage::keyAt(page, currSlotNum_), FixedPage::KEYSIZE);
+        return ScanCODE::SUCC;
     }
-    if(currSlotNum_ >= IndexPage::getSlotCount(pagebuf_)-1){ // omit the child-only slot
-        nextLeafId = IndexPage::getNextLeafId(pagebuf_);
+    if(currSlotNum_ >= IndexPage::getSlotCount(page)-1){ // omit the child-only slot
+        nextLeafId = IndexPage::getNextLeafId(page);
         return ScanCODE::OVERSLOT;
     } 
-    SlotItem& slotref = *(SlotItem*)(pagebuf_ + IndexPage::PAGEHEADSIZE + currSlotNum_ * sizeof(SlotItem));
+    const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + currSlotNum_ * sizeof(SlotItem));
     if(slotref.metadata_size == -1)
         return ScanCODE::INVALID_RECORD;
 
-    // read index on (currPageNum_, currSlotNum_)
-    auto item = IndexPage::readIndexItem(pagebuf_, currSlotNum_);
-    // compare with highKey
+    // compare highKey with the entry on (currPageNum_, currSlotNum_)
     bool compres;
     if(highKeyNull_) compres = true;
-    else if(highKeyInclusive_) compres = comp_(item, highKey_) <= 0;
-    else compres = comp_(item,highKey_) < 0;
+    else if(highKeyInclusive_) compres = compareSlot<T, false>(makeKeyRef(highKey_), page, currSlotNum_) >= 0;
+    else compres = compareSlot<T, false>(makeKeyRef(highKey_), page, currSlotNum_) > 0;
     
     if(!compres) return ScanCODE::OVERPAGE;
-    rid = item.rid;
-    switch(attr_.type){
-        case TypeVarChar:
-        {
-            int varlen = item.value.size();
-            memcpy(key, &varlen, sizeof(int));
-            memcpy((char*)key + sizeof(int), item.value.data(), varlen);
-            break;
-        }
-        default:
-            memcpy(key, item.value.data(), item.value.size());
-    }
+    // copy key and rid straight out of the slot, behind the page prefix
+    const char* data = page + slotref.offset + sizeof(int);
+    int suffixlen = slotref.data_size - sizeof(int) - sizeof(RID);
+    int plen = IndexPage::getPrefixLen(page), varlen = plen + suffixlen;
+    memcpy(&rid, data + suffixlen, sizeof(RID));
+    if(PostingPage::isPosting(rid) && (code = _nextPosting(rid.pageNum, rid)) != ScanCODE::SUCC)
+        return code;
+    memcpy(key, &varlen, sizeof(int));
+    memcpy((char*)key + sizeof(int), IndexPage::getPrefix(page), plen);
+    memcpy((char*)key + sizeof(int) + plen, data, suffixlen);
     return ScanCODE::SUCC;
 }
-RC IX_ScanIterator::getNextEntry(RID &rid, void *key) {
+RC IX_ScanIterator::getNextEntry(RID &rid, void *key) {
+    if(hash_) return _getNextHashEntry(rid, key);
+    switch(attr_.type) {
+        case TypeInt: return _getNextEntry<TypeInt>(rid, key);
+        case TypeReal: return _getNextEntry<TypeReal>(rid, key);
+        case TypeVarChar: return _getNextEntry<TypeVarChar>(rid, key);
+    }
+    return IX_EOF;
+}
+template<AttrType T>
+RC IX_ScanIterator::_getNextEntry(RID &rid, void *key) {
+    IndexLatches& latches = fh_.latches();
     if(!inited_){
-        if(this->init() < 0) return IX_EOF;
+        if(this->_init<T>() < 0) return IX_EOF;
+    } else if(!latches.validate(currPageNum_, leafVersion_)){
+        if(this->_reseek<T>() < 0) return IX_EOF;
     }
     ScanCODE errcode;
     int nextLeafId;
-    while((errcode = _getNextEntry(rid, key, nextLeafId)) != ScanCODE::OVERPAGE){
+    uint64_t version;
+    while((errcode = _getNextEntry<T>(rid, key, nextLeafId)) != ScanCODE::OVERPAGE){
         if(errcode == ScanCODE::SUCC){
-            currSlotNum_ ++;
+            if(!inPosting_) currSlotNum_ ++; // a posting list stays on its entry until its last RID
+            const char* k = (const char*)key;
+            if(FixedPage::usedFor(T)) last_.value.assign(k, k + FixedPage::KEYSIZE);
+            else last_.value.assign(k + sizeof(int), k + sizeof(int) + *(const int*)k);
+            last_.rid = rid;
+            hasLast_ = true;
             return 0;
         } else if(errcode == ScanCODE::OVERSLOT){
-            currSlotNum_ = 0;
+            if(nextLeafId == -1) break;
+            // the next leaf is only the next one while the current leaf still links to it
+            if(!latches.readLock(nextLeafId, version) || !latches.validate(currPageNum_, leafVersion_)) {
+                if(this->_reseek<T>() < 0) return IX_EOF;
+                continue;
+            }
+            if(fh_.readPage(nextLeafId, pagebuf_) < 0) return IX_EOF;
             currPageNum_ = nextLeafId;
+            leafVersion_ = version;
+            currSlotNum_ = 0;
+            inPosting_ = false;
+            if(!latches.validate(currPageNum_, leafVersion_) && this->_reseek<T>() < 0) return IX_EOF;
         } else if(errcode == ScanCODE::INVALID_RECORD){
             currSlotNum_ ++;
+            inPosting_ = false;
+        } else if(errcode == ScanCODE::RESTART){
+            if(this->_reseek<T>() < 0) return IX_EOF;
         } else {
             std::cerr << "Invalid ScanCODE" << std::endl;
             exit(EXIT_FAILURE);
@@ -687,6 +2139,137 @@ RC IX_ScanIterator::getNextEntry(RID &rid, void *key) {
     return IX_EOF;
 }
 
+// a page of the posting list of an entry of the current leaf; it belongs to the list while the leaf is unchanged
+ScanCODE IX_ScanIterator::_readPosting(int pageNum, char* page) {
+    if(fh_.readPage(pageNum, page) < 0) return ScanCODE::INVALID_RECORD;
+    return fh_.latches().validate(currPageNum_, leafVersion_) ? ScanCODE::SUCC : ScanCODE::RESTART;
+}
+
+ScanCODE IX_ScanIterator::_nextPosting(int head, RID& rid) {
+    if(!inPosting_) {
+        inPosting_ = true;
+        postings_.clear();
+        postingPos_ = 0;
+        postingNext_ = head;
+    }
+    while(postingPos_ == postings_.size()) {
+        char page[PAGE_SIZE];
+        ScanCODE code = postingNext_ == -1 ? ScanCODE::INVALID_RECORD : _readPosting(postingNext_, page);
+        if(code != ScanCODE::SUCC) {
+            inPosting_ = false;
+            return code;
+        }
+        postings_ = PostingPage::decode(page);
+        postingPos_ = 0;
+        postingNext_ = PostingPage::getNextPage(page);
+    }
+    rid = postings_[postingPos_++];
+    return ScanCODE::SUCC;
+}
+
+ScanCODE IX_ScanIterator::_seekPosting(int head, const RID& after) {
+    char page[PAGE_SIZE];
+    int pageNum = head;
+    while(true) {
+        ScanCODE code = _readPosting(pageNum, page);
+        if(code != ScanCODE::SUCC) return code;
+        int next = PostingPage::getNextPage(page);
+        if(next == -1 || (PostingPage::getCount(page) > 0 && compareRID(after, PostingPage::getLast(page)) < 0)) break;
+        pageNum = next;
+    }
+    postings_ = PostingPage::decode(page);
+    postingPos_ = std::upper_bound(postings_.begin(), postings_.end(), after,
+                                   [](const RID& a, const RID& b){ return compareRID(a, b) < 0; }) - postings_.begin();
+    postingNext_ = PostingPage::getNextPage(page);
+    inPosting_ = postingPos_ < postings_.size();
+    return inPosting_ ? ScanCODE::SUCC : ScanCODE::INVALID_RECORD;
+}
+
+// an equality probe reads the one bucket of its key
+bool IX_ScanIterator::_isProbe() {
+    return !lowKeyNull_ && !highKeyNull_ && lowKeyInclusive_ && highKeyInclusive_ &&
+           compareKeyOf(attr_.type, lowKey_.value.data(), lowKey_.value.size(), highKey_.value.data(), highKey_.value.size()) == 0;
+}
+
+// Copy the matching entries of the next bucket. Other scans than probes go through the directory slots
+// and skip a slot whose entries were copied from an earlier slot with fewer bits, since local depths
+// only grow: its bucket then was the same one, or the bucket it split off from.
+RC IX_ScanIterator::_nextBucket() {
+    IndexLatches& latches = fh_.latches();
+    bool probe = _isProbe();
+    std::vector<int> pageNums;
+    std::vector<char> pages;
+    bucket_.clear();
+    bucketPos_ = 0;
+    while(bucket_.empty()) {
+        if(probe && hashSlot_ > 0) return IX_EOF;
+        unsigned h = probe ? hashOf(attr_.type, lowKey_) : hashSlot_, slots;
+        int head, read = 0;
+        uint64_t version;
+        if(findBucket(latches, h, head, version, slots)) {
+            if(!probe && hashSlot_ >= slots) return IX_EOF;
+            read = readBucket(fh_, head, &version, pageNums, pages);
+            if(read < 0) return IX_EOF;
+        }
+        if(read == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        hashSlot_++;
+        int depth = HashPage::getLocalDepth(pages.data());
+        if(!probe) {
+            bool seen = false;
+            for(int d = 0; d <= depth && !seen; ++d) {
+                unsigned j = h & ((1u << d) - 1);
+                seen = j < visitedDepth_.size() && visitedDepth_[j] == d;
+            }
+            if(seen) continue;
+            if(visitedDepth_.size() <= h) visitedDepth_.resize(h + 1, -1);
+            visitedDepth_[h] = depth;
+        }
+        for(size_t i = 0; i < pageNums.size(); ++i) {
+            const char* page = pages.data() + i * PAGE_SIZE;
+            for(int off = HashPage::HEADSIZE, end = off + HashPage::getUsed(page); off < end; off += HashPage::entrySize(page + off)) {
+                const char* entry = page + off;
+                const char* key = HashPage::getKey(entry);
+                int len = HashPage::getKeyLen(entry), c;
+                if(probe) {
+                    if(!HashPage::matches(entry, h, lowKey_.value.data(), lowKey_.value.size())) continue;
+                } else {
+                    if(!lowKeyNull_ && ((c = compareKeyOf(attr_.type, key, len, lowKey_.value.data(), lowKey_.value.size())) < 0 ||
+                                        (c == 0 && !lowKeyInclusive_))) continue;
+                    if(!highKeyNull_ && ((c = compareKeyOf(attr_.type, key, len, highKey_.value.data(), highKey_.value.size())) > 0 ||
+                                         (c == 0 && !highKeyInclusive_))) continue;
+                }
+                bucket_.insert(bucket_.end(), entry, entry + HashPage::entrySize(entry));
+            }
+        }
+    }
+    return 0;
+}
+
+RC IX_ScanIterator::_getNextHashEntry(RID &rid, void *key) {
+    if(!inited_) {
+        inited_ = true;
+        hashSlot_ = 0;
+        visitedDepth_.clear();
+        bucket_.clear();
+        bucketPos_ = 0;
+    }
+    if(bucketPos_ >= bucket_.size() && _nextBucket() < 0) return IX_EOF;
+    const char* entry = bucket_.data() + bucketPos_;
+    rid = HashPage::getRID(entry);
+    int len = HashPage::getKeyLen(entry);
+    if(attr_.type == TypeVarChar) {
+        memcpy(key, &len, sizeof(int));
+        memcpy((char*)key + sizeof(int), HashPage::getKey(entry), len);
+    } else {
+        memcpy(key, HashPage::getKey(entry), len);
+    }
+    bucketPos_ += HashPage::entrySize(entry);
+    return 0;
+}
+
 RC IX_ScanIterator::close() {return 0;}
 /* ================= IXFileHandle ================ */
 IXFileHandle::IXFileHandle() {}
@@ -696,58 +2279,126 @@ IXFileHandle::~IXFileHandle() {
 bool IXFileHandle::isOpen() {
     return (bool)shared_item_;
 }
-RC IXFileHandle::setFile(FILE* fp){
-    shared_item_ = std::make_shared<FileHandle::SharedItem>();
-    shared_item_->name = fp;
-
-    if (getSize() < PAGE_SIZE) {
-        shared_item_->readPageCounter = 0;
-        shared_item_->writePageCounter = 0;
-        shared_item_->appendPageCounter = 0;
-        if (ftruncate(fileno(shared_item_->name), PAGE_SIZE) < 0) {
-            perror("setFile: ");
-            exit(EXIT_FAILURE);
-        }
-        fseek(shared_item_->name, 0, SEEK_SET);
-        unsigned counter[] = {0,0,0};
-        fwrite(counter, sizeof(unsigned), 3, shared_item_->name);
-        int roots[] = {-1, -1};
-        fwrite(roots, sizeof(roots), 1, shared_item_->name);
-    } else {
-        fseek(shared_item_->name, 0, SEEK_SET);
-        char buf[3 * sizeof(unsigned)]{'\0'};
-        if (fread(buf, sizeof(unsigned), 3, shared_item_->name) < 3) {
-            perror("setFile: ");
-            exit(EXIT_FAILURE);
-        }
-        shared_item_->readPageCounter = *(unsigned *) buf;
-        shared_item_->writePageCounter = *(unsigned *) (buf + sizeof(unsigned));
-        shared_item_->appendPageCounter = *(unsigned *) (buf + 2 * sizeof(unsigned));
+RC IXFileHandle::setFile(int fd){
+    struct stat st;
+    bool empty = fstat(fd, &st) < 0 || st.st_size < PAGE_SIZE;
+    FileHandle::setFile(fd);
+    if (empty) { // no root page and no idle page yet
+        setRootPageNum(-1);
+        setIdlePageNum(-1);
+        int version = INDEX_FORMAT_VERSION;
+        shared_item_->writeHeader(INDEX_FORMAT_OFFSET, &version, sizeof(int));
     }
     return 0;
 }
 
 int IXFileHandle::getRootPageNum(){
-    fseek(shared_item_->name, 3 * sizeof(unsigned), SEEK_SET);
+    if(latches_) return latches_->root;
     int res;
-    fread(&res, sizeof(int), 1, shared_item_->name);
+    shared_item_->readHeader(3 * sizeof(unsigned), &res, sizeof(int));
     return res;
 }
 int IXFileHandle::setRootPageNum(int v){
-    fseek(shared_item_->name, 3 * sizeof(unsigned), SEEK_SET);
-    fwrite(&v, sizeof(int), 1, shared_item_->name);
-    return 0;
+    if(latches_) latches_->root = v;
+    return shared_item_->writeHeader(3 * sizeof(unsigned), &v, sizeof(int));
 }
 int  IXFileHandle::getIdlePageNum(){
-    fseek(shared_item_->name, 3 * sizeof(unsigned) + sizeof(int), SEEK_SET);
+    if(latches_) return latches_->idle;
     int res;
-    fread(&res, sizeof(int), 1, shared_item_->name);
+    shared_item_->readHeader(3 * sizeof(unsigned) + sizeof(int), &res, sizeof(int));
     return res;
 }
 int  IXFileHandle::setIdlePageNum(int v){
-    fseek(shared_item_->name, 3 * sizeof(unsigned) + sizeof(int), SEEK_SET);
-    fwrite(&v, sizeof(int), 1, shared_item_->name);
-    return 0;
+    if(latches_) latches_->idle = v;
+    return shared_item_->writeHeader(3 * sizeof(unsigned) + sizeof(int), &v, sizeof(int));
+}
+
+IndexKind IXFileHandle::getIndexKind(){
+    if(latches_) return latches_->kind;
+    int kind = 0;
+    shared_item_->readHeader(INDEX_KIND_OFFSET, &kind, sizeof(int));
+    return (IndexKind)kind;
+}
+
+// the page is latched while it is written, readers still holding its old number start over
+int IXFileHandle::newPage(const void *data){
+    std::lock_guard<std::mutex> lock(latches_->pageMutex);
+    int idle = getIdlePageNum(), next = -1;
+    char page[PAGE_SIZE];
+    if(idle != -1 && readPage(idle, page) == 0) next = *(int*)page;
+    else idle = -1;
+    int pageNum = idle != -1 ? idle : getNumberOfPages();
+    if(pageNum >= IndexLatches::MAX_PAGES) return -1;
+    latches_->writeLock(pageNum);
+    RC rc = idle != -1 ? writePage(pageNum, data) : appendPage(data);
+    latches_->writeUnlock(pageNum);
+    if(rc < 0) return -1;
+    if(idle != -1) setIdlePageNum(next);
+    return pageNum;
+}
+RC IXFileHandle::freePage(int pageNum){
+    std::lock_guard<std::mutex> lock(latches_->pageMutex);
+    char page[PAGE_SIZE];
+    memset(page, 0, PAGE_SIZE);
+    *(int*)page = getIdlePageNum();
+    latches_->writeLock(pageNum);
+    RC rc = writePage(pageNum, page);
+    latches_->writeUnlock(pageNum);
+    if(rc < 0) return -1;
+    return setIdlePageNum(pageNum);
+}
+
+/* ====================== IndexLatches ==================== */
+IndexLatches::IndexLatches(int root, int idle) : root(root), idle(idle) {
+    for(auto& chunk: chunks_) chunk.store(nullptr);
+}
+IndexLatches::~IndexLatches() {
+    for(auto& chunk: chunks_) delete[] chunk.load();
+}
+std::atomic<uint64_t>* IndexLatches::_latch(int pageNum) {
+    unsigned i = pageNum + 1; // META takes the first latch
+    if(i > (unsigned)MAX_PAGES) return nullptr;
+    std::atomic<std::atomic<uint64_t>*>& slot = chunks_[i >> CHUNK_BITS];
+    std::atomic<uint64_t>* chunk = slot.load();
+    if(chunk == nullptr) {
+        std::atomic<uint64_t>* fresh = new std::atomic<uint64_t>[1 << CHUNK_BITS];
+        for(int j = 0; j < 1 << CHUNK_BITS; ++j) fresh[j].store(0);
+        // another thread may have been first, then chunk holds its array
+        if(slot.compare_exchange_strong(chunk, fresh)) chunk = fresh;
+        else delete[] fresh;
+    }
+    return chunk + (i & ((1 << CHUNK_BITS) - 1));
+}
+bool IndexLatches::readLock(int pageNum, uint64_t& version) {
+    std::atomic<uint64_t>* latch = _latch(pageNum);
+    if(latch == nullptr) return false;
+    version = latch->load(std::memory_order_acquire);
+    return (version & 1) == 0;
+}
+bool IndexLatches::validate(int pageNum, uint64_t version) {
+    std::atomic<uint64_t>* latch = _latch(pageNum);
+    // the page was read before this, keep it that way
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return latch != nullptr && latch->load(std::memory_order_relaxed) == version;
+}
+bool IndexLatches::upgrade(int pageNum, uint64_t version) {
+    std::atomic<uint64_t>* latch = _latch(pageNum);
+    return latch != nullptr && latch->compare_exchange_strong(version, version + 1);
+}
+void IndexLatches::writeLock(int pageNum) {
+    std::atomic<uint64_t>* latch = _latch(pageNum);
+    if(latch == nullptr) return;
+    uint64_t version = latch->load();
+    while((version & 1) || !latch->compare_exchange_weak(version, version + 1)) {
+        if(version & 1) {
+            std::this_thread::yield();
+            version = latch->load();
+        }
+    }
+}
+void IndexLatches::writeUnlock(int pageNum) {
+    std::atomic<uint64_t>* latch = _latch(pageNum);
+    if(latch != nullptr) latch->fetch_add(1, std::memory_order_release);
 }
 
 /* ====================== IndexPage ==================== */
@@ -755,6 +2406,7 @@ void IndexPage::InitializePage(char* page) {
     IndexPage::setSlotTableLen(page, 0);
     IndexPage::setStackTop(page, PAGE_SIZE);
     IndexPage::setNextLeafId(page, -1);
+    IndexPage::setPrefixLen(page, 0);
     IndexPage::setEmptySlotFlag(page, false);
 }
 
@@ -781,20 +2433,21 @@ void IndexPage::setNextLeafId(char* page, int n){
     *(int*)(page+2*sizeof(TypeOffset)) = n;
 }
 
-std::vector<char> IndexPage::readRawIndex(char* page, int i){
+std::vector<char> IndexPage::readRawIndex(const char* page, int i){
     if(i * sizeof(SlotItem) >= IndexPage::getSlotTableLen(page)){
         std::cerr << "readRawIndex error !!!" << std::endl;
         return std::vector<char>();
     }
-    SlotItem& slotref = *(SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+    const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
     std::vector<char> res;
     int len = slotref.data_size - sizeof(int);
+    if(slotref.field_num == 2) pushBackTo(res, IndexPage::getPrefix(page), IndexPage::getPrefixLen(page));
     pushBackTo(res, page + slotref.offset + sizeof(int), len);
     //if(len <= 0) std::cerr << "[readRawIndex] " << IndexPage::getSlotCount(page) << std::endl;
     return res;
 }
 
-IndexItem IndexPage::readIndexItem(char* page, int i){
+IndexItem IndexPage::readIndexItem(const char* page, int i){
     /*
     data format | leftChildPageNum | [key | rid] |
                                 4B                                    x B    8 B
@@ -803,21 +2456,34 @@ IndexItem IndexPage::readIndexItem(char* page, int i){
         std::cerr << "readIndexItem error !!!" << std::endl;
         return IndexItem();
     }
-    SlotItem& slotref = *(SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+    const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
     IndexItem res;
-    char* datastart = page + slotref.offset;
-    res.leftChildPageNum = *(int*)datastart;
+    const char* datastart = page + slotref.offset;
+    res.leftChildPageNum = *(const int*)datastart;
     datastart += sizeof(int);
     int len = slotref.data_size - sizeof(int) - sizeof(RID);
     //if(len < 4) 
     //    std::cerr << len <<" "<<i<<std::endl;
+    if(slotref.field_num == 2) pushBackTo(res.value, IndexPage::getPrefix(page), IndexPage::getPrefixLen(page));
     pushBackTo(res.value, datastart, len);
     datastart += len;
-    res.rid.pageNum = *(unsigned*)datastart;
-    res.rid.slotNum = *(unsigned*)(datastart + sizeof(unsigned));
+    res.rid.pageNum = *(const unsigned*)datastart;
+    res.rid.slotNum = *(const unsigned*)(datastart + sizeof(unsigned));
     return res;
 }
 
+RID IndexPage::getRID(const char* page, int i){
+    const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+    RID rid;
+    memcpy(&rid, page + slotref.offset + slotref.data_size - sizeof(RID), sizeof(RID));
+    return rid;
+}
+
+void IndexPage::setRID(char* page, int i, const RID& rid){
+    const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+    memcpy(page + slotref.offset + slotref.data_size - sizeof(RID), &rid, sizeof(RID));
+}
+
 void IndexPage::setChildPageNum(char* page, int childPageNum, int i) {
     SlotItem& slotref = *(SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
     *(int*)(page + slotref.offset) = childPageNum;
@@ -995,8 +2661,8 @@ void IndexPage::setEmptySlotFlag(char* page, bool v){
     bool* pos = (bool*)(page + IndexPage::PAGEHEADSIZE - sizeof(bool));
     *pos = v;
 }
-bool IndexPage::hasEmptySlot(char* page){
-    return *(bool*)(page + IndexPage::PAGEHEADSIZE - sizeof(bool));
+bool IndexPage::hasEmptySlot(const char* page){
+    return *(const bool*)(page + IndexPage::PAGEHEADSIZE - sizeof(bool));
 }
 void IndexPage::garbageSlotCollection(char* page) {
     if(!IndexPage::hasEmptySlot(page)) return;
@@ -1017,22 +2683,652 @@ void IndexPage::garbageSlotCollection(char* page) {
     IndexPage::setEmptySlotFlag(page, false);
     IndexPage::setStackTop(page, item_start[left-1].offset);
 }
-TypeOffset IndexPage::getSlotTableLen(char* page){
-    return *(TypeOffset *) page;
+TypeOffset IndexPage::getSlotTableLen(const char* page){
+    return *(const TypeOffset *) page;
 }
 
-TypeOffset IndexPage::getStackTop(char* page){
-    return *(TypeOffset *) (page + sizeof(TypeOffset));
+TypeOffset IndexPage::getStackTop(const char* page){
+    return *(const TypeOffset *) (page + sizeof(TypeOffset));
 }
 
-int IndexPage::getNextLeafId(char* page){
-    return *(int*)(page+2*sizeof(TypeOffset));
+int IndexPage::getNextLeafId(const char* page){
+    return *(const int*)(page+2*sizeof(TypeOffset));
 }
 
-TypeOffset IndexPage::getEmptySize(char *page){
+TypeOffset IndexPage::getEmptySize(const char* page){
     return IndexPage::getStackTop(page) - IndexPage::getSlotTableLen(page) - IndexPage::PAGEHEADSIZE;
 
 }
-int IndexPage::getSlotCount(char* page){
+int IndexPage::getSlotCount(const char* page){
     return IndexPage::getSlotTableLen(page) / sizeof(SlotItem);
 }
+
+int IndexPage::getPrefixLen(const char* page){
+    return *(const TypeOffset*)(page + 2*sizeof(TypeOffset) + sizeof(int));
+}
+
+void IndexPage::setPrefixLen(char* page, int n){
+    *(TypeOffset*)(page + 2*sizeof(TypeOffset) + sizeof(int)) = n;
+}
+
+const char* IndexPage::getPrefix(const char* page){
+    return page + PAGE_SIZE - IndexPage::getPrefixLen(page);
+}
+
+int IndexPage::commonPrefixLen(const std::vector<char>& a, const std::vector<char>& b){
+    int n = std::min(a.size(), b.size()) - sizeof(RID), i = 0;
+    while(i < n && a[i] == b[i]) ++i;
+    return i;
+}
+
+std::vector<std::vector<char>> IndexPage::readLeafValues(const char* page){
+    std::vector<std::vector<char>> values;
+    int slotnum = IndexPage::getSlotCount(page);
+    for(int i = 0; i < slotnum - 1; ++i){ // omit the final child-only record
+        const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+        if(slotref.metadata_size == -1) continue;
+        values.push_back(IndexPage::readRawIndex(page, i));
+    }
+    return values;
+}
+
+int IndexPage::leafSize(const std::vector<std::vector<char>>& values, int begin, int end){
+    int n = end - begin, plen = n > 0 ? IndexPage::commonPrefixLen(values[begin], values[end-1]) : 0, bytes = 0;
+    for(int j = begin; j < end; ++j) bytes += values[j].size();
+    return IndexPage::leafSize(n, bytes, plen);
+}
+
+int IndexPage::leafSize(int count, int bytes, int plen){
+    // head + slots with the tail one + | childPageNum | suffix | rid | entries + tail child + prefix
+    return IndexPage::PAGEHEADSIZE + (count + 1) * sizeof(SlotItem) + sizeof(int) + plen +
+           count * ((int)sizeof(int) - plen) + bytes;
+}
+
+void IndexPage::buildLeaf(char* page, const std::vector<std::vector<char>>& values, int begin, int end, int nextLeafId){
+    // the keys are sorted, so the first and the last share what all of them share
+    int plen = end > begin ? IndexPage::commonPrefixLen(values[begin], values[end-1]) : 0;
+    IndexPage::InitializePage(page);
+    if(plen > 0) {
+        memcpy(page + PAGE_SIZE - plen, values[begin].data(), plen);
+        IndexPage::setPrefixLen(page, plen);
+        IndexPage::setStackTop(page, PAGE_SIZE - plen);
+    }
+    std::vector<char> data;
+    int child = -1;
+    for(int j = begin; j < end; ++j){
+        data.clear();
+        pushBackTo(data, (const char*)&child, sizeof(int));
+        data.insert(data.end(), values[j].begin() + plen, values[j].end());
+        SlotItem slot{0, (TypeOffset)data.size(), 0, 2};
+        slot.offset = IndexPage::appendData(page, data.data(), data.size());
+        IndexPage::writeSlot(page, IndexPage::appendSlot(page), slot);
+    }
+    IndexPage::appendTailChildPointer(page);
+    IndexPage::setNextLeafId(page, nextLeafId);
+}
+
+std::vector<char> IndexPage::separator(const std::vector<char>& left, const std::vector<char>& right){
+    int llen = left.size() - sizeof(RID), rlen = right.size() - sizeof(RID);
+    int lcp = IndexPage::commonPrefixLen(left, right);
+    if(lcp == llen && lcp == rlen) return right; // equal keys, only the rid tells them apart
+    // one byte past the common prefix is already greater than left, and with the smallest rid not greater than right
+    std::vector<char> res(right.begin(), right.begin() + lcp + 1);
+    RID rid{0, 0};
+    pushBackTo(res, (const char*)&rid, sizeof(RID));
+    return res;
+}
+
+std::vector<std::vector<char>> IndexPage::readInnerValues(const char* page, std::vector<int>& children){
+    std::vector<std::vector<char>> values;
+    int slotnum = IndexPage::getSlotCount(page);
+    children.clear();
+    for(int i = 0; i < slotnum; ++i){
+        const SlotItem& slotref = *(const SlotItem*)(page + IndexPage::PAGEHEADSIZE + i * sizeof(SlotItem));
+        children.push_back(*(const int*)(page + slotref.offset));
+        if(i < slotnum - 1) values.push_back(IndexPage::readRawIndex(page, i));
+    }
+    return values;
+}
+
+int IndexPage::innerSize(const std::vector<std::vector<char>>& values, int begin, int end){
+    int bytes = 0;
+    for(int j = begin; j < end; ++j) bytes += values[j].size();
+    return IndexPage::innerSize(end - begin, bytes);
+}
+
+int IndexPage::innerSize(int count, int bytes){
+    // head + slots with the tail one + | childPageNum | key | rid | entries + tail child
+    return IndexPage::PAGEHEADSIZE + (count + 1) * sizeof(SlotItem) + sizeof(int) + count * sizeof(int) + bytes;
+}
+
+void IndexPage::buildInner(char* page, const std::vector<std::vector<char>>& values, const std::vector<int>& children,
+                           int begin, int end){
+    IndexPage::InitializePage(page);
+    std::vector<char> data;
+    for(int j = begin; j < end; ++j){
+        data.clear();
+        pushBackTo(data, (const char*)&children[j], sizeof(int));
+        data.insert(data.end(), values[j].begin(), values[j].end());
+        SlotItem slot{0, (TypeOffset)data.size(), 0, 2};
+        slot.offset = IndexPage::appendData(page, data.data(), data.size());
+        IndexPage::writeSlot(page, IndexPage::appendSlot(page), slot);
+    }
+    IndexPage::appendTailChildPointer(page);
+    IndexPage::setChildPageNum(page, children[end], end - begin);
+    IndexPage::setNextLeafId(page, NONLEAF);
+}
+
+bool IndexPage::underflows(const char* page){
+    return (PAGE_SIZE - IndexPage::getEmptySize(page)) * UNDERFLOW_FILL < PAGE_SIZE;
+}
+
+/* ====================== FixedPage ==================== */
+void FixedPage::InitializePage(char* page, int nextLeafId) {
+    memset(page, 0, PAGE_SIZE);
+    IndexPage::setNextLeafId(page, nextLeafId);
+}
+
+int FixedPage::getCount(const char* page) {
+    return *(const unsigned short*)page;
+}
+
+void FixedPage::setCount(char* page, int n) {
+    *(unsigned short*)page = n;
+}
+
+bool FixedPage::isLeaf(const char* page) {
+    return IndexPage::getNextLeafId(page) >= -1;
+}
+
+int FixedPage::getCapacity(const char* page) {
+    return FixedPage::isLeaf(page) ? LEAF_CAPACITY : INNER_CAPACITY;
+}
+
+const char* FixedPage::keyAt(const char* page, int i) {
+    return page + HEADSIZE + i * KEYSIZE;
+}
+
+RID FixedPage::getRID(const char* page, int i) {
+    return *(const RID*)(page + HEADSIZE + FixedPage::getCapacity(page) * KEYSIZE + i * sizeof(RID));
+}
+
+void FixedPage::setEntry(char* page, int i, const char* value) {
+    int cap = FixedPage::getCapacity(page);
+    memcpy(page + HEADSIZE + i * KEYSIZE, value, KEYSIZE);
+    memcpy(page + HEADSIZE + cap * KEYSIZE + i * sizeof(RID), value + KEYSIZE, sizeof(RID));
+}
+
+int FixedPage::getChild(const char* page, int i) {
+    return ((const int*)(page + HEADSIZE + INNER_CAPACITY * (KEYSIZE + sizeof(RID))))[i];
+}
+
+void FixedPage::setChild(char* page, int i, int childPageNum) {
+    ((int*)(page + HEADSIZE + INNER_CAPACITY * (KEYSIZE + sizeof(RID))))[i] = childPageNum;
+}
+
+bool FixedPage::isDeleted(const char* page, int i) {
+    if(!FixedPage::isLeaf(page)) return false;
+    const char* bitmap = page + HEADSIZE + LEAF_CAPACITY * (KEYSIZE + sizeof(RID));
+    return (bitmap[i / 8] >> (i % 8)) & 1;
+}
+
+void FixedPage::setDeleted(char* page, int i, bool v) {
+    char* bitmap = page + HEADSIZE + LEAF_CAPACITY * (KEYSIZE + sizeof(RID));
+    if(v) {
+        bitmap[i / 8] |= 1 << (i % 8);
+        IndexPage::setEmptySlotFlag(page, true);
+    } else {
+        bitmap[i / 8] &= ~(1 << (i % 8));
+    }
+}
+
+void FixedPage::insertAt(char* page, int i, const char* value, int rightChild) {
+    int n = FixedPage::getCount(page), cap = FixedPage::getCapacity(page);
+    char* keys = page + HEADSIZE;
+    char* rids = keys + cap * KEYSIZE;
+    memmove(keys + (i + 1) * KEYSIZE, keys + i * KEYSIZE, (n - i) * KEYSIZE);
+    memmove(rids + (i + 1) * sizeof(RID), rids + i * sizeof(RID), (n - i) * sizeof(RID));
+    if(FixedPage::isLeaf(page)) {
+        if(IndexPage::hasEmptySlot(page)) {
+            for(int j = n; j > i; --j) FixedPage::setDeleted(page, j, FixedPage::isDeleted(page, j - 1));
+        }
+        FixedPage::setDeleted(page, i, false);
+    } else {
+        int* children = (int*)(rids + cap * sizeof(RID));
+        memmove(children + i + 2, children + i + 1, (n - i) * sizeof(int));
+        children[i + 1] = rightChild;
+    }
+    FixedPage::setEntry(page, i, value);
+    FixedPage::setCount(page, n + 1);
+}
+
+void FixedPage::insertAndSplit(char* page, char* newpage, int i, std::vector<char>& value, int rightChild) {
+    // lay all entries out in order with the new one at i
+    const int entrySize = KEYSIZE + sizeof(RID);
+    int n = FixedPage::getCount(page), total = n + 1;
+    bool leaf = FixedPage::isLeaf(page);
+    std::vector<char> entries(total * entrySize);
+    std::vector<int> children;
+    for(int j = 0; j < n; ++j) {
+        char* dst = entries.data() + (j < i ? j : j + 1) * entrySize;
+        RID rid = FixedPage::getRID(page, j);
+        memcpy(dst, FixedPage::keyAt(page, j), KEYSIZE);
+        memcpy(dst + KEYSIZE, &rid, sizeof(RID));
+    }
+    memcpy(entries.data() + i * entrySize, value.data(), entrySize);
+    if(!leaf) {
+        for(int j = 0; j <= n; ++j) children.push_back(FixedPage::getChild(page, j));
+        children.insert(children.begin() + i + 1, rightChild);
+    }
+    // a leaf keeps its lower half and copies the first key of newpage up,
+    // an inner node moves the middle key up
+    int left = total / 2, right = leaf ? left : left + 1;
+    int nextLeafId = IndexPage::getNextLeafId(page);
+    FixedPage::InitializePage(page, nextLeafId);
+    FixedPage::InitializePage(newpage, nextLeafId);
+    for(int j = 0; j < left; ++j) FixedPage::setEntry(page, j, entries.data() + j * entrySize);
+    for(int j = right; j < total; ++j) FixedPage::setEntry(newpage, j - right, entries.data() + j * entrySize);
+    FixedPage::setCount(page, left);
+    FixedPage::setCount(newpage, total - right);
+    if(!leaf) {
+        for(int j = 0; j <= left; ++j) FixedPage::setChild(page, j, children[j]);
+        for(int j = right; j <= total; ++j) FixedPage::setChild(newpage, j - right, children[j]);
+    }
+    value.assign(entries.data() + left * entrySize, entries.data() + (left + 1) * entrySize);
+}
+
+void FixedPage::removeAt(char* page, int i) {
+    int n = FixedPage::getCount(page), cap = FixedPage::getCapacity(page);
+    char* keys = page + HEADSIZE;
+    char* rids = keys + cap * KEYSIZE;
+    memmove(keys + i * KEYSIZE, keys + (i + 1) * KEYSIZE, (n - i - 1) * KEYSIZE);
+    memmove(rids + i * sizeof(RID), rids + (i + 1) * sizeof(RID), (n - i - 1) * sizeof(RID));
+    if(FixedPage::isLeaf(page)) {
+        if(IndexPage::hasEmptySlot(page)) {
+            for(int j = i; j < n - 1; ++j) FixedPage::setDeleted(page, j, FixedPage::isDeleted(page, j + 1));
+        }
+        FixedPage::setDeleted(page, n - 1, false);
+    } else {
+        int* children = (int*)(rids + cap * sizeof(RID));
+        memmove(children + i + 1, children + i + 2, (n - i - 1) * sizeof(int));
+    }
+    FixedPage::setCount(page, n - 1);
+}
+
+bool FixedPage::underflows(const char* page) {
+    return FixedPage::getCount(page) * UNDERFLOW_FILL < FixedPage::getCapacity(page);
+}
+
+void FixedPage::garbageSlotCollection(char* page) {
+    if(!IndexPage::hasEmptySlot(page)) return;
+    int n = FixedPage::getCount(page), left = 0;
+    char value[KEYSIZE + sizeof(RID)];
+    for(int i = 0; i < n; ++i) {
+        if(FixedPage::isDeleted(page, i)) continue;
+        if(left < i) {
+            RID rid = FixedPage::getRID(page, i);
+            memcpy(value, FixedPage::keyAt(page, i), KEYSIZE);
+            memcpy(value + KEYSIZE, &rid, sizeof(RID));
+            FixedPage::setEntry(page, left, value);
+        }
+        left++;
+    }
+    memset(page + HEADSIZE + LEAF_CAPACITY * (KEYSIZE + sizeof(RID)), 0, (LEAF_CAPACITY + 7) / 8);
+    FixedPage::setCount(page, left);
+    IndexPage::setEmptySlotFlag(page, false);
+}
+
+KeySearchKernel FixedPage::getSearchKernel() {
+    return keyCounters().kernel;
+}
+
+bool FixedPage::setSearchKernel(KeySearchKernel kernel) {
+    if(!kernelSupported(kernel)) return false;
+    keyCounters() = makeKeyCounters(kernel);
+    return true;
+}
+
+int FixedPage::lowerBound(const char* page, AttrType type, const void* key) {
+    KeyRef k{(const char*)key, FixedPage::KEYSIZE, RID{0, 0}};
+    return type == TypeInt ? fixedLowerBound<TypeInt, false>(page, k) : fixedLowerBound<TypeReal, false>(page, k);
+}
+
+int IndexPage::lowerBound(const char* page, AttrType type, const void* key) {
+    switch(type) {
+        case TypeInt: return binarySearchLowerBound<TypeInt, false>(page, KeyRef{(const char*)key, 4, RID{0, 0}});
+        case TypeReal: return binarySearchLowerBound<TypeReal, false>(page, KeyRef{(const char*)key, 4, RID{0, 0}});
+        case TypeVarChar:
+            return binarySearchLowerBound<TypeVarChar, false>(page, KeyRef{(const char*)key + 4, *(const int*)key, RID{0, 0}});
+    }
+    return -1;
+}
+
+/* ====================== PostingPage ==================== */
+// a RID after the previous one: | slot delta << 1 | on the same page, | page delta << 1 | 1 | slot | otherwise
+static int putVarint(char* p, unsigned v) {
+    int n = 0;
+    while(v >= 0x80) {
+        p[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (char)v;
+    return n;
+}
+
+static unsigned getVarint(const char* p, int& pos) {
+    unsigned v = 0;
+    for(int shift = 0; ; shift += 7) {
+        unsigned char c = p[pos++];
+        v |= (unsigned)(c & 0x7f) << shift;
+        if(!(c & 0x80)) return v;
+    }
+}
+
+static int putDelta(char* p, const RID& prev, const RID& rid) {
+    if(rid.pageNum == prev.pageNum) return putVarint(p, (rid.slotNum - prev.slotNum) << 1);
+    int n = putVarint(p, (rid.pageNum - prev.pageNum) << 1 | 1);
+    return n + putVarint(p + n, rid.slotNum);
+}
+
+void PostingPage::InitializePage(char* page) {
+    memset(page, 0, HEADSIZE);
+    PostingPage::setNextPage(page, -1);
+}
+
+int PostingPage::getNextPage(const char* page) {
+    return *(const int*)page;
+}
+
+void PostingPage::setNextPage(char* page, int pageNum) {
+    *(int*)page = pageNum;
+}
+
+int PostingPage::getCount(const char* page) {
+    return *(const unsigned short*)(page + 4);
+}
+
+RID PostingPage::getFirst(const char* page) {
+    return *(const RID*)(page + 8);
+}
+
+RID PostingPage::getLast(const char* page) {
+    return *(const RID*)(page + 16);
+}
+
+int PostingPage::getTailPage(const char* head) {
+    return *(const int*)(head + 24);
+}
+
+void PostingPage::setTailPage(char* head, int pageNum) {
+    *(int*)(head + 24) = pageNum;
+}
+
+int PostingPage::getTotal(const char* head) {
+    return *(const int*)(head + 28);
+}
+
+void PostingPage::setTotal(char* head, int n) {
+    *(int*)(head + 28) = n;
+}
+
+std::vector<RID> PostingPage::decode(const char* page) {
+    int n = PostingPage::getCount(page), pos = HEADSIZE;
+    std::vector<RID> rids;
+    rids.reserve(n);
+    if(n == 0) return rids;
+    rids.push_back(PostingPage::getFirst(page));
+    for(int j = 1; j < n; ++j) {
+        RID rid = rids.back();
+        unsigned v = getVarint(page, pos);
+        if(v & 1) {
+            rid.pageNum += v >> 1;
+            rid.slotNum = getVarint(page, pos);
+        } else {
+            rid.slotNum += v >> 1;
+        }
+        rids.push_back(rid);
+    }
+    return rids;
+}
+
+int PostingPage::encode(char* page, const std::vector<RID>& rids, int begin, int end) {
+    int used = HEADSIZE, j = begin;
+    char buf[10];
+    if(j < end) *(RID*)(page + 8) = rids[j++];
+    for(; j < end; ++j) {
+        int n = putDelta(buf, rids[j - 1], rids[j]);
+        if(used + n > PAGE_SIZE) break;
+        memcpy(page + used, buf, n);
+        used += n;
+    }
+    *(unsigned short*)(page + 4) = j - begin;
+    *(unsigned short*)(page + 6) = used;
+    if(j > begin) *(RID*)(page + 16) = rids[j - 1];
+    return j;
+}
+
+int PostingPage::buildChain(const std::vector<RID>& rids, int firstPageNum, std::vector<char>& pages) {
+    int n = rids.size(), j = 0, count = 0;
+    pages.clear();
+    do {
+        pages.resize((count + 1) * PAGE_SIZE);
+        char* page = &pages[count * PAGE_SIZE];
+        PostingPage::InitializePage(page);
+        j = PostingPage::encode(page, rids, j, n);
+        if(j < n) PostingPage::setNextPage(page, firstPageNum + count + 1);
+        count++;
+    } while(j < n);
+    PostingPage::setTailPage(pages.data(), firstPageNum + count - 1);
+    PostingPage::setTotal(pages.data(), n);
+    return count;
+}
+
+int PostingPage::create(IXFileHandle& ixFileHandle, const std::vector<RID>& rids) {
+    std::vector<char> pages;
+    // a list of one page can take an idle page, it learns its number from newPage
+    if(PostingPage::buildChain(rids, 0, pages) == 1) {
+        int head = ixFileHandle.newPage(pages.data());
+        if(head < 0) return -1;
+        PostingPage::setTailPage(pages.data(), head);
+        return ixFileHandle.writePage(head, pages.data()) < 0 ? -1 : head;
+    }
+    // longer ones are appended in one go, numbered from the end of the file
+    std::lock_guard<std::mutex> lock(ixFileHandle.latches().pageMutex);
+    int head = ixFileHandle.getNumberOfPages(), count = PostingPage::buildChain(rids, head, pages);
+    PageNum first;
+    if(ixFileHandle.appendPages(pages.data(), count, first) < 0 || (int)first != head) return -1;
+    return head;
+}
+
+// the page of a list where rid belongs: past the pages whose RIDs are all smaller
+static int findPostingPage(IXFileHandle& ixFileHandle, int pageNum, const RID& rid, char* page) {
+    while(true) {
+        if(ixFileHandle.readPage(pageNum, page) < 0) return -1;
+        int next = PostingPage::getNextPage(page);
+        if(next == -1) return pageNum;
+        if(PostingPage::getCount(page) > 0 && compareRID(rid, PostingPage::getLast(page)) <= 0) return pageNum;
+        pageNum = next;
+    }
+}
+
+RC PostingPage::insert(IXFileHandle& ixFileHandle, int head, const RID& rid) {
+    char headpage[PAGE_SIZE], pagebuf[PAGE_SIZE];
+    if(ixFileHandle.readPage(head, headpage) < 0) return -1;
+    // new records mostly get larger RIDs, so try the tail before walking the list
+    int tail = PostingPage::getTailPage(headpage), pageNum = -1;
+    if(tail != head) {
+        if(ixFileHandle.readPage(tail, pagebuf) < 0) return -1;
+        if(PostingPage::getCount(pagebuf) > 0 && compareRID(rid, PostingPage::getFirst(pagebuf)) > 0) pageNum = tail;
+    }
+    if(pageNum == -1 && (pageNum = findPostingPage(ixFileHandle, head, rid, pagebuf)) < 0) return -1;
+    char* page = pageNum == head ? headpage : pagebuf;
+
+    // a RID after the last one of the page just gets its delta appended
+    int n = PostingPage::getCount(page), used = *(unsigned short*)(page + 6);
+    char buf[10];
+    int len = n > 0 && compareRID(rid, PostingPage::getLast(page)) > 0 ? putDelta(buf, PostingPage::getLast(page), rid) : 0;
+    if(len > 0 && used + len <= PAGE_SIZE) {
+        memcpy(page + used, buf, len);
+        *(unsigned short*)(page + 4) = n + 1;
+        *(unsigned short*)(page + 6) = used + len;
+        *(RID*)(page + 16) = rid;
+        PostingPage::setTotal(headpage, PostingPage::getTotal(headpage) + 1);
+        if(pageNum != head && ixFileHandle.writePage(pageNum, page) < 0) return -1;
+        return ixFileHandle.writePage(head, headpage);
+    }
+
+    std::vector<RID> rids = PostingPage::decode(page);
+    auto pos = std::lower_bound(rids.begin(), rids.end(), rid, [](const RID& a, const RID& b){ return compareRID(a, b) < 0; });
+    if(pos != rids.end() && compareRID(*pos, rid) == 0) return -1;
+    bool atEnd = pos == rids.end();
+    rids.insert(pos, rid);
+    n = rids.size();
+    if(PostingPage::encode(page, rids, 0, n) < n) {
+        // split the page; an append to the tail starts a new page instead
+        int m = atEnd && pageNum == tail ? n - 1 : n / 2;
+        char newpage[PAGE_SIZE];
+        PostingPage::InitializePage(newpage);
+        PostingPage::encode(newpage, rids, m, n);
+        PostingPage::setNextPage(newpage, PostingPage::getNextPage(page));
+        int newPageNum = ixFileHandle.newPage(newpage);
+        if(newPageNum < 0) return -1;
+        PostingPage::encode(page, rids, 0, m);
+        PostingPage::setNextPage(page, newPageNum);
+        if(pageNum == tail) PostingPage::setTailPage(headpage, newPageNum);
+    }
+    PostingPage::setTotal(headpage, PostingPage::getTotal(headpage) + 1);
+    if(pageNum != head && ixFileHandle.writePage(pageNum, page) < 0) return -1;
+    return ixFileHandle.writePage(head, headpage);
+}
+
+RC PostingPage::remove(IXFileHandle& ixFileHandle, int head, const RID& rid, bool& empty) {
+    char headpage[PAGE_SIZE], pagebuf[PAGE_SIZE];
+    if(ixFileHandle.readPage(head, headpage) < 0) return -1;
+    int pageNum = findPostingPage(ixFileHandle, head, rid, pagebuf);
+    if(pageNum < 0) return -1;
+    char* page = pageNum == head ? headpage : pagebuf;
+
+    std::vector<RID> rids = PostingPage::decode(page);
+    auto pos = std::lower_bound(rids.begin(), rids.end(), rid, [](const RID& a, const RID& b){ return compareRID(a, b) < 0; });
+    if(pos == rids.end() || compareRID(*pos, rid) != 0) return -1;
+    rids.erase(pos);
+    // dropping a RID never makes the deltas longer; an emptied page stays in the list
+    PostingPage::encode(page, rids, 0, rids.size());
+    PostingPage::setTotal(headpage, PostingPage::getTotal(headpage) - 1);
+    empty = PostingPage::getTotal(headpage) == 0;
+    if(pageNum != head && ixFileHandle.writePage(pageNum, page) < 0) return -1;
+    return ixFileHandle.writePage(head, headpage);
+}
+
+std::vector<RID> PostingPage::readAll(IXFileHandle& ixFileHandle, int head) {
+    std::vector<RID> rids;
+    char page[PAGE_SIZE];
+    for(int pageNum = head; pageNum != -1; pageNum = PostingPage::getNextPage(page)) {
+        if(ixFileHandle.readPage(pageNum, page) < 0) break;
+        std::vector<RID> part = PostingPage::decode(page);
+        rids.insert(rids.end(), part.begin(), part.end());
+    }
+    return rids;
+}
+
+RC PostingPage::release(IXFileHandle& ixFileHandle, int head) {
+    char page[PAGE_SIZE];
+    for(int pageNum = head, next; pageNum != -1; pageNum = next) {
+        if(ixFileHandle.readPage(pageNum, page) < 0) return -1;
+        next = PostingPage::getNextPage(page);
+        if(ixFileHandle.freePage(pageNum) < 0) return -1;
+    }
+    return 0;
+}
+
+/* ====================== HashPage ==================== */
+void HashPage::InitializePage(char* page, int localDepth) {
+    memset(page, 0, HEADSIZE);
+    HashPage::setNextPage(page, -1);
+    HashPage::setLocalDepth(page, localDepth);
+}
+
+int HashPage::getNextPage(const char* page) {
+    return *(const int*)page;
+}
+
+void HashPage::setNextPage(char* page, int pageNum) {
+    *(int*)page = pageNum;
+}
+
+int HashPage::getLocalDepth(const char* page) {
+    return *(const unsigned short*)(page + 4);
+}
+
+void HashPage::setLocalDepth(char* page, int depth) {
+    *(unsigned short*)(page + 4) = depth;
+}
+
+int HashPage::getCount(const char* page) {
+    return *(const unsigned short*)(page + 6);
+}
+
+int HashPage::getUsed(const char* page) {
+    return *(const unsigned short*)(page + 8);
+}
+
+int HashPage::entrySize(const char* entry) {
+    return ENTRY_HEADSIZE + HashPage::getKeyLen(entry);
+}
+
+unsigned HashPage::getHash(const char* entry) {
+    return *(const unsigned*)entry;
+}
+
+RID HashPage::getRID(const char* entry) {
+    return *(const RID*)(entry + 4);
+}
+
+const char* HashPage::getKey(const char* entry) {
+    return entry + ENTRY_HEADSIZE;
+}
+
+int HashPage::getKeyLen(const char* entry) {
+    return *(const unsigned short*)(entry + 12);
+}
+
+// FNV-1a, then the murmur3 finalizer, so that the low bits the directory uses depend on every byte
+unsigned HashPage::hash(const char* key, int len) {
+    unsigned h = 2166136261u;
+    for(int i = 0; i < len; ++i) h = (h ^ (unsigned char)key[i]) * 16777619u;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    return h ^ (h >> 16);
+}
+
+bool HashPage::matches(const char* entry, unsigned h, const char* key, int len) {
+    return HashPage::getHash(entry) == h && HashPage::getKeyLen(entry) == len &&
+           memcmp(HashPage::getKey(entry), key, len) == 0;
+}
+
+bool HashPage::append(char* page, unsigned h, const char* key, int len, const RID& rid) {
+    int used = HashPage::getUsed(page);
+    if(HEADSIZE + used + ENTRY_HEADSIZE + len > PAGE_SIZE) return false;
+    char* entry = page + HEADSIZE + used;
+    *(unsigned*)entry = h;
+    *(RID*)(entry + 4) = rid;
+    *(unsigned short*)(entry + 12) = len;
+    memcpy(entry + ENTRY_HEADSIZE, key, len);
+    *(unsigned short*)(page + 6) = HashPage::getCount(page) + 1;
+    *(unsigned short*)(page + 8) = used + ENTRY_HEADSIZE + len;
+    return true;
+}
+
+bool HashPage::appendEntry(char* page, const char* entry) {
+    return HashPage::append(page, HashPage::getHash(entry), HashPage::getKey(entry), HashPage::getKeyLen(entry),
+                            HashPage::getRID(entry));
+}
+
+void HashPage::removeAt(char* page, int offset) {
+    int size = HashPage::entrySize(page + offset), end = HEADSIZE + HashPage::getUsed(page);
+    memmove(page + offset, page + offset + size, end - offset - size);
+    *(unsigned short*)(page + 6) = HashPage::getCount(page) - 1;
+    *(unsigned short*)(page + 8) = end - HEADSIZE - size;
+}
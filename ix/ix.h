@@ -3,23 +3,39 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdint>
 
 #include "../rbf/rbfm.h"
 
 # define IX_EOF (-1)  // end of the index scan
 #define NONLEAF -2
+#define BULK_LOAD_FILL_FACTOR 0.9   // share of a page bulkLoad fills with entries
+#define BULK_LOAD_MEMORY (32 << 20) // bytes of entries bulkLoad sorts in memory before spilling a sorted run
+#define POSTING_SLOT 0xFFFFFFFFu    // slotNum of the RID of a leaf entry that owns a posting list
+#define POSTING_MIN_BYTES (PAGE_SIZE / 2) // leaf bytes the entries of one key take before they move to a posting list
+#define UNDERFLOW_FILL 4            // a page less than 1/UNDERFLOW_FILL full borrows from or merges with a sibling
+#define HASH_MAX_DEPTH 20           // hash bits the directory of a hash index uses at most
+#define INDEX_FORMAT_OFFSET 24      // header bytes of the format version, written when a file gets its header page
+#define INDEX_FORMAT_VERSION 1      // bumped when pages change layout or key order; openFile rejects other versions
 struct IndexPage;
 
 class IX_ScanIterator;
 
 class IXFileHandle;
 
+// how an index file finds its entries; a hash index answers equality probes with about one page read,
+// other ranges visit all of its buckets and come out in no particular order
+enum class IndexKind { BTREE, HASH };
+
 class IndexManager {
 public:
     static IndexManager &instance();
 
     // Create an index file.
-    RC createFile(const std::string &fileName);
+    RC createFile(const std::string &fileName, IndexKind kind = IndexKind::BTREE);
 
     // Delete an index file.
     RC destroyFile(const std::string &fileName);
@@ -33,6 +49,17 @@ public:
     // Insert an entry into the given index that is indicated by the given ixFileHandle.
     RC insertEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
 
+    // Insert many entries, sorted first so that neighbouring keys go to the same leaf one after another.
+    RC insertEntries(IXFileHandle &ixFileHandle, const Attribute &attribute, const std::vector<const void *> &keys,
+                     const std::vector<RID> &rids);
+
+    // Build the tree of an empty index from unsorted entries; next() returns false after the last one.
+    // Entries are sorted with an external merge sort, leaves are packed to fillFactor and the inner
+    // levels are built bottom-up. Other writers of the index wait until it is done.
+    RC bulkLoad(IXFileHandle &ixFileHandle, const Attribute &attribute,
+                const std::function<bool(const void *&key, RID &rid)> &next,
+                float fillFactor = BULK_LOAD_FILL_FACTOR, size_t memoryLimit = BULK_LOAD_MEMORY);
+
     // Delete an entry from the given index that is indicated by the given ixFileHandle.
     RC deleteEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
 
@@ -56,8 +83,50 @@ protected:
 
 };
 
+// pages a descent copied, at the versions it copied them
+struct PathCopy {
+    std::vector<int> pageNums;
+    std::vector<uint64_t> versions;
+    std::vector<char> pages; // PAGE_SIZE bytes each
+};
+
+// Latches of the pages of one index file, shared by every handle on it. A latch is a version counter
+// which is odd while a writer holds it. Readers take no latch: they copy a page, check that its version
+// did not change meanwhile and start over if it did (optimistic lock coupling).
+class IndexLatches {
+public:
+    static const int META = -1;                     // guards the root page number
+    static const int CHUNK_BITS = 14, CHUNKS = 1 << 14;
+    static const int MAX_PAGES = (CHUNKS << CHUNK_BITS) - 1;
+
+    IndexLatches(int root, int idle);
+    ~IndexLatches();
+    bool readLock(int pageNum, uint64_t& version); // false: a writer holds it
+    bool validate(int pageNum, uint64_t version);  // still at the version readLock gave
+    bool upgrade(int pageNum, uint64_t version);   // take it for writing, false if it changed since version
+    void writeLock(int pageNum);
+    void writeUnlock(int pageNum);
+
+    std::atomic<int> root, idle;   // the header fields, cached
+    std::mutex smoMutex;           // splits and merges run one at a time
+    std::mutex pageMutex;          // guards the idle list and appends
+    std::vector<int> held, freed;  // pages latched and freed by the running split or merge
+    PathCopy path;                 // the descent that led to it, its pages need no second read
+
+    IndexKind kind = IndexKind::BTREE;
+    // directory of a hash index, guarded by the META latch: the bucket of each value of the low
+    // globalDepth bits of a hash, and the pages it is stored on
+    std::mutex dirMutex;
+    std::vector<int> dir, dirPages;
+    int globalDepth = 0;
+private:
+    std::atomic<std::atomic<uint64_t>*> chunks_[CHUNKS]; // allocated when first used
+    std::atomic<uint64_t>* _latch(int pageNum);         // nullptr past MAX_PAGES
+};
+
 class IXFileHandle: public FileHandle {
     
+
 public:
     // variables to keep counter for each operation
     // unsigned ixReadPageCounter;
@@ -73,13 +142,19 @@ public:
     // Put the current counter values of associated PF FileHandles into variables
     // RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);
 
-    RC setFile(FILE*);
+    RC setFile(int fd) override;
     int getRootPageNum();
     int setRootPageNum(int);
     int getIdlePageNum();
     int setIdlePageNum(int);
+    // pages freed by merges are kept on a list of idle pages, each holding the next one in its first bytes
+    int newPage(const void *data); // write data to an idle page or append it; returns the page, -1 on failure
+    RC freePage(int pageNum);
+    IndexKind getIndexKind();
 
     bool isOpen();
+    IndexLatches &latches() { return *latches_; }
+    std::shared_ptr<IndexLatches> latches_; // set by IndexManager::openFile
 };
 
 struct IndexItem { // composite Index
@@ -111,31 +186,59 @@ private:
     Attribute attr_;
     IndexItem lowKey_, highKey_;
     bool lowKeyInclusive_, highKeyInclusive_, lowKeyNull_, highKeyNull_, inited_;
-    int currPageNum_, currSlotNum_, loadedPageNum_; // internal state: currPageNum_ have to be a leaf node
-
-    CompFunc comp_;
-    char pagebuf_[PAGE_SIZE]; // single-thread
-
-    ScanCODE _getNextEntry(RID&, void*, int&);
+    int currPageNum_, currSlotNum_; // internal state: currPageNum_ have to be a leaf node
+    // the last entry returned; when the leaf changed since, the scan goes on from it
+    IndexItem last_;
+    bool hasLast_ = false;
+
+    char pagebuf_[PAGE_SIZE]; // copy of the current leaf, taken at leafVersion_
+    uint64_t leafVersion_ = 0;
+    // a posting list being scanned: RIDs of its current page and the next page
+    bool inPosting_ = false;
+    std::vector<RID> postings_;
+    size_t postingPos_ = 0;
+    int postingNext_ = -1;
+
+    // instantiated per key type, so keys are compared in place on the page
+    template<AttrType T> RC _init();
+    template<AttrType T> RC _getNextEntry(RID&, void*);
+    template<AttrType T> ScanCODE _getNextEntry(RID&, void*, int&);
+    template<AttrType T> RC _reseek();
+    // SUCC, INVALID_RECORD after the last RID of the list, RESTART when the leaf changed
+    ScanCODE _nextPosting(int head, RID& rid);
+    ScanCODE _seekPosting(int head, const RID& after); // go to the first RID after after
+    ScanCODE _readPosting(int pageNum, char* page);
+
+    // a hash index: the matching entries of the current bucket, copied at once
+    bool hash_ = false;
+    std::vector<char> bucket_;       // | hash | rid | key length | key | entries
+    size_t bucketPos_ = 0;
+    unsigned hashSlot_ = 0;          // next directory slot of a scan that is no equality probe
+    std::vector<signed char> visitedDepth_; // local depth each slot was visited at, -1 if it was not
+    bool _isProbe();
+    RC _nextBucket();
+    RC _getNextHashEntry(RID &rid, void *key);
 };
 struct IndexPage {
-    static const int PAGEHEADSIZE = 9; // slottablelen 2 + stack top 2 + nextleafid 4 + nextIdleId 1
+    static const int PAGEHEADSIZE = 11; // slottablelen 2 + stack top 2 + nextleafid 4 + prefixlen 2 + nextIdleId 1
     // statistics
     static void InitializePage(char* page);
     static void setSlotTableLen(char* page, TypeOffset);
     static void setStackTop(char* page, TypeOffset);
     static void setNextLeafId(char* page, int);
-    static TypeOffset getSlotTableLen(char* page);
-    static TypeOffset getStackTop(char* page);
-    static int getNextLeafId(char* page);
-    static TypeOffset getEmptySize(char *page);
+    static TypeOffset getSlotTableLen(const char* page);
+    static TypeOffset getStackTop(const char* page);
+    static int getNextLeafId(const char* page);
+    static TypeOffset getEmptySize(const char* page);
 
     static void setEmptySlotFlag(char* page, bool);
-    static bool hasEmptySlot(char* page);
-    static int getSlotCount(char* page);
+    static bool hasEmptySlot(const char* page);
+    static int getSlotCount(const char* page);
     // index operations
-    static std::vector<char> readRawIndex(char* page, int i);   // not include leftChildPageNum
-    static IndexItem readIndexItem(char* page, int i);  // not include leftChildPageNum
+    static std::vector<char> readRawIndex(const char* page, int i);   // not include leftChildPageNum
+    static IndexItem readIndexItem(const char* page, int i);  // not include leftChildPageNum
+    static RID getRID(const char* page, int i);
+    static void setRID(char* page, int i, const RID& rid);
     static void insertValueTo(char* page, int childPageNum,std::vector<char>& value, int i);
     // insert to i-th index than split data into two page
     static void insertValueAndSplitPage(char* oldpage, char* newpage, int childPageNum, std::vector<char>& value, int i);
@@ -150,5 +253,135 @@ struct IndexPage {
     static void garbageSlotCollection(char* page);
     // data movement
     static void compress(char* page, TypeOffset start, TypeOffset end, TypeOffset offset);
+    // the first entry with a key >= key, given as insertEntry takes it
+    static int lowerBound(const char* page, AttrType type, const void* key);
+
+    // A leaf stores the common prefix of its keys once, at the end of the page, and each entry
+    // keeps the rest of its key. readRawIndex and readIndexItem put the prefix back.
+    static int getPrefixLen(const char* page);
+    static void setPrefixLen(char* page, int);
+    static const char* getPrefix(const char* page);
+    static int commonPrefixLen(const std::vector<char>& a, const std::vector<char>& b); // of | key | rid | values
+    // full | key | rid | values of a leaf
+    static std::vector<std::vector<char>> readLeafValues(const char* page);
+    // bytes a leaf of values[begin, end) takes, and lay such a leaf out
+    static int leafSize(const std::vector<std::vector<char>>& values, int begin, int end);
+    static int leafSize(int count, int bytes, int plen); // of count values taking bytes with a prefix of plen
+    static void buildLeaf(char* page, const std::vector<std::vector<char>>& values, int begin, int end, int nextLeafId);
+    // | key | rid | values of an inner node and its children, one more than the values
+    static std::vector<std::vector<char>> readInnerValues(const char* page, std::vector<int>& children);
+    // bytes an inner node of values[begin, end) takes, and lay one out with children[begin, end]
+    static int innerSize(const std::vector<std::vector<char>>& values, int begin, int end);
+    static int innerSize(int count, int bytes);
+    static void buildInner(char* page, const std::vector<std::vector<char>>& values, const std::vector<int>& children,
+                           int begin, int end);
+    static bool underflows(const char* page);
+    // the shortest value that sorts after left and not after right, to separate two leaves in their parent
+    static std::vector<char> separator(const std::vector<char>& left, const std::vector<char>& right);
+};
+// how FixedPage finds a key in its sorted key array
+enum class KeySearchKernel { SCALAR, SSE2, AVX2 };
+
+// Page format of int and real keys: sorted keys, RIDs and child pointers in parallel arrays, no slots.
+// The header keeps the entry count, nextLeafId and the deleted flag where IndexPage keeps its fields.
+struct FixedPage {
+    static const int HEADSIZE = 12; // count 2 + unused 2 + nextleafid 4 + unused 2 + deleted flag 1 + padding 1
+    static const int KEYSIZE = 4;
+    // leaf: | keys | rids | deleted bitmap |    inner: | keys | rids | children, one more than keys |
+    static const int LEAF_CAPACITY = (PAGE_SIZE - HEADSIZE) * 8 / ((KEYSIZE + sizeof(RID)) * 8 + 1);
+    static const int INNER_CAPACITY = (PAGE_SIZE - HEADSIZE - sizeof(int)) / (KEYSIZE + sizeof(RID) + sizeof(int));
+    static constexpr bool usedFor(AttrType type) { return type != TypeVarChar; }
+
+    static void InitializePage(char* page, int nextLeafId); // nextLeafId NONLEAF makes an inner node
+    static int getCount(const char* page);
+    static void setCount(char* page, int n);
+    static bool isLeaf(const char* page);
+    static int getCapacity(const char* page);
+    static const char* keyAt(const char* page, int i);
+    static RID getRID(const char* page, int i);
+    static void setEntry(char* page, int i, const char* value); // value: | key | rid |
+    static int getChild(const char* page, int i);
+    static void setChild(char* page, int i, int childPageNum);
+    static bool isDeleted(const char* page, int i);
+    static void setDeleted(char* page, int i, bool v);
+    // insert value as the i-th entry, an inner node gets rightChild right of it
+    static void insertAt(char* page, int i, const char* value, int rightChild);
+    // insert into a full page and move the upper half to newpage; value returns the entry going up
+    static void insertAndSplit(char* page, char* newpage, int i, std::vector<char>& value, int rightChild);
+    // remove the i-th entry, an inner node loses the child right of it
+    static void removeAt(char* page, int i);
+    static bool underflows(const char* page);
+    static void garbageSlotCollection(char* page);
+    // the first entry with a key >= key, given as insertEntry takes it
+    static int lowerBound(const char* page, AttrType type, const void* key);
+    // searches use the best kernel the CPU supports unless told otherwise
+    static KeySearchKernel getSearchKernel();
+    static bool setSearchKernel(KeySearchKernel kernel); // false: not supported here
+};
+
+// A posting list holds the RIDs of one key, sorted and delta encoded on a chain of pages. When the
+// entries of a key take POSTING_MIN_BYTES of a leaf they move to a list, and the leaf keeps a single
+// entry for the key whose RID is {head page, POSTING_SLOT}. That entry compares equal to any RID of
+// its key, so inserts, deletes and scans of the key all land on it.
+struct PostingPage {
+    // next page 4 + count 2 + used bytes 2 + first rid 8 + last rid 8 + tail page 4 + total 4, the last two on the head
+    static const int HEADSIZE = 32;
+    static bool isPosting(const RID& rid) { return rid.slotNum == POSTING_SLOT; }
+    static RID marker(int headPage) { return RID{(unsigned)headPage, POSTING_SLOT}; }
+
+    static void InitializePage(char* page);
+    static int getNextPage(const char* page);
+    static void setNextPage(char* page, int pageNum);
+    static int getCount(const char* page);
+    static RID getFirst(const char* page);
+    static RID getLast(const char* page);
+    static int getTailPage(const char* head);
+    static void setTailPage(char* head, int pageNum);
+    static int getTotal(const char* head);
+    static void setTotal(char* head, int n);
+    // the RIDs of a page, and write rids[begin, end) to one as far as they fit; returns where it stopped
+    static std::vector<RID> decode(const char* page);
+    static int encode(char* page, const std::vector<RID>& rids, int begin, int end);
+    // pages of a new list numbered from firstPageNum; returns how many
+    static int buildChain(const std::vector<RID>& rids, int firstPageNum, std::vector<char>& pages);
+
+    // list operations, the list is named by its head page
+    static int create(IXFileHandle& ixFileHandle, const std::vector<RID>& rids); // returns the head page, -1 on failure
+    static RC insert(IXFileHandle& ixFileHandle, int head, const RID& rid);       // -1: already there
+    static RC remove(IXFileHandle& ixFileHandle, int head, const RID& rid, bool& empty); // -1: not there
+    static std::vector<RID> readAll(IXFileHandle& ixFileHandle, int head);
+    static RC release(IXFileHandle& ixFileHandle, int head); // free the pages of an emptied list
+};
+
+// An extendible hash index keeps a directory of 2^globalDepth slots, indexed by the low bits of the hash
+// of a key, on a chain of directory pages from the root page. Slots point to buckets, and a bucket with
+// local depth d is shared by the slots that agree on the low d bits. A bucket is a page of unsorted
+// entries; when it is full it splits on its next bit, and only entries that all have one hash (a
+// duplicated key) or need more than HASH_MAX_DEPTH bits go to overflow pages chained to it.
+struct HashPage {
+    static const int HEADSIZE = 12;       // next page 4 + local depth 2 + count 2 + used bytes 2 + unused 2
+    static const int ENTRY_HEADSIZE = 14; // | hash 4 | rid 8 | key length 2 | key |
+    static const int DIR_HEADSIZE = 8;    // next page 4 + global depth 4
+    static const int DIR_CAPACITY = (PAGE_SIZE - DIR_HEADSIZE) / sizeof(int);
+
+    static void InitializePage(char* page, int localDepth);
+    static int getNextPage(const char* page);
+    static void setNextPage(char* page, int pageNum);
+    static int getLocalDepth(const char* page);
+    static void setLocalDepth(char* page, int depth);
+    static int getCount(const char* page);
+    static int getUsed(const char* page); // bytes of the entries
+    // entries of a page follow each other from HEADSIZE on
+    static int entrySize(const char* entry);
+    static unsigned getHash(const char* entry);
+    static RID getRID(const char* entry);
+    static const char* getKey(const char* entry);
+    static int getKeyLen(const char* entry);
+    static unsigned hash(const char* key, int len); // key as an IndexItem value
+    static bool matches(const char* entry, unsigned h, const char* key, int len);
+    // false: the entry does not fit
+    static bool append(char* page, unsigned h, const char* key, int len, const RID& rid);
+    static bool appendEntry(char* page, const char* entry);
+    static void removeAt(char* page, int offset); // offset of the entry on the page
 };
 #endif
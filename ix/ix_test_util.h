@@ -10,6 +10,31 @@ const int fail = -1;
 
 IndexManager &indexManager = IndexManager::instance();
 
+// builds the key of entry i, whose RID is {i, i % 7}; the keys of i < 100003 are distinct
+void makeKey(const Attribute &attribute, unsigned i, char *key) {
+    if (attribute.type == TypeVarChar) {
+        std::string s = "customer-" + std::to_string(i * 7919 % 100003);
+        int len = s.size();
+        memcpy(key, &len, sizeof(int));
+        memcpy(key + sizeof(int), s.data(), len);
+    } else {
+        *(int *) key = (i * 7919) % 100003;
+    }
+}
+
+RID makeRID(unsigned i) {
+    RID rid;
+    rid.pageNum = i;
+    rid.slotNum = i % 7;
+    return rid;
+}
+
+// the characters of a varchar key, empty for other types
+std::string keyString(const Attribute &attribute, const char *key) {
+    if (attribute.type == TypeVarChar) return std::string(key + sizeof(int), *(int *) key);
+    return std::string();
+}
+
 #endif
 
 
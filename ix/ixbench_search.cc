@@ -0,0 +1,82 @@
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstring>
+
+#include "ix.h"
+
+// Microbenchmark of the search inside one inner node of int keys: the binary search over an
+// IndexPage slot table against the kernels of FixedPage.
+
+static const int LOOKUPS = 2000000;
+
+template<typename F>
+static double timeLookups(const std::vector<int> &probes, F search, long &checksum) {
+    auto start = std::chrono::steady_clock::now();
+    checksum = 0;
+    for (int i = 0; i < LOOKUPS; i++) {
+        checksum += search(&probes[i % probes.size()]);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / LOOKUPS;
+}
+
+int main() {
+    char slotted[PAGE_SIZE], fixed[PAGE_SIZE];
+    IndexPage::InitializePage(slotted);
+    IndexPage::appendTailChildPointer(slotted);
+    IndexPage::setNextLeafId(slotted, NONLEAF);
+    FixedPage::InitializePage(fixed, NONLEAF);
+
+    // fill both pages with the same separators 0, 10, 20, ...
+    std::vector<int> keys;
+    std::vector<char> value(sizeof(int) + sizeof(RID), 0);
+    for (int key = 0; FixedPage::getCount(fixed) < FixedPage::INNER_CAPACITY; key += 10) {
+        memcpy(value.data(), &key, sizeof(int));
+        FixedPage::insertAt(fixed, FixedPage::getCount(fixed), value.data(), 0);
+        if (value.size() + sizeof(SlotItem) + sizeof(int) <= (size_t) IndexPage::getEmptySize(slotted)) {
+            IndexPage::insertValueTo(slotted, 0, value, IndexPage::getSlotCount(slotted) - 1);
+        }
+        keys.push_back(key);
+    }
+    int slottedKeys = IndexPage::getSlotCount(slotted) - 1;
+
+    std::mt19937 gen(222);
+    std::uniform_int_distribution<int> dist(-5, keys.back() + 5);
+    std::vector<int> probes(1 << 16);
+    for (auto &p: probes) p = dist(gen);
+
+    std::cout << "keys per node: IndexPage " << slottedKeys << ", FixedPage " << FixedPage::getCount(fixed) << std::endl;
+    long checksum;
+    double ns = timeLookups(probes, [&](const int *key) { return IndexPage::lowerBound(slotted, TypeInt, key); }, checksum);
+    std::cout << "IndexPage binarySearchLowerBound: " << ns << " ns/lookup" << std::endl;
+
+    // every kernel has to agree with std::lower_bound
+    for (auto &p: probes) {
+        int expected = std::lower_bound(keys.begin(), keys.end(), p) - keys.begin();
+        if (IndexPage::lowerBound(slotted, TypeInt, &p) != std::min(expected, slottedKeys)) {
+            std::cout << "IndexPage search is wrong for " << p << std::endl;
+            return -1;
+        }
+    }
+    const char *names[] = {"scalar", "sse2", "avx2"};
+    KeySearchKernel kernels[] = {KeySearchKernel::SCALAR, KeySearchKernel::SSE2, KeySearchKernel::AVX2};
+    KeySearchKernel best = FixedPage::getSearchKernel();
+    for (int k = 0; k < 3; k++) {
+        if (!FixedPage::setSearchKernel(kernels[k])) {
+            std::cout << "FixedPage " << names[k] << ": not supported" << std::endl;
+            continue;
+        }
+        for (auto &p: probes) {
+            int expected = std::lower_bound(keys.begin(), keys.end(), p) - keys.begin();
+            if (FixedPage::lowerBound(fixed, TypeInt, &p) != expected) {
+                std::cout << "FixedPage " << names[k] << " search is wrong for " << p << std::endl;
+                return -1;
+            }
+        }
+        ns = timeLookups(probes, [&](const int *key) { return FixedPage::lowerBound(fixed, TypeInt, key); }, checksum);
+        std::cout << "FixedPage " << names[k] << ": " << ns << " ns/lookup" << (kernels[k] == best ? " (default)" : "") << std::endl;
+    }
+    FixedPage::setSearchKernel(best);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "ix.h"
+#include "ix_test_util.h"
+
+int testCase_16(const std::string &indexFileName, const std::string &insertFileName, const Attribute &attribute) {
+    // Checks bulkLoad() against an index built with insertEntry().
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. **bulkLoad** with sorted runs spilled to temporary files
+    // 4. Scan entries - the keys come out in order, once each
+    // 5. Insert entry after the bulk load
+    // 6. Close Index File
+    // 7. Destroy Index File
+    std::cerr << std::endl << "***** In IX Test Case 16 *****" << std::endl;
+
+    RC rc;
+    RID rid;
+    IXFileHandle ixFileHandle, insertFileHandle;
+    IX_ScanIterator ix_ScanIterator;
+    unsigned numOfTuples = 30000;
+    int key;
+
+    rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    rc = indexManager.createFile(insertFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(insertFileName, insertFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // keys in a scrambled order, every key twice with different RIDs
+    std::vector<int> keys(numOfTuples);
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        keys[i] = (int) ((i * 7919) % (numOfTuples / 2));
+    }
+    unsigned pos = 0;
+    rc = indexManager.bulkLoad(ixFileHandle, attribute, [&](const void *&k, RID &r) {
+        if (pos == numOfTuples) return false;
+        k = &keys[pos];
+        r.pageNum = pos;
+        r.slotNum = pos % 7;
+        ++pos;
+        return true;
+    }, 0.9, 64 * 1024); // a small memory limit forces several runs
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        rid.pageNum = i;
+        rid.slotNum = i % 7;
+        rc = indexManager.insertEntry(insertFileHandle, attribute, &keys[i], rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+
+    // a loaded index only accepts a bulk load while it is empty
+    rc = indexManager.bulkLoad(ixFileHandle, attribute, [](const void *&, RID &) { return false; });
+    assert(rc != success && "indexManager::bulkLoad() on a non-empty index should fail.");
+
+    unsigned loadedPages = ixFileHandle.getNumberOfPages(), insertedPages = insertFileHandle.getNumberOfPages();
+    std::cerr << "pages after bulkLoad: " << loadedPages << ", after insertEntry: " << insertedPages << std::endl;
+    if (loadedPages >= insertedPages) {
+        std::cerr << "bulkLoad should pack the leaves tighter than insertEntry." << std::endl;
+        return fail;
+    }
+
+    // scan all entries
+    rc = indexManager.scan(ixFileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    unsigned count = 0;
+    int prevKey = -1;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+        if (key < prevKey || keys[rid.pageNum] != key || rid.slotNum != rid.pageNum % 7) {
+            std::cerr << "Wrong entry at " << count << ": " << key << " " << rid.pageNum << std::endl;
+            ix_ScanIterator.close();
+            return fail;
+        }
+        prevKey = key;
+        count++;
+    }
+    ix_ScanIterator.close();
+    if (count != numOfTuples) {
+        std::cerr << "Wrong number of entries: " << count << std::endl;
+        return fail;
+    }
+
+    // the loaded tree keeps working with the usual inserts and range scans
+    key = 1000;
+    rid.pageNum = numOfTuples;
+    rid.slotNum = 0;
+    rc = indexManager.insertEntry(ixFileHandle, attribute, &key, rid);
+    assert(rc == success && "indexManager::insertEntry() should not fail.");
+    rc = indexManager.scan(ixFileHandle, attribute, &key, &key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+        count++;
+    }
+    ix_ScanIterator.close();
+    if (count != 3) {
+        std::cerr << "Wrong number of entries for key 1000: " << count << std::endl;
+        return fail;
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.closeFile(insertFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    rc = indexManager.destroyFile(insertFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main() {
+
+    const std::string indexFileName = "age_idx";
+    const std::string insertFileName = "age_insert_idx";
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    indexManager.destroyFile(indexFileName);
+    indexManager.destroyFile(insertFileName);
+
+    if (testCase_16(indexFileName, insertFileName, attrAge) == success) {
+        std::cerr << "***** IX Test Case 16 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 16 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
@@ -0,0 +1,139 @@
+#include "ix.h"
+#include "ix_test_util.h"
+
+int testCase_17(const std::string &indexFileName, const Attribute &attribute) {
+    // Checks the compact page format of real keys.
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries in a scrambled order - **leaves hold far more than 170 entries**
+    // 4. Delete every other entry while scanning
+    // 5. Reinsert the deleted entries
+    // 6. Scan entries - the keys come out in order, once each
+    // 7. Close Index File
+    // 8. Destroy Index File
+    std::cerr << std::endl << "***** In IX Test Case 17 *****" << std::endl;
+
+    RC rc;
+    RID rid;
+    IXFileHandle ixFileHandle;
+    IX_ScanIterator ix_ScanIterator;
+    unsigned numOfTuples = 20000;
+    float key;
+
+    rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // key i is i - 10000.5, inserted in a scrambled order
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        unsigned k = (i * 7919) % numOfTuples;
+        key = (float) k - 10000.5f;
+        rid.pageNum = k;
+        rid.slotNum = k % 11;
+        rc = indexManager.insertEntry(ixFileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    // an entry with 4-byte keys used to take 24 bytes of a page, its leaves held at most 170 entries
+    unsigned pages = ixFileHandle.getNumberOfPages();
+    std::cerr << "pages: " << pages << std::endl;
+    if (pages * 170 >= numOfTuples) {
+        std::cerr << "Leaves should hold more entries." << std::endl;
+        return fail;
+    }
+
+    // delete the entries with odd keys while scanning
+    rc = indexManager.scan(ixFileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    unsigned count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+        if (rid.pageNum != count) {
+            std::cerr << "Wrong entry at " << count << ": " << key << " " << rid.pageNum << std::endl;
+            return fail;
+        }
+        if (count % 2 == 1) {
+            rc = indexManager.deleteEntry(ixFileHandle, attribute, &key, rid);
+            assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        }
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == numOfTuples && "The scan should see every entry.");
+
+    // a deleted entry is gone
+    key = 1.0f - 10000.5f;
+    rid.pageNum = 1;
+    rid.slotNum = 1;
+    rc = indexManager.deleteEntry(ixFileHandle, attribute, &key, rid);
+    assert(rc != success && "Deleting a deleted entry should fail.");
+
+    // range scan over the remaining entries
+    float lowKey = 99.5f - 10000.5f, highKey = 300.0f - 10000.5f;
+    rc = indexManager.scan(ixFileHandle, attribute, &lowKey, &highKey, false, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+        if (rid.pageNum % 2 == 1 || key != (float) rid.pageNum - 10000.5f) {
+            std::cerr << "Wrong entry in range: " << key << " " << rid.pageNum << std::endl;
+            return fail;
+        }
+        count++;
+    }
+    ix_ScanIterator.close();
+    if (count != 101) { // 100, 102, ..., 300
+        std::cerr << "Wrong number of entries in range: " << count << std::endl;
+        return fail;
+    }
+
+    // reinsert the odd keys, the deleted entries make room on their leaves
+    for (unsigned k = 1; k < numOfTuples; k += 2) {
+        key = (float) k - 10000.5f;
+        rid.pageNum = k;
+        rid.slotNum = k % 11;
+        rc = indexManager.insertEntry(ixFileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    rc = indexManager.scan(ixFileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+        if (rid.pageNum != count || rid.slotNum != count % 11) {
+            std::cerr << "Wrong entry at " << count << ": " << key << " " << rid.pageNum << std::endl;
+            return fail;
+        }
+        count++;
+    }
+    ix_ScanIterator.close();
+    if (count != numOfTuples) {
+        std::cerr << "Wrong number of entries: " << count << std::endl;
+        return fail;
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main() {
+
+    const std::string indexFileName = "height_idx";
+    Attribute attrHeight;
+    attrHeight.length = 4;
+    attrHeight.name = "height";
+    attrHeight.type = TypeReal;
+
+    indexManager.destroyFile(indexFileName);
+
+    if (testCase_17(indexFileName, attrHeight) == success) {
+        std::cerr << "***** IX Test Case 17 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 17 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
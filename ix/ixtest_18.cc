@@ -0,0 +1,186 @@
+#include <algorithm>
+#include "ix.h"
+#include "ix_test_util.h"
+
+static const std::string urlPrefix = "https://www.example.com/catalog/item/";
+
+// k as a six digit number cut to its first digits
+static std::string urlKey(unsigned k, int digits = 6) {
+    char buf[8];
+    sprintf(buf, "%06u", k);
+    return urlPrefix + std::string(buf, digits);
+}
+
+static void toVarchar(const std::string &s, char *key) {
+    int len = s.size();
+    memcpy(key, &len, sizeof(int));
+    memcpy(key + sizeof(int), s.data(), len);
+}
+
+// scans [low, high] and checks that the keys come out in order and belong to their RIDs
+static int scanInOrder(IXFileHandle &ixFileHandle, const Attribute &attribute, const std::vector<std::string> &keys,
+                       const char *low, const char *high, unsigned &count) {
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    char key[PAGE_SIZE];
+    RC rc = indexManager.scan(ixFileHandle, attribute, low, high, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    std::string prev;
+    count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success) {
+        std::string s(key + sizeof(int), *(int *) key);
+        if (rid.pageNum >= keys.size() || s != keys[rid.pageNum] || (count > 0 && s <= prev)) {
+            std::cerr << "Wrong entry at " << count << ": " << s << " " << rid.pageNum << std::endl;
+            ix_ScanIterator.close();
+            return fail;
+        }
+        prev = s;
+        count++;
+    }
+    ix_ScanIterator.close();
+    return success;
+}
+
+int testCase_18(const std::string &indexFileName, const Attribute &attribute) {
+    // Checks prefix and suffix truncation of varchar keys.
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert URL keys sharing a long prefix - **leaves hold more entries than their full keys take**
+    // 4. Insert shorter keys that break the prefix of the leaves they land in
+    // 5. Scan entries - full and range - the keys come out in order, once each
+    // 6. Delete and reinsert half of the entries
+    // 7. Close Index File
+    // 8. Open it with its format version cleared - **a file of an older format is rejected**
+    // 9. Destroy Index File
+    std::cerr << std::endl << "***** In IX Test Case 18 *****" << std::endl;
+
+    RC rc;
+    RID rid;
+    IXFileHandle ixFileHandle;
+    unsigned numOfTuples = 20000;
+    char key[PAGE_SIZE];
+    std::vector<std::string> keys;
+
+    rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // URL keys in a scrambled order, the RID points back to the key
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        keys.push_back(urlKey((i * 7919) % numOfTuples));
+        toVarchar(keys.back(), key);
+        rid.pageNum = i;
+        rid.slotNum = i % 13;
+        rc = indexManager.insertEntry(ixFileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    // a full entry takes slot 8 + child 4 + key 43 + RID 8 bytes, so a page holds at most 64 of them
+    unsigned pages = ixFileHandle.getNumberOfPages();
+    std::cerr << "pages: " << pages << std::endl;
+    if (pages * 64 >= numOfTuples) {
+        std::cerr << "Leaves should store their common prefix once." << std::endl;
+        return fail;
+    }
+
+    // keys cut to 3 and 4 digits sort right before the keys they start, and at the start of a leaf
+    // they do not share its prefix; the other two sort before and after everything
+    for (unsigned k = 0; k < numOfTuples; k += 100) {
+        if (k % 1000 == 0) keys.push_back(urlKey(k, 3));
+        keys.push_back(urlKey(k, 4));
+    }
+    keys.push_back("http://www.example.com/");
+    keys.push_back("mailto:someone@example.com");
+    for (unsigned i = numOfTuples; i < keys.size(); i++) {
+        toVarchar(keys[i], key);
+        rid.pageNum = i;
+        rid.slotNum = i % 13;
+        rc = indexManager.insertEntry(ixFileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+
+    unsigned count;
+    if (scanInOrder(ixFileHandle, attribute, keys, NULL, NULL, count) != success) return fail;
+    if (count != keys.size()) {
+        std::cerr << "Wrong number of entries: " << count << std::endl;
+        return fail;
+    }
+
+    // "0100" <= key <= "0102" holds 010000 - 010199 and the cut keys 0100, 0101 and 0102
+    char lowKey[PAGE_SIZE], highKey[PAGE_SIZE];
+    toVarchar(urlKey(10000, 4), lowKey);
+    toVarchar(urlKey(10200, 4), highKey);
+    if (scanInOrder(ixFileHandle, attribute, keys, lowKey, highKey, count) != success) return fail;
+    if (count != 203) {
+        std::cerr << "Wrong number of entries in range: " << count << std::endl;
+        return fail;
+    }
+
+    // delete the entries with odd RIDs, a deleted entry is gone
+    for (unsigned i = 1; i < keys.size(); i += 2) {
+        toVarchar(keys[i], key);
+        rid.pageNum = i;
+        rid.slotNum = i % 13;
+        rc = indexManager.deleteEntry(ixFileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    rc = indexManager.deleteEntry(ixFileHandle, attribute, key, rid);
+    assert(rc != success && "Deleting a deleted entry should fail.");
+    if (scanInOrder(ixFileHandle, attribute, keys, NULL, NULL, count) != success) return fail;
+    if (count != (keys.size() + 1) / 2) {
+        std::cerr << "Wrong number of entries after deletion: " << count << std::endl;
+        return fail;
+    }
+
+    // reinsert them
+    for (unsigned i = 1; i < keys.size(); i += 2) {
+        toVarchar(keys[i], key);
+        rid.pageNum = i;
+        rid.slotNum = i % 13;
+        rc = indexManager.insertEntry(ixFileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    if (scanInOrder(ixFileHandle, attribute, keys, NULL, NULL, count) != success) return fail;
+    if (count != keys.size()) {
+        std::cerr << "Wrong number of entries after reinsertion: " << count << std::endl;
+        return fail;
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+
+    // a file without the format version was written with the old page layout and is not opened
+    std::fstream file(indexFileName, std::ios::in | std::ios::out | std::ios::binary);
+    int version = 0;
+    file.seekp(INDEX_FORMAT_OFFSET);
+    file.write((const char *) &version, sizeof(int));
+    file.close();
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc != success && "Opening an index of an older format should fail.");
+
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main() {
+
+    const std::string indexFileName = "url_idx";
+    Attribute attrUrl;
+    attrUrl.length = 100;
+    attrUrl.name = "url";
+    attrUrl.type = TypeVarChar;
+
+    indexManager.destroyFile(indexFileName);
+
+    if (testCase_18(indexFileName, attrUrl) == success) {
+        std::cerr << "***** IX Test Case 18 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 18 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
@@ -0,0 +1,182 @@
+#include "ix.h"
+#include "ix_test_util.h"
+
+// counts the entries of key and checks that their RIDs come in ascending order
+static unsigned countKey(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
+                         bool (*belongs)(const RID &)) {
+    IX_ScanIterator ix_ScanIterator;
+    RID rid, prev;
+    char found[PAGE_SIZE];
+    RC rc = indexManager.scan(ixFileHandle, attribute, key, key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    unsigned count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, found) == success) {
+        if (!belongs(rid) || (count > 0 && (rid.pageNum < prev.pageNum ||
+                                            (rid.pageNum == prev.pageNum && rid.slotNum <= prev.slotNum)))) {
+            std::cerr << "Wrong RID (" << rid.pageNum << "," << rid.slotNum << ") at " << count << std::endl;
+            ix_ScanIterator.close();
+            return 0;
+        }
+        prev = rid;
+        count++;
+    }
+    ix_ScanIterator.close();
+    return count;
+}
+
+// the i-th record of a heap file with 40 records per page
+static RID heapRID(unsigned i) {
+    RID rid;
+    rid.pageNum = i / 40;
+    rid.slotNum = i % 40;
+    return rid;
+}
+
+static bool status2(const RID &rid) { return (rid.pageNum * 40 + rid.slotNum) % 4 == 2; }
+static bool status1(const RID &rid) { return (rid.pageNum * 40 + rid.slotNum) % 4 == 1; }
+static bool countryUS(const RID &rid) { return (rid.pageNum * 40 + rid.slotNum) % 4 == 3; }
+
+int testCase_19(const std::string &indexFileName, const Attribute &attrStatus, const Attribute &attrCountry) {
+    // Checks posting lists of duplicated keys.
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries of four keys - **the RIDs of a key go to posting lists**
+    // 4. Scan one key - its RIDs come out sorted
+    // 5. Delete and reinsert RIDs of a posting list
+    // 6. bulkLoad of a varchar column with four values and a few unique ones
+    // 7. Close Index File
+    // 8. Destroy Index File
+    std::cerr << std::endl << "***** In IX Test Case 19 *****" << std::endl;
+
+    RC rc;
+    IXFileHandle ixFileHandle;
+    unsigned numOfTuples = 60000;
+    int key;
+
+    rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // a status column: record i has status i % 4
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        key = i % 4;
+        rc = indexManager.insertEntry(ixFileHandle, attrStatus, &key, heapRID(i));
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    // composite entries would fill numOfTuples / LEAF_CAPACITY = 179 leaves
+    unsigned pages = ixFileHandle.getNumberOfPages();
+    std::cerr << "pages: " << pages << std::endl;
+    if (pages * 5 > numOfTuples / FixedPage::LEAF_CAPACITY) {
+        std::cerr << "The RIDs of a key should be stored as posting lists." << std::endl;
+        return fail;
+    }
+
+    key = 1;
+    rc = indexManager.insertEntry(ixFileHandle, attrStatus, &key, heapRID(5));
+    assert(rc != success && "Inserting an entry twice should fail.");
+
+    key = 2;
+    if (countKey(ixFileHandle, attrStatus, &key, status2) != numOfTuples / 4) {
+        std::cerr << "Wrong number of entries of key 2." << std::endl;
+        return fail;
+    }
+
+    // delete every other RID of key 1, then put them back
+    key = 1;
+    for (unsigned i = 1; i < numOfTuples; i += 8) {
+        rc = indexManager.deleteEntry(ixFileHandle, attrStatus, &key, heapRID(i));
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    rc = indexManager.deleteEntry(ixFileHandle, attrStatus, &key, heapRID(1));
+    assert(rc != success && "Deleting a deleted entry should fail.");
+    if (countKey(ixFileHandle, attrStatus, &key, status1) != numOfTuples / 8) {
+        std::cerr << "Wrong number of entries of key 1 after deletion." << std::endl;
+        return fail;
+    }
+    for (unsigned i = 1; i < numOfTuples; i += 8) {
+        rc = indexManager.insertEntry(ixFileHandle, attrStatus, &key, heapRID(i));
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    if (countKey(ixFileHandle, attrStatus, &key, status1) != numOfTuples / 4) {
+        std::cerr << "Wrong number of entries of key 1 after reinsertion." << std::endl;
+        return fail;
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    // a country column, bulk loaded: four countries and every 100th record from somewhere else
+    rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    const char *countries[] = {"CN", "DE", "FR", "US"};
+    char country[PAGE_SIZE];
+    unsigned pos = 0;
+    rc = indexManager.bulkLoad(ixFileHandle, attrCountry, [&](const void *&k, RID &r) {
+        if (pos == numOfTuples) return false;
+        std::string s = pos % 100 == 1 ? "X" + std::to_string(pos) : countries[pos % 4];
+        int len = s.size();
+        memcpy(country, &len, sizeof(int));
+        memcpy(country + sizeof(int), s.data(), len);
+        k = country;
+        r = heapRID(pos++);
+        return true;
+    });
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    pages = ixFileHandle.getNumberOfPages();
+    std::cerr << "pages: " << pages << std::endl;
+    // a composite entry takes slot 8 + child 4 + key 2 + RID 8 bytes
+    if (pages * 5 > numOfTuples * 22 / PAGE_SIZE) {
+        std::cerr << "The RIDs of a key should be stored as posting lists." << std::endl;
+        return fail;
+    }
+
+    // new records append to the list of their country
+    int len = 2;
+    memcpy(country, &len, sizeof(int));
+    memcpy(country + sizeof(int), "US", len);
+    for (unsigned i = numOfTuples + 3; i < numOfTuples + 4000; i += 4) {
+        rc = indexManager.insertEntry(ixFileHandle, attrCountry, country, heapRID(i));
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    if (countKey(ixFileHandle, attrCountry, country, countryUS) != (numOfTuples + 4000) / 4) {
+        std::cerr << "Wrong number of entries of US." << std::endl;
+        return fail;
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main() {
+
+    const std::string indexFileName = "status_idx";
+    Attribute attrStatus;
+    attrStatus.length = 4;
+    attrStatus.name = "status";
+    attrStatus.type = TypeInt;
+    Attribute attrCountry;
+    attrCountry.length = 20;
+    attrCountry.name = "country";
+    attrCountry.type = TypeVarChar;
+
+    indexManager.destroyFile(indexFileName);
+
+    if (testCase_19(indexFileName, attrStatus, attrCountry) == success) {
+        std::cerr << "***** IX Test Case 19 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 19 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
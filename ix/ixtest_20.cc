@@ -0,0 +1,148 @@
+#include "ix.h"
+#include "ix_test_util.h"
+
+static RC insertRange(IXFileHandle &ixFileHandle, const Attribute &attribute, unsigned n, unsigned step, unsigned skip) {
+    char key[PAGE_SIZE];
+    for (unsigned i = 0; i < n; i++) {
+        if (i % step == skip) continue;
+        makeKey(attribute, i, key);
+        if (indexManager.insertEntry(ixFileHandle, attribute, key, makeRID(i)) != success) return fail;
+    }
+    return success;
+}
+
+// scans everything, checking the entries against their RIDs; with deleting, each one is deleted right away
+static int scanAll(IXFileHandle &ixFileHandle, const Attribute &attribute, bool deleting) {
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    char key[PAGE_SIZE], expected[PAGE_SIZE];
+    RC rc = indexManager.scan(ixFileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success) {
+        makeKey(attribute, rid.pageNum, expected);
+        int len = attribute.type == TypeVarChar ? sizeof(int) + *(int *) expected : sizeof(int);
+        if (rid.slotNum != rid.pageNum % 7 || memcmp(key, expected, len) != 0) {
+            std::cerr << "Wrong entry " << rid.pageNum << " at " << count << std::endl;
+            ix_ScanIterator.close();
+            return -1;
+        }
+        if (deleting) {
+            rc = indexManager.deleteEntry(ixFileHandle, attribute, key, rid);
+            assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        }
+        count++;
+    }
+    ix_ScanIterator.close();
+    return count;
+}
+
+static int churn(const std::string &indexFileName, const Attribute &attribute) {
+    unsigned numOfTuples = 30000;
+    IXFileHandle ixFileHandle;
+    RC rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    rc = insertRange(ixFileHandle, attribute, numOfTuples, 1, 1);
+    assert(rc == success && "indexManager::insertEntry() should not fail.");
+    unsigned pages = ixFileHandle.getNumberOfPages();
+    std::cerr << attribute.name << " pages: " << pages << std::endl;
+
+    // delete every entry while scanning, leaves merge under the scan
+    if (scanAll(ixFileHandle, attribute, true) != (int) numOfTuples) {
+        std::cerr << "Wrong number of entries deleted during the scan." << std::endl;
+        return fail;
+    }
+    if (scanAll(ixFileHandle, attribute, false) != 0) {
+        std::cerr << "The index should be empty." << std::endl;
+        return fail;
+    }
+    // the tree is down to one leaf, the other pages are idle
+    if (ixFileHandle.getIdlePageNum() == -1) {
+        std::cerr << "Merged pages should be freed." << std::endl;
+        return fail;
+    }
+
+    // the same entries again take the freed pages
+    rc = insertRange(ixFileHandle, attribute, numOfTuples, 1, 1);
+    assert(rc == success && "indexManager::insertEntry() should not fail.");
+    if (ixFileHandle.getNumberOfPages() > pages) {
+        std::cerr << "Freed pages should be reused: " << ixFileHandle.getNumberOfPages() << std::endl;
+        return fail;
+    }
+
+    // delete nine of ten entries and put them back
+    char key[PAGE_SIZE];
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        if (i % 10 == 0) continue;
+        makeKey(attribute, i, key);
+        rc = indexManager.deleteEntry(ixFileHandle, attribute, key, makeRID(i));
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    if (scanAll(ixFileHandle, attribute, false) != (int) numOfTuples / 10) {
+        std::cerr << "Wrong number of entries after deletion." << std::endl;
+        return fail;
+    }
+    rc = insertRange(ixFileHandle, attribute, numOfTuples, 10, 0);
+    assert(rc == success && "indexManager::insertEntry() should not fail.");
+    if (scanAll(ixFileHandle, attribute, false) != (int) numOfTuples) {
+        std::cerr << "Wrong number of entries after reinsertion." << std::endl;
+        return fail;
+    }
+    // the leaves split in other places than before, but they should not need many more pages
+    std::cerr << attribute.name << " pages after reinsertion: " << ixFileHandle.getNumberOfPages() << std::endl;
+    if (ixFileHandle.getNumberOfPages() * 4 > pages * 5) {
+        std::cerr << "Freed pages should be reused." << std::endl;
+        return fail;
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int testCase_20(const std::string &indexFileName, const Attribute &attrAge, const Attribute &attrName) {
+    // Checks merging of underflowed pages and reuse of freed pages.
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries
+    // 4. Scan and delete every entry - **the scan sees each entry once while pages merge**
+    // 5. Insert the entries again - **the freed pages are reused before the file grows**
+    // 6. Delete and reinsert nine of ten entries
+    // 7. Close Index File
+    // 8. Destroy Index File
+    // for an int and a varchar key
+    std::cerr << std::endl << "***** In IX Test Case 20 *****" << std::endl;
+
+    if (churn(indexFileName, attrAge) != success) return fail;
+    return churn(indexFileName, attrName);
+}
+
+int main() {
+
+    const std::string indexFileName = "churn_idx";
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+    Attribute attrName;
+    attrName.length = 20;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    indexManager.destroyFile(indexFileName);
+
+    if (testCase_20(indexFileName, attrAge, attrName) == success) {
+        std::cerr << "***** IX Test Case 20 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 20 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <thread>
+#include "ix.h"
+#include "ix_test_util.h"
+
+static const unsigned numOfThreads = 4;
+
+// scans everything, checking that the keys come in order and belong to their RIDs; -1 on a wrong entry
+static int scanAll(IXFileHandle &ixFileHandle, const Attribute &attribute) {
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    char key[PAGE_SIZE], expected[PAGE_SIZE];
+    // an empty index has no root to scan from
+    if (indexManager.scan(ixFileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator) != success) return 0;
+    int count = 0, prevInt = 0;
+    std::string prev;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success) {
+        makeKey(attribute, rid.pageNum, expected);
+        int len = attribute.type == TypeVarChar ? sizeof(int) + *(int *) expected : sizeof(int);
+        bool ordered = count == 0 || (attribute.type == TypeVarChar ? keyString(attribute, key) > prev
+                                                                    : *(int *) key > prevInt);
+        if (rid.slotNum != rid.pageNum % 7 || memcmp(key, expected, len) != 0 || !ordered) {
+            std::cerr << "Wrong entry " << rid.pageNum << " at " << count << std::endl;
+            ix_ScanIterator.close();
+            return -1;
+        }
+        prev = keyString(attribute, key);
+        prevInt = *(int *) key;
+        count++;
+    }
+    ix_ScanIterator.close();
+    return count;
+}
+
+// thread t of threads inserts (or deletes) the entries i < n with i % threads == t and i % step == skip
+static void runThreads(IXFileHandle &ixFileHandle, const Attribute &attribute, unsigned threads, unsigned n,
+                       bool inserting, unsigned step, unsigned skip, std::atomic<int> &failures) {
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            char key[PAGE_SIZE];
+            for (unsigned i = t; i < n; i += threads) {
+                if (i % step != skip) continue;
+                makeKey(attribute, i, key);
+                RC rc = inserting ? indexManager.insertEntry(ixFileHandle, attribute, key, makeRID(i))
+                                  : indexManager.deleteEntry(ixFileHandle, attribute, key, makeRID(i));
+                if (rc != success) failures++;
+            }
+        });
+    }
+    for (auto &worker : workers) worker.join();
+}
+
+static int stress(const std::string &indexFileName, const Attribute &attribute) {
+    unsigned numOfTuples = 40000;
+    IXFileHandle ixFileHandle;
+    std::atomic<int> failures(0), badScans(0), scans(0);
+    std::atomic<bool> writing(true);
+    RC rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // a scanner runs while the writers split leaves, then merge them
+    std::thread scanner([&]() {
+        while (writing) {
+            if (scanAll(ixFileHandle, attribute) < 0) badScans++;
+            scans++;
+        }
+    });
+    runThreads(ixFileHandle, attribute, numOfThreads, numOfTuples, true, 1, 0, failures);
+    // delete the entries with i % 4 == 1, then put them back while other threads delete i % 4 == 2 and 3
+    runThreads(ixFileHandle, attribute, numOfThreads, numOfTuples, false, 4, 1, failures);
+    std::thread reinserter([&]() {
+        runThreads(ixFileHandle, attribute, numOfThreads / 2, numOfTuples, true, 4, 1, failures);
+    });
+    runThreads(ixFileHandle, attribute, numOfThreads / 2, numOfTuples, false, 4, 2, failures);
+    runThreads(ixFileHandle, attribute, numOfThreads / 2, numOfTuples, false, 4, 3, failures);
+    reinserter.join();
+    writing = false;
+    scanner.join();
+    std::cerr << attribute.name << " scans during the writes: " << scans << std::endl;
+
+    if (failures != 0 || badScans != 0) {
+        std::cerr << failures << " failed operations, " << badScans << " wrong scans." << std::endl;
+        return fail;
+    }
+    // entries with i % 4 == 0 or 1 are left, each once
+    if (scanAll(ixFileHandle, attribute) != (int) numOfTuples / 2) {
+        std::cerr << "Wrong number of entries after the writes." << std::endl;
+        return fail;
+    }
+    char key[PAGE_SIZE];
+    for (unsigned i = 0; i < numOfTuples; i += 4) {
+        makeKey(attribute, i + 2, key);
+        rc = indexManager.deleteEntry(ixFileHandle, attribute, key, makeRID(i + 2));
+        assert(rc != success && "Deleting a deleted entry should fail.");
+        makeKey(attribute, i + 1, key);
+        rc = indexManager.insertEntry(ixFileHandle, attribute, key, makeRID(i + 1));
+        assert(rc != success && "Inserting an entry twice should fail.");
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int testCase_21(const std::string &indexFileName, const Attribute &attrAge, const Attribute &attrName) {
+    // Checks concurrent writers and scans of one index.
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries from several threads while another thread scans - **scans see the keys in order**
+    // 4. Delete and reinsert entries from several threads
+    // 5. Close Index File
+    // 6. Destroy Index File
+    // for an int and a varchar key
+    std::cerr << std::endl << "***** In IX Test Case 21 *****" << std::endl;
+
+    if (stress(indexFileName, attrAge) != success) return fail;
+    return stress(indexFileName, attrName);
+}
+
+int main() {
+
+    const std::string indexFileName = "concurrent_idx";
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+    Attribute attrName;
+    attrName.length = 20;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    indexManager.destroyFile(indexFileName);
+
+    if (testCase_21(indexFileName, attrAge, attrName) == success) {
+        std::cerr << "***** IX Test Case 21 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 21 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
@@ -0,0 +1,218 @@
+#include "ix.h"
+#include "ix_test_util.h"
+
+// low <= key < high
+static bool keyBetween(const Attribute &attribute, const char *key, const char *low, const char *high) {
+    if (attribute.type == TypeVarChar)
+        return keyString(attribute, key) >= keyString(attribute, low) &&
+               keyString(attribute, key) < keyString(attribute, high);
+    return *(int *) key >= *(int *) low && *(int *) key < *(int *) high;
+}
+
+// the entries of one key, which all have to carry it; -1 on a wrong entry
+static int probe(IXFileHandle &ixFileHandle, const Attribute &attribute, const char *key) {
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    char found[PAGE_SIZE];
+    RC rc = indexManager.scan(ixFileHandle, attribute, key, key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int len = attribute.type == TypeVarChar ? sizeof(int) + *(int *) key : sizeof(int);
+    int count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, found) == success) {
+        if (memcmp(found, key, len) != 0) count = -1;
+        if (count >= 0) count++;
+    }
+    ix_ScanIterator.close();
+    return count;
+}
+
+// page reads of the probes of entries [0, n); UINT_MAX when a probe finds the wrong entries
+static unsigned probeReads(IXFileHandle &ixFileHandle, const Attribute &attribute, unsigned n) {
+    unsigned readBefore, readAfter, write, append;
+    char key[PAGE_SIZE];
+    ixFileHandle.collectCounterValues(readBefore, write, append);
+    for (unsigned i = 0; i < n; i++) {
+        makeKey(attribute, i, key);
+        if (probe(ixFileHandle, attribute, key) != 1) return UINT_MAX;
+    }
+    ixFileHandle.collectCounterValues(readAfter, write, append);
+    return readAfter - readBefore;
+}
+
+static int hashIndex(const std::string &indexFileName, const Attribute &attribute) {
+    unsigned numOfTuples = 30000, numOfProbes = 1000;
+    IXFileHandle ixFileHandle;
+    char key[PAGE_SIZE];
+    RC rc;
+
+    // the same entries in a B+ tree, for comparison
+    rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        makeKey(attribute, i, key);
+        rc = indexManager.insertEntry(ixFileHandle, attribute, key, makeRID(i));
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    unsigned treeReads = probeReads(ixFileHandle, attribute, numOfProbes);
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    rc = indexManager.createFile(indexFileName, IndexKind::HASH);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        makeKey(attribute, i, key);
+        rc = indexManager.insertEntry(ixFileHandle, attribute, key, makeRID(i));
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    rc = indexManager.insertEntry(ixFileHandle, attribute, key, makeRID(numOfTuples - 1));
+    assert(rc != success && "Inserting an entry twice should fail.");
+
+    // the directory is cached, a probe reads its bucket
+    unsigned hashReads = probeReads(ixFileHandle, attribute, numOfProbes);
+    std::cerr << attribute.name << " page reads of " << numOfProbes << " probes: hash " << hashReads
+              << ", B+ tree " << treeReads << std::endl;
+    if (hashReads > numOfProbes * 11 / 10) {
+        std::cerr << "A probe should take about one page read." << std::endl;
+        return fail;
+    }
+
+    // a scan of all entries sees each one once
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    std::vector<bool> seen(numOfTuples);
+    rc = indexManager.scan(ixFileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    unsigned count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success) {
+        if (rid.pageNum >= numOfTuples || seen[rid.pageNum]) {
+            std::cerr << "Wrong entry " << rid.pageNum << " in the full scan." << std::endl;
+            return fail;
+        }
+        seen[rid.pageNum] = true;
+        count++;
+    }
+    ix_ScanIterator.close();
+    if (count != numOfTuples) {
+        std::cerr << "Wrong number of entries in the full scan: " << count << std::endl;
+        return fail;
+    }
+
+    // a range scan filters the buckets by the bounds
+    char low[PAGE_SIZE], high[PAGE_SIZE];
+    makeKey(attribute, 3, low);
+    makeKey(attribute, 5, high);
+    unsigned expected = 0;
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        makeKey(attribute, i, key);
+        if (keyBetween(attribute, key, low, high)) expected++;
+    }
+    rc = indexManager.scan(ixFileHandle, attribute, low, high, true, false, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success) {
+        if (!keyBetween(attribute, key, low, high)) {
+            std::cerr << "Entry " << rid.pageNum << " is out of the range." << std::endl;
+            return fail;
+        }
+        count++;
+    }
+    ix_ScanIterator.close();
+    if (count != expected) {
+        std::cerr << "Wrong number of entries in the range scan: " << count << std::endl;
+        return fail;
+    }
+
+    // delete every other entry, a deleted entry is gone
+    for (unsigned i = 0; i < numOfTuples; i += 2) {
+        makeKey(attribute, i, key);
+        rc = indexManager.deleteEntry(ixFileHandle, attribute, key, makeRID(i));
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    rc = indexManager.deleteEntry(ixFileHandle, attribute, key, makeRID(numOfTuples - 2));
+    assert(rc != success && "Deleting a deleted entry should fail.");
+    for (unsigned i = 0; i < 100; i++) {
+        makeKey(attribute, i, key);
+        if (probe(ixFileHandle, attribute, key) != (int) (i % 2)) {
+            std::cerr << "Wrong entries of key " << i << " after deletion." << std::endl;
+            return fail;
+        }
+    }
+
+    // 5000 RIDs of one key go to overflow pages of its bucket
+    makeKey(attribute, 1, key);
+    for (unsigned i = numOfTuples; i < numOfTuples + 5000; i++) {
+        rc = indexManager.insertEntry(ixFileHandle, attribute, key, makeRID(i));
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    if (probe(ixFileHandle, attribute, key) != 5001) {
+        std::cerr << "Wrong number of entries of a duplicated key." << std::endl;
+        return fail;
+    }
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+
+    // the directory is read back when the file is opened again
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    for (unsigned i = 1; i < numOfTuples; i += 2) {
+        makeKey(attribute, i, key);
+        if (probe(ixFileHandle, attribute, key) != (i == 1 ? 5001 : 1)) {
+            std::cerr << "Wrong entries of key " << i << " after reopening." << std::endl;
+            return fail;
+        }
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int testCase_22(const std::string &indexFileName, const Attribute &attrAge, const Attribute &attrName) {
+    // Checks the extendible hash index.
+    // Functions tested
+    // 1. Create Index File of a hash index
+    // 2. Open Index File
+    // 3. Insert entries
+    // 4. Equality probes - **a probe reads about one page, where a B+ tree reads its height**
+    // 5. Scan all entries and a range - each one once, in no particular order
+    // 6. Delete entries, insert many RIDs of one key
+    // 7. Close Index File, open it again
+    // 8. Destroy Index File
+    // for an int and a varchar key
+    std::cerr << std::endl << "***** In IX Test Case 22 *****" << std::endl;
+
+    if (hashIndex(indexFileName, attrAge) != success) return fail;
+    return hashIndex(indexFileName, attrName);
+}
+
+int main() {
+
+    const std::string indexFileName = "hash_idx";
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+    Attribute attrName;
+    attrName.length = 20;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    indexManager.destroyFile(indexFileName);
+
+    if (testCase_22(indexFileName, attrAge, attrName) == success) {
+        std::cerr << "***** IX Test Case 22 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 22 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
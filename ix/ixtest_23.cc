@@ -0,0 +1,143 @@
+#include <atomic>
+#include <random>
+#include <thread>
+#include "ix.h"
+#include "ix_test_util.h"
+
+static const unsigned numOfInserters = 4;
+static const unsigned numOfSearchers = 4;
+
+// looks entry i up by its key; 1 if it is there alone, 0 if the key is missing, -1 otherwise
+static int search(IXFileHandle &ixFileHandle, const Attribute &attribute, unsigned i) {
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    char key[PAGE_SIZE], found[PAGE_SIZE];
+    makeKey(attribute, i, key);
+    // an empty index has no root to scan from
+    if (indexManager.scan(ixFileHandle, attribute, key, key, true, true, ix_ScanIterator) != success) return 0;
+    int count = 0;
+    bool right = true;
+    while (ix_ScanIterator.getNextEntry(rid, found) == success) {
+        if (rid.pageNum != i || rid.slotNum != i % 7) right = false;
+        count++;
+    }
+    ix_ScanIterator.close();
+    if (!right || count > 1) return -1;
+    return count;
+}
+
+static int insertAndSearch(const std::string &indexFileName, const Attribute &attribute) {
+    unsigned numOfTuples = 40000;
+    IXFileHandle ixFileHandle;
+    RC rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // inserter t inserts the entries i with i % numOfInserters == t in order, and publishes how many
+    // it has done; the entries below that count have to be found by any search from then on
+    std::atomic<unsigned> inserted[numOfInserters];
+    for (auto &count : inserted) count = 0;
+    std::atomic<unsigned> started(0), inserting(numOfInserters);
+    std::atomic<int> failures(0), wrongSearches(0), overlapped(0);
+    auto waitForAll = [&]() {
+        started++;
+        while (started < numOfInserters + numOfSearchers) std::this_thread::yield();
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < numOfSearchers; t++) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 gen(t + 1);
+            std::uniform_int_distribution<unsigned> dist(0, numOfTuples - 1);
+            waitForAll();
+            while (inserting > 0) {
+                unsigned i = dist(gen);
+                bool due = i / numOfInserters < inserted[i % numOfInserters];
+                int res = search(ixFileHandle, attribute, i);
+                if (res < 0 || (due && res == 0)) wrongSearches++;
+                // the search began and ended while entries were being inserted
+                if (inserting > 0) overlapped++;
+            }
+        });
+    }
+    for (unsigned t = 0; t < numOfInserters; t++) {
+        threads.emplace_back([&, t]() {
+            char key[PAGE_SIZE];
+            waitForAll();
+            for (unsigned i = t; i < numOfTuples; i += numOfInserters) {
+                makeKey(attribute, i, key);
+                RID rid;
+                rid.pageNum = i;
+                rid.slotNum = i % 7;
+                if (indexManager.insertEntry(ixFileHandle, attribute, key, rid) != success) failures++;
+                inserted[t]++;
+            }
+            inserting--;
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    std::cerr << attribute.name << " searches during the inserts: " << overlapped << std::endl;
+
+    if (failures != 0 || wrongSearches != 0) {
+        std::cerr << failures << " failed inserts, " << wrongSearches << " wrong searches." << std::endl;
+        return fail;
+    }
+    if (overlapped == 0) {
+        std::cerr << "No search ran while entries were inserted." << std::endl;
+        return fail;
+    }
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        if (search(ixFileHandle, attribute, i) != 1) {
+            std::cerr << "Entry " << i << " is missing after the inserts." << std::endl;
+            return fail;
+        }
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int testCase_23(const std::string &indexFileName, const Attribute &attrAge, const Attribute &attrName) {
+    // Checks point searches while other threads insert into the same index.
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Insert entries from several threads while several others search single keys
+    //    **an entry is found by every search that starts after its insert returned**
+    // 4. Search every entry after the inserts
+    // 5. Close Index File
+    // 6. Destroy Index File
+    // for an int and a varchar key
+    std::cerr << std::endl << "***** In IX Test Case 23 *****" << std::endl;
+
+    if (insertAndSearch(indexFileName, attrAge) != success) return fail;
+    return insertAndSearch(indexFileName, attrName);
+}
+
+int main() {
+
+    const std::string indexFileName = "concurrent_search_idx";
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+    Attribute attrName;
+    attrName.length = 20;
+    attrName.name = "name";
+    attrName.type = TypeVarChar;
+
+    indexManager.destroyFile(indexFileName);
+
+    if (testCase_23(indexFileName, attrAge, attrName) == success) {
+        std::cerr << "***** IX Test Case 23 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 23 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
@@ -0,0 +1,136 @@
+#include "ix.h"
+#include "ix_test_util.h"
+
+static const unsigned numOfShort = 354; // two full leaves
+static const unsigned numOfLong = 3000;
+static const unsigned prefixLen = 600;
+static const unsigned numOfDeleted = 140; // of the short keys, the second leaf is left with too few
+
+// short keys "a000".. come first, then long ones sharing prefixLen characters, so the leaves of the
+// long keys are separated by long keys in their parent
+static std::string keyOf(unsigned i) {
+    char digits[8];
+    if (i < numOfShort) {
+        snprintf(digits, sizeof(digits), "a%03u", i);
+        return digits;
+    }
+    snprintf(digits, sizeof(digits), "%04u", i - numOfShort);
+    return "b" + std::string(prefixLen, 'x') + digits;
+}
+
+static void toKey(const std::string &s, char *key) {
+    int len = s.size();
+    memcpy(key, &len, sizeof(int));
+    memcpy(key + sizeof(int), s.data(), len);
+}
+
+// number of leaves under pageNum that underflow, the root aside
+static int underflowedLeaves(IXFileHandle &ixFileHandle, int pageNum, bool root) {
+    char page[PAGE_SIZE];
+    if (ixFileHandle.readPage(pageNum, page) != success) return -1;
+    if (IndexPage::getNextLeafId(page) >= -1) return !root && IndexPage::underflows(page) ? 1 : 0;
+    std::vector<int> children;
+    IndexPage::readInnerValues(page, children);
+    int count = 0;
+    for (int child: children) {
+        int n = underflowedLeaves(ixFileHandle, child, false);
+        if (n < 0) return -1;
+        count += n;
+    }
+    return count;
+}
+
+int testCase_24(const std::string &indexFileName, const Attribute &attribute) {
+    // Checks that an underflowed leaf is rebalanced when the separator of it and one sibling does
+    // not fit in their parent.
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Bulk load two leaves of short keys and leaves of keys with a long common prefix, packing the pages
+    // 4. Delete most keys of the second leaf from the last one down - **the second leaf borrows from its left
+    //    sibling, since the long separator it would need with its right one does not fit in the parent**
+    // 5. Scan the rest
+    // 6. Close Index File
+    // 7. Destroy Index File
+    std::cerr << std::endl << "***** In IX Test Case 24 *****" << std::endl;
+
+    IXFileHandle ixFileHandle;
+    RC rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    char key[PAGE_SIZE];
+    unsigned pos = 0;
+    rc = indexManager.bulkLoad(ixFileHandle, attribute, [&](const void *&k, RID &r) {
+        if (pos == numOfShort + numOfLong) return false;
+        toKey(keyOf(pos), key);
+        k = key;
+        r = makeRID(pos);
+        ++pos;
+        return true;
+    }, 1.0);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+
+    // the last leaf of the load may be short already
+    int underflowed = underflowedLeaves(ixFileHandle, ixFileHandle.getRootPageNum(), true);
+    assert(underflowed >= 0 && "IXFileHandle::readPage() should not fail.");
+
+    // delete short keys from the last one down; their leaf cannot take long keys from its right sibling
+    for (unsigned i = numOfShort; i-- > numOfShort - numOfDeleted;) {
+        toKey(keyOf(i), key);
+        rc = indexManager.deleteEntry(ixFileHandle, attribute, key, makeRID(i));
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+    if (underflowedLeaves(ixFileHandle, ixFileHandle.getRootPageNum(), true) != underflowed) {
+        std::cerr << "An underflowed leaf was not rebalanced." << std::endl;
+        return fail;
+    }
+
+    // the rest comes back in order
+    IX_ScanIterator ix_ScanIterator;
+    RID rid;
+    rc = indexManager.scan(ixFileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    unsigned count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success) {
+        unsigned i = count < numOfShort - numOfDeleted ? count : count + numOfDeleted;
+        if (rid.pageNum != i || keyString(attribute, key) != keyOf(i)) {
+            std::cerr << "Wrong entry " << rid.pageNum << " at " << count << std::endl;
+            ix_ScanIterator.close();
+            return fail;
+        }
+        count++;
+    }
+    ix_ScanIterator.close();
+    if (count != numOfShort - numOfDeleted + numOfLong) {
+        std::cerr << "Wrong number of entries: " << count << std::endl;
+        return fail;
+    }
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main() {
+
+    const std::string indexFileName = "separator_idx";
+    Attribute attribute;
+    attribute.length = 1000;
+    attribute.name = "name";
+    attribute.type = TypeVarChar;
+
+    indexManager.destroyFile(indexFileName);
+
+    if (testCase_24(indexFileName, attribute) == success) {
+        std::cerr << "***** IX Test Case 24 finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cerr << "***** [FAIL] IX Test Case 24 failed. *****" << std::endl;
+        return fail;
+    }
+
+}
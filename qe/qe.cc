@@ -1,6 +1,9 @@
 
 #include "qe.h"
+#include <algorithm>
+#include <atomic>
 #include <cfloat>
+#include <unistd.h>
 void makeTableAttrName(std::string colName, std::string* tableName, std::string* attrName){
     std::string tmp;
     int i = 0;
@@ -55,14 +58,33 @@ int compareNumber(Num a, Num b){
     else return 1;
 }
 
+// memcmp, then the shorter one first
+static int compareKeys(const char *a, size_t aLength, const char *b, size_t bLength) {
+    int res = memcmp(a, b, std::min(aLength, bLength));
+    if (res != 0 || aLength == bLength) return res;
+    return aLength < bLength ? -1 : 1;
+}
+
+// whether a comparison that came out as res satisfies compOp
+static bool holds(CompOp compOp, int res) {
+    switch (compOp)
+    {
+        case EQ_OP:  return res == 0;
+        case LT_OP: return res < 0;
+        case LE_OP: return res <= 0;
+        case GT_OP: return res > 0;
+        case GE_OP: return res >= 0;
+        case NE_OP: return res != 0;
+        default: break;
+    };
+    return false;
+}
+
 bool applyComp(CompOp compOp, const char* left, const char* right, const Attribute& recordDescriptor){
     int res;
     if(recordDescriptor.type == TypeVarChar){
         int len1 = *(int*)left, len2 = *(int*)right;
-        res = memcmp(left + sizeof(int), right+sizeof(int), std::min(len1, len2));
-        if(res == 0 && len1 != len2){
-            res = len1 < len2 ? -1 : 1;
-        }
+        res = compareKeys(left + sizeof(int), len1, right + sizeof(int), len2);
     }
     else if(recordDescriptor.type == TypeInt){
         int a = *(int*)left, b = *(int*)right;
@@ -72,18 +94,32 @@ bool applyComp(CompOp compOp, const char* left, const char* right, const Attribu
         float a = *(float*)left, b = *(float*)right;
         res = compareNumber(a, b);
     }
+    return holds(compOp, res);
+}
 
-    switch (compOp)
-    {
-        case EQ_OP:  return res == 0;
-        case LT_OP: return res < 0;
-        case LE_OP: return res <= 0;
-        case GT_OP: return res > 0;
-        case GE_OP: return res >= 0;
-        case NE_OP: return res != 0;
-        default: break;
-    };
-    return false;
+RC IndexScan::fetchBatch() {
+    rids_.clear();
+    RID entry;
+    while (rids_.size() < HEAP_FETCH_BATCH && iter->getNextEntry(entry, key) == 0)
+        rids_.push_back(entry);
+    fetched_.clear();
+    next_ = 0;
+    if (rids_.empty())
+        return QE_EOF;
+    tuples_.clear();
+    if (keyOrder)
+        fetched_.resize(rids_.size());
+    RC rc = rm.readTuples(tableName, rids_, [this](size_t i, const void *tuple, unsigned length) {
+        Fetched fetched{rids_[i], tuples_.size(), length};
+        if (keyOrder) fetched_[i] = fetched;
+        else fetched_.push_back(fetched);
+        pushBackTo(tuples_, (const char *) tuple, length);
+    });
+    if (rc != 0) {
+        fetched_.clear();
+        return rc;
+    }
+    return 0;
 }
 
 Filter::Filter(Iterator *input, const Condition &condition) {
@@ -106,7 +142,9 @@ RC Filter::getNextTuple(void *data){
     if(lAttrIdx_ < 0) return QE_EOF;
     while(input->getNextTuple(data) != QE_EOF) {
         std::vector<std::vector<char>> ans = decoupleFieldValues(data, attributes);
-        if(applyComp(condition.op, ans[lAttrIdx_+1].data(), (char*)condition.rhsValue.data, attributes[lAttrIdx_ + 1])) {
+        // a NULL has no value to compare, it satisfies no condition
+        if(testBit(ans[0].data(), lAttrIdx_)) continue;
+        if(applyComp(condition.op, ans[lAttrIdx_+1].data(), (char*)condition.rhsValue.data, attributes[lAttrIdx_])) {
             return 0;
         }
     }
@@ -144,6 +182,175 @@ RC Project::getNextTuple(void *data) {
     return 0;
 };
 
+// appends value i of column, nullptr for NULL
+static void appendValue(Batch::Column &column, unsigned i, const char *value, unsigned length) {
+    if (i % 8 == 0) column.nulls.push_back(0);
+    if (value == nullptr) column.nulls.back() |= 1u << (i % 8);
+    if (column.type == TypeVarChar) {
+        if (value != nullptr) column.heap.insert(column.heap.end(), value, value + length);
+        column.offsets.push_back(column.heap.size());
+    } else if (value != nullptr) {
+        column.values.insert(column.values.end(), value, value + 4);
+    } else {
+        column.values.resize(column.values.size() + 4);
+    }
+}
+
+void Batch::reset(const std::vector<Attribute> &attrs) {
+    columns.resize(attrs.size());
+    for (size_t c = 0; c < attrs.size(); ++c) columns[c].type = attrs[c].type;
+    clear();
+}
+
+void Batch::clear() {
+    // the buffers keep their capacity for the next batch
+    for (auto &column: columns) {
+        column.values.clear();
+        column.nulls.clear();
+        column.offsets.assign(1, 0);
+        column.heap.clear();
+    }
+    size = 0;
+}
+
+void Batch::append(const char *const *fields, const unsigned *lengths) {
+    for (size_t c = 0; c < columns.size(); ++c) appendValue(columns[c], size, fields[c], lengths[c]);
+    size++;
+}
+
+void Batch::appendTuple(const void *data) {
+    const char *tuple = (const char *) data;
+    int offset = getIndicatorLen(columns.size());
+    for (size_t c = 0; c < columns.size(); ++c) {
+        if (testBit(tuple, c)) {
+            appendValue(columns[c], size, nullptr, 0);
+        } else if (columns[c].type == TypeVarChar) {
+            int length = *(const int *) (tuple + offset);
+            appendValue(columns[c], size, tuple + offset + sizeof(int), length);
+            offset += sizeof(int) + length;
+        } else {
+            appendValue(columns[c], size, tuple + offset, 4);
+            offset += 4;
+        }
+    }
+    size++;
+}
+
+unsigned Batch::getTuple(unsigned i, void *data) const {
+    char *tuple = (char *) data;
+    int offset = getIndicatorLen(columns.size());
+    bzero(tuple, offset);
+    for (size_t c = 0; c < columns.size(); ++c) {
+        const Column &column = columns[c];
+        if (column.isNull(i)) {
+            setBit(tuple, c);
+        } else if (column.type == TypeVarChar) {
+            int length = column.offsets[i + 1] - column.offsets[i];
+            memcpy(tuple + offset, &length, sizeof(int));
+            memcpy(tuple + offset + sizeof(int), column.heap.data() + column.offsets[i], length);
+            offset += sizeof(int) + length;
+        } else {
+            memcpy(tuple + offset, column.values.data() + 4 * i, 4);
+            offset += 4;
+        }
+    }
+    return offset;
+}
+
+void Batch::select(const Batch &from, const std::vector<unsigned> &rows) {
+    columns.resize(from.columns.size());
+    for (size_t c = 0; c < columns.size(); ++c) columns[c].type = from.columns[c].type;
+    clear();
+    for (size_t c = 0; c < columns.size(); ++c) {
+        Column &column = columns[c];
+        const Column &source = from.columns[c];
+        column.nulls.resize((rows.size() + 7) / 8);
+        for (unsigned j = 0; j < rows.size(); ++j) {
+            if (source.isNull(rows[j])) column.nulls[j / 8] |= 1u << (j % 8);
+        }
+        if (column.type == TypeVarChar) {
+            for (unsigned row: rows) {
+                column.heap.insert(column.heap.end(), source.heap.begin() + source.offsets[row],
+                                   source.heap.begin() + source.offsets[row + 1]);
+                column.offsets.push_back(column.heap.size());
+            }
+        } else {
+            column.values.resize(4 * rows.size());
+            const uint32_t *values = (const uint32_t *) source.values.data();
+            uint32_t *selected = (uint32_t *) column.values.data();
+            for (unsigned j = 0; j < rows.size(); ++j) selected[j] = values[rows[j]];
+        }
+    }
+    size = rows.size();
+}
+
+RC Iterator::getNextBatch(Batch &batch) {
+    std::vector<Attribute> attrs;
+    getAttributes(attrs);
+    batch.reset(attrs);
+    char data[PAGE_SIZE];
+    while (batch.size < BATCH_SIZE && getNextTuple(data) != QE_EOF) batch.appendTuple(data);
+    return batch.size == 0 ? QE_EOF : 0;
+}
+
+template<typename T, typename Comp>
+static void selectRows(const Batch::Column &column, unsigned size, T value, Comp comp, std::vector<unsigned> &rows) {
+    const T *values = (const T *) column.values.data();
+    for (unsigned i = 0; i < size; ++i) {
+        if (comp(values[i], value) && !column.isNull(i)) rows.push_back(i);
+    }
+}
+
+// the rows of column whose values satisfy op value, with the comparison picked once for the whole batch
+template<typename T>
+static void selectRows(const Batch::Column &column, unsigned size, CompOp op, T value, std::vector<unsigned> &rows) {
+    switch (op) {
+        case EQ_OP: selectRows(column, size, value, std::equal_to<T>(), rows); break;
+        case LT_OP: selectRows(column, size, value, std::less<T>(), rows); break;
+        case LE_OP: selectRows(column, size, value, std::less_equal<T>(), rows); break;
+        case GT_OP: selectRows(column, size, value, std::greater<T>(), rows); break;
+        case GE_OP: selectRows(column, size, value, std::greater_equal<T>(), rows); break;
+        case NE_OP: selectRows(column, size, value, std::not_equal_to<T>(), rows); break;
+        default: break;
+    }
+}
+
+RC Filter::getNextBatch(Batch &batch) {
+    if (lAttrIdx_ < 0) return QE_EOF;
+    const char *value = (const char *) condition.rhsValue.data;
+    while (input->getNextBatch(inBatch_) == 0) {
+        const Batch::Column &column = inBatch_.columns[lAttrIdx_];
+        rows_.clear();
+        if (column.type == TypeInt) {
+            selectRows(column, inBatch_.size, condition.op, *(const int *) value, rows_);
+        } else if (column.type == TypeReal) {
+            selectRows(column, inBatch_.size, condition.op, *(const float *) value, rows_);
+        } else {
+            for (unsigned i = 0; i < inBatch_.size; ++i) {
+                if (!column.isNull(i) &&
+                    holds(condition.op, compareKeys(column.heap.data() + column.offsets[i],
+                                                    column.offsets[i + 1] - column.offsets[i], value + sizeof(int),
+                                                    *(const int *) value)))
+                    rows_.push_back(i);
+            }
+        }
+        if (rows_.empty()) continue;
+        if (rows_.size() == inBatch_.size) std::swap(batch, inBatch_);
+        else batch.select(inBatch_, rows_);
+        return 0;
+    }
+    return QE_EOF;
+}
+
+RC Project::getNextBatch(Batch &batch) {
+    if (input->getNextBatch(inBatch_) != 0)
+        return QE_EOF;
+    batch.columns.resize(selected_idx_.size());
+    for (size_t i = 0; i < selected_idx_.size(); ++i) batch.columns[i] = inBatch_.columns[selected_idx_[i]];
+    batch.size = inBatch_.size;
+    return 0;
+}
+
 
 BNLJoin::BNLJoin(Iterator *leftIn, TableScan *rightIn, const Condition &condition, 
         const unsigned numPages):numPages_(numPages), leftIn_(leftIn), rightIn_(rightIn), cond_(condition) {
@@ -289,130 +496,410 @@ bool INLJoin::joinRecord(void* data) {
     return true;
 }
 
-RC Aggregate::getCount(void* data){
-    float count = 0;
-    char buf[PAGE_SIZE];
-    while(input_->getNextTuple(buf) != QE_EOF)
-        count ++;
+// the tuple of two decoupled records, null indicators included
+static void joinValues(void *data, const DecoupledRecord &left, size_t leftCount, const DecoupledRecord &right,
+                       size_t rightCount) {
+    int indicator_len = getIndicatorLen(leftCount + rightCount);
+    bzero(data, indicator_len);
+    memcpy(data, left[0].data(), left[0].size());
+    for (size_t i = 0; i < rightCount; ++i) {
+        if (testBit(right[0].data(), i)) setBit((char *) data, i + leftCount);
+    }
+    for (size_t i = 1; i < left.size(); ++i) {
+        memcpy((char *) data + indicator_len, left[i].data(), left[i].size());
+        indicator_len += left[i].size();
+    }
+    for (size_t i = 1; i < right.size(); ++i) {
+        memcpy((char *) data + indicator_len, right[i].data(), right[i].size());
+        indicator_len += right[i].size();
+    }
+}
+
+// a field as a hash key, -0.0 made 0.0 so equal reals meet
+static std::string keyOf(const std::vector<char> &field, AttrType type) {
+    if (type == TypeReal && *(const float *) field.data() == 0) {
+        float zero = 0;
+        return std::string((const char *) &zero, sizeof(float));
+    }
+    return std::string(field.begin(), field.end());
+}
 
-    // skip null indicator, so plus one
-    memcpy(data+1, &count, sizeof(float));
-    finish_ = true;
-    return 0;
+// FNV-1a seeded by level and the murmur3 finalizer, so every level splits a partition differently
+static uint32_t hashOf(const char *key, size_t length, unsigned level) {
+    uint32_t h = 2166136261u ^ (level * 0x9e3779b9u);
+    for (size_t i = 0; i < length; ++i) {
+        h ^= (unsigned char) key[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
 }
 
-RC Aggregate::getMax(void *data) {
-    if(aggAttr_.type == TypeVarChar) return QE_EOF;
-    char buf[PAGE_SIZE];
-    float max = FLT_MIN;
-    if(aggAttr_.type == TypeInt) {
-        while (input_->getNextTuple(buf) != QE_EOF) {
-            std::vector<std::vector<char>> ans = decoupleFieldValues(buf, attributes);
-            if (max < *(int *) ans[AttrIdx_ + 1].data()) {
-                max = (float)(*(int *) ans[AttrIdx_ + 1].data());
-            }
+static unsigned partitionOf(const std::string &key, unsigned level, unsigned numPartitions) {
+    return hashOf(key.data(), key.size(), level) % numPartitions;
+}
+
+// the prefix of the temporary files of one operator, which those of other operators, also of other processes,
+// don't share
+static std::string tempFilePrefix(const std::string &op) {
+    static std::atomic<unsigned> operators{0};
+    return op + "_" + std::to_string(getpid()) + "_" + std::to_string(operators++) + "_";
+}
+
+// opens a scan of all the records of a temporary file
+static RC scanTempFile(const std::string &fileName, const std::vector<Attribute> &attrs, FileHandle &file,
+                       RBFM_ScanIterator &scanner) {
+    auto &rbfm = RecordBasedFileManager::instance();
+    std::vector<std::string> names;
+    for (auto &attr: attrs) names.push_back(attr.name);
+    if (rbfm.openFile(fileName, file) < 0) return -1;
+    return rbfm.scan(file, attrs, "", NO_OP, NULL, names, scanner);
+}
+
+// Writes tuples to a set of temporary files. A page of tuples is kept for each file and written with insertRecords.
+class PartitionWriter {
+    std::vector<Attribute> attrs_;
+    std::vector<FileHandle> files_;
+    std::vector<std::vector<char>> buffers_;
+    std::vector<std::vector<size_t>> offsets_;
+
+    RC flush(size_t p) {
+        std::vector<const void *> tuples;
+        std::vector<RID> rids;
+        for (size_t offset: offsets_[p]) tuples.push_back(buffers_[p].data() + offset);
+        RC rc = RecordBasedFileManager::instance().insertRecords(files_[p], attrs_, tuples, rids);
+        buffers_[p].clear();
+        offsets_[p].clear();
+        return rc;
+    }
+public:
+    std::vector<unsigned> bytes;        // of the tuples added to each file
+
+    // creates the files
+    RC open(const std::vector<std::string> &fileNames, const std::vector<Attribute> &attrs) {
+        auto &rbfm = RecordBasedFileManager::instance();
+        attrs_ = attrs;
+        files_ = std::vector<FileHandle>(fileNames.size());
+        buffers_.assign(fileNames.size(), std::vector<char>());
+        offsets_.assign(fileNames.size(), std::vector<size_t>());
+        bytes.assign(fileNames.size(), 0);
+        for (size_t p = 0; p < fileNames.size(); ++p) {
+            if (rbfm.createFile(fileNames[p]) < 0 || rbfm.openFile(fileNames[p], files_[p]) < 0) return -1;
         }
-        memcpy(data+1, &max, sizeof(int));
-        finish_ = true;
         return 0;
     }
-    else if(aggAttr_.type == TypeReal) {
-        while (input_->getNextTuple(buf) != QE_EOF) {
-            std::vector<std::vector<char>> ans = decoupleFieldValues(buf, attributes);
-            if (max < *(float *) ans[AttrIdx_ + 1].data()) {
-                max = *(float *) ans[AttrIdx_ + 1].data();
-            }
+
+    RC add(size_t p, const void *tuple, int size) {
+        offsets_[p].push_back(buffers_[p].size());
+        pushBackTo(buffers_[p], (const char *) tuple, size);
+        bytes[p] += size;
+        return buffers_[p].size() >= PAGE_SIZE ? flush(p) : 0;
+    }
+
+    // writes what is left and closes the files
+    RC close() {
+        RC rc = 0;
+        for (size_t p = 0; p < files_.size(); ++p) {
+            if (rc == 0 && !offsets_[p].empty()) rc = flush(p);
+            RecordBasedFileManager::instance().closeFile(files_[p]);
         }
-        memcpy(data+1, &max, sizeof(float));
-        finish_ = true;
-        return 0;
+        return rc;
     }
-    return QE_EOF;
-}
+};
 
-RC Aggregate::getMin(void *data) {
-    if(aggAttr_.type == TypeVarChar) return QE_EOF;
-    char buf[PAGE_SIZE];
-    float min = FLT_MAX;
-    if(aggAttr_.type == TypeInt) {
-        while (input_->getNextTuple(buf) != QE_EOF) {
-            std::vector<std::vector<char>> ans = decoupleFieldValues(buf, attributes);
-            if (min > *(int *) ans[AttrIdx_ + 1].data()) {
-                min = (float)(*(int *) ans[AttrIdx_ + 1].data());
-            }
+GHJoin::GHJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition, const unsigned numPartitions,
+               const unsigned memoryPages)
+        : leftIn_(leftIn), rightIn_(rightIn), cond_(condition), numPartitions_(std::max(numPartitions, 1u)),
+          memoryBytes_(memoryPages * PAGE_SIZE) {
+    if (!cond_.bRhsIsAttr || cond_.lhsAttr.size() == 0 || cond_.rhsAttr.size() == 0) return;
+    leftIn_->getAttributes(attrs_[0]);
+    rightIn_->getAttributes(attrs_[1]);
+    for (int i = 0; i < attrs_[0].size(); ++i) {
+        if (attrs_[0][i].name == cond_.lhsAttr) {
+            joinIdx_[0] = i; break;
         }
-        memcpy(data+1, &min, sizeof(int));
-        finish_ = true;
-        return 0;
     }
-    else if(aggAttr_.type == TypeReal) {
-        while (input_->getNextTuple(buf) != QE_EOF) {
-            std::vector<std::vector<char>> ans = decoupleFieldValues(buf, attributes);
-            if (min > *(float *) ans[AttrIdx_ + 1].data()) {
-                min = *(float *) ans[AttrIdx_ + 1].data();
-            }
+    for (int i = 0; i < attrs_[1].size(); ++i) {
+        if (attrs_[1][i].name == cond_.rhsAttr) {
+            joinIdx_[1] = i; break;
         }
-        memcpy(data+1, &min, sizeof(float));
-        finish_ = true;
-        return 0;
     }
-    return QE_EOF;
+    prefix_ = tempFilePrefix("ghjoin");
+}
+
+GHJoin::~GHJoin() {
+    auto &rbfm = RecordBasedFileManager::instance();
+    if (joining_) endPair();
+    for (auto &part: pending_) {
+        rbfm.destroyFile(part.fileName[0]);
+        rbfm.destroyFile(part.fileName[1]);
+    }
+}
+
+void GHJoin::getAttributes(std::vector<Attribute> &attrs) const {
+    attrs = attrs_[0];
+    attrs.insert(attrs.end(), attrs_[1].begin(), attrs_[1].end());
 }
 
-RC Aggregate::getSum(void *data) {
-    if(aggAttr_.type == TypeVarChar) return QE_EOF;
-    char buf[PAGE_SIZE];
-    float sum = 0;
+RC GHJoin::partition(const std::function<RC(void *)> &next, int side, std::vector<Partition> &parts) {
+    const auto &attrs = attrs_[side];
+    std::vector<std::string> fileNames;
+    for (auto &part: parts) fileNames.push_back(part.fileName[side]);
+    PartitionWriter writer;
+    RC rc = writer.open(fileNames, attrs);
+    while (rc == 0 && next(databuf_) == 0) {
+        int size;
+        DecoupledRecord values = decoupleFieldValues(databuf_, attrs, &size);
+        if (testBit(values[0].data(), joinIdx_[side])) continue; // a NULL key joins nothing
+        unsigned p = partitionOf(keyOf(values[joinIdx_[side] + 1], attrs[joinIdx_[side]].type), parts[0].level,
+                                 parts.size());
+        rc = writer.add(p, databuf_, size);
+    }
+    RC closed = writer.close();
+    for (size_t p = 0; p < parts.size(); ++p) parts[p].bytes[side] = writer.bytes[p];
+    return rc == 0 ? closed : rc;
+}
 
-    if(aggAttr_.type == TypeInt) {
-        while (input_->getNextTuple(buf) != QE_EOF) {
-            std::vector<std::vector<char>> ans = decoupleFieldValues(buf, attributes);
-            sum += (float)(*(int *) ans[AttrIdx_ + 1].data());
+RC GHJoin::partitionPair(const std::function<RC(void *)> &left, const std::function<RC(void *)> &right,
+                         unsigned level) {
+    auto &rbfm = RecordBasedFileManager::instance();
+    std::vector<Partition> parts(numPartitions_);
+    for (auto &part: parts) {
+        part.fileName[0] = prefix_ + std::to_string(numFiles_++);
+        part.fileName[1] = prefix_ + std::to_string(numFiles_++);
+        part.bytes[0] = part.bytes[1] = 0;
+        part.level = level;
+    }
+    RC rc = partition(left, 0, parts);
+    if (rc == 0) rc = partition(right, 1, parts);
+    for (auto &part: parts) {
+        // a pair with an empty side joins nothing
+        if (rc == 0 && part.bytes[0] > 0 && part.bytes[1] > 0) {
+            pending_.push_back(part);
+            continue;
         }
-        memcpy(data+1, &sum, sizeof(int));
-        finish_ = true;
-        return 0;
+        rbfm.destroyFile(part.fileName[0]);
+        rbfm.destroyFile(part.fileName[1]);
     }
-    else if(aggAttr_.type == TypeReal) {
-        while (input_->getNextTuple(buf) != QE_EOF) {
-            std::vector<std::vector<char>> ans = decoupleFieldValues(buf, attributes);
-            sum += *(float *) ans[AttrIdx_ + 1].data();
+    return rc;
+}
+
+RC GHJoin::readPartition(const std::string &fileName, int side, const std::function<void(void *)> &func) {
+    auto &rbfm = RecordBasedFileManager::instance();
+    FileHandle file;
+    RBFM_ScanIterator scanner;
+    RID rid;
+    RC rc = scanTempFile(fileName, attrs_[side], file, scanner);
+    while (rc == 0 && scanner.getNextRecord(rid, databuf_) != RBFM_EOF)
+        func(databuf_);
+    scanner.close();
+    rbfm.closeFile(file);
+    rbfm.destroyFile(fileName);
+    return rc;
+}
+
+RC GHJoin::nextPair() {
+    auto &rbfm = RecordBasedFileManager::instance();
+    while (!pending_.empty()) {
+        Partition part = pending_.back();
+        pending_.pop_back();
+        int build = part.bytes[0] <= part.bytes[1] ? 0 : 1;
+        if (part.bytes[build] > memoryBytes_ && part.level < GHJOIN_MAX_LEVEL) {
+            // too big for the hash table, split both sides again
+            RBFM_ScanIterator scanners[2];
+            FileHandle files[2];
+            RC rc = 0;
+            for (int side = 0; side < 2; ++side) {
+                if (scanTempFile(part.fileName[side], attrs_[side], files[side], scanners[side]) < 0) rc = -1;
+            }
+            RID rid;
+            if (rc == 0) {
+                rc = partitionPair([&](void *data) { return scanners[0].getNextRecord(rid, data); },
+                                   [&](void *data) { return scanners[1].getNextRecord(rid, data); }, part.level + 1);
+            }
+            for (int side = 0; side < 2; ++side) {
+                scanners[side].close();
+                rbfm.closeFile(files[side]);
+                rbfm.destroyFile(part.fileName[side]);
+            }
+            if (rc != 0) return rc;
+            continue;
         }
-        memcpy(data+1, &sum, sizeof(float));
-        finish_ = true;
-        return 0;
+        // build the smaller side, probe with the other one
+        const auto &attrs = attrs_[build];
+        int idx = joinIdx_[build];
+        RC rc = readPartition(part.fileName[build], build, [&](void *data) {
+            DecoupledRecord values = decoupleFieldValues(data, attrs);
+            hashmap_[keyOf(values[idx + 1], attrs[idx].type)].push_back(std::move(values));
+        });
+        probeName_ = part.fileName[1 - build];
+        buildSide_ = build;
+        joining_ = true;
+        if (rc == 0) rc = scanTempFile(probeName_, attrs_[1 - build], probeFile_, probeScan_);
+        if (rc != 0) endPair();
+        return rc;
     }
     return QE_EOF;
 }
 
-RC Aggregate::getAvg(void *data) {
-    if(aggAttr_.type == TypeVarChar) return QE_EOF;
-    char buf[PAGE_SIZE];
-    float sum = 0;
-    int count = 0;
-    if(aggAttr_.type == TypeInt) {
-        while (input_->getNextTuple(buf) != QE_EOF) {
-            std::vector<std::vector<char>> ans = decoupleFieldValues(buf, attributes);
-            sum += (float)(*(int *) ans[AttrIdx_ + 1].data());
-            count ++;
-        }
-        float avg = sum/(count*1.0);
-        memcpy(data+1, &avg, sizeof(float));
-        finish_ = true;
-        return 0;
+void GHJoin::endPair() {
+    auto &rbfm = RecordBasedFileManager::instance();
+    probeScan_.close();
+    rbfm.closeFile(probeFile_);
+    rbfm.destroyFile(probeName_);
+    hashmap_.clear();
+    matches_ = nullptr;
+    joining_ = false;
+}
+
+RC GHJoin::getNextTuple(void *data) {
+    if (joinIdx_[0] < 0 || joinIdx_[1] < 0)
+        return QE_EOF;
+    if (!partitioned_) {
+        partitioned_ = true;
+        if (partitionPair([this](void *data) { return leftIn_->getNextTuple(data); },
+                          [this](void *data) { return rightIn_->getNextTuple(data); }, 0) != 0)
+            return QE_EOF;
     }
-    else if(aggAttr_.type == TypeReal) {
-        while (input_->getNextTuple(buf) != QE_EOF) {
-            std::vector<std::vector<char>> ans = decoupleFieldValues(buf, attributes);
-            sum += *(float *) ans[AttrIdx_ + 1].data();
-            count ++;
+    while (1) {
+        if (matches_ != nullptr && matchIdx_ < matches_->size()) {
+            const DecoupledRecord &match = (*matches_)[matchIdx_++];
+            if (buildSide_ == 0) joinValues(data, match, attrs_[0].size(), probeValues_, attrs_[1].size());
+            else joinValues(data, probeValues_, attrs_[0].size(), match, attrs_[1].size());
+            return 0;
         }
-        float avg = sum/count;
-        memcpy(data+1, &avg, sizeof(float));
-        finish_ = true;
-        return 0;
+        if (!joining_ && nextPair() != 0)
+            return QE_EOF;
+        RID rid;
+        if (probeScan_.getNextRecord(rid, databuf_) == RBFM_EOF) {
+            endPair();
+            continue;
+        }
+        int probe = 1 - buildSide_;
+        probeValues_ = decoupleFieldValues(databuf_, attrs_[probe]);
+        auto it = hashmap_.find(keyOf(probeValues_[joinIdx_[probe] + 1], attrs_[probe][joinIdx_[probe]].type));
+        matches_ = it == hashmap_.end() ? nullptr : &it->second;
+        matchIdx_ = 0;
+    }
+}
+
+void GroupTable::reset(size_t memoryBytes) {
+    arena_.clear();
+    groups_.clear();
+    slots_.assign(16, 0);
+    memoryBytes_ = memoryBytes;
+}
+
+void GroupTable::place(uint32_t index) {
+    size_t mask = slots_.size() - 1;
+    size_t i = groups_[index].hash & mask;
+    while (slots_[i] != 0) i = (i + 1) & mask;
+    slots_[i] = index + 1;
+}
+
+GroupTable::Group *GroupTable::find(const char *key, unsigned length, uint32_t hash, bool insert) {
+    if (slots_.empty()) slots_.assign(16, 0);
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask; slots_[i] != 0; i = (i + 1) & mask) {
+        Group &group = groups_[slots_[i] - 1];
+        if (group.hash == hash && group.length == length && memcmp(key, arena_.data() + group.offset, length) == 0)
+            return &group;
+    }
+    if (!insert) return nullptr;
+    // the table doubles when it is half full
+    bool grow = (groups_.size() + 1) * 2 > slots_.size();
+    size_t bytes = arena_.size() + length + (groups_.size() + 1) * sizeof(Group) +
+                   (grow ? 2 : 1) * slots_.size() * sizeof(uint32_t);
+    if (!groups_.empty() && bytes > memoryBytes_) return nullptr;
+    Group group;
+    group.offset = arena_.size();
+    group.length = length;
+    group.hash = hash;
+    arena_.insert(arena_.end(), key, key + length);
+    groups_.push_back(group);
+    if (grow) {
+        slots_.assign(slots_.size() * 2, 0);
+        for (uint32_t index = 0; index < groups_.size(); ++index) place(index);
+    } else {
+        place(groups_.size() - 1);
+    }
+    return &groups_.back();
+}
+
+// folds a value into the count, min, max and sum of a group
+static void accumulate(GroupTable::Group &group, double value) {
+    if (group.count == 0 || value < group.min) group.min = value;
+    if (group.count == 0 || value > group.max) group.max = value;
+    group.sum += value;
+    group.count++;
+}
+
+// folds the values of a column that aren't NULL into min, max and sum, in floats as getNextTuple always did
+template<typename T>
+static void accumulateColumn(const Batch::Column &column, unsigned size, float &min, float &max, float &sum,
+                             unsigned &count) {
+    const T *values = (const T *) column.values.data();
+    for (unsigned i = 0; i < size; ++i) {
+        if (column.isNull(i)) continue;
+        if (min > values[i]) min = (float) values[i];
+        if (max < values[i]) max = (float) values[i];
+        sum += (float) values[i];
+        count++;
+    }
+}
+
+// appends value i of column in the format of getNextTuple, a real -0.0 as 0.0
+static void appendField(std::string &out, const Batch::Column &column, unsigned i) {
+    if (column.type == TypeVarChar) {
+        int length = column.offsets[i + 1] - column.offsets[i];
+        out.append((const char *) &length, sizeof(int));
+        out.append(column.heap.data() + column.offsets[i], length);
+    } else if (column.type == TypeReal && column.reals()[i] == 0) {
+        float zero = 0;
+        out.append((const char *) &zero, sizeof(float));
+    } else {
+        out.append(column.values.data() + 4 * i, 4);
     }
-    return QE_EOF;
+}
+
+// the aggregate of a group, false when it is NULL, which an aggregate of no values other than COUNT is
+static bool aggregateOf(AggregateOp op, const GroupTable::Group &group, float &value) {
+    switch (op) {
+        case AggregateOp::COUNT: value = group.count; return true;
+        case AggregateOp::MIN: value = group.min; break;
+        case AggregateOp::MAX: value = group.max; break;
+        case AggregateOp::SUM: value = group.sum; break;
+        case AggregateOp::AVG: value = group.count == 0 ? 0 : group.sum / group.count; break;
+    }
+    return group.count > 0;
+}
+
+// COUNT is the number of values that aren't NULL, as for a group; MIN and MAX of no values stay at their seeds
+RC Aggregate::aggregate(void *data) {
+    finish_ = true;
+    if (AttrIdx_ < 0) return QE_EOF;
+    float min = FLT_MAX, max = FLT_MIN, sum = 0, value = 0;
+    unsigned count = 0;
+    while (input_->getNextBatch(batch_) == 0) {
+        const Batch::Column &column = batch_.columns[AttrIdx_];
+        if (column.type == TypeInt) accumulateColumn<int>(column, batch_.size, min, max, sum, count);
+        else if (column.type == TypeReal) accumulateColumn<float>(column, batch_.size, min, max, sum, count);
+        else for (unsigned i = 0; i < batch_.size; ++i) count += !column.isNull(i);
+    }
+    switch (aggOp_) {
+        case AggregateOp::COUNT: value = count; break;
+        case AggregateOp::MIN: value = min; break;
+        case AggregateOp::MAX: value = max; break;
+        case AggregateOp::SUM: value = sum; break;
+        case AggregateOp::AVG: value = aggAttr_.type == TypeInt ? sum / (count * 1.0) : sum / count; break;
+    }
+    ((char *) data)[0] = 0;
+    memcpy((char *) data + 1, &value, sizeof(float));
+    return 0;
 }
 
 Aggregate::Aggregate(Iterator *input, const Attribute &aggAttr, AggregateOp op): 
@@ -425,24 +912,136 @@ Aggregate::Aggregate(Iterator *input, const Attribute &aggAttr, AggregateOp op):
     }
 }
 
+Aggregate::Aggregate(Iterator *input, const Attribute &aggAttr, const Attribute &groupAttr, AggregateOp op,
+                     const unsigned memoryPages)
+        : input_(input), aggAttr_(aggAttr), aggOp_(op), grouped_(true), groupAttr_(groupAttr),
+          memoryBytes_((size_t) memoryPages * PAGE_SIZE) {
+    input->getAttributes(attributes);
+    for (int i = 0; i < attributes.size(); ++i) {
+        if (attributes[i].name == aggAttr.name) AttrIdx_ = i;
+        if (attributes[i].name == groupAttr.name) groupIdx_ = i;
+    }
+    if (AttrIdx_ < 0 || groupIdx_ < 0) return;
+    spillAttrs_.push_back(attributes[groupIdx_]);
+    spillAttrs_.push_back(attributes[AttrIdx_]);
+    prefix_ = tempFilePrefix("aggregate");
+}
+
+Aggregate::~Aggregate() {
+    for (auto &spill: pending_) RecordBasedFileManager::instance().destroyFile(spill.fileName);
+}
+
+RC Aggregate::aggregateGroups(const std::function<RC(Batch &)> &next, int groupIdx, int aggIdx, unsigned level) {
+    auto &rbfm = RecordBasedFileManager::instance();
+    groups_.reset(memoryBytes_);
+    emitted_ = 0;
+    PartitionWriter writer;
+    std::vector<std::string> fileNames;
+    std::string key, spilled;
+    RC rc = 0;
+    while (rc == 0 && next(batch_) == 0) {
+        const Batch::Column &groupColumn = batch_.columns[groupIdx], &aggColumn = batch_.columns[aggIdx];
+        for (unsigned i = 0; i < batch_.size && rc == 0; ++i) {
+            bool groupNull = groupColumn.isNull(i), aggNull = aggColumn.isNull(i);
+            // a tag byte tells the NULL group from the others
+            key.assign(1, groupNull ? 0 : 1);
+            if (!groupNull) appendField(key, groupColumn, i);
+            uint32_t hash = hashOf(key.data(), key.size(), level);
+            GroupTable::Group *group = groups_.find(key.data(), key.size(), hash, true);
+            if (group == nullptr) {
+                // out of memory, the group and the value go to a spill file
+                if (fileNames.empty()) {
+                    for (int p = 0; p < AGGREGATE_PARTITIONS; ++p)
+                        fileNames.push_back(prefix_ + std::to_string(numFiles_++));
+                    rc = writer.open(fileNames, spillAttrs_);
+                    if (rc != 0) break;
+                }
+                spilled.assign(1, 0);
+                if (groupNull) setBit(&spilled[0], 0);
+                else spilled.append(key, 1, std::string::npos);
+                if (aggNull) setBit(&spilled[0], 1);
+                else appendField(spilled, aggColumn, i);
+                rc = writer.add(hash % AGGREGATE_PARTITIONS, spilled.data(), spilled.size());
+                continue;
+            }
+            if (aggNull) continue;
+            if (aggColumn.type == TypeInt) accumulate(*group, aggColumn.ints()[i]);
+            else if (aggColumn.type == TypeReal) accumulate(*group, aggColumn.reals()[i]);
+            else group->count++;
+        }
+    }
+    if (fileNames.empty()) return rc;
+    RC closed = writer.close();
+    if (rc == 0) rc = closed;
+    for (size_t p = 0; p < fileNames.size(); ++p) {
+        if (rc == 0 && writer.bytes[p] > 0) pending_.push_back(Spill{fileNames[p], level + 1});
+        else rbfm.destroyFile(fileNames[p]);
+    }
+    return rc;
+}
+
+// a NULL group value is NULL
+void Aggregate::emitGroup(const GroupTable::Group &group, void *data) {
+    char *out = (char *) data;
+    const char *key = groups_.key(group);
+    int offset = 1;
+    out[0] = 0;
+    if (key[0] == 0) setBit(out, 0);
+    memcpy(out + offset, key + 1, group.length - 1);
+    offset += group.length - 1;
+    float value;
+    if (aggregateOf(aggOp_, group, value)) memcpy(out + offset, &value, sizeof(float));
+    else setBit(out, 1);
+}
+
 RC Aggregate::getNextTuple(void *data){
-    if(finish_ || aggAttr_.type == TypeVarChar) return QE_EOF;
-    switch(aggOp_) {
-        case AggregateOp::COUNT:
-            return getCount(data);
-        case AggregateOp::MAX:
-            return getMax(data);
-        case AggregateOp::MIN:
-            return getMin(data);
-        case AggregateOp::SUM:
-            return getSum(data);
-        case AggregateOp::AVG:
-            return getAvg(data);
-        default: return -1;
+    if (grouped_) {
+        // a varchar attribute can only be counted
+        if (finish_ || AttrIdx_ < 0 || groupIdx_ < 0 ||
+            (aggAttr_.type == TypeVarChar && aggOp_ != AggregateOp::COUNT))
+            return QE_EOF;
+        if (!aggregated_) {
+            aggregated_ = true;
+            if (aggregateGroups([this](Batch &batch) { return input_->getNextBatch(batch); }, groupIdx_, AttrIdx_,
+                                0) != 0) {
+                finish_ = true;
+                return QE_EOF;
+            }
+        }
+        while (emitted_ == groups_.size()) {
+            if (pending_.empty()) return QE_EOF;
+            auto &rbfm = RecordBasedFileManager::instance();
+            Spill spill = pending_.back();
+            pending_.pop_back();
+            FileHandle file;
+            RBFM_ScanIterator scanner;
+            RC rc = scanTempFile(spill.fileName, spillAttrs_, file, scanner);
+            auto next = [&](Batch &batch) {
+                batch.reset(spillAttrs_);
+                scanner.getNextRecords(BATCH_SIZE, [&batch](const char *const *fields, const unsigned *lengths) {
+                    batch.append(fields, lengths);
+                });
+                return batch.size == 0 ? QE_EOF : 0;
+            };
+            if (rc == 0) rc = aggregateGroups(next, 0, 1, spill.level);
+            scanner.close();
+            rbfm.closeFile(file);
+            rbfm.destroyFile(spill.fileName);
+            if (rc != 0) {
+                finish_ = true;
+                return QE_EOF;
+            }
+        }
+        emitGroup(groups_.at(emitted_++), data);
+        return 0;
     }
+    if(finish_ || (aggAttr_.type == TypeVarChar && aggOp_ != AggregateOp::COUNT)) return QE_EOF;
+    return aggregate(data);
 }
 
 void Aggregate::getAttributes(std::vector<Attribute> &attrs) const {
+    attrs.clear();
+    if (grouped_) attrs.push_back(groupAttr_);
     Attribute res;
     res.type = TypeReal;
     res.length = 4;
@@ -465,4 +1064,440 @@ void Aggregate::getAttributes(std::vector<Attribute> &attrs) const {
     else return;
     attrs.emplace_back(res);
     return;
-}
\ No newline at end of file
+}
+// appends field to key so that memcmp orders keys the way applyComp orders the values: a tag byte puts NULL first,
+// ints and reals follow as big-endian unsigned ints, varchars with 0 escaped and a 0 0 terminator
+static void appendNormalized(std::string &key, const char *field, AttrType type, bool ascending) {
+    size_t begin = key.size();
+    key.push_back(field == nullptr ? 0 : 1);
+    if (field != nullptr && type == TypeVarChar) {
+        int length = *(const int *) field;
+        for (int i = 0; i < length; ++i) {
+            key.push_back(field[sizeof(int) + i]);
+            if (field[sizeof(int) + i] == 0) key.push_back((char) 0xff);
+        }
+        key.append(2, 0);
+    } else if (field != nullptr) {
+        uint32_t u;
+        if (type == TypeReal) {
+            float f = *(const float *) field;
+            if (f == 0) f = 0;      // -0.0 equals 0.0
+            memcpy(&u, &f, sizeof(float));
+            u = (u & 0x80000000u) ? ~u : u | 0x80000000u;
+        } else {
+            u = (uint32_t) *(const int *) field ^ 0x80000000u;
+        }
+        for (int shift = 24; shift >= 0; shift -= 8) key.push_back((char) (u >> shift));
+    }
+    if (!ascending) {
+        for (size_t i = begin; i < key.size(); ++i) key[i] = ~key[i];
+    }
+}
+
+Sort::Sort(Iterator *input, const std::vector<SortKey> &keys, const unsigned limit, const unsigned memoryPages)
+        : input_(input), limit_(limit), memoryBytes_((size_t) std::max(memoryPages, 1u) * PAGE_SIZE),
+          fanIn_(std::max(memoryPages, 3u) - 1) {
+    input_->getAttributes(attrs_);
+    for (auto &key: keys) {
+        int idx = -1;
+        for (int i = 0; i < attrs_.size(); ++i) {
+            if (attrs_[i].name == key.attr) {
+                idx = i; break;
+            }
+        }
+        if (idx < 0) failed_ = true;
+        keyIdx_.push_back(idx);
+        ascending_.push_back(key.ascending);
+    }
+    fieldOffsets_.resize(attrs_.size());
+    prefix_ = tempFilePrefix("sort");
+}
+
+Sort::~Sort() {
+    closeMerge();
+    for (auto &fileName: runNames_) RecordBasedFileManager::instance().destroyFile(fileName);
+}
+
+void Sort::getAttributes(std::vector<Attribute> &attrs) const {
+    attrs = attrs_;
+}
+
+unsigned Sort::normalizeKey(const char *tuple, std::string &key) {
+    int offset = getIndicatorLen(attrs_.size());
+    for (size_t i = 0; i < attrs_.size(); ++i) {
+        if (testBit(tuple, i)) {
+            fieldOffsets_[i] = -1;
+            continue;
+        }
+        fieldOffsets_[i] = offset;
+        offset += attrs_[i].type == TypeVarChar ? sizeof(int) + *(const int *) (tuple + offset) : sizeof(int);
+    }
+    for (size_t k = 0; k < keyIdx_.size(); ++k) {
+        int field = fieldOffsets_[keyIdx_[k]];
+        appendNormalized(key, field < 0 ? nullptr : tuple + field, attrs_[keyIdx_[k]].type, ascending_[k]);
+    }
+    return offset;
+}
+
+bool Sort::entryLess(const Entry &a, const Entry &b) const {
+    int res = compareKeys(arena_.data() + a.offset, a.keyLength, arena_.data() + b.offset, b.keyLength);
+    return res < 0 || (res == 0 && a.seq < b.seq);
+}
+
+void Sort::sortEntries() {
+    std::sort(entries_.begin(), entries_.end(), [this](const Entry &a, const Entry &b) { return entryLess(a, b); });
+}
+
+RC Sort::spillRun() {
+    sortEntries();
+    std::string fileName = prefix_ + std::to_string(numFiles_++);
+    runNames_.push_back(fileName);
+    size_t count = limit_ > 0 ? std::min<size_t>(limit_, entries_.size()) : entries_.size();
+    PartitionWriter writer;
+    RC rc = writer.open({fileName}, attrs_);
+    for (size_t i = 0; i < count && rc == 0; ++i)
+        rc = writer.add(0, arena_.data() + entries_[i].offset + entries_[i].keyLength, entries_[i].tupleLength);
+    RC closed = writer.close();
+    arena_.clear();
+    entries_.clear();
+    return rc == 0 ? closed : rc;
+}
+
+RC Sort::sortInput() {
+    RC rc = 0;
+    std::string key;
+    while (rc == 0 && input_->getNextTuple(databuf_) != QE_EOF) {
+        key.clear();
+        Entry entry;
+        entry.tupleLength = normalizeKey(databuf_, key);
+        entry.offset = arena_.size();
+        entry.keyLength = key.size();
+        entry.seq = seq_++;
+        arena_.insert(arena_.end(), key.begin(), key.end());
+        arena_.insert(arena_.end(), databuf_, databuf_ + entry.tupleLength);
+        entries_.push_back(entry);
+        if (arena_.size() + entries_.size() * sizeof(Entry) <= memoryBytes_) continue;
+        if (limit_ > 0 && entries_.size() > limit_) {
+            // only the first limit tuples can be returned, they stay in memory if they take half of it at most
+            sortEntries();
+            entries_.resize(limit_);
+            std::vector<char> arena;
+            for (auto &e: entries_) {
+                size_t offset = arena.size();
+                arena.insert(arena.end(), arena_.begin() + e.offset,
+                             arena_.begin() + e.offset + e.keyLength + e.tupleLength);
+                e.offset = offset;
+            }
+            arena_.swap(arena);
+            if (arena_.size() + entries_.size() * sizeof(Entry) <= memoryBytes_ / 2) continue;
+        }
+        rc = spillRun();
+    }
+    if (rc != 0) return rc;
+    if (runNames_.empty()) {
+        // it all fits in memory
+        sortEntries();
+        if (limit_ > 0 && entries_.size() > limit_) entries_.resize(limit_);
+        return 0;
+    }
+    if (!entries_.empty()) rc = spillRun();
+    std::vector<char>().swap(arena_);
+    std::vector<Entry>().swap(entries_);
+
+    // merge consecutive runs, fanIn_ at a time, until one merge is left
+    while (rc == 0 && runNames_.size() > fanIn_) {
+        std::vector<std::string> merged;
+        for (size_t i = 0; i < runNames_.size() && rc == 0; i += fanIn_) {
+            std::vector<std::string> fileNames(runNames_.begin() + i,
+                                               runNames_.begin() + std::min<size_t>(i + fanIn_, runNames_.size()));
+            if (fileNames.size() == 1) {
+                merged.push_back(fileNames[0]);
+                continue;
+            }
+            std::string fileName = prefix_ + std::to_string(numFiles_++);
+            merged.push_back(fileName);
+            PartitionWriter writer;
+            rc = writer.open({fileName}, attrs_);
+            if (rc == 0) rc = openMerge(fileNames);
+            for (unsigned count = 0; rc == 0 && !runs_[tree_[0]]->done && (limit_ == 0 || count < limit_); ++count) {
+                rc = writer.add(0, runs_[tree_[0]]->tuple, runs_[tree_[0]]->tupleLength);
+                if (rc == 0) rc = advance();
+            }
+            RC closed = writer.close();
+            if (rc == 0) rc = closed;
+            closeMerge();
+        }
+        if (rc == 0) runNames_.swap(merged);
+        else runNames_.insert(runNames_.end(), merged.begin(), merged.end());
+    }
+    if (rc != 0) return rc;
+    rc = openMerge(runNames_);
+    runNames_.clear();
+    return rc;
+}
+
+RC Sort::readRun(Run &run) {
+    RID rid;
+    if (run.scanner.getNextRecord(rid, run.tuple) == RBFM_EOF) {
+        run.done = true;
+        return 0;
+    }
+    run.key.clear();
+    run.tupleLength = normalizeKey(run.tuple, run.key);
+    return 0;
+}
+
+// a run that is done comes last, ties go to the earlier run, which holds earlier input
+bool Sort::runLess(size_t a, size_t b) const {
+    const Run &runA = *runs_[a], &runB = *runs_[b];
+    if (runA.done || runB.done) return !runA.done || (runB.done && a < b);
+    int res = compareKeys(runA.key.data(), runA.key.size(), runB.key.data(), runB.key.size());
+    return res < 0 || (res == 0 && a < b);
+}
+
+size_t Sort::buildTree(size_t node) {
+    if (node >= runs_.size()) return node - runs_.size();
+    size_t left = buildTree(2 * node), right = buildTree(2 * node + 1);
+    bool leftWins = runLess(left, right);
+    tree_[node] = leftWins ? right : left;
+    return leftWins ? left : right;
+}
+
+RC Sort::openMerge(const std::vector<std::string> &fileNames) {
+    closeMerge();
+    for (auto &fileName: fileNames) {
+        runs_.emplace_back(new Run);
+        runs_.back()->fileName = fileName;
+    }
+    for (auto &run: runs_) {
+        if (scanTempFile(run->fileName, attrs_, run->file, run->scanner) != 0 || readRun(*run) != 0) return -1;
+    }
+    tree_.assign(runs_.size(), 0);
+    tree_[0] = buildTree(1);
+    return 0;
+}
+
+RC Sort::advance() {
+    size_t winner = tree_[0];
+    if (readRun(*runs_[winner]) != 0) return -1;
+    // replay the matches on the way from the winner's leaf to the root
+    for (size_t node = (winner + runs_.size()) / 2; node >= 1; node /= 2) {
+        if (runLess(tree_[node], winner)) std::swap(tree_[node], winner);
+    }
+    tree_[0] = winner;
+    return 0;
+}
+
+void Sort::closeMerge() {
+    auto &rbfm = RecordBasedFileManager::instance();
+    for (auto &run: runs_) {
+        run->scanner.close();
+        rbfm.closeFile(run->file);
+        rbfm.destroyFile(run->fileName);
+    }
+    runs_.clear();
+    tree_.clear();
+}
+
+RC Sort::getNextTuple(void *data) {
+    if (!sorted_) {
+        sorted_ = true;
+        failed_ = failed_ || sortInput() != 0;
+    }
+    if (failed_ || (limit_ > 0 && returned_ >= limit_)) return QE_EOF;
+    if (!runs_.empty()) {
+        const Run &run = *runs_[tree_[0]];
+        if (run.done) return QE_EOF;
+        memcpy(data, run.tuple, run.tupleLength);
+        failed_ = advance() != 0;
+    } else {
+        if (next_ >= entries_.size()) return QE_EOF;
+        const Entry &entry = entries_[next_++];
+        memcpy(data, arena_.data() + entry.offset + entry.keyLength, entry.tupleLength);
+    }
+    returned_++;
+    return 0;
+}
+
+SMJoin::SMJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition, const bool sortInputs,
+               const unsigned memoryPages) : leftIn_(leftIn), rightIn_(rightIn), cond_(condition),
+                                             memoryBytes_((size_t) memoryPages * PAGE_SIZE) {
+    prefix_ = tempFilePrefix("smjoin");
+    if (!cond_.bRhsIsAttr || cond_.op > GE_OP) return;
+    leftIn_->getAttributes(attrs_[0]);
+    rightIn_->getAttributes(attrs_[1]);
+    for (int i = 0; i < attrs_[0].size(); ++i) {
+        if (attrs_[0][i].name == cond_.lhsAttr) {
+            joinIdx_[0] = i; break;
+        }
+    }
+    for (int i = 0; i < attrs_[1].size(); ++i) {
+        if (attrs_[1][i].name == cond_.rhsAttr) {
+            joinIdx_[1] = i; break;
+        }
+    }
+    if (sortInputs) {
+        leftSort_ = new Sort(leftIn_, {{cond_.lhsAttr, true}}, 0, memoryPages);
+        rightSort_ = new Sort(rightIn_, {{cond_.rhsAttr, true}}, 0, memoryPages);
+        leftIn_ = leftSort_;
+        rightIn_ = rightSort_;
+    }
+}
+
+SMJoin::~SMJoin() {
+    delete leftSort_;
+    delete rightSort_;
+    if (spillOpen_) {
+        RecordBasedFileManager::instance().closeFile(spillFile_);
+        RecordBasedFileManager::instance().destroyFile(prefix_ + "window");
+    }
+}
+
+void SMJoin::getAttributes(std::vector<Attribute> &attrs) const {
+    attrs = attrs_[0];
+    attrs.insert(attrs.end(), attrs_[1].begin(), attrs_[1].end());
+}
+
+bool SMJoin::matches(const std::string &rightKey) const {
+    int res = compareKeys(rightKey.data(), rightKey.size(), leftKey_.data(), leftKey_.size());
+    switch (cond_.op) {
+        case EQ_OP: return res == 0;
+        case LT_OP: return res > 0;
+        case LE_OP: return res >= 0;
+        case GT_OP: return res < 0;
+        case GE_OP: return res <= 0;
+        default: return false;
+    }
+}
+
+RC SMJoin::nextLeft() {
+    const Attribute &attr = attrs_[0][joinIdx_[0]];
+    while (leftIn_->getNextTuple(databuf_) != QE_EOF) {
+        leftValues_ = decoupleFieldValues(databuf_, attrs_[0]);
+        if (testBit(leftValues_[0].data(), joinIdx_[0])) continue; // a NULL key joins nothing
+        leftKey_.clear();
+        appendNormalized(leftKey_, leftValues_[joinIdx_[0] + 1].data(), attr.type, true);
+        return 0;
+    }
+    return QE_EOF;
+}
+
+RC SMJoin::pushWindow(Buffered &buffered) {
+    lastKey_ = buffered.key;
+    if (spilled_.empty() && windowBytes_ + buffered.bytes <= memoryBytes_) {
+        windowBytes_ += buffered.bytes;
+        window_.push_back(std::move(buffered));
+        return 0;
+    }
+    // once a tuple is spilled, those after it are too, so that the window stays in order
+    auto &rbfm = RecordBasedFileManager::instance();
+    if (!spillOpen_) {
+        if (rbfm.createFile(prefix_ + "window") < 0 || rbfm.openFile(prefix_ + "window", spillFile_) < 0) return -1;
+        spillOpen_ = true;
+    }
+    RID rid;
+    if (rbfm.insertRecord(spillFile_, attrs_[1], databuf_, rid) < 0) return -1;
+    spilled_.push_back(rid);
+    return 0;
+}
+
+const SMJoin::Buffered *SMJoin::windowAt(size_t i) {
+    if (i < window_.size()) return &window_[i];
+    if (RecordBasedFileManager::instance().readRecord(spillFile_, attrs_[1], spilled_[i - window_.size()],
+                                                      databuf_) < 0)
+        return nullptr;
+    int size = 0;
+    spillBuf_.values = decoupleFieldValues(databuf_, attrs_[1], &size);
+    spillBuf_.key.clear();
+    appendNormalized(spillBuf_.key, spillBuf_.values[joinIdx_[1] + 1].data(), attrs_[1][joinIdx_[1]].type, true);
+    spillBuf_.bytes = sizeof(Buffered) + spillBuf_.key.size() + size;
+    return &spillBuf_;
+}
+
+void SMJoin::popWindow() {
+    if (window_.empty()) {
+        RecordBasedFileManager::instance().deleteRecord(spillFile_, attrs_[1], spilled_.front());
+        spilled_.pop_front();
+        return;
+    }
+    windowBytes_ -= window_.front().bytes;
+    window_.pop_front();
+    if (!window_.empty() || spilled_.empty()) return;
+    // the spilled tuples come back to memory as the front drops
+    while (!spilled_.empty()) {
+        const Buffered *front = windowAt(window_.size());
+        if (front == nullptr) {
+            failed_ = true;
+            return;
+        }
+        if (!window_.empty() && windowBytes_ + front->bytes > memoryBytes_) break;
+        windowBytes_ += front->bytes;
+        window_.push_back(*front);
+        RecordBasedFileManager::instance().deleteRecord(spillFile_, attrs_[1], spilled_.front());
+        spilled_.pop_front();
+    }
+}
+
+void SMJoin::fillWindow() {
+    const Attribute &attr = attrs_[1][joinIdx_[1]];
+    // LT and LE match every right tuple after some point, the others none after the left key
+    bool all = cond_.op == LT_OP || cond_.op == LE_OP;
+    while (!rightDone_) {
+        if (!all && windowSize() > 0 &&
+            compareKeys(lastKey_.data(), lastKey_.size(), leftKey_.data(), leftKey_.size()) > 0)
+            break;
+        if (rightIn_->getNextTuple(databuf_) == QE_EOF) {
+            rightDone_ = true;
+            break;
+        }
+        Buffered buffered;
+        int size = 0;
+        buffered.values = decoupleFieldValues(databuf_, attrs_[1], &size);
+        if (testBit(buffered.values[0].data(), joinIdx_[1])) continue;
+        appendNormalized(buffered.key, buffered.values[joinIdx_[1] + 1].data(), attr.type, true);
+        buffered.bytes = sizeof(Buffered) + buffered.key.size() + size;
+        if (pushWindow(buffered) != 0) {
+            failed_ = true;
+            return;
+        }
+    }
+    // for EQ, LT and LE, the right tuples the left keys have passed match no later left tuple
+    if (cond_.op != EQ_OP && !all) return;
+    while (windowSize() > 0 && !failed_) {
+        const Buffered *front = windowAt(0);
+        if (front == nullptr) {
+            failed_ = true;
+            return;
+        }
+        int res = compareKeys(front->key.data(), front->key.size(), leftKey_.data(), leftKey_.size());
+        if (res > 0 || (res == 0 && cond_.op != LT_OP)) break;
+        popWindow();
+    }
+}
+
+RC SMJoin::getNextTuple(void *data) {
+    if (joinIdx_[0] < 0 || joinIdx_[1] < 0)
+        return QE_EOF;
+    while (!failed_) {
+        if (haveLeft_ && matchIdx_ < windowSize()) {
+            const Buffered *right = windowAt(matchIdx_);
+            if (right == nullptr) {
+                failed_ = true;
+                break;
+            }
+            if (matches(right->key)) {
+                joinValues(data, leftValues_, attrs_[0].size(), right->values, attrs_[1].size());
+                matchIdx_++;
+                return 0;
+            }
+        }
+        if (nextLeft() != 0)
+            return QE_EOF;
+        haveLeft_ = true;
+        fillWindow();
+        matchIdx_ = 0;
+        if (rightDone_ && windowSize() == 0)
+            return QE_EOF;
+    }
+    return QE_EOF;
+}
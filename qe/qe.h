@@ -1,11 +1,19 @@
 #ifndef _qe_h_
 #define _qe_h_
 
+#include <deque>
 #include "../rbf/rbfm.h"
 #include "../rm/rm.h"
 #include "../ix/ix.h"
 
 #define QE_EOF (-1)  // end of the index scan
+#define HEAP_FETCH_BATCH 256 // index entries IndexScan reads before it fetches their tuples
+#define GHJOIN_MEMORY_PAGES 1024 // default memory of the hash table GHJoin builds for one partition
+#define GHJOIN_MAX_LEVEL 3 // times GHJoin partitions a partition again before it builds it as it is
+#define AGGREGATE_MEMORY_PAGES 1024 // default memory of the group table of a grouped Aggregate
+#define AGGREGATE_PARTITIONS 8 // files the groups that don't fit in memory are spilled to
+#define SORT_MEMORY_PAGES 1024 // default memory of the runs Sort builds, a merge takes a page of it per run
+#define BATCH_SIZE 1024 // tuples of a full Batch
 
 void makeTableAttrName(std::string colName, std::string* tableName=nullptr, std::string* attrName=nullptr);
 std::vector<std::vector<char>> decoupleFieldValues(void * data, std::vector<Attribute> attributes, int* size=nullptr);
@@ -24,6 +32,11 @@ struct Value {
     void *data;             // value
 };
 
+struct SortKey {
+    std::string attr;           // rel.attr
+    bool ascending;
+};
+
 struct Condition {
     std::string lhsAttr;        // left-hand side attribute
     CompOp op;                  // comparison operator
@@ -32,11 +45,44 @@ struct Condition {
     Value rhsValue;             // right-hand side value if bRhsIsAttr = FALSE
 };
 
+struct Batch {
+    // Up to BATCH_SIZE tuples stored by column
+    struct Column {
+        AttrType type;
+        std::vector<char> values;           // TypeInt and TypeReal: 4 bytes a tuple, also for NULLs
+        std::vector<unsigned char> nulls;   // bit i % 8 of byte i / 8 is set when the value of tuple i is NULL
+        std::vector<unsigned> offsets;      // TypeVarChar: tuple i takes heap[offsets[i], offsets[i + 1])
+        std::vector<char> heap;
+
+        bool isNull(unsigned i) const { return nulls[i / 8] & (1u << (i % 8)); }
+        const int *ints() const { return (const int *) values.data(); }
+        const float *reals() const { return (const float *) values.data(); }
+    };
+    std::vector<Column> columns;
+    unsigned size = 0;
+
+    // empties the batch, which gets a column for each attribute
+    void reset(const std::vector<Attribute> &attrs);
+    void clear();
+    // appends a tuple of the values of each column, nullptr for NULL, and their lengths; a varchar without its length
+    void append(const char *const *fields, const unsigned *lengths);
+    // appends a tuple in the format of getNextTuple
+    void appendTuple(const void *data);
+    // writes tuple i in the format of getNextTuple, returns its length
+    unsigned getTuple(unsigned i, void *data) const;
+    // makes this batch the tuples rows of from
+    void select(const Batch &from, const std::vector<unsigned> &rows);
+};
+
 class Iterator {
     // All the relational operators and access methods are iterators.
 public:
     virtual RC getNextTuple(void *data) = 0;
 
+    // Fills batch with the next tuples, QE_EOF when there are none left. A consumer uses either this or getNextTuple.
+    // This one collects tuples of getNextTuple, operators that work on columns override it.
+    virtual RC getNextBatch(Batch &batch);
+
     virtual void getAttributes(std::vector<Attribute> &attrs) const = 0;
 
     virtual ~Iterator() = default;
@@ -85,6 +131,15 @@ public:
         return iter->getNextTuple(rid, data);
     };
 
+    // the columns are filled straight from the fields in the pages
+    RC getNextBatch(Batch &batch) override {
+        batch.reset(attrs);
+        iter->getNextTuples(BATCH_SIZE, [&batch](const char *const *fields, const unsigned *lengths) {
+            batch.append(fields, lengths);
+        });
+        return batch.size == 0 ? QE_EOF : 0;
+    };
+
     void getAttributes(std::vector<Attribute> &attributes) const override {
         attributes.clear();
         attributes = this->attrs;
@@ -105,6 +160,19 @@ public:
 
 class IndexScan : public Iterator {
     // A wrapper inheriting Iterator over IX_IndexScan
+    // Entries are read HEAP_FETCH_BATCH at a time and their tuples fetched with RelationManager::readTuples,
+    // which reads each data page once. With keyOrder the tuples come out in key order, otherwise page by page.
+    struct Fetched {
+        RID rid;
+        size_t offset;      // in tuples_
+        unsigned length;
+    };
+    std::vector<RID> rids_;
+    std::vector<char> tuples_;
+    std::vector<Fetched> fetched_;      // the tuples of the batch, in output order
+    size_t next_ = 0;
+
+    RC fetchBatch();
 public:
     RelationManager &rm;
     RM_IndexScanIterator *iter;
@@ -112,10 +180,12 @@ public:
     std::string attrName;
     std::vector<Attribute> attrs;
     char key[PAGE_SIZE]{};
-    RID rid{};
+    RID rid{};          // of the last tuple returned
+    bool keyOrder;
 
-    IndexScan(RelationManager &rm, const std::string &tableName, const std::string &attrName, const char *alias = NULL)
-            : rm(rm) {
+    IndexScan(RelationManager &rm, const std::string &tableName, const std::string &attrName, const char *alias = NULL,
+              bool keyOrder = true)
+            : rm(rm), keyOrder(keyOrder) {
         // Set members
         this->tableName = tableName;
         this->attrName = attrName;
@@ -138,14 +208,17 @@ public:
         delete iter;
         iter = new RM_IndexScanIterator();
         rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, *iter);
+        fetched_.clear();
+        next_ = 0;
     };
 
     RC getNextTuple(void *data) override {
-        int rc = iter->getNextEntry(rid, key);
-        if (rc == 0) {
-            rc = rm.readTuple(tableName, rid, data);
-        }
-        return rc;
+        if (next_ == fetched_.size() && fetchBatch() != 0)
+            return QE_EOF;
+        const Fetched &tuple = fetched_[next_++];
+        rid = tuple.rid;
+        memcpy(data, tuples_.data() + tuple.offset, tuple.length);
+        return 0;
     };
 
     void getAttributes(std::vector<Attribute> &attributes) const override {
@@ -174,6 +247,8 @@ public:
     Condition condition;
     std::vector<Attribute> attributes;
     int lAttrIdx_ = -1;
+    Batch inBatch_;
+    std::vector<unsigned> rows_;
     Filter(Iterator *input,               // Iterator of input R
            const Condition &condition     // Selection condition
     );
@@ -182,6 +257,9 @@ public:
 
     RC getNextTuple(void *data) override;
 
+    // compares the condition column of input batches with the value in a loop of each type
+    RC getNextBatch(Batch &batch) override;
+
     // For attribute in std::vector<Attribute>, name it as rel.attr
     void getAttributes(std::vector<Attribute> &attrs) const override {
         attrs = this->attributes;
@@ -195,12 +273,16 @@ public:
     Iterator *input;
     std::vector<Attribute> attributes;
     std::vector<int> selected_idx_;    
+    Batch inBatch_;
     Project(Iterator *input,                    // Iterator of input R
             const std::vector<std::string> &attrNames);
     ~Project() override = default;
 
     RC getNextTuple(void *data) override;
 
+    // copies the selected columns of input batches
+    RC getNextBatch(Batch &batch) override;
+
     // For attribute in std::vector<Attribute>, name it as rel.attr
     void getAttributes(std::vector<Attribute> &attrs) const override {
         for(int idx: selected_idx_)
@@ -265,37 +347,187 @@ public:
     void getAttributes(std::vector<Attribute> &attrs) const override;
 };
 
+class Sort;
+class SMJoin : public Iterator {
+    // Sort-merge join operator
+    // Both inputs have to come in ascending order of their join attributes, as IndexScan and Sort return them; with
+    // sortInputs they go through a Sort first. The right tuples that can still match are kept in a window. For EQ it
+    // holds the run of right tuples of the current key, replayed for every left tuple of that key. A band join (LT,
+    // LE, GT, GE) matches a suffix or a prefix of the right input, which the window then holds. Past memoryPages the
+    // rest of the window goes to a temporary RBFM file.
+    struct Buffered {
+        std::string key;                // normalized join key
+        DecoupledRecord values;
+        size_t bytes = 0;               // taken in memory
+    };
+    Iterator *leftIn_ = nullptr;
+    Iterator *rightIn_ = nullptr;
+    Sort *leftSort_ = nullptr;
+    Sort *rightSort_ = nullptr;
+    Condition cond_;
+    int joinIdx_[2] = {-1, -1};
+    std::vector<Attribute> attrs_[2];
+    bool rightDone_ = false;
+    bool haveLeft_ = false;
+    DecoupledRecord leftValues_;
+    std::string leftKey_;
+    std::deque<Buffered> window_;       // the front of the window, in the order of the right input
+    size_t windowBytes_ = 0;
+    size_t memoryBytes_;
+    std::string prefix_;
+    FileHandle spillFile_;
+    bool spillOpen_ = false;
+    std::deque<RID> spilled_;           // the rest of the window, in the spill file
+    std::string lastKey_;               // of the last right tuple in the window
+    Buffered spillBuf_;
+    size_t matchIdx_ = 0;
+    bool failed_ = false;
+    char databuf_[PAGE_SIZE];
+
+    bool matches(const std::string &rightKey) const;
+    RC nextLeft();                      // reads the next left tuple with a join key, QE_EOF at the end
+    void fillWindow();                  // reads the right tuples the left tuple may match, drops those it can't
+    size_t windowSize() const { return window_.size() + spilled_.size(); }
+    RC pushWindow(Buffered &buffered);  // the tuple is in databuf_
+    const Buffered *windowAt(size_t i); // nullptr if the spill file can't be read
+    void popWindow();
+public:
+    SMJoin(Iterator *leftIn,            // Iterator of input R
+           Iterator *rightIn,           // Iterator of input S
+           const Condition &condition,  // Join condition, EQ, LT, LE, GT or GE
+           const bool sortInputs = false,   // whether the inputs still have to be sorted on the join attributes
+           const unsigned memoryPages = SORT_MEMORY_PAGES // pages each of those sorts and the window may take
+    );
+
+    ~SMJoin() override;
+
+    RC getNextTuple(void *data) override;
+
+    // For attribute in std::vector<Attribute>, name it as rel.attr
+    void getAttributes(std::vector<Attribute> &attrs) const override;
+};
+
 // Optional for everyone. 10 extra-credit points
 class GHJoin : public Iterator {
     // Grace hash join operator
+    // Both inputs are hashed on the join key into numPartitions temporary RBFM files. Pairs of partitions are then
+    // joined one at a time: the smaller side goes into a hash table, the other side probes it. A side larger than
+    // memoryPages is partitioned again with the next level of the hash, up to GHJOIN_MAX_LEVEL times.
+    struct Partition {
+        std::string fileName[2];        // left, right
+        unsigned bytes[2];
+        unsigned level;
+    };
+    Iterator *leftIn_ = nullptr;
+    Iterator *rightIn_ = nullptr;
+    Condition cond_;
+    unsigned numPartitions_;
+    unsigned memoryBytes_;
+    int joinIdx_[2] = {-1, -1};
+    std::vector<Attribute> attrs_[2];
+    std::string prefix_;                // of the names of the partition files
+    unsigned numFiles_ = 0;
+    bool partitioned_ = false;
+    std::vector<Partition> pending_;    // partitions not joined yet
+    // the pair being joined
+    bool joining_ = false;
+    std::string probeName_;
+    int buildSide_ = 0;
+    std::unordered_map<std::string, std::vector<DecoupledRecord>> hashmap_;
+    FileHandle probeFile_;
+    RBFM_ScanIterator probeScan_;
+    DecoupledRecord probeValues_;
+    std::vector<DecoupledRecord> *matches_ = nullptr;
+    size_t matchIdx_ = 0;
+    char databuf_[PAGE_SIZE];
+
+    // hashes the tuples next returns into the files of side in parts, which are at level
+    RC partition(const std::function<RC(void *)> &next, int side, std::vector<Partition> &parts);
+    RC partitionPair(const std::function<RC(void *)> &left, const std::function<RC(void *)> &right, unsigned level);
+    RC readPartition(const std::string &fileName, int side, const std::function<void(void *)> &func);
+    RC nextPair();                      // start joining the next pending pair, QE_EOF when there is none
+    void endPair();
 public:
     GHJoin(Iterator *leftIn,               // Iterator of input R
            Iterator *rightIn,               // Iterator of input S
            const Condition &condition,      // Join condition (CompOp is always EQ)
-           const unsigned numPartitions     // # of partitions for each relation (decided by the optimizer)
-    ) {};
+           const unsigned numPartitions,    // # of partitions for each relation (decided by the optimizer)
+           const unsigned memoryPages = GHJOIN_MEMORY_PAGES // pages the hash table of one partition may take
+    );
 
-    ~GHJoin() override = default;
+    ~GHJoin() override;
 
-    RC getNextTuple(void *data) override { return QE_EOF; };
+    RC getNextTuple(void *data) override;
 
     // For attribute in std::vector<Attribute>, name it as rel.attr
-    void getAttributes(std::vector<Attribute> &attrs) const override {};
+    void getAttributes(std::vector<Attribute> &attrs) const override;
+};
+
+class GroupTable {
+    // The groups of a hash aggregation. Keys are packed one after another in an arena, the groups refer to them by
+    // offset, and an open addressing table with linear probing maps a key to its group.
+public:
+    struct Group {
+        size_t offset;                  // of the key in the arena
+        unsigned length;
+        uint32_t hash;
+        unsigned count = 0;             // of the values aggregated, NULLs left out
+        double min = 0, max = 0, sum = 0;
+    };
+private:
+    std::vector<char> arena_;
+    std::vector<Group> groups_;         // in the order they were added
+    std::vector<uint32_t> slots_;       // index + 1 of a group, 0 when empty
+    size_t memoryBytes_ = 0;
+
+    void place(uint32_t index);
+public:
+    // drops all groups, the table may take memoryBytes from now on
+    void reset(size_t memoryBytes);
+    // the group of key, added when insert is set; nullptr when there is none, or adding it would take the table over
+    // its memory. The first group is always added.
+    Group *find(const char *key, unsigned length, uint32_t hash, bool insert);
+    size_t size() const { return groups_.size(); }
+    Group &at(size_t i) { return groups_[i]; }
+    const char *key(const Group &group) const { return arena_.data() + group.offset; }
 };
 
 class Aggregate : public Iterator {
     // Aggregation operator
+    // The input is read a Batch at a time and aggregated column by column.
+    // Grouped, it is a hash aggregation: groups go into a GroupTable until it is out of memory. The tuples of groups
+    // that don't fit are spilled to AGGREGATE_PARTITIONS temporary files, which are aggregated one at a time after the
+    // groups in memory are returned.
+    struct Spill {
+        std::string fileName;
+        unsigned level;
+    };
     Iterator* input_;
     Attribute aggAttr_;
     AggregateOp aggOp_;
     bool finish_ = false;
     int AttrIdx_ = -1;
     std::vector<Attribute> attributes;
-    RC getCount(void *data);
-    RC getMax(void *data);
-    RC getMin(void *data);
-    RC getSum(void *data);
-    RC getAvg(void *data);
+    // GROUP BY
+    bool grouped_ = false;
+    Attribute groupAttr_;
+    int groupIdx_ = -1;
+    size_t memoryBytes_ = 0;
+    bool aggregated_ = false;
+    GroupTable groups_;
+    size_t emitted_ = 0;                // groups returned from groups_
+    std::vector<Attribute> spillAttrs_; // the group and the aggregated attribute
+    std::string prefix_;                // of the names of the spill files
+    unsigned numFiles_ = 0;
+    std::vector<Spill> pending_;        // spill files not aggregated yet
+    char databuf_[PAGE_SIZE];
+
+    Batch batch_;
+
+    RC aggregate(void *data);           // the aggregate of all input tuples
+    // aggregates the batches next returns into groups_, spilling the tuples of groups that don't fit to level + 1
+    RC aggregateGroups(const std::function<RC(Batch &)> &next, int groupIdx, int aggIdx, unsigned level);
+    void emitGroup(const GroupTable::Group &group, void *data);
 public:
     // Mandatory
     // Basic aggregation
@@ -309,10 +541,11 @@ public:
     Aggregate(Iterator *input,             // Iterator of input R
               const Attribute &aggAttr,           // The attribute over which we are computing an aggregate
               const Attribute &groupAttr,         // The attribute over which we are grouping the tuples
-              AggregateOp op              // Aggregate operation
-    ) {};
+              AggregateOp op,             // Aggregate operation
+              const unsigned memoryPages = AGGREGATE_MEMORY_PAGES // pages the groups in memory may take
+    );
 
-    ~Aggregate() override = default;
+    ~Aggregate() override;
 
     RC getNextTuple(void *data) override;
 
@@ -322,4 +555,79 @@ public:
     void getAttributes(std::vector<Attribute> &attrs) const override;
 };
 
+class Sort : public Iterator {
+    // External merge sort operator
+    // Input tuples are buffered up to memoryPages, ordered, and written as runs to temporary RBFM files. The runs are
+    // merged with a loser tree, memoryPages - 1 of them at a time, until a single merge returns the output; input that
+    // fits in memory is returned from there without any file. Tuples are compared by normalized keys, the sort
+    // attributes encoded so that memcmp orders them the way applyComp does (NULL first), with descending attributes
+    // inverted. Ties keep the input order.
+    // With a limit, only the first limit tuples are returned and a run keeps only its first limit tuples. A full buffer
+    // is cut to its first limit tuples rather than written out, as long as they take at most half of the memory.
+    struct Entry {
+        size_t offset;                  // of the key, the tuple follows it
+        unsigned keyLength;
+        unsigned tupleLength;
+        unsigned long long seq;         // position in the input
+    };
+    struct Run {
+        std::string fileName;
+        FileHandle file;
+        RBFM_ScanIterator scanner;
+        std::string key;
+        unsigned tupleLength = 0;
+        bool done = false;
+        char tuple[PAGE_SIZE];
+    };
+    Iterator *input_;
+    std::vector<Attribute> attrs_;
+    std::vector<int> keyIdx_;
+    std::vector<bool> ascending_;
+    std::vector<int> fieldOffsets_;     // of the fields of the tuple being normalized, -1 for NULLs
+    unsigned limit_;                    // 0 for no limit
+    size_t memoryBytes_;
+    unsigned fanIn_;
+    bool sorted_ = false;
+    bool failed_ = false;
+    unsigned returned_ = 0;
+    // tuples in memory
+    std::vector<char> arena_;
+    std::vector<Entry> entries_;
+    unsigned long long seq_ = 0;
+    size_t next_ = 0;
+    // runs
+    std::string prefix_;                // of the names of the run files
+    unsigned numFiles_ = 0;
+    std::vector<std::string> runNames_; // runs not merged yet
+    std::vector<std::unique_ptr<Run>> runs_;    // runs being merged
+    std::vector<size_t> tree_;          // the loser tree over runs_, tree_[0] is the winner
+    char databuf_[PAGE_SIZE];
+
+    // appends the normalized key of tuple to key, returns the length of the tuple
+    unsigned normalizeKey(const char *tuple, std::string &key);
+    bool entryLess(const Entry &a, const Entry &b) const;
+    void sortEntries();
+    RC spillRun();                      // writes the buffered tuples as a run
+    RC sortInput();
+    RC openMerge(const std::vector<std::string> &fileNames);
+    RC readRun(Run &run);
+    bool runLess(size_t a, size_t b) const;
+    size_t buildTree(size_t node);      // returns the winner below node
+    RC advance();                       // moves the winner to its next tuple
+    void closeMerge();
+public:
+    Sort(Iterator *input,                   // Iterator of input R
+         const std::vector<SortKey> &keys,  // The attributes to order by, the first one first
+         const unsigned limit = 0,          // Tuples to return, 0 for all of them
+         const unsigned memoryPages = SORT_MEMORY_PAGES // pages the tuples of a run may take
+    );
+
+    ~Sort() override;
+
+    RC getNextTuple(void *data) override;
+
+    // For attribute in std::vector<Attribute>, name it as rel.attr
+    void getAttributes(std::vector<Attribute> &attrs) const override;
+};
+
 #endif
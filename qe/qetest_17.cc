@@ -0,0 +1,139 @@
+#include <chrono>
+#include "qe_test_util.h"
+
+static const int heapTupleCount = 20000;
+
+// tuple i has A = i, B = i * 7919 % heapTupleCount and C = i + 0.5, so B is far from the order of the pages
+static int createHeapTable() {
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+
+    rm.deleteTable("heapfetch");
+    RC rc = rm.createTable("heapfetch", attrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+
+    unsigned char nullsIndicator = 0;
+    char buf[bufSize];
+    RID rid;
+    for (int i = 0; i < heapTupleCount; ++i) {
+        prepareLeftTuple(attrs.size(), &nullsIndicator, i, (int) ((long) i * 7919 % heapTupleCount),
+                         (float) i + 0.5f, buf);
+        rc = rm.insertTuple("heapfetch", buf, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+    return rm.createIndex("heapfetch", "B");
+}
+
+// a tuple whose fields don't belong together
+static bool wrongTuple(const char *data) {
+    int a = *(int *) (data + 1), b = *(int *) (data + 5);
+    float c = *(float *) (data + 9);
+    return data[0] != 0 || b != (int) ((long) a * 7919 % heapTupleCount) || c != (float) a + 0.5f;
+}
+
+RC testCase_17() {
+    // Index scan with the tuples fetched page by page
+    // 1. IndexScan in key order - **the tuples of a batch are read with one read of each data page**
+    // 2. IndexScan in page order - the same tuples, page by page within a batch
+    // 3. A range of keys with setIterator
+    // SELECT * FROM heapfetch ORDER BY B
+    std::cerr << std::endl << "***** In QE Test Case 17 *****" << std::endl;
+
+    RC rc = createHeapTable();
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    char data[bufSize];
+
+    // the way IndexScan read its tuples before, one readTuple per entry
+    auto start = std::chrono::steady_clock::now();
+    RM_IndexScanIterator rmisi;
+    rc = rm.indexScan("heapfetch", "B", NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    RID rid;
+    int key, count = 0;
+    while (rmisi.getNextEntry(rid, &key) != RM_EOF && rm.readTuple("heapfetch", rid, data) == success)
+        count++;
+    rmisi.close();
+    double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    auto *is = new IndexScan(rm, "heapfetch", "B");
+    count = 0;
+    while (is->getNextTuple(data) != QE_EOF) {
+        if (wrongTuple(data) || *(int *) (data + 5) != count) {
+            std::cerr << "***** [FAIL] Wrong tuple at " << count << " in key order *****" << std::endl;
+            delete is;
+            return fail;
+        }
+        count++;
+    }
+    double batched = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "seconds to read " << count << " tuples in key order: one by one " << single << ", by pages "
+              << batched << std::endl;
+    if (count != heapTupleCount) {
+        std::cerr << "***** [FAIL] " << count << " tuples in key order *****" << std::endl;
+        delete is;
+        return fail;
+    }
+
+    // a range of keys, 1000 <= B < 3000
+    int low = 1000, high = 3000;
+    is->setIterator(&low, &high, true, false);
+    count = 0;
+    while (is->getNextTuple(data) != QE_EOF) {
+        if (wrongTuple(data) || *(int *) (data + 5) != low + count) rc = fail;
+        count++;
+    }
+    delete is;
+    if (rc != success || count != high - low) {
+        std::cerr << "***** [FAIL] Wrong tuples in the range, " << count << " of them *****" << std::endl;
+        return fail;
+    }
+
+    // in page order every batch goes through its pages once
+    is = new IndexScan(rm, "heapfetch", "B", NULL, false);
+    std::vector<bool> seen(heapTupleCount);
+    RID prev{};
+    count = 0;
+    while (is->getNextTuple(data) != QE_EOF) {
+        int b = *(int *) (data + 5);
+        bool ordered = count % HEAP_FETCH_BATCH == 0 || prev.pageNum < is->rid.pageNum ||
+                       (prev.pageNum == is->rid.pageNum && prev.slotNum < is->rid.slotNum);
+        if (wrongTuple(data) || seen[b] || !ordered) {
+            std::cerr << "***** [FAIL] Wrong tuple at " << count << " in page order *****" << std::endl;
+            delete is;
+            return fail;
+        }
+        seen[b] = true;
+        prev = is->rid;
+        count++;
+    }
+    delete is;
+    if (count != heapTupleCount) {
+        std::cerr << "***** [FAIL] " << count << " tuples in page order *****" << std::endl;
+        return fail;
+    }
+
+    rc = rm.deleteTable("heapfetch");
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    return success;
+}
+
+int main() {
+
+    if (testCase_17() != success) {
+        std::cerr << "***** [FAIL] QE Test Case 17 failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case 17 finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
@@ -0,0 +1,121 @@
+#include <dirent.h>
+#include "qe_test_util.h"
+
+static const int ghTupleCount = 20000;
+
+// tuple i has A = i, B = i % keys and C = i + 0.5
+static int createKeyTable(const std::string &tableName, int keys) {
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+
+    rm.deleteTable(tableName);
+    RC rc = rm.createTable(tableName, attrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+
+    unsigned char nullsIndicator = 0;
+    char buf[bufSize];
+    std::vector<char> tuples(ghTupleCount * bufSize);
+    std::vector<const void *> data;
+    std::vector<RID> rids;
+    for (int i = 0; i < ghTupleCount; ++i) {
+        prepareLeftTuple(attrs.size(), &nullsIndicator, i, i % keys, (float) i + 0.5f, buf);
+        memcpy(tuples.data() + i * bufSize, buf, bufSize);
+        data.push_back(tuples.data() + i * bufSize);
+    }
+    return rm.insertTuples(tableName, data, rids);
+}
+
+// partition files left in the directory
+static int partitionFiles() {
+    int count = 0;
+    DIR *dir = opendir(".");
+    while (struct dirent *entry = readdir(dir)) {
+        count += strncmp(entry->d_name, "ghjoin_", 7) == 0;
+    }
+    closedir(dir);
+    return count;
+}
+
+RC testCase_18() {
+    // GHJoin of partitions larger than its memory
+    // 1. GHJoin -- on TypeInt attribute, both sides with duplicated keys
+    //    **a partition that doesn't fit in memoryPages is partitioned again**
+    // 2. The partition files are gone after the join, and after a join stopped halfway
+    // SELECT * FROM ghleft, ghright WHERE ghleft.B = ghright.B
+    std::cerr << std::endl << "***** In QE Test Case 18 *****" << std::endl;
+
+    // keys below 4000 meet 4 tuples of ghleft and 5 of ghright
+    RC rc = createKeyTable("ghleft", 5000);
+    assert(rc == success && "RelationManager::insertTuples() should not fail.");
+    rc = createKeyTable("ghright", 4000);
+    assert(rc == success && "RelationManager::insertTuples() should not fail.");
+    int expectedResultCnt = 4000 * 4 * 5;
+
+    Condition cond;
+    cond.lhsAttr = "ghleft.B";
+    cond.op = EQ_OP;
+    cond.bRhsIsAttr = true;
+    cond.rhsAttr = "ghright.B";
+
+    // one page of memory for a partition of about 50 pages
+    auto *leftIn = new TableScan(rm, "ghleft");
+    auto *rightIn = new TableScan(rm, "ghright");
+    auto *ghJoin = new GHJoin(leftIn, rightIn, cond, 4, 1);
+    char data[bufSize];
+    int count = 0, files = 0;
+    while (ghJoin->getNextTuple(data) != QE_EOF) {
+        if (count == 0) files = partitionFiles();
+        int leftA = *(int *) (data + 1), leftB = *(int *) (data + 5);
+        int rightA = *(int *) (data + 13), rightB = *(int *) (data + 17);
+        if (data[0] != 0 || leftB != leftA % 5000 || rightB != rightA % 4000 || leftB != rightB) {
+            std::cerr << "***** [FAIL] Wrong tuple " << leftA << ", " << rightA << " *****" << std::endl;
+            rc = fail;
+            break;
+        }
+        count++;
+    }
+    delete ghJoin;
+    std::cerr << "partition files during the join: " << files << ", results: " << count << std::endl;
+    if (rc != success || count != expectedResultCnt || files == 0 || partitionFiles() != 0) {
+        std::cerr << "***** [FAIL] The join should return " << expectedResultCnt
+                  << " tuples and leave no files behind *****" << std::endl;
+        rc = fail;
+    }
+
+    // a join deleted halfway cleans up as well
+    leftIn->setIterator();
+    rightIn->setIterator();
+    ghJoin = new GHJoin(leftIn, rightIn, cond, 4, 1);
+    for (count = 0; count < 100 && ghJoin->getNextTuple(data) != QE_EOF; count++);
+    delete ghJoin;
+    if (count != 100 || partitionFiles() != 0) {
+        std::cerr << "***** [FAIL] A stopped join should leave no files behind *****" << std::endl;
+        rc = fail;
+    }
+
+    delete leftIn;
+    delete rightIn;
+    rm.deleteTable("ghleft");
+    rm.deleteTable("ghright");
+    return rc;
+}
+
+int main() {
+
+    if (testCase_18() != success) {
+        std::cerr << "***** [FAIL] QE Test Case 18 failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case 18 finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
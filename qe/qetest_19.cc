@@ -0,0 +1,152 @@
+#include <dirent.h>
+#include "qe_test_util.h"
+
+static const int groupCount = 3000;
+static const int groupSize = 10;
+
+// tuple i has A = i, B = i % groupCount and C = i + 0.5, A is NULL in group 7;
+// groupSize more tuples have A = 1 and B NULL
+static int createSpillTable() {
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+
+    rm.deleteTable("aggspill");
+    RC rc = rm.createTable("aggspill", attrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+
+    char buf[bufSize];
+    RID rid;
+    for (int i = 0; i < groupCount * groupSize + groupSize; ++i) {
+        unsigned char nullsIndicator = 0;
+        if (i >= groupCount * groupSize) nullsIndicator = 1u << 6u;
+        else if (i % groupCount == 7) nullsIndicator = 1u << 7u;
+        int a = i >= groupCount * groupSize ? 1 : i;
+        prepareLeftTuple(attrs.size(), &nullsIndicator, a, i % groupCount, (float) i + 0.5f, buf);
+        rc = rm.insertTuple("aggspill", buf, rid);
+        if (rc != success) return rc;
+    }
+    return success;
+}
+
+// spill files left in the directory
+static int spillFiles() {
+    int count = 0;
+    DIR *dir = opendir(".");
+    while (struct dirent *entry = readdir(dir)) {
+        count += strncmp(entry->d_name, "aggregate_", 10) == 0;
+    }
+    closedir(dir);
+    return count;
+}
+
+// the aggregate of group b, false when it is NULL
+static bool expected(AggregateOp op, int b, float &value) {
+    if (b == 7 && op != COUNT) return false;
+    int first = b < 0 ? 1 : b, step = b < 0 ? 0 : groupCount;
+    switch (op) {
+        case MIN: value = first; break;
+        case MAX: value = first + step * (groupSize - 1); break;
+        case COUNT: value = b == 7 ? 0 : groupSize; break;
+        case SUM: value = first * groupSize + step * groupSize * (groupSize - 1) / 2; break;
+        case AVG: value = first + step * (groupSize - 1) / 2.0f; break;
+    }
+    return true;
+}
+
+// runs op over aggspill grouped by B, checking every group is returned once with its aggregate
+static RC aggregateGroups(AggregateOp op, unsigned memoryPages, int &files) {
+    Attribute aggAttr;
+    aggAttr.name = "aggspill.A";
+    aggAttr.type = TypeInt;
+    aggAttr.length = 4;
+    Attribute gAttr;
+    gAttr.name = "aggspill.B";
+    gAttr.type = TypeInt;
+    gAttr.length = 4;
+
+    auto *input = new TableScan(rm, "aggspill");
+    auto *agg = new Aggregate(input, aggAttr, gAttr, op, memoryPages);
+    std::vector<bool> seen(groupCount + 1);
+    char data[bufSize];
+    int count = 0;
+    RC rc = success;
+    files = 0;
+    while (agg->getNextTuple(data) != QE_EOF) {
+        if (count == 0) files = spillFiles();
+        // a NULL group has no value before the aggregate
+        bool groupNull = (data[0] & 0x80) != 0, valueNull = (data[0] & 0x40) != 0;
+        int b = groupNull ? -1 : *(int *) (data + 1);
+        float value = *(float *) (data + (groupNull ? 1 : 5)), expectedValue = 0;
+        bool notNull = b < groupCount && expected(op, b, expectedValue);
+        if (b >= groupCount || seen[b + 1] || valueNull == notNull || (notNull && value != expectedValue)) {
+            std::cerr << "***** [FAIL] Wrong aggregate " << value << " of group " << b << " *****" << std::endl;
+            rc = fail;
+            break;
+        }
+        seen[b + 1] = true;
+        count++;
+    }
+    delete agg;
+    delete input;
+    if (rc == success && count != groupCount + 1) {
+        std::cerr << "***** [FAIL] " << count << " groups returned *****" << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+RC testCase_19() {
+    // Group-based hash aggregation with more groups than fit in memory
+    // 1. Aggregate -- MIN, MAX, COUNT, SUM, AVG (with GroupBy), a NULL group and a group of NULL values
+    //    **the groups that don't fit in memoryPages are spilled to files and aggregated afterwards**
+    // 2. The spill files are gone after the aggregation
+    // SELECT aggspill.B, op(aggspill.A) FROM aggspill GROUP BY aggspill.B
+    std::cerr << std::endl << "***** In QE Test Case 19 *****" << std::endl;
+
+    RC rc = createSpillTable();
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+
+    int files;
+    const AggregateOp ops[] = {MIN, MAX, COUNT, SUM, AVG};
+    for (AggregateOp op: ops) {
+        rc = aggregateGroups(op, 1, files);
+        if (rc != success || files == 0 || spillFiles() != 0) {
+            std::cerr << "***** [FAIL] Aggregate " << op << " in one page, spill files during the aggregation: "
+                      << files << ", after: " << spillFiles() << " *****" << std::endl;
+            rc = fail;
+            break;
+        }
+    }
+
+    // all groups fit in the default memory
+    if (rc == success) {
+        rc = aggregateGroups(AVG, AGGREGATE_MEMORY_PAGES, files);
+        if (rc == success && files != 0) {
+            std::cerr << "***** [FAIL] Groups that fit in memory should not be spilled *****" << std::endl;
+            rc = fail;
+        }
+    }
+
+    rm.deleteTable("aggspill");
+    return rc;
+}
+
+int main() {
+
+    if (testCase_19() != success) {
+        std::cerr << "***** [FAIL] QE Test Case 19 failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case 19 finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
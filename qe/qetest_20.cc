@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <dirent.h>
+#include "qe_test_util.h"
+
+static const int sortTupleCount = 20000;
+
+struct Row {
+    int a, b;
+    bool cNull;
+    float c;
+    std::string d;
+};
+
+// tuple i has A = i, B = i * 7919 % 1000, C from -250 to 250 (some of its zeros -0.0, NULL when i % 50 == 3)
+// and D = "k" followed by i * 13 % 101, so some values of D are prefixes of others
+static Row makeRow(int i) {
+    Row row;
+    row.a = i;
+    row.b = (int) ((long) i * 7919 % 1000);
+    row.cNull = i % 50 == 3;
+    row.c = (float) ((i * 31) % 2001 - 1000) / 4;
+    if (row.c == 0 && i % 2 == 1) row.c = -0.0f;
+    row.d = "k" + std::to_string(i * 13 % 101);
+    return row;
+}
+
+static int createSortTable(std::vector<Row> &rows) {
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+    attr.name = "D";
+    attr.type = TypeVarChar;
+    attr.length = 10;
+    attrs.push_back(attr);
+
+    rm.deleteTable("sortin");
+    RC rc = rm.createTable("sortin", attrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+
+    char buf[bufSize];
+    RID rid;
+    for (int i = 0; i < sortTupleCount; ++i) {
+        Row row = makeRow(i);
+        rows.push_back(row);
+        int offset = 1;
+        buf[0] = row.cNull ? (char) (1u << 5u) : 0;
+        memcpy(buf + offset, &row.a, sizeof(int));
+        offset += sizeof(int);
+        memcpy(buf + offset, &row.b, sizeof(int));
+        offset += sizeof(int);
+        if (!row.cNull) {
+            memcpy(buf + offset, &row.c, sizeof(float));
+            offset += sizeof(float);
+        }
+        int length = row.d.size();
+        memcpy(buf + offset, &length, sizeof(int));
+        memcpy(buf + offset + sizeof(int), row.d.data(), length);
+        rc = rm.insertTuple("sortin", buf, rid);
+        if (rc != success) return rc;
+    }
+    return success;
+}
+
+static Row parseRow(const char *data) {
+    Row row;
+    int offset = 1;
+    row.a = *(int *) (data + offset);
+    offset += sizeof(int);
+    row.b = *(int *) (data + offset);
+    offset += sizeof(int);
+    row.cNull = (data[0] & (1u << 5u)) != 0;
+    row.c = 0;
+    if (!row.cNull) {
+        row.c = *(float *) (data + offset);
+        offset += sizeof(float);
+    }
+    row.d = std::string(data + offset + sizeof(int), *(int *) (data + offset));
+    return row;
+}
+
+// sort files left in the directory
+static int sortFiles() {
+    int count = 0;
+    DIR *dir = opendir(".");
+    while (struct dirent *entry = readdir(dir)) {
+        count += strncmp(entry->d_name, "sort_", 5) == 0;
+    }
+    closedir(dir);
+    return count;
+}
+
+// sorts sortin by keys and compares the output with rows ordered by less
+static RC checkSort(const std::vector<Row> &rows, const std::vector<SortKey> &keys, unsigned limit,
+                    unsigned memoryPages, const std::function<bool(const Row &, const Row &)> &less, int &files) {
+    std::vector<Row> expected = rows;
+    std::stable_sort(expected.begin(), expected.end(), less);
+    if (limit > 0 && expected.size() > limit) expected.resize(limit);
+
+    auto *input = new TableScan(rm, "sortin");
+    auto *sort = new Sort(input, keys, limit, memoryPages);
+    char data[bufSize];
+    size_t count = 0;
+    RC rc = success;
+    files = 0;
+    while (sort->getNextTuple(data) != QE_EOF) {
+        if (count == 0) files = sortFiles();
+        Row row = parseRow(data);
+        if (count >= expected.size() || row.a != expected[count].a) {
+            std::cerr << "***** [FAIL] Tuple " << row.a << " at " << count << " is out of order *****" << std::endl;
+            rc = fail;
+            break;
+        }
+        count++;
+    }
+    delete sort;
+    delete input;
+    if (rc == success && count != expected.size()) {
+        std::cerr << "***** [FAIL] " << count << " tuples returned, not " << expected.size() << " *****" << std::endl;
+        rc = fail;
+    }
+    if (sortFiles() != 0) {
+        std::cerr << "***** [FAIL] The runs should be gone after the sort *****" << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+RC testCase_20() {
+    // External merge sort
+    // 1. ORDER BY int ASC, real DESC - **runs of a few pages, merged in more than one pass**
+    // 2. ORDER BY varchar ASC, int DESC - in memory, without any run
+    // 3. ORDER BY real ASC LIMIT 500 - **the first 500 tuples are kept in memory instead of spilled**
+    // 4. The same limit with runs
+    // NULL comes before any value, -0.0 equals 0.0
+    std::cerr << std::endl << "***** In QE Test Case 20 *****" << std::endl;
+
+    std::vector<Row> rows;
+    RC rc = createSortTable(rows);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+
+    // ascending real with NULL first
+    auto cLess = [](const Row &x, const Row &y) { return !y.cNull && (x.cNull || x.c < y.c); };
+    int files;
+
+    // SELECT * FROM sortin ORDER BY B, C DESC, A
+    rc = checkSort(rows, {{"sortin.B", true}, {"sortin.C", false}, {"sortin.A", true}}, 0, 4,
+                   [&](const Row &x, const Row &y) {
+                       if (x.b != y.b) return x.b < y.b;
+                       if (cLess(y, x) || cLess(x, y)) return cLess(y, x);
+                       return x.a < y.a;
+                   }, files);
+    if (rc != success || files < 2) {
+        std::cerr << "***** [FAIL] Sort in 4 pages, " << files << " runs *****" << std::endl;
+        rc = fail;
+    }
+
+    // SELECT * FROM sortin ORDER BY D, A DESC
+    if (rc == success) {
+        rc = checkSort(rows, {{"sortin.D", true}, {"sortin.A", false}}, 0, SORT_MEMORY_PAGES,
+                       [](const Row &x, const Row &y) { return x.d != y.d ? x.d < y.d : x.a > y.a; }, files);
+        if (rc != success || files != 0) {
+            std::cerr << "***** [FAIL] Sort in memory, " << files << " runs *****" << std::endl;
+            rc = fail;
+        }
+    }
+
+    // SELECT * FROM sortin ORDER BY C, A LIMIT 500
+    auto limitLess = [&](const Row &x, const Row &y) {
+        if (cLess(y, x) || cLess(x, y)) return cLess(x, y);
+        return x.a < y.a;
+    };
+    if (rc == success) {
+        rc = checkSort(rows, {{"sortin.C", true}, {"sortin.A", true}}, 500, 32, limitLess, files);
+        if (rc != success || files != 0) {
+            std::cerr << "***** [FAIL] Top 500 in 32 pages, " << files << " runs *****" << std::endl;
+            rc = fail;
+        }
+    }
+    if (rc == success) {
+        rc = checkSort(rows, {{"sortin.C", true}, {"sortin.A", true}}, 500, 4, limitLess, files);
+        if (rc != success || files == 0) {
+            std::cerr << "***** [FAIL] Top 500 in 4 pages, " << files << " runs *****" << std::endl;
+            rc = fail;
+        }
+    }
+
+    rm.deleteTable("sortin");
+    return rc;
+}
+
+int main() {
+
+    if (testCase_20() != success) {
+        std::cerr << "***** [FAIL] QE Test Case 20 failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case 20 finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
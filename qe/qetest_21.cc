@@ -0,0 +1,173 @@
+#include <dirent.h>
+#include "qe_test_util.h"
+
+static const int smLeftCount = 1000;
+static const int smRightCount = 800;
+
+// tuple i of smleft has A = i, B = i % 250 and C = i + 0.5, B is NULL when i % 100 == 99;
+// tuple i of smright has A = i, B = i * 7 % 200 and C = i + 0.5
+static int leftKey(int i) { return i % 100 == 99 ? -1 : i % 250; }
+
+static int rightKey(int i) { return i * 7 % 200; }
+
+static int createSMTable(const std::string &tableName, int count, int (*key)(int)) {
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+
+    rm.deleteTable(tableName);
+    RC rc = rm.createTable(tableName, attrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+
+    char buf[bufSize];
+    RID rid;
+    for (int i = 0; i < count; ++i) {
+        unsigned char nullsIndicator = key(i) < 0 ? 1u << 6u : 0;
+        prepareLeftTuple(attrs.size(), &nullsIndicator, i, key(i), (float) i + 0.5f, buf);
+        rc = rm.insertTuple(tableName, buf, rid);
+        if (rc != success) return rc;
+    }
+    return rm.createIndex(tableName, "B");
+}
+
+// window files left in the directory
+static int windowFiles() {
+    int count = 0;
+    DIR *dir = opendir(".");
+    while (struct dirent *entry = readdir(dir)) {
+        count += strncmp(entry->d_name, "smjoin_", 7) == 0;
+    }
+    closedir(dir);
+    return count;
+}
+
+static bool compare(CompOp op, int left, int right) {
+    switch (op) {
+        case EQ_OP: return left == right;
+        case LT_OP: return left < right;
+        case LE_OP: return left <= right;
+        case GT_OP: return left > right;
+        case GE_OP: return left >= right;
+        default: return false;
+    }
+}
+
+// joins smleft and smright on B with op, checking every result against the condition and their number
+static RC checkJoin(Iterator *leftIn, Iterator *rightIn, CompOp op, bool sortInputs, unsigned memoryPages = 4) {
+    Condition cond;
+    cond.lhsAttr = "smleft.B";
+    cond.op = op;
+    cond.bRhsIsAttr = true;
+    cond.rhsAttr = "smright.B";
+
+    long expectedResultCnt = 0;
+    for (int i = 0; i < smLeftCount; ++i) {
+        for (int j = 0; j < smRightCount; ++j) {
+            expectedResultCnt += leftKey(i) >= 0 && compare(op, leftKey(i), rightKey(j));
+        }
+    }
+
+    auto *smJoin = new SMJoin(leftIn, rightIn, cond, sortInputs, memoryPages);
+    char data[bufSize];
+    long count = 0;
+    int prevLeftB = -1;
+    RC rc = success;
+    while (smJoin->getNextTuple(data) != QE_EOF) {
+        int leftA = *(int *) (data + 1), leftB = *(int *) (data + 5);
+        int rightA = *(int *) (data + 13), rightB = *(int *) (data + 17);
+        // the results follow the order of the left join key
+        if (data[0] != 0 || leftB != leftKey(leftA) || rightB != rightKey(rightA) || !compare(op, leftB, rightB) ||
+            leftB < prevLeftB) {
+            std::cerr << "***** [FAIL] Wrong tuple " << leftA << ", " << rightA << " *****" << std::endl;
+            rc = fail;
+            break;
+        }
+        prevLeftB = leftB;
+        count++;
+    }
+    // a window of one page doesn't hold the right tuples a band join keeps
+    if (rc == success && memoryPages == 1 && windowFiles() != 1) {
+        std::cerr << "***** [FAIL] The window should be spilled *****" << std::endl;
+        rc = fail;
+    }
+    delete smJoin;
+    if (rc == success && windowFiles() != 0) {
+        std::cerr << "***** [FAIL] The window file should be gone *****" << std::endl;
+        rc = fail;
+    }
+    if (rc == success && count != expectedResultCnt) {
+        std::cerr << "***** [FAIL] The join should return " << expectedResultCnt << " tuples, not " << count
+                  << " *****" << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+RC testCase_21() {
+    // Sort-merge join
+    // 1. SMJoin -- EQ on IndexScans, duplicated keys on both sides - **the run of a right key is replayed**
+    // 2. SMJoin -- EQ on TableScans sorted by the join
+    // 3. SMJoin -- LT, LE, GT, GE band joins on TableScans sorted by the join
+    // 4. SMJoin -- LT and GE band joins on IndexScans in one page - **the window spills to a file, which is
+    //    gone after the join**
+    // NULL keys join nothing
+    // SELECT * FROM smleft, smright WHERE smleft.B op smright.B
+    std::cerr << std::endl << "***** In QE Test Case 21 *****" << std::endl;
+
+    RC rc = createSMTable("smleft", smLeftCount, leftKey);
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    rc = createSMTable("smright", smRightCount, rightKey);
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    auto *leftIndex = new IndexScan(rm, "smleft", "B");
+    auto *rightIndex = new IndexScan(rm, "smright", "B");
+    rc = checkJoin(leftIndex, rightIndex, EQ_OP, false);
+    delete leftIndex;
+    delete rightIndex;
+
+    const CompOp ops[] = {EQ_OP, LT_OP, LE_OP, GT_OP, GE_OP};
+    for (CompOp op: ops) {
+        if (rc != success) break;
+        auto *leftIn = new TableScan(rm, "smleft");
+        auto *rightIn = new TableScan(rm, "smright");
+        rc = checkJoin(leftIn, rightIn, op, true);
+        if (rc != success)
+            std::cerr << "***** [FAIL] Join of sorted inputs with operator " << op << " *****" << std::endl;
+        delete leftIn;
+        delete rightIn;
+    }
+    // a page holds some 50 right tuples of the window, of up to 800
+    for (CompOp op: {LT_OP, GE_OP}) {
+        if (rc != success) break;
+        leftIndex = new IndexScan(rm, "smleft", "B");
+        rightIndex = new IndexScan(rm, "smright", "B");
+        rc = checkJoin(leftIndex, rightIndex, op, false, 1);
+        if (rc != success)
+            std::cerr << "***** [FAIL] Join with a spilled window with operator " << op << " *****" << std::endl;
+        delete leftIndex;
+        delete rightIndex;
+    }
+
+    rm.deleteTable("smleft");
+    rm.deleteTable("smright");
+    return rc;
+}
+
+int main() {
+
+    if (testCase_21() != success) {
+        std::cerr << "***** [FAIL] QE Test Case 21 failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case 21 finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
@@ -0,0 +1,307 @@
+#include <chrono>
+#include <map>
+#include "qe_test_util.h"
+
+static const int batchTupleCount = 30000;
+
+// tuple i has A = i, B = i % 1000 - 499.75 and C = "v" followed by i % 37; B is NULL when i % 13 == 0 and C when
+// i % 11 == 0
+static int createBatchTable() {
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeVarChar;
+    attr.length = 10;
+    attrs.push_back(attr);
+
+    rm.deleteTable("batchin");
+    RC rc = rm.createTable("batchin", attrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+
+    char buf[bufSize];
+    RID rid;
+    for (int i = 0; i < batchTupleCount; ++i) {
+        int offset = 1;
+        buf[0] = 0;
+        memcpy(buf + offset, &i, sizeof(int));
+        offset += sizeof(int);
+        if (i % 13 == 0) {
+            buf[0] |= (char) (1u << 6u);
+        } else {
+            float b = (float) (i % 1000) - 499.75f;
+            memcpy(buf + offset, &b, sizeof(float));
+            offset += sizeof(float);
+        }
+        if (i % 11 == 0) {
+            buf[0] |= (char) (1u << 5u);
+        } else {
+            std::string c = "v" + std::to_string(i % 37);
+            int length = c.size();
+            memcpy(buf + offset, &length, sizeof(int));
+            memcpy(buf + offset + sizeof(int), c.data(), length);
+        }
+        rc = rm.insertTuple("batchin", buf, rid);
+        if (rc != success) return rc;
+    }
+    return success;
+}
+
+// the length of a tuple in the format of getNextTuple
+static int tupleLength(const char *data, const std::vector<Attribute> &attrs) {
+    int offset = getActualByteForNullsIndicator(attrs.size());
+    for (size_t i = 0; i < attrs.size(); ++i) {
+        if (data[i / 8] & (1u << (7 - i % 8))) continue;
+        offset += attrs[i].type == TypeVarChar ? sizeof(int) + *(int *) (data + offset) : sizeof(int);
+    }
+    return offset;
+}
+
+// the tuples of an iterator, read with getNextTuple or getNextBatch
+static std::vector<std::string> drain(Iterator *it, bool batches) {
+    std::vector<Attribute> attrs;
+    it->getAttributes(attrs);
+    std::vector<std::string> tuples;
+    char data[bufSize];
+    if (!batches) {
+        while (it->getNextTuple(data) != QE_EOF) tuples.emplace_back(data, tupleLength(data, attrs));
+        return tuples;
+    }
+    Batch batch;
+    while (it->getNextBatch(batch) != QE_EOF) {
+        if (batch.size == 0 || batch.size > BATCH_SIZE || batch.columns.size() != attrs.size()) {
+            std::cerr << "***** [FAIL] A batch of " << batch.size << " tuples *****" << std::endl;
+            return std::vector<std::string>();
+        }
+        for (unsigned i = 0; i < batch.size; ++i) {
+            unsigned length = batch.getTuple(i, data);
+            tuples.emplace_back(data, length);
+        }
+    }
+    return tuples;
+}
+
+// reads the output of make in both modes, which have to return the same tuples
+static RC sameTuples(const std::string &what, const std::function<Iterator *(TableScan *)> &make, size_t expected) {
+    std::vector<std::string> result[2];
+    for (int batches = 0; batches < 2; ++batches) {
+        auto *input = new TableScan(rm, "batchin");
+        Iterator *it = make(input);
+        result[batches] = drain(it, batches);
+        if (it != input) delete it;
+        delete input;
+    }
+    if (result[0].size() != expected || result[0] != result[1]) {
+        std::cerr << "***** [FAIL] " << what << ": " << result[0].size() << " tuples one by one, "
+                  << result[1].size() << " in batches, " << expected << " expected *****" << std::endl;
+        return fail;
+    }
+    return success;
+}
+
+RC testCase_22() {
+    // Batches of tuples stored by column
+    // 1. TableScan - **the batches are filled from the pages**, the same tuples as getNextTuple
+    // 2. Filter on an int, a real and a varchar, Project - batches of the same tuples as getNextTuple
+    //    **a NULL satisfies no condition**, in either mode
+    // 3. Sort - a batch of getNextTuple tuples
+    // 4. Aggregate of batches - SUM as it was of tuples, AVG GROUP BY a varchar with spilled groups
+    //    **COUNT counts the values that aren't NULL, with and without GROUP BY**
+    // NULLs in the real and the varchar
+    std::cerr << std::endl << "***** In QE Test Case 22 *****" << std::endl;
+
+    RC rc = createBatchTable();
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+
+    // a scan of all tuples, one by one and in batches
+    double seconds[2];
+    for (int batches = 0; batches < 2; ++batches) {
+        auto start = std::chrono::steady_clock::now();
+        auto *input = new TableScan(rm, "batchin");
+        size_t count = 0;
+        char data[bufSize];
+        Batch batch;
+        if (batches) {
+            while (input->getNextBatch(batch) != QE_EOF) count += batch.size;
+        } else {
+            while (input->getNextTuple(data) != QE_EOF) count++;
+        }
+        delete input;
+        seconds[batches] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (count != batchTupleCount) rc = fail;
+    }
+    std::cerr << "seconds to scan " << batchTupleCount << " tuples: one by one " << seconds[0] << ", in batches "
+              << seconds[1] << std::endl;
+    if (rc == success) rc = sameTuples("TableScan", [](TableScan *input) { return input; }, batchTupleCount);
+
+    Condition cond;
+    cond.bRhsIsAttr = false;
+    char value[bufSize];
+    cond.rhsValue.data = value;
+
+    // SELECT * FROM batchin WHERE A >= 20000
+    cond.lhsAttr = "batchin.A";
+    cond.op = GE_OP;
+    cond.rhsValue.type = TypeInt;
+    *(int *) value = 20000;
+    if (rc == success)
+        rc = sameTuples("Filter on A", [&](TableScan *input) { return new Filter(input, cond); }, 10000);
+
+    // SELECT * FROM batchin WHERE B < 0, 500 of every 1000 tuples, less the NULLs
+    size_t expected = 0;
+    for (int i = 0; i < batchTupleCount; ++i) expected += i % 13 != 0 && i % 1000 < 500;
+    cond.lhsAttr = "batchin.B";
+    cond.op = LT_OP;
+    cond.rhsValue.type = TypeReal;
+    *(float *) value = 0;
+    if (rc == success)
+        rc = sameTuples("Filter on B", [&](TableScan *input) { return new Filter(input, cond); }, expected);
+
+    // SELECT * FROM batchin WHERE B <> 0.25, a NULL is not unequal either
+    expected = 0;
+    for (int i = 0; i < batchTupleCount; ++i) expected += i % 13 != 0 && i % 1000 != 500;
+    cond.op = NE_OP;
+    *(float *) value = 0.25f;
+    if (rc == success)
+        rc = sameTuples("Filter on B <>", [&](TableScan *input) { return new Filter(input, cond); }, expected);
+
+    // SELECT * FROM batchin WHERE C = "v5"
+    expected = 0;
+    for (int i = 0; i < batchTupleCount; ++i) expected += i % 11 != 0 && i % 37 == 5;
+    cond.lhsAttr = "batchin.C";
+    cond.op = EQ_OP;
+    cond.rhsValue.type = TypeVarChar;
+    *(int *) value = 2;
+    memcpy(value + sizeof(int), "v5", 2);
+    if (rc == success)
+        rc = sameTuples("Filter on C", [&](TableScan *input) { return new Filter(input, cond); }, expected);
+
+    // SELECT C, A FROM batchin
+    if (rc == success) {
+        rc = sameTuples("Project", [](TableScan *input) {
+            return new Project(input, {"batchin.C", "batchin.A"});
+        }, batchTupleCount);
+    }
+
+    // SELECT * FROM batchin ORDER BY A DESC
+    if (rc == success) {
+        rc = sameTuples("Sort", [](TableScan *input) {
+            return new Sort(input, {{"batchin.A", false}}, 0, 8);
+        }, batchTupleCount);
+    }
+
+    // SELECT SUM(B) FROM batchin WHERE A >= 20000, summed in a float in the order of the tuples
+    cond.lhsAttr = "batchin.A";
+    cond.op = GE_OP;
+    cond.rhsValue.type = TypeInt;
+    *(int *) value = 20000;
+    Attribute aggAttr;
+    aggAttr.name = "batchin.B";
+    aggAttr.type = TypeReal;
+    aggAttr.length = 4;
+    float sum = 0;
+    for (int i = 20000; i < batchTupleCount; ++i) {
+        if (i % 13 != 0) sum += (float) (i % 1000) - 499.75f;
+    }
+    auto *input = new TableScan(rm, "batchin");
+    auto *filter = new Filter(input, cond);
+    auto *agg = new Aggregate(filter, aggAttr, SUM);
+    char data[bufSize];
+    if (rc == success && (agg->getNextTuple(data) == QE_EOF || data[0] != 0 || *(float *) (data + 1) != sum)) {
+        std::cerr << "***** [FAIL] SUM(batchin.B) should be " << sum << " *****" << std::endl;
+        rc = fail;
+    }
+    delete agg;
+    delete filter;
+    delete input;
+
+    // SELECT COUNT(B), COUNT(C) FROM batchin count the values that aren't NULL
+    Attribute gAttr;
+    gAttr.name = "batchin.C";
+    gAttr.type = TypeVarChar;
+    gAttr.length = 10;
+    const int countB = batchTupleCount - (batchTupleCount + 12) / 13;
+    const int countC = batchTupleCount - (batchTupleCount + 10) / 11;
+    for (const Attribute &attr: {aggAttr, gAttr}) {
+        float expected = attr.type == TypeVarChar ? countC : countB;
+        input = new TableScan(rm, "batchin");
+        agg = new Aggregate(input, attr, COUNT);
+        if (rc == success && (agg->getNextTuple(data) == QE_EOF || *(float *) (data + 1) != expected)) {
+            std::cerr << "***** [FAIL] COUNT(" << attr.name << ") should be " << expected << " *****" << std::endl;
+            rc = fail;
+        }
+        delete agg;
+        delete input;
+    }
+
+    // SELECT C, AVG(B) FROM batchin GROUP BY C, in one page of memory
+    std::map<std::string, std::pair<double, int>> groups;
+    for (int i = 0; i < batchTupleCount; ++i) {
+        auto &group = groups[i % 11 == 0 ? "NULL" : "v" + std::to_string(i % 37)];
+        if (i % 13 == 0) continue;
+        group.first += (float) (i % 1000) - 499.75f;
+        group.second++;
+    }
+    input = new TableScan(rm, "batchin");
+    agg = new Aggregate(input, aggAttr, gAttr, AVG, 1);
+    size_t count = 0;
+    while (rc == success && agg->getNextTuple(data) != QE_EOF) {
+        bool groupNull = (data[0] & 0x80) != 0;
+        std::string c = groupNull ? "NULL" : std::string(data + 1 + sizeof(int), *(int *) (data + 1));
+        float avg = *(float *) (data + (groupNull ? 1 : 1 + sizeof(int) + c.size()));
+        auto it = groups.find(c);
+        if (it == groups.end() || (data[0] & 0x40) != 0 || avg != (float) (it->second.first / it->second.second)) {
+            std::cerr << "***** [FAIL] Wrong AVG(batchin.B) " << avg << " of " << c << " *****" << std::endl;
+            rc = fail;
+        }
+        count++;
+    }
+    delete agg;
+    delete input;
+    if (rc == success && count != groups.size()) {
+        std::cerr << "***** [FAIL] " << count << " groups, not " << groups.size() << " *****" << std::endl;
+        rc = fail;
+    }
+
+    // SELECT C, COUNT(B) FROM batchin GROUP BY C counts as COUNT(B) does, adding up to it
+    input = new TableScan(rm, "batchin");
+    agg = new Aggregate(input, aggAttr, gAttr, COUNT);
+    int total = 0;
+    while (rc == success && agg->getNextTuple(data) != QE_EOF) {
+        bool groupNull = (data[0] & 0x80) != 0;
+        std::string c = groupNull ? "NULL" : std::string(data + 1 + sizeof(int), *(int *) (data + 1));
+        float groupCount = *(float *) (data + (groupNull ? 1 : 1 + sizeof(int) + c.size()));
+        auto it = groups.find(c);
+        if (it == groups.end() || (data[0] & 0x40) != 0 || groupCount != it->second.second) {
+            std::cerr << "***** [FAIL] Wrong COUNT(batchin.B) " << groupCount << " of " << c << " *****" << std::endl;
+            rc = fail;
+        }
+        total += (int) groupCount;
+    }
+    delete agg;
+    delete input;
+    if (rc == success && total != countB) {
+        std::cerr << "***** [FAIL] The groups count " << total << " values, not " << countB << " *****" << std::endl;
+        rc = fail;
+    }
+
+    rm.deleteTable("batchin");
+    return rc;
+}
+
+int main() {
+
+    if (testCase_22() != success) {
+        std::cerr << "***** [FAIL] QE Test Case 22 failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case 22 finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
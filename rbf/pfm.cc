@@ -1,9 +1,16 @@
 #include "pfm.h"
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
 #include <iostream>
 #include <memory.h>
 #include <libgen.h>
 #include <stack>
+#include <algorithm>
 
 using namespace std;
 
@@ -16,7 +23,10 @@ PagedFileManager &PagedFileManager::instance() {
 
 PagedFileManager::PagedFileManager() = default;
 
-PagedFileManager::~PagedFileManager() { delete _pf_manager; }
+PagedFileManager::~PagedFileManager() {
+    bufferPool().flushAll();
+    delete _pf_manager;
+}
 
 PagedFileManager::PagedFileManager(const PagedFileManager &) = default;
 
@@ -31,24 +41,197 @@ RC PagedFileManager::destroyFile(const std::string &fileName) {
 }
 
 RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
-    FILE *fPointer = NULL;
-    fPointer = fopen(fileName.c_str(), "r+");
-    if (fPointer == NULL) {
+    int fd = open(fileName.c_str(), O_RDWR);
+    if (fd < 0) {
         return -1;
-    } else {
-        fileHandle.setFile(fPointer);
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    // find-or-attach must be atomic, or two threads could open one file twice
+    static std::mutex open_mutex;
+    std::lock_guard<std::mutex> lock(open_mutex);
+    // share the SharedItem (and therefore the cached pages) of a file that is already opened
+    auto opened = bufferPool().findFile(st.st_dev, st.st_ino);
+    struct stat opened_st;
+    if (opened && (fstat(opened->fd, &opened_st) < 0 || opened_st.st_nlink == 0)) {
+        // that file was removed while still open and its inode number got reused
+        opened.reset();
+    }
+    if (opened) {
+        close(fd);
+        fileHandle.shared_item_ = opened;
         return 0;
     }
+    fileHandle.setFile(fd);
+    fileHandle.shared_item_->dev = st.st_dev;
+    fileHandle.shared_item_->ino = st.st_ino;
+    bufferPool().attachFile(fileHandle.shared_item_);
+    if (mmap_mode_)
+        fileHandle.setMmapMode(true);
+    return 0;
 }
 
 RC PagedFileManager::closeFile(FileHandle &fileHandle) {
     return fileHandle.releaseFile();
 }
 
+BufferPool &PagedFileManager::bufferPool() {
+    // never destroyed: FileHandles in static storage may still release their pages after main returns
+    static BufferPool *pool = new BufferPool(BUFFER_POOL_SIZE);
+    return *pool;
+}
+
+RC PagedFileManager::setBufferPoolSize(unsigned numFrames) {
+    return bufferPool().resize(numFrames);
+}
+
+static IOEngine *&ioEnginePtr() {
+    // never destroyed, like the buffer pool
+    static IOEngine *engine = new IOEngine(true);
+    return engine;
+}
+
+// the FileHandle calls running on the engine, setIOEngine waits for them to leave
+struct IOEngineUsers {
+    std::mutex mutex;
+    std::condition_variable left_cv;
+    unsigned count = 0;
+};
+
+static IOEngineUsers &ioEngineUsers() {
+    static IOEngineUsers *users = new IOEngineUsers();
+    return *users;
+}
+
+// keeps the engine from being replaced for the lifetime of a FileHandle call
+class IOEngineUse {
+public:
+    IOEngineUse() {
+        IOEngineUsers &users = ioEngineUsers();
+        std::lock_guard<std::mutex> lock(users.mutex);
+        users.count++;
+    }
+    ~IOEngineUse() {
+        IOEngineUsers &users = ioEngineUsers();
+        std::lock_guard<std::mutex> lock(users.mutex);
+        if (--users.count == 0) users.left_cv.notify_all();
+    }
+};
+
+IOEngine &PagedFileManager::ioEngine() {
+    return *ioEnginePtr();
+}
+
+RC PagedFileManager::setIOEngine(bool useRing) {
+    IOEngineUsers &users = ioEngineUsers();
+    // holding the mutex keeps new calls out until the new engine is in place
+    std::unique_lock<std::mutex> lock(users.mutex);
+    users.left_cv.wait(lock, [&users] { return users.count == 0; });
+    IOEngine *&engine = ioEnginePtr();
+    delete engine; // finishes the reads still in flight, so waitReads finds them done
+    engine = new IOEngine(useRing);
+    return 0;
+}
+
 /* ================= FileHandle =============== */
 FileHandle::SharedItem::~SharedItem() {
-    if(name != NULL)
-        fclose(name);
+    if (fd >= 0) {
+        PagedFileManager::bufferPool().detachFile(this);
+        if (map_ != nullptr)
+            munmap(map_, MMAP_RESERVE);
+        for (char *map: retired_maps_) munmap(map, MMAP_RESERVE);
+        saveHeader();
+        close(fd);
+    }
+}
+
+RC FileHandle::SharedItem::readHeader(off_t offset, void *buf, size_t len) {
+    return pread(fd, buf, len, offset) == (ssize_t) len ? 0 : -1;
+}
+
+RC FileHandle::SharedItem::writeHeader(off_t offset, const void *buf, size_t len) {
+    return pwrite(fd, buf, len, offset) == (ssize_t) len ? 0 : -1;
+}
+
+RC FileHandle::SharedItem::saveHeader() {
+    std::lock_guard<std::mutex> lock(header_mutex_);
+    return _saveHeader();
+}
+
+RC FileHandle::SharedItem::_saveHeader() {
+    unsigned counter[] = {readPageCounter, writePageCounter, appendPageCounter};
+    if (writeHeader(0, counter, sizeof(counter)) < 0)
+        return -1;
+    unsaved_ops_ = 0;
+    if (free_space_dirty_) {
+        if (writeHeader(FSM_OFFSET, free_space_.data(), FSM_CAPACITY) < 0)
+            return -1;
+        free_space_dirty_ = false;
+    }
+    return 0;
+}
+
+char *FileHandle::SharedItem::pinMap() {
+    map_pins_++;
+    char *map = map_;
+    if (map == nullptr) unpinMap();
+    return map;
+}
+
+void FileHandle::SharedItem::unpinMap() {
+    // the last reader of a mapping that was switched off unmaps it
+    if (--map_pins_ == 0 && map_retired_) {
+        std::lock_guard<std::mutex> lock(header_mutex_);
+        unmapRetired();
+    }
+}
+
+void FileHandle::SharedItem::unmapRetired() {
+    if (map_pins_ != 0) return;
+    for (char *map: retired_maps_) munmap(map, MMAP_RESERVE);
+    retired_maps_.clear();
+    map_retired_ = false;
+}
+
+char *MapPin::acquire(const std::shared_ptr<FileHandle::SharedItem> &item) {
+    release();
+    if (!item || (map_ = item->pinMap()) == nullptr) return nullptr;
+    item_ = item;
+    return map_;
+}
+
+void MapPin::release() {
+    if (map_ != nullptr) item_->unpinMap();
+    map_ = nullptr;
+    item_.reset();
+}
+
+void FileHandle::SharedItem::countAccess(std::atomic<unsigned> &counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+    // only the access that reaches the interval takes the lock, the others just count
+    if ((unsaved_ops_.fetch_add(1, std::memory_order_relaxed) + 1) % HEADER_FLUSH_INTERVAL != 0) return;
+    std::lock_guard<std::mutex> lock(header_mutex_);
+    _saveHeader();
+}
+
+RC FileHandle::SharedItem::readFromDisk(PageNum pageNum, void *data) {
+    if (pread(fd, data, PAGE_SIZE, (off_t) PAGE_SIZE * (pageNum + 1)) != PAGE_SIZE)
+        return -1;
+    return 0;
+}
+
+RC FileHandle::SharedItem::writeToDisk(PageNum pageNum, const void *data, unsigned count) {
+    size_t len = (size_t) PAGE_SIZE * count;
+    off_t end = (off_t) PAGE_SIZE * (pageNum + 1) + len;
+    if (pwrite(fd, data, len, end - len) != (ssize_t) len)
+        return -1;
+    // the file only grows, keep the largest end seen
+    off_t size = file_size_.load();
+    while (size < end && !file_size_.compare_exchange_weak(size, end));
+    return 0;
 }
 FileHandle::FileHandle() {}
 FileHandle::~FileHandle(){}
@@ -56,101 +239,270 @@ FileHandle::~FileHandle(){}
 // FileHandle::FileHandle(const FileHandle& fh){ _copyMembers(fh);}
 // FileHandle& FileHandle::operator = (const FileHandle& fh){ _copyMembers(fh); return *this;}
 
-RC FileHandle::setFile(FILE *fp) {
+RC FileHandle::setFile(int fd) {
     shared_item_ = std::make_shared<FileHandle::SharedItem>();
-    shared_item_->name = fp;
+    shared_item_->fd = fd;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("setFile: ");
+        exit(EXIT_FAILURE);
+    }
+    shared_item_->file_size_ = st.st_size;
 
     if (getSize() < PAGE_SIZE) {
         shared_item_->readPageCounter = 0;
         shared_item_->writePageCounter = 0;
         shared_item_->appendPageCounter = 0;
-        if (ftruncate(fileno(shared_item_->name), PAGE_SIZE) < 0) {
+        if (ftruncate(fd, PAGE_SIZE) < 0) {
             perror("setFile: ");
             exit(EXIT_FAILURE);
         }
-        fseek(shared_item_->name, 0, SEEK_SET);
+        shared_item_->file_size_ = PAGE_SIZE;
         unsigned counter[] = {0,0,0};
-        fwrite(counter, sizeof(unsigned), 3, shared_item_->name);
-        // fdatasync(fileno(name)); // remember to flush data !!
+        shared_item_->writeHeader(0, counter, sizeof(counter));
+        // fdatasync(fd); // remember to flush data !!
     } else {
-        fseek(shared_item_->name, 0, SEEK_SET);
-        char buf[3 * sizeof(unsigned)]{'\0'};
-        if (fread(buf, sizeof(unsigned), 3, shared_item_->name) < 3) {
+        unsigned counter[3];
+        if (shared_item_->readHeader(0, counter, sizeof(counter)) < 0) {
             perror("setFile: ");
             exit(EXIT_FAILURE);
         }
-        shared_item_->readPageCounter = *(unsigned *) buf;
-        shared_item_->writePageCounter = *(unsigned *) (buf + sizeof(unsigned));
-        shared_item_->appendPageCounter = *(unsigned *) (buf + 2 * sizeof(unsigned));
+        shared_item_->readPageCounter = counter[0];
+        shared_item_->writePageCounter = counter[1];
+        shared_item_->appendPageCounter = counter[2];
     }
+    shared_item_->free_space_.assign(FSM_CAPACITY, 0);
+    if (shared_item_->readHeader(FSM_OFFSET, shared_item_->free_space_.data(), FSM_CAPACITY) < 0) {
+        perror("setFile: ");
+        exit(EXIT_FAILURE);
+    }
+    // the room of pages past the saved map is learnt when they are read
+    shared_item_->free_space_.resize(std::max(getNumberOfPages(), (unsigned) FSM_CAPACITY), FSM_UNKNOWN);
     return 0;
 }
 
 RC FileHandle::releaseFile() {
+    if (shared_item_ && shared_item_.use_count() > 1) {
+        // other handles keep the file open, but this user is done with it
+        shared_item_->saveHeader();
+    }
     shared_item_.reset();
     return 0;
 }
 
+RC FileHandle::checkpoint() {
+    if (!shared_item_) return -1;
+    if (PagedFileManager::bufferPool().flushFile(shared_item_.get()) != 0) return -1;
+    return shared_item_->saveHeader();
+}
+
+RC FileHandle::setMmapMode(bool on) {
+    if (!shared_item_) return -1;
+    std::lock_guard<std::mutex> lock(shared_item_->header_mutex_);
+    if (on == (shared_item_->map_ != nullptr)) return 0;
+    if (!on) {
+        // scans may still read pages in place: the mapping goes once the last of them lets go of it
+        shared_item_->retired_maps_.push_back(shared_item_->map_.exchange(nullptr));
+        shared_item_->map_retired_ = true;
+        shared_item_->unmapRetired();
+        return 0;
+    }
+    // writes go straight to the file in mmap mode, so no frame of this file may stay behind
+    if (PagedFileManager::bufferPool().evictFile(shared_item_.get()) != 0) return -1;
+    // the mapping may reach past the end of the file: pages appended later show up in it without a remap
+    void *map = mmap(nullptr, MMAP_RESERVE, PROT_READ, MAP_SHARED, shared_item_->fd, 0);
+    if (map == MAP_FAILED) return -1;
+    shared_item_->map_ = (char *) map;
+    return 0;
+}
+
+bool FileHandle::isMapped() {
+    return shared_item_ && shared_item_->map_ != nullptr;
+}
+
+void FileHandle::adviseSequential() {
+    MapPin pin;
+    if (pin.acquire(shared_item_) != nullptr)
+        madvise(pin.map(), MMAP_RESERVE, MADV_SEQUENTIAL);
+}
+
+// the page lives at (pageNum + 1) * PAGE_SIZE, behind the hidden page
+static bool insideMapping(PageNum pageNum) {
+    return (size_t) PAGE_SIZE * (pageNum + 2) <= MMAP_RESERVE;
+}
+
+const char *FileHandle::readPageInPlace(PageNum pageNum, MapPin &pin) {
+    if (!shared_item_ || pageNum >= getNumberOfPages() || !insideMapping(pageNum)) return nullptr;
+    // a pin of another file, or of a mapping switched off since, is renewed
+    if (!pin.holds(shared_item_) || pin.map() != shared_item_->map_) pin.acquire(shared_item_);
+    if (pin.map() == nullptr) return nullptr;
+    shared_item_->countAccess(shared_item_->readPageCounter);
+    return pin.map() + (size_t) PAGE_SIZE * (pageNum + 1);
+}
+
+RC FileHandle::readPages(PageNum firstPage, unsigned count, void *data) {
+    if (!shared_item_) return -1;
+    if (count == 0 || firstPage >= getNumberOfPages() || count > getNumberOfPages() - firstPage) {
+        return -1;
+    }
+
+    MapPin pin;
+    char *map = pin.acquire(shared_item_);
+    if (map != nullptr && insideMapping(firstPage + count - 1)) {
+        memcpy(data, map + (size_t) PAGE_SIZE * (firstPage + 1), (size_t) PAGE_SIZE * count);
+    } else if (PagedFileManager::bufferPool().readPages(shared_item_.get(), firstPage, count, (char *) data) != 0) {
+        return -1;
+    }
+    for (unsigned i = 0; i < count; ++i)
+        shared_item_->countAccess(shared_item_->readPageCounter);
+    return 0;
+}
+
+void FileHandle::prefetchPages(PageNum firstPage, unsigned count) {
+    if (!shared_item_ || firstPage >= getNumberOfPages()) return;
+    count = std::min(count, getNumberOfPages() - firstPage);
+    off_t offset = (off_t) PAGE_SIZE * (firstPage + 1);
+    size_t len = (size_t) PAGE_SIZE * count;
+    MapPin pin;
+    char *map = pin.acquire(shared_item_);
+    if (map != nullptr && insideMapping(firstPage + count - 1))
+        madvise(map + offset, len, MADV_WILLNEED);
+    else
+        posix_fadvise(shared_item_->fd, offset, len, POSIX_FADV_WILLNEED);
+}
+
+RC FileHandle::submitReads(std::vector<PageRead> &reads) {
+    if (!shared_item_) return -1;
+    IOEngineUse use;
+    auto &engine = PagedFileManager::ioEngine();
+    auto &pool = PagedFileManager::bufferPool();
+    MapPin pin;
+    char *map = pin.acquire(shared_item_);
+    for (auto &read: reads) {
+        read.done = false;
+        if (read.pageNum >= getNumberOfPages()) {
+            engine.complete(&read, -1);
+            continue;
+        }
+        shared_item_->countAccess(shared_item_->readPageCounter);
+        // pages which are already in memory need no I/O
+        if (map != nullptr && insideMapping(read.pageNum)) {
+            memcpy(read.data, map + (size_t) PAGE_SIZE * (read.pageNum + 1), PAGE_SIZE);
+            engine.complete(&read, 0);
+        } else if (pool.copyResident(shared_item_.get(), read.pageNum, (char *) read.data)) {
+            engine.complete(&read, 0);
+        } else if (engine.submit(shared_item_->fd, (off_t) PAGE_SIZE * (read.pageNum + 1), &read) != 0) {
+            engine.complete(&read, -1);
+        }
+    }
+    return engine.flush();
+}
+
+unsigned FileHandle::waitReads(std::vector<PageRead> &reads, unsigned minDone) {
+    IOEngineUse use;
+    return PagedFileManager::ioEngine().wait(reads.data(), reads.size(), minDone);
+}
+
+unsigned FileHandle::getWriteVersion() {
+    return shared_item_ ? shared_item_->write_version_.load() : 0;
+}
+
 int FileHandle::getSize() {
-    fseek(shared_item_->name, 0, SEEK_END);
-    return ftell(shared_item_->name);
+    return shared_item_->file_size_;
 }
 
 RC FileHandle::readPage(PageNum pageNum, void *data) {
     if (!shared_item_) return -1;
 
-    if (pageNum > getNumberOfPages() - 1) {
+    if (pageNum >= getNumberOfPages()) {
         return -1;
     }
-    
-    int rc = fseek(shared_item_->name, PAGE_SIZE * (pageNum + 1), SEEK_SET);
-    int num = fread(data, sizeof(char), PAGE_SIZE, shared_item_->name);
-    // cout << "[readPage] "<<getNumberOfPages()<<" " << num<< " "<<pageNum <<" "<< rc<<endl;
 
-    if (num == PAGE_SIZE) {
-        shared_item_->readPageCounter++;
-        fseek(shared_item_->name, 0, SEEK_SET);
-        fwrite(&(shared_item_->readPageCounter), sizeof(unsigned), 1, shared_item_->name);
-        // fdatasync(fileno(name)); // remember to flush data !!
+    MapPin pin;
+    char *map = pin.acquire(shared_item_);
+    if (map != nullptr) {
+        if (insideMapping(pageNum))
+            memcpy(data, map + (size_t) PAGE_SIZE * (pageNum + 1), PAGE_SIZE);
+        else if (shared_item_->readFromDisk(pageNum, data) != 0)
+            return -1;
+        shared_item_->countAccess(shared_item_->readPageCounter);
         return 0;
     }
-    else {
+
+    auto &pool = PagedFileManager::bufferPool();
+    char *frame = pool.pinPage(shared_item_.get(), pageNum, true);
+    if (frame == nullptr) {
         // perror("[readPage]");
         return -1;
     }
+    memcpy(data, frame, PAGE_SIZE);
+    pool.unpinPage(shared_item_.get(), pageNum, false);
+
+    shared_item_->countAccess(shared_item_->readPageCounter);
+    return 0;
 }
 
 RC FileHandle::writePage(PageNum pageNum, const void *data) {
-    if (shared_item_->name == NULL) {
+    if (!shared_item_ || shared_item_->fd < 0) {
         return -1;
     }
-    //    fseek(name, 0, SEEK_END);
-    //    int size = ftell(name);  //判断文件大小
-    if (pageNum > getNumberOfPages() - 1) {
+    if (pageNum >= getNumberOfPages()) {
         return -1;
     }
 
-    fseek(shared_item_->name, PAGE_SIZE * (pageNum + 1), SEEK_SET);
-    int num = fwrite(data, sizeof(char), PAGE_SIZE, shared_item_->name);
-    if (num == PAGE_SIZE) {
-        shared_item_->writePageCounter++;
-        fseek(shared_item_->name, sizeof(unsigned), SEEK_SET);
-        fwrite(&(shared_item_->writePageCounter), sizeof(unsigned), 1, shared_item_->name);
-        // fdatasync(fileno(name)); // remember to flush data !!
+    if (shared_item_->map_ != nullptr) {
+        // the shared mapping sees the write at once
+        if (shared_item_->writeToDisk(pageNum, data) != 0) return -1;
+        shared_item_->write_version_++;
+        shared_item_->countAccess(shared_item_->writePageCounter);
         return 0;
-    } else {
+    }
+
+    // the whole page is overwritten, so there is no need to load it
+    auto &pool = PagedFileManager::bufferPool();
+    char *frame = pool.pinPage(shared_item_.get(), pageNum, false);
+    if (frame == nullptr) {
         return -1;
     }
+    memcpy(frame, data, PAGE_SIZE);
+    pool.unpinPage(shared_item_.get(), pageNum, true);
+    shared_item_->write_version_++;
+
+    shared_item_->countAccess(shared_item_->writePageCounter);
+    return 0;
 }
 
 RC FileHandle::appendPage(const void *data) {
     if (!shared_item_) return -1;
-    fseek(shared_item_->name, (shared_item_->appendPageCounter + 1) * PAGE_SIZE, SEEK_SET);
-    if (fwrite(data, sizeof(char), PAGE_SIZE, shared_item_->name) != PAGE_SIZE) return -1;
-    shared_item_->appendPageCounter++;
-    fseek(shared_item_->name, sizeof(unsigned) * 2, SEEK_SET);
-    fwrite(&(shared_item_->appendPageCounter), sizeof(unsigned), 1, shared_item_->name);
-    // fdatasync(fileno(name)); // remember to flush data !!
+    // the counter hands out page numbers, so appends of one file go one at a time
+    std::lock_guard<std::mutex> lock(shared_item_->header_mutex_);
+    PageNum pageNum = shared_item_->appendPageCounter;
+    // appendPageCounter defines the file length: the page must reach the file before the counter does
+    if (shared_item_->writeToDisk(pageNum, data) != 0) return -1;
+    if (shared_item_->map_ == nullptr) {
+        auto &pool = PagedFileManager::bufferPool();
+        char *frame = pool.pinPage(shared_item_.get(), pageNum, false);
+        if (frame == nullptr) return -1;
+        memcpy(frame, data, PAGE_SIZE);
+        pool.unpinPage(shared_item_.get(), pageNum, false);
+    }
+    unsigned counter = pageNum + 1;
+    shared_item_->writeHeader(sizeof(unsigned) * 2, &counter, sizeof(unsigned));
+    shared_item_->appendPageCounter = counter;
+    shared_item_->write_version_++;
+    return 0;
+}
+
+RC FileHandle::appendPages(const void *data, unsigned count, PageNum &firstPage) {
+    if (!shared_item_ || count == 0) return -1;
+    std::lock_guard<std::mutex> lock(shared_item_->header_mutex_);
+    firstPage = shared_item_->appendPageCounter;
+    // bulk loads would only flood the buffer pool, so the pages are not cached
+    if (shared_item_->writeToDisk(firstPage, data, count) != 0) return -1;
+    unsigned counter = firstPage + count;
+    shared_item_->writeHeader(sizeof(unsigned) * 2, &counter, sizeof(unsigned));
+    shared_item_->appendPageCounter = counter;
+    shared_item_->write_version_++;
     return 0;
 }
 
@@ -159,18 +511,47 @@ unsigned FileHandle::getNumberOfPages() {
 }
 
 int FileHandle::getTableID() {
-    fseek(shared_item_->name, sizeof(unsigned) * 3, SEEK_SET);
-    char buf[sizeof(int)]{'\0'};
-    if (fread(buf, sizeof(int), 1, shared_item_->name) < 1) {
+    int table_id;
+    if (shared_item_->readHeader(sizeof(unsigned) * 3, &table_id, sizeof(int)) < 0) {
         perror("getTableID ");
         exit(EXIT_FAILURE);
     }
-    return *(int *) buf;
+    return table_id;
 }
 
 void FileHandle::setTableID(int table_id) {
-    fseek(shared_item_->name, sizeof(unsigned) * 3, SEEK_SET);
-    fwrite(&table_id, sizeof(int), 1, shared_item_->name);
+    shared_item_->writeHeader(sizeof(unsigned) * 3, &table_id, sizeof(int));
+}
+
+unsigned FileHandle::getFreeSpace(PageNum pageNum) {
+    std::lock_guard<std::mutex> lock(shared_item_->header_mutex_);
+    if (pageNum >= shared_item_->free_space_.size()) return 0;
+    return shared_item_->free_space_[pageNum] * FREE_SPACE_UNIT;
+}
+
+void FileHandle::setFreeSpace(PageNum pageNum, unsigned freeBytes) {
+    // round down, so a page found by findFreePage really has the room
+    byte v = (byte) std::min(freeBytes / FREE_SPACE_UNIT, (unsigned) UCHAR_MAX);
+    std::lock_guard<std::mutex> lock(shared_item_->header_mutex_);
+    std::vector<byte> &fsm = shared_item_->free_space_;
+    if (pageNum >= fsm.size()) fsm.resize(pageNum + 1, FSM_UNKNOWN);
+    if (fsm[pageNum] == v) return;
+    fsm[pageNum] = v;
+    if (pageNum < FSM_CAPACITY) shared_item_->free_space_dirty_ = true;
+}
+
+int FileHandle::findFreePage(unsigned needBytes) {
+    unsigned numPages = getNumberOfPages();
+    unsigned need = (needBytes + FREE_SPACE_UNIT - 1) / FREE_SPACE_UNIT;
+    std::lock_guard<std::mutex> lock(shared_item_->header_mutex_);
+    std::vector<byte> &fsm = shared_item_->free_space_;
+    if (fsm.size() < numPages) fsm.resize(numPages, FSM_UNKNOWN);
+    // latest pages first, the same order the old full scan used; a page whose room is unknown
+    // is tried once, and the caller records what it found
+    for (int i = (int) numPages - 1; i >= 0; --i) {
+        if (fsm[i] >= need) return i;
+    }
+    return -1;
 }
 
 RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount) {
@@ -180,6 +561,472 @@ RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePage
     return 0;
 }
 
+/* ================= BufferPool =============== */
+BufferPool::BufferPool(unsigned numFrames) {
+    resize(numFrames);
+}
+
+BufferPool::~BufferPool() {
+    flushAll();
+    delete[] pages_;
+}
+
+char *BufferPool::pinPage(FileHandle::SharedItem *file, PageNum pageNum, bool load) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto key = std::make_pair(file, pageNum);
+    auto it = page_table_.find(key);
+    // another thread is reading the page, look again once it is done since the read may have failed
+    while (it != page_table_.end() && frames_[it->second].loading) {
+        loaded_cv_.wait(lock);
+        it = page_table_.find(key);
+    }
+    if (it != page_table_.end()) { // hit
+        Frame &frame = frames_[it->second];
+        frame.pinCount++;
+        frame.referenced = true;
+        return pages_ + (size_t) it->second * PAGE_SIZE;
+    }
+    // miss: take a victim frame
+    int idx = _findVictim();
+    if (idx < 0) return nullptr;
+    char *page = pages_ + (size_t) idx * PAGE_SIZE;
+    Frame &frame = frames_[idx];
+    frame.file = file;
+    frame.pageNum = pageNum;
+    frame.pinCount = 1;
+    frame.dirty = false;
+    frame.referenced = true;
+    // until it is filled, by the read below or by the caller before unpinPage, the frame holds another page
+    frame.loading = true;
+    page_table_[key] = idx;
+    file_frames_[file].insert(idx);
+    if (!load) return page;
+    // the pin keeps the frame, other threads use the pool while the page is read
+    lock.unlock();
+    RC rc = file->readFromDisk(pageNum, page);
+    lock.lock();
+    frames_[idx].loading = false;
+    if (rc < 0) _evict(idx);
+    loaded_cv_.notify_all();
+    return rc < 0 ? nullptr : page;
+}
+
+void BufferPool::unpinPage(FileHandle::SharedItem *file, PageNum pageNum, bool dirty) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = page_table_.find(std::make_pair(file, pageNum));
+    if (it == page_table_.end()) return;
+    Frame &frame = frames_[it->second];
+    if (frame.pinCount > 0) frame.pinCount--;
+    frame.dirty = frame.dirty || dirty;
+    if (frame.loading) {
+        frame.loading = false;
+        loaded_cv_.notify_all();
+    }
+}
+
+int BufferPool::_findVictim() {
+    // CLOCK: sweep at most twice, the first round clears reference bits
+    for (unsigned step = 0; step < 2 * frames_.size(); ++step) {
+        int idx = clock_hand_;
+        clock_hand_ = (clock_hand_ + 1) % frames_.size();
+        Frame &frame = frames_[idx];
+        if (frame.file == nullptr) return idx;
+        if (frame.pinCount > 0) continue;
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        if (_writeBack(idx) < 0) continue;
+        _evict(idx);
+        return idx;
+    }
+    std::cerr << "[BufferPool] every frame is pinned" << std::endl;
+    return -1;
+}
+
+RC BufferPool::_writeBack(int frameIdx) {
+    Frame &frame = frames_[frameIdx];
+    if (!frame.dirty) return 0;
+    if (frame.file->writeToDisk(frame.pageNum, pages_ + (size_t) frameIdx * PAGE_SIZE) < 0) {
+        perror("[BufferPool] write back");
+        return -1;
+    }
+    frame.dirty = false;
+    return 0;
+}
+
+void BufferPool::_evict(int frameIdx) {
+    Frame &frame = frames_[frameIdx];
+    page_table_.erase(std::make_pair(frame.file, frame.pageNum));
+    auto it = file_frames_.find(frame.file);
+    it->second.erase(frameIdx);
+    if (it->second.empty())
+        file_frames_.erase(it);
+    frame = Frame();
+}
+
+std::vector<int> BufferPool::_framesOf(FileHandle::SharedItem *file) {
+    std::vector<int> res;
+    auto it = file_frames_.find(file);
+    if (it == file_frames_.end()) return res;
+    res.assign(it->second.begin(), it->second.end());
+    std::sort(res.begin(), res.end(), [this](int a, int b) { return frames_[a].pageNum < frames_[b].pageNum; });
+    return res;
+}
+
+RC BufferPool::readPages(FileHandle::SharedItem *file, PageNum firstPage, unsigned count, char *data) {
+    // pin the resident frames, so a dirty one can't be written back and dropped before it is copied over the file data
+    std::vector<int> pinned;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (unsigned i = 0; i < count; ++i) {
+            auto it = page_table_.find(std::make_pair(file, firstPage + i));
+            if (it == page_table_.end() || frames_[it->second].loading) continue;
+            frames_[it->second].pinCount++;
+            pinned.push_back(it->second);
+        }
+    }
+    // one syscall per IOV_MAX pages, each page lands in its own slot of data
+    std::vector<struct iovec> iov(std::min(count, (unsigned) IOV_MAX));
+    RC rc = 0;
+    for (unsigned done = 0; done < count && rc == 0; done += iov.size()) {
+        unsigned n = std::min(count - done, (unsigned) iov.size());
+        for (unsigned i = 0; i < n; ++i) {
+            iov[i].iov_base = data + (size_t) PAGE_SIZE * (done + i);
+            iov[i].iov_len = PAGE_SIZE;
+        }
+        if (preadv(file->fd, iov.data(), n, (off_t) PAGE_SIZE * (firstPage + done + 1)) != (ssize_t) PAGE_SIZE * n)
+            rc = -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int idx: pinned) frames_[idx].pinCount--;
+    if (rc != 0) return rc;
+    // the frames may hold newer (dirty) data than the file; a loading frame holds what the file does
+    for (unsigned i = 0; i < count; ++i) {
+        auto it = page_table_.find(std::make_pair(file, firstPage + i));
+        if (it != page_table_.end() && !frames_[it->second].loading) {
+            memcpy(data + (size_t) PAGE_SIZE * i, pages_ + (size_t) it->second * PAGE_SIZE, PAGE_SIZE);
+            frames_[it->second].referenced = true;
+        }
+    }
+    return 0;
+}
+
+bool BufferPool::copyResident(FileHandle::SharedItem *file, PageNum pageNum, char *data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = page_table_.find(std::make_pair(file, pageNum));
+    // a loading frame isn't filled yet, the caller reads the same page from the file
+    if (it == page_table_.end() || frames_[it->second].loading) return false;
+    memcpy(data, pages_ + (size_t) it->second * PAGE_SIZE, PAGE_SIZE);
+    frames_[it->second].referenced = true;
+    return true;
+}
+
+RC BufferPool::flushFile(FileHandle::SharedItem *file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RC rc = 0;
+    for (int i: _framesOf(file)) {
+        if (_writeBack(i) < 0)
+            rc = -1;
+    }
+    return rc;
+}
+
+RC BufferPool::flushAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return _flushAll();
+}
+
+RC BufferPool::_flushAll() {
+    RC rc = 0;
+    for (size_t i = 0; i < frames_.size(); ++i) {
+        if (frames_[i].file != nullptr && _writeBack(i) < 0)
+            rc = -1;
+    }
+    return rc;
+}
+
+RC BufferPool::resize(unsigned numFrames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (numFrames == 0) return -1;
+    for (auto &frame: frames_) {
+        if (frame.pinCount > 0) return -1;
+    }
+    if (_flushAll() < 0) return -1;
+    page_table_.clear();
+    file_frames_.clear();
+    frames_.assign(numFrames, Frame());
+    delete[] pages_;
+    pages_ = new char[(size_t) numFrames * PAGE_SIZE];
+    clock_hand_ = 0;
+    return 0;
+}
+
+std::shared_ptr<FileHandle::SharedItem> BufferPool::findFile(dev_t dev, ino_t ino) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = open_files_.find(std::make_pair(dev, ino));
+    if (it == open_files_.end()) return nullptr;
+    return it->second.lock();
+}
+
+void BufferPool::attachFile(const std::shared_ptr<FileHandle::SharedItem> &file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_files_[std::make_pair(file->dev, file->ino)] = file;
+}
+
+RC BufferPool::evictFile(FileHandle::SharedItem *file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i: _framesOf(file)) {
+        if (frames_[i].pinCount > 0 || _writeBack(i) < 0) return -1;
+        _evict(i);
+    }
+    return 0;
+}
+
+void BufferPool::detachFile(FileHandle::SharedItem *file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i: _framesOf(file)) {
+        _writeBack(i);
+        _evict(i);
+    }
+    auto it = open_files_.find(std::make_pair(file->dev, file->ino));
+    if (it != open_files_.end() && it->second.expired())
+        open_files_.erase(it);
+}
+
+/* ================= IOEngine =============== */
+#ifdef IORING_OFF_SQ_RING
+static int ioUringSetup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+// whether the ring takes IORING_OP_READ; io_uring came in 5.1, but READ and the probe only in 5.6
+static bool ringSupportsRead(int fd) {
+#ifdef IO_URING_OP_SUPPORTED
+    const unsigned numOps = 256;
+    std::vector<char> buf(sizeof(struct io_uring_probe) + numOps * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe *probe = (struct io_uring_probe *) buf.data();
+    // a kernel without the probe answers EINVAL, and it has no IORING_OP_READ either
+    if (ioUringRegister(fd, IORING_REGISTER_PROBE, probe, numOps) < 0) return false;
+    return probe->last_op >= IORING_OP_READ && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+#else
+    return false;
+#endif
+}
+#endif
+
+IOEngine::IOEngine(bool useRing) {
+    if (useRing && _setupRing())
+        return;
+    for (int i = 0; i < AIO_THREADS; ++i)
+        workers_.emplace_back(&IOEngine::_work, this);
+}
+
+IOEngine::~IOEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    job_cv_.notify_all();
+    for (auto &worker: workers_)
+        worker.join();
+    if (ring_fd_ >= 0) {
+        // let the kernel finish what it still reads into our buffers
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (inflight_ > 0) _reap(lock, 1);
+        munmap(sqes_, sqes_size_);
+        if (cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+        munmap(sq_ring_, sq_ring_size_);
+        close(ring_fd_);
+    }
+}
+
+bool IOEngine::_setupRing() {
+#ifdef IORING_OFF_SQ_RING
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = ioUringSetup(AIO_QUEUE_DEPTH, &params);
+    if (fd < 0) return false; // old kernel or io_uring disabled
+    if (!ringSupportsRead(fd)) {
+        // every read would complete with EINVAL, the thread pool does the work instead
+        close(fd);
+        return false;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    cq_ring_ = single ? sq_ring_ : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                        fd, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (cq_ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+        if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+        if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+        munmap(sq_ring_, sq_ring_size_);
+        close(fd);
+        return false;
+    }
+    char *sq = (char *) sq_ring_, *cq = (char *) cq_ring_;
+    sq_head_ = (unsigned *) (sq + params.sq_off.head);
+    sq_tail_ = (unsigned *) (sq + params.sq_off.tail);
+    sq_mask_ = (unsigned *) (sq + params.sq_off.ring_mask);
+    sq_array_ = (unsigned *) (sq + params.sq_off.array);
+    cq_head_ = (unsigned *) (cq + params.cq_off.head);
+    cq_tail_ = (unsigned *) (cq + params.cq_off.tail);
+    cq_mask_ = (unsigned *) (cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+    sq_entries_ = params.sq_entries;
+    ring_fd_ = fd;
+    return true;
+#else
+    return false;
+#endif
+}
+
+RC IOEngine::submit(int fd, off_t offset, PageRead *read) {
+    if (ring_fd_ < 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(Job{fd, offset, read});
+        }
+        job_cv_.notify_one();
+        return 0;
+    }
+#ifdef IORING_OFF_SQ_RING
+    std::unique_lock<std::mutex> lock(mutex_);
+    // never have more reads in the kernel than the completion queue can hold
+    while (queued_ + inflight_ >= sq_entries_) {
+        if (queued_ > 0) {
+            int n = ioUringEnter(ring_fd_, queued_, 0, 0);
+            if (n < 0) return -1;
+            queued_ -= n;
+            inflight_ += n;
+        }
+        if (queued_ + inflight_ >= sq_entries_) _reap(lock, 1);
+    }
+    // we are the only producer, the kernel only moves the head
+    unsigned tail = *sq_tail_;
+    unsigned idx = tail & *sq_mask_;
+    struct io_uring_sqe *sqe = (struct io_uring_sqe *) sqes_ + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = (unsigned long) read->data;
+    sqe->len = PAGE_SIZE;
+    sqe->user_data = (unsigned long) read;
+    sq_array_[idx] = idx;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    queued_++;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+RC IOEngine::flush() {
+#ifdef IORING_OFF_SQ_RING
+    if (ring_fd_ < 0) return 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (queued_ > 0) {
+        int n = ioUringEnter(ring_fd_, queued_, 0, 0);
+        if (n < 0) return -1;
+        queued_ -= n;
+        inflight_ += n;
+    }
+#endif
+    return 0;
+}
+
+void IOEngine::complete(PageRead *read, RC rc) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    read->rc = rc;
+    read->done = true;
+}
+
+unsigned IOEngine::_reap(std::unique_lock<std::mutex> &lock, unsigned minComplete) {
+    unsigned reaped = 0;
+#ifdef IORING_OFF_SQ_RING
+    while (true) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head, ++reaped) {
+            struct io_uring_cqe *cqe = (struct io_uring_cqe *) cqes_ + (head & *cq_mask_);
+            PageRead *read = (PageRead *) cqe->user_data;
+            read->rc = cqe->res == PAGE_SIZE ? 0 : -1;
+            read->done = true;
+            inflight_--;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        if (reaped > 0) done_cv_.notify_all();
+        if (reaped >= minComplete || inflight_ == 0) break;
+        if (reaping_) {
+            // another thread sleeps in the kernel and wakes us when it drained the queue
+            done_cv_.wait(lock);
+            break;
+        }
+        // sleep without mutex_ so submitters and other waiters are not stalled behind the kernel
+        reaping_ = true;
+        lock.unlock();
+        int rc = ioUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+        int err = errno;
+        lock.lock();
+        reaping_ = false;
+        done_cv_.notify_all();
+        if (rc < 0 && err != EINTR) break;
+    }
+#endif
+    return reaped;
+}
+
+unsigned IOEngine::wait(PageRead *reads, unsigned count, unsigned minDone) {
+    minDone = std::min(minDone, count);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        unsigned done = 0;
+        for (unsigned i = 0; i < count; ++i)
+            done += reads[i].done;
+        if (done >= minDone) return done;
+        if (ring_fd_ >= 0) {
+            if (inflight_ == 0) return done; // nothing left that could finish
+            _reap(lock, 1);
+        } else {
+            done_cv_.wait(lock);
+        }
+    }
+}
+
+void IOEngine::_work() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        job_cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+        if (jobs_.empty()) return; // stopping and nothing left to read
+        Job job = jobs_.front();
+        jobs_.pop_front();
+        lock.unlock();
+        RC rc = pread(job.fd, job.read->data, PAGE_SIZE, job.offset) == PAGE_SIZE ? 0 : -1;
+        lock.lock();
+        job.read->rc = rc;
+        job.read->done = true;
+        done_cv_.notify_all();
+    }
+}
+
 //* ================== Functions ================= */
 bool is_file_exists(const char *path) {
     return access(path, F_OK) == 0 ? true : false;
@@ -5,17 +5,48 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <memory>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <deque>
 typedef unsigned PageNum;
 typedef int RC;
 typedef unsigned char byte;
 
 #define PAGE_SIZE 4096
+#define BUFFER_POOL_SIZE 1024 // default number of frames in the shared buffer pool
+// free-space map kept in the hidden header page: one byte per data page, counting FREE_SPACE_UNIT bytes
+#define FREE_SPACE_UNIT 16
+#define FSM_OFFSET 32
+#define FSM_CAPACITY (PAGE_SIZE - FSM_OFFSET) // data pages beyond this are tracked in memory only
+#define FSM_UNKNOWN UCHAR_MAX                 // an untracked page not read since the file was opened
+#define HEADER_FLUSH_INTERVAL 1024 // page accesses between two writes of the cached header data
+#define MMAP_RESERVE ((size_t) 1 << 32) // address space mapped per file in mmap mode, pages beyond use pread
+#define SCAN_WINDOW_PAGES 8 // pages a scan reads with one readPages call
+#define AIO_QUEUE_DEPTH 64 // io_uring submission queue entries
+#define AIO_THREADS 4 // workers of the thread pool used when io_uring is not available
 
 RC wCreateFile(const std::string& fileName);
 RC wRemoveFile(const std::string& fileName);
 void wMkdirs(char* pathname);
 
 class FileHandle;
+class BufferPool;
+class IOEngine;
+class MapPin;
+
+// One asynchronous page read. It must stay at the same address until it is done.
+struct PageRead {
+    PageNum pageNum = 0;
+    void *data = nullptr;                                               // PAGE_SIZE bytes
+    RC rc = 0;                                                          // result, valid once done
+    bool done = false;
+};
 
 class  PagedFileManager{
 
@@ -27,6 +58,12 @@ public:
     RC openFile(const std::string &fileName, FileHandle &fileHandle);   // Open a file
     RC closeFile(FileHandle &fileHandle);                               // Close a file
 
+    static BufferPool &bufferPool();                                    // Access to the shared buffer pool
+    RC setBufferPoolSize(unsigned numFrames);                           // Resize the shared buffer pool
+    static IOEngine &ioEngine();                                        // Access to the asynchronous I/O engine
+    RC setIOEngine(bool useRing);                                       // Rebuild the engine once FileHandles leave it
+    void setMmapMode(bool on) { mmap_mode_ = on; }                      // map files opened from now on
+
 protected:
     PagedFileManager();                                                 // Prevent construction
     ~PagedFileManager();                                                // Prevent unwanted destruction
@@ -35,6 +72,7 @@ protected:
 
 private:
     static PagedFileManager *_pf_manager;
+    bool mmap_mode_ = false;
 };
 
 class FileHandle {
@@ -42,30 +80,193 @@ class FileHandle {
 public:
     struct SharedItem {
         // variables to keep the counter for each operation
-        unsigned readPageCounter = 0;
-        unsigned writePageCounter = 0;
-        unsigned appendPageCounter = 0;
-        FILE *name = NULL;                                                  // file pointer
+        std::atomic<unsigned> readPageCounter{0};                           // bumped without header_mutex_
+        std::atomic<unsigned> writePageCounter{0};
+        std::atomic<unsigned> appendPageCounter{0};
+        int fd = -1;                                                        // positional I/O only, no shared offset
+        std::atomic<off_t> file_size_{0};                                   // cached file length in bytes
+        dev_t dev = 0;                                                      // identify the file in the buffer pool
+        ino_t ino = 0;
+        std::vector<byte> free_space_;                                      // free-space map, FREE_SPACE_UNIT per step,
+                                                                            // its first FSM_CAPACITY bytes are saved
+        std::atomic<unsigned> unsaved_ops_{0};                              // counter updates not on disk yet
+        bool free_space_dirty_ = false;
+        std::mutex header_mutex_;                                           // guards the cached header data above
+        std::atomic<char *> map_{nullptr};                                  // read-only mapping in mmap mode
+        std::atomic<unsigned> map_pins_{0};                                 // readers of a mapping, see MapPin
+        std::atomic<bool> map_retired_{false};
+        std::vector<char *> retired_maps_;                                  // unmapped by the last pin, header_mutex_
+        std::atomic<unsigned> write_version_{0};                            // bumped by every page write
         ~SharedItem();
+
+        RC readFromDisk(PageNum pageNum, void *data);                       // bypass the buffer pool
+        RC writeToDisk(PageNum pageNum, const void *data, unsigned count = 1);
+        RC readHeader(off_t offset, void *buf, size_t len);                 // bytes of the hidden page
+        RC writeHeader(off_t offset, const void *buf, size_t len);
+        RC saveHeader();                                                    // write counters and free-space map
+        void countAccess(std::atomic<unsigned> &counter);                   // bump a counter, save every N
+        char *pinMap();                                                     // the mapping kept alive, nullptr if none
+        void unpinMap();
+        void unmapRetired();                                                // header_mutex_ already held
+    private:
+        RC _saveHeader();                                                   // header_mutex_ already held
     };
     std::shared_ptr<FileHandle::SharedItem> shared_item_;
 
     FileHandle();                                                       // Default constructor
-    ~FileHandle();                                                      // Destructor
+    virtual ~FileHandle();                                              // Destructor
     // FileHandle(const FileHandle&);
     // FileHandle& operator = (const FileHandle&);
 
-    RC setFile(FILE*);                                                    // set FIle* name and detect meta page
-    RC releaseFile();                                                     // close FILE* name
+    virtual RC setFile(int fd);                                           // take the file descriptor and detect meta page
+    RC releaseFile();                                                     // close the file once no handle uses it
+    RC checkpoint();                                                      // persist the cached header data
+    RC setMmapMode(bool on);                                              // read pages from a mapping of the file
+    bool isMapped();
+    void adviseSequential();                                              // hint the mapping will be read in order
     int getSize();                                                         // return file size
     RC readPage(PageNum pageNum, void *data);                           // Get a specific page
+    const char *readPageInPlace(PageNum pageNum, MapPin &pin);           // page bytes in the mapping, valid while pin
+                                                                        // holds it; nullptr if unmapped
+    RC readPages(PageNum firstPage, unsigned count, void *data);        // Get count consecutive pages
+    void prefetchPages(PageNum firstPage, unsigned count);              // start reading pages ahead of use
+    unsigned getWriteVersion();                                         // changes whenever a page is written
+    RC submitReads(std::vector<PageRead> &reads);                       // start reading pages, return at once
+    unsigned waitReads(std::vector<PageRead> &reads, unsigned minDone); // wait until minDone reads are done
     RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
     RC appendPage(const void *data);                                    // Append a specific page
+    RC appendPages(const void *data, unsigned count, PageNum &firstPage); // Append count pages with one write
     unsigned getNumberOfPages();                                        // Get the number of pages in the file
     RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount,
                             unsigned &appendPageCount);                 // Put current counter values into variables
     int getTableID();
     void setTableID(int table_id);
+
+    unsigned getFreeSpace(PageNum pageNum);                              // free bytes recorded for a data page
+    void setFreeSpace(PageNum pageNum, unsigned freeBytes);              // record free bytes of a data page
+    int findFreePage(unsigned needBytes);                               // a page with at least needBytes free, -1 if none
+};
+
+// Keeps the mapping of a file alive while pages handed out by readPageInPlace are in use. setMmapMode(false)
+// leaves a mapping which is still pinned to its last pin, which unmaps it.
+class MapPin {
+public:
+    MapPin() = default;
+    ~MapPin() { release(); }
+    MapPin(const MapPin &) = delete;
+    MapPin &operator=(const MapPin &) = delete;
+
+    char *acquire(const std::shared_ptr<FileHandle::SharedItem> &item); // the mapping of item, nullptr if unmapped
+    void release();
+    char *map() const { return map_; }
+    bool holds(const std::shared_ptr<FileHandle::SharedItem> &item) const { return item_ == item; }
+private:
+    std::shared_ptr<FileHandle::SharedItem> item_;
+    char *map_ = nullptr;
+};
+
+// Process-wide page cache shared by every FileHandle.
+// Frames are looked up by (file, PageNum) and replaced with the CLOCK policy. Dirty frames are
+// written back when they are evicted or when the last FileHandle of their file is released.
+// Handles opened on the same file share one SharedItem, so they always see the same frames.
+// Every public method takes the pool mutex; a pinned frame stays valid until it is unpinned.
+class BufferPool {
+public:
+    explicit BufferPool(unsigned numFrames);
+    ~BufferPool();
+
+    // return the frame holding the page, reading it from disk if load is set; nullptr on failure.
+    // Without load, a frame that wasn't resident must be filled before it is unpinned.
+    char *pinPage(FileHandle::SharedItem *file, PageNum pageNum, bool load);
+    void unpinPage(FileHandle::SharedItem *file, PageNum pageNum, bool dirty);
+
+    // read consecutive pages with one preadv, taking the frames which are resident instead
+    RC readPages(FileHandle::SharedItem *file, PageNum firstPage, unsigned count, char *data);
+    bool copyResident(FileHandle::SharedItem *file, PageNum pageNum, char *data); // copy a cached page, if any
+    RC flushFile(FileHandle::SharedItem *file);                          // write back dirty frames of file
+    RC flushAll();
+    RC resize(unsigned numFrames);                                       // flush and rebuild with numFrames frames
+    unsigned size() const { return frames_.size(); }
+
+    std::shared_ptr<FileHandle::SharedItem> findFile(dev_t dev, ino_t ino); // already opened SharedItem
+    void attachFile(const std::shared_ptr<FileHandle::SharedItem> &file);
+    void detachFile(FileHandle::SharedItem *file);                        // flush and forget every frame of file
+    RC evictFile(FileHandle::SharedItem *file);                           // flush and drop frames, keep the file
+
+private:
+    struct Frame {
+        FileHandle::SharedItem *file = nullptr;                         // nullptr: free frame
+        PageNum pageNum = 0;
+        int pinCount = 0;
+        bool dirty = false;
+        bool referenced = false;                                        // CLOCK reference bit
+        bool loading = false;                                           // not filled yet, nobody else may pin it
+    };
+    struct PageKeyHash {
+        size_t operator()(const std::pair<FileHandle::SharedItem *, PageNum> &k) const {
+            return std::hash<FileHandle::SharedItem *>()(k.first) ^ (std::hash<PageNum>()(k.second) * 31);
+        }
+    };
+
+    int _findVictim();
+    RC _writeBack(int frameIdx);
+    void _evict(int frameIdx);
+    std::vector<int> _framesOf(FileHandle::SharedItem *file);            // ordered by PageNum
+    RC _flushAll();
+
+    std::mutex mutex_;
+    std::condition_variable loaded_cv_;                                 // a loading frame got its page
+
+    std::vector<Frame> frames_;
+    char *pages_ = nullptr;                                             // frames_.size() * PAGE_SIZE bytes
+    unsigned clock_hand_ = 0;
+    std::unordered_map<std::pair<FileHandle::SharedItem *, PageNum>, int, PageKeyHash> page_table_;
+    std::unordered_map<FileHandle::SharedItem *, std::set<int>> file_frames_; // resident frames of each file
+    std::map<std::pair<dev_t, ino_t>, std::weak_ptr<FileHandle::SharedItem>> open_files_;
+};
+
+// Process-wide engine for asynchronous page reads.
+// It drives an io_uring instance when the kernel offers one, and a small thread pool doing pread
+// otherwise. Completions are reaped by whoever waits, so a request is marked done under mutex_;
+// only one waiter at a time sleeps in the kernel, without holding mutex_.
+class IOEngine {
+public:
+    explicit IOEngine(bool useRing);
+    ~IOEngine();
+
+    bool usesRing() const { return ring_fd_ >= 0; }
+    RC submit(int fd, off_t offset, PageRead *read);                     // queue a read of PAGE_SIZE bytes
+    RC flush();                                                          // hand queued reads to the kernel
+    void complete(PageRead *read, RC rc);                                // mark a read done without I/O
+    unsigned wait(PageRead *reads, unsigned count, unsigned minDone);    // number of reads done
+
+private:
+    struct Job {
+        int fd;
+        off_t offset;
+        PageRead *read;
+    };
+
+    bool _setupRing();
+    unsigned _reap(std::unique_lock<std::mutex> &lock, unsigned minComplete); // ring only, sleeps unlocked
+    void _work();                                                        // thread pool worker loop
+
+    std::mutex mutex_;
+    std::condition_variable done_cv_;
+    // io_uring
+    int ring_fd_ = -1;
+    unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_mask_ = nullptr, *sq_array_ = nullptr;
+    unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr, *cq_mask_ = nullptr;
+    void *sqes_ = nullptr, *cqes_ = nullptr;
+    void *sq_ring_ = nullptr, *cq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0, cq_ring_size_ = 0, sqes_size_ = 0;
+    unsigned sq_entries_ = 0, queued_ = 0, inflight_ = 0;
+    bool reaping_ = false;                                               // a thread waits in io_uring_enter
+    // thread pool
+    std::vector<std::thread> workers_;
+    std::deque<Job> jobs_;
+    std::condition_variable job_cv_;
+    bool stop_ = false;
 };
 
 #endif
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <iomanip>
 #include <memory.h>
+#include <algorithm>
 
 void pushBackTo(std::vector<char> &data, const char *src, int len) {
     for (int i = 0; i < len; ++i) {
@@ -88,32 +89,37 @@ static void serialize(std::vector<char> &dst, const char *src, SlotItem &slot,
     }
 }
 
-static void deserializeField(std::vector<char> &dst, const char *src, const SlotItem &slot, const Attribute &recordDescriptor,
-                 int field_idx) {
-    /* deserialize from disk format to caller format, and push back into dst */
+// the bytes of field field_idx of a record in disk format, a varchar without its length
+static const char *fieldOf(const char *src, const SlotItem &slot, AttrType type, int field_idx, int &length) {
     TypeOffset read_offset =
             slot.data_size + sizeof(TypeSlotNum) + sizeof(TypeSchemaVersion) + sizeof(TypeOffset) * field_idx;
     read_offset = *(TypeOffset *) (src + read_offset);
+    if (type != TypeVarChar)
+        length = 4;
+    else if (field_idx == slot.field_num - 1)
+        length = slot.data_size - read_offset;
+    else {
+        TypeOffset &endoffset = *(TypeOffset *) (src + slot.data_size + sizeof(TypeSlotNum) +
+                                                 sizeof(TypeSchemaVersion) + OFFTSIZE * (field_idx + 1));
+        length = endoffset - read_offset;
+    }
+    return src + read_offset;
+}
+
+static void deserializeField(std::vector<char> &dst, const char *src, const SlotItem &slot, const Attribute &recordDescriptor,
+                 int field_idx) {
+    /* deserialize from disk format to caller format, and push back into dst */
+    int varlen;
+    const char *field = fieldOf(src, slot, recordDescriptor.type, field_idx, varlen);
     switch (recordDescriptor.type) {
         case TypeReal:
-            pushBackTo(dst, src + read_offset, 4);
-            break;
         case TypeInt:
-            pushBackTo(dst, src + read_offset, 4);
+            pushBackTo(dst, field, 4);
             break;
-        case TypeVarChar: {
-            int varlen;
-            if (field_idx == slot.field_num - 1)
-                varlen = slot.data_size - read_offset;
-            else {
-                TypeOffset &endoffset = *(TypeOffset *) (src + slot.data_size + sizeof(TypeSlotNum) +
-                                                         sizeof(TypeSchemaVersion) + OFFTSIZE * (field_idx + 1));
-                varlen = endoffset - read_offset;
-            }
+        case TypeVarChar:
             pushBackTo(dst, (char *) &varlen, 4);
-            pushBackTo(dst, src + read_offset, varlen);
+            pushBackTo(dst, field, varlen);
             break;
-        }
         default:
             printf("Undefined type! ");
             exit(EXIT_FAILURE);
@@ -201,10 +207,7 @@ RC RecordBasedFileManager::destroyFile(const std::string &fileName) {
 }
 
 RC RecordBasedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
-    FILE *fp = fopen(fileName.c_str(), "r+");
-    if (fp == NULL) return -1;
-    fileHandle.setFile(fp);
-    return 0;
+    return PagedFileManager::instance().openFile(fileName, fileHandle);
 }
 
 RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) {
@@ -218,11 +221,12 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vecto
     SlotItem slot;
     std::vector<char> databuf;
     serialize(databuf, (const char *) data, slot, recordDescriptor, version);
-    // traversal all existing pages
+    // ask the free-space map for a page with room, instead of reading every page
     char *pagebuf = new char[PAGE_SIZE];
-    int64_t pageidx = fileHandle.getNumberOfPages(); // read the last page
+    unsigned need = databuf.size() + sizeof(SlotItem);
     DataPage datapage;
-    for (pageidx = pageidx - 1; pageidx >= 0; --pageidx) {
+    int pageidx;
+    while ((pageidx = fileHandle.findFreePage(need)) >= 0) {
         // reading page
         if (fileHandle.readPage(pageidx, pagebuf) < 0) {
             std::cerr << "insertRecord error !";
@@ -233,9 +237,12 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vecto
         if (tryWriteToPage(datapage, databuf, slot, rid.slotNum)) {
             rid.pageNum = (unsigned) pageidx;
             fileHandle.writePage(pageidx, datapage.data());
+            fileHandle.setFreeSpace(pageidx, datapage.getEmptySize());
             return 0;
         }
         pagebuf = datapage.release();
+        // the map was stale, or didn't know the page yet
+        fileHandle.setFreeSpace(pageidx, DataPage::getEmptySize(pagebuf));
     }
     // new page
     DataPage::InitializePage(pagebuf);
@@ -243,11 +250,96 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vecto
     if (tryWriteToPage(datapage, databuf, slot, rid.slotNum)) {
         rid.pageNum = fileHandle.getNumberOfPages();
         fileHandle.appendPage(datapage.data());
+        fileHandle.setFreeSpace(rid.pageNum, datapage.getEmptySize());
         return 0;
     }
     return -1;
 }
 
+RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                         const std::vector<const void *> &data, std::vector<RID> &rids, char version) {
+    rids.resize(data.size());
+    SlotItem slot;
+    std::vector<char> databuf;
+    DataPage datapage;
+    bool open = false;           // datapage holds the page being filled
+    int pageidx = -1;            // that page in the file, -1: a new page
+    bool modified = false;
+    bool reuse = true;           // the free-space map may still know pages with room
+    std::vector<char> appended;  // filled new pages which are not written yet
+    std::vector<size_t> pending; // records on them; their pageNum counts from the first of these pages
+
+    auto appendPending = [&]() -> RC {
+        unsigned count = appended.size() / PAGE_SIZE;
+        if (count == 0) return 0;
+        PageNum first;
+        if (fileHandle.appendPages(appended.data(), count, first) != 0) return -1;
+        for (unsigned i = 0; i < count; ++i)
+            fileHandle.setFreeSpace(first + i, DataPage::getEmptySize(appended.data() + (size_t) PAGE_SIZE * i));
+        for (size_t i: pending)
+            rids[i].pageNum += first;
+        appended.clear();
+        pending.clear();
+        return 0;
+    };
+    auto closePage = [&]() -> RC {
+        open = false;
+        if (pageidx >= 0) {
+            if (modified && fileHandle.writePage(pageidx, datapage.data()) != 0) return -1;
+            fileHandle.setFreeSpace(pageidx, datapage.getEmptySize());
+            return 0;
+        }
+        appended.insert(appended.end(), datapage.data(), datapage.data() + PAGE_SIZE);
+        return appended.size() / PAGE_SIZE >= APPEND_BATCH_PAGES ? appendPending() : 0;
+    };
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        databuf.clear(); // serialize appends
+        serialize(databuf, (const char *) data[i], slot, recordDescriptor, version);
+        bool placed = open && tryWriteToPage(datapage, databuf, slot, rids[i].slotNum);
+        if (!placed && open && closePage() != 0) return -1;
+        // the page is full: take the next one from the free-space map like insertRecord, then new pages
+        while (!placed && reuse) {
+            int idx = fileHandle.findFreePage(databuf.size() + sizeof(SlotItem));
+            if (idx < 0) {
+                reuse = false;
+                break;
+            }
+            char *pagebuf = new char[PAGE_SIZE];
+            if (fileHandle.readPage(idx, pagebuf) < 0) {
+                delete[] pagebuf;
+                return -1;
+            }
+            datapage.reset(pagebuf);
+            open = true;
+            pageidx = idx;
+            modified = false;
+            placed = tryWriteToPage(datapage, databuf, slot, rids[i].slotNum);
+            if (!placed) { // the map was stale, or didn't know the page yet
+                open = false;
+                fileHandle.setFreeSpace(idx, datapage.getEmptySize());
+            }
+        }
+        if (!placed) {
+            char *pagebuf = new char[PAGE_SIZE];
+            DataPage::InitializePage(pagebuf);
+            datapage.reset(pagebuf);
+            open = true;
+            pageidx = -1;
+            if (!tryWriteToPage(datapage, databuf, slot, rids[i].slotNum)) return -1; // larger than a page
+        }
+        modified = true;
+        if (pageidx >= 0) {
+            rids[i].pageNum = pageidx;
+        } else {
+            rids[i].pageNum = appended.size() / PAGE_SIZE;
+            pending.push_back(i);
+        }
+    }
+    if (open && closePage() != 0) return -1;
+    return appendPending();
+}
+
 RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                       const RID &rid, void *data) {
     char pagebuf[PAGE_SIZE];
@@ -311,6 +403,34 @@ RC RecordBasedFileManager::readRawRecord(FileHandle& fileHandle, const RID& rid,
     return -1;
 }
 
+RC RecordBasedFileManager::readRawRecords(FileHandle &fileHandle, const std::vector<RID> &rids,
+                                          const std::function<void(size_t, char *, int, const SlotItem &)> &func) {
+    char pagebuf[PAGE_SIZE], databuf[PAGE_SIZE];
+    int from_version;
+    SlotItem slot;
+    for (size_t i = 0; i < rids.size(); ++i) {
+        if (i == 0 || rids[i].pageNum != rids[i - 1].pageNum) {
+            if (fileHandle.readPage(rids[i].pageNum, pagebuf) != 0)
+                return -1;
+        }
+        if (rids[i].slotNum >= (unsigned) DataPage::getSlotNum(pagebuf))
+            return -1;
+        SlotItem &slotref = *(SlotItem *) (pagebuf + PAGEHEADSIZE + rids[i].slotNum * sizeof(SlotItem));
+        if (slotref.offset > 0) { // direct slot, straight from the page
+            char *data_start = pagebuf + slotref.offset;
+            from_version = *(TypeSchemaVersion *) (data_start + slotref.data_size + sizeof(TypeSlotNum));
+            func(i, data_start, from_version, slotref);
+        } else if (slotref.offset < 0) { // indirect slot
+            if (readRawRecord(fileHandle, rids[i], databuf, from_version, slot) != 0)
+                return -1;
+            func(i, databuf, from_version, slot);
+        } else { // deleted slot
+            return -1;
+        }
+    }
+    return 0;
+}
+
 RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                         const RID &rid) {
 
@@ -333,6 +453,7 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const std::vecto
             dataStackTop += slotref.data_size + slotref.metadata_size;
             memcpy(pagebuf + sizeof(TypeOffset), &dataStackTop, sizeof(TypeOffset));
             fileHandle.writePage(pageNum, pagebuf);
+            fileHandle.setFreeSpace(pageNum, DataPage::getEmptySize(pagebuf));
             //std::cout<<"data stack top after delete: "<<DataPage::getDataStackTop(pagetmp)<<std::endl;
             return 0;
         } else if (slotref.offset < 0) {
@@ -347,6 +468,7 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const std::vecto
             dataStackTop += 9;
             memcpy(pagebuf + sizeof(TypeOffset), &dataStackTop, sizeof(TypeOffset));
             fileHandle.writePage(oldPageNum, pagebuf);
+            fileHandle.setFreeSpace(oldPageNum, DataPage::getEmptySize(pagebuf));
             //   |type s m |p n|
         } else {
             return -1;
@@ -457,6 +579,7 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vecto
                 }
             }
             fileHandle.writePage(pageNum, pagebuf);
+            fileHandle.setFreeSpace(pageNum, DataPage::getEmptySize(pagebuf));
             return 0;
         } else if (slotref.offset < 0) {
             char *data_start = pagebuf - slotref.offset;
@@ -588,7 +711,7 @@ bool RecordBasedFileManager::tryWriteToPage(DataPage &datapage, std::vector<char
     return false;
 }
 
-void RecordBasedFileManager::convertVersion(char* from_data, char* to_data, std::vector<Attribute>& from_attrs, std::vector<Attribute>& to_attrs, const SlotItem& slot){
+int RecordBasedFileManager::convertVersion(char* from_data, char* to_data, std::vector<Attribute>& from_attrs, std::vector<Attribute>& to_attrs, const SlotItem& slot){
     int indicator_len = getIndicatorLen(to_attrs.size());
     auto name2idx = getFieldIndex(from_attrs);
     auto indicator_start = from_data+slot.data_size + sizeof(TypeSchemaVersion) + sizeof(TypeSlotNum) + slot.field_num * sizeof(TypeOffset);
@@ -608,6 +731,7 @@ void RecordBasedFileManager::convertVersion(char* from_data, char* to_data, std:
         deserializeField(databuf, from_data, slot, from_attrs[ name2idx[to_attrs[i].name] ], name2idx[to_attrs[i].name]);
     }
     memcpy(to_data, databuf.data(), databuf.size());
+    return databuf.size();
 }
 
 /* =========== ScanIterator ========== */
@@ -615,7 +739,7 @@ void RBFM_ScanIterator::_copyMembers(const RBFM_ScanIterator& other){
     next_rid = other.next_rid;
     _conditionAttribute = other._conditionAttribute;
     _compOp = other._compOp;
-    // memcpy(pagebuf, other.pagebuf, PAGE_SIZE); // don't need to copy because we won't reuse this data
+    _window_count = 0; // don't need to copy the window because we won't reuse this data
     _field_dict = other._field_dict;
     _fh = other._fh;
     _recordDescriptor = other._recordDescriptor;
@@ -630,6 +754,7 @@ RBFM_ScanIterator::~RBFM_ScanIterator(){ close(); }
 RC RBFM_ScanIterator::close() { 
     delete [] _value;
     _value = nullptr;
+    _map_pin.release();
     return 0; 
 }
 
@@ -638,10 +763,12 @@ void RBFM_ScanIterator::setParams(FileHandle &fileHandle, const std::vector<Attr
                             const std::vector<std::string> &attributeNames, const std::unordered_map<std::string, int>& field_dict){
     next_rid.pageNum = 0;
     next_rid.slotNum = 0;
+    _window_count = 0; // the window may hold pages of the file scanned before
 
     _conditionAttribute = conditionAttribute;
     _compOp = compOp;
     _fh = fileHandle;
+    _fh.adviseSequential();
     _recordDescriptor = recordDescriptor;
     _attributeNames = attributeNames;
     _field_dict = field_dict;
@@ -690,21 +817,94 @@ RC  RBFM_ScanIterator::getNextRecord(RID &rid, void *data) {
     }
     return RBFM_EOF;
 }
+RC RBFM_ScanIterator::getNextRecords(unsigned maxRecords,
+                                     const std::function<void(const char *const *, const unsigned *)> &func) {
+    std::vector<int> field_idx;
+    for (auto &name: _attributeNames) field_idx.push_back(_field_dict[name]);
+    std::vector<const char *> fields(field_idx.size());
+    std::vector<unsigned> lengths(field_idx.size());
+    std::vector<char> databuf;
+    unsigned count = 0;
+    while (count < maxRecords) {
+        const char* page = _fh.readPageInPlace(next_rid.pageNum, _map_pin);
+        if(page == nullptr && (page = _windowPage(next_rid.pageNum)) == nullptr)
+            break;
+        unsigned slot_num = DataPage::getSlotTableLen(page) / sizeof(SlotItem);
+        // the records of the page are decoded in place, without a copy in the caller format
+        for (; next_rid.slotNum < slot_num && count < maxRecords; ++next_rid.slotNum) {
+            const SlotItem& slotref = *(const SlotItem*)(page + PAGEHEADSIZE + next_rid.slotNum * sizeof(SlotItem));
+            if(slotref.offset <= 0)
+                continue;
+            const char* data_start = page + slotref.offset;
+            const char* indicator_start = data_start + slotref.data_size + sizeof(TypeSlotNum) +
+                                          sizeof(TypeSchemaVersion) + sizeof(TypeOffset) * slotref.field_num;
+            if(_compOp != NO_OP){
+                auto cond_idx = _field_dict[_conditionAttribute];
+                if (testBit(indicator_start, cond_idx))
+                    continue;
+                databuf.clear();
+                deserializeField(databuf, data_start, slotref, _recordDescriptor[cond_idx], cond_idx);
+                if(!applyComp(_compOp, databuf.data(), _value, _recordDescriptor[cond_idx]))
+                    continue;
+            }
+            for (size_t i = 0; i < field_idx.size(); ++i) {
+                if (testBit(indicator_start, field_idx[i])) {
+                    fields[i] = nullptr;
+                    continue;
+                }
+                int length;
+                fields[i] = fieldOf(data_start, slotref, _recordDescriptor[field_idx[i]].type, field_idx[i], length);
+                lengths[i] = length;
+            }
+            func(fields.data(), lengths.data());
+            count++;
+        }
+        if (next_rid.slotNum >= slot_num) {
+            next_rid.pageNum ++;
+            next_rid.slotNum = 0;
+        }
+    }
+    return count == 0 ? RBFM_EOF : 0;
+}
+
+const char* RBFM_ScanIterator::_windowPage(PageNum pageNum){
+    // a write since the window was read may have changed any page in it
+    if(pageNum < _window_first || pageNum >= _window_first + _window_count || _window_version != _fh.getWriteVersion()){
+        unsigned numPages = _fh.getNumberOfPages();
+        if(pageNum >= numPages) return nullptr;
+        // while the file is being written under the scan, refresh only the current page
+        bool written = _window_count > 0 && _window_version != _fh.getWriteVersion();
+        _window_version = _fh.getWriteVersion();
+        _window_first = pageNum;
+        _window_count = written ? 1 : std::min((unsigned) SCAN_WINDOW_PAGES, numPages - pageNum);
+        _window.resize((size_t) SCAN_WINDOW_PAGES * PAGE_SIZE);
+        if(_fh.readPages(_window_first, _window_count, _window.data()) != 0){
+            _window_count = 0;
+            return nullptr;
+        }
+        // the next window is read by the kernel while this one is processed
+        if(!written) _fh.prefetchPages(_window_first + _window_count, SCAN_WINDOW_PAGES);
+    }
+    return _window.data() + (size_t) (pageNum - _window_first) * PAGE_SIZE;
+}
+
 ScanCODE RBFM_ScanIterator::_getNextRecord(void *data){
     // std::cout << "[scan] page count "<< _fh.getNumberOfPages() << std::endl;
-    if(_fh.readPage(next_rid.pageNum, pagebuf) != 0)
+    // a mapped file hands out the page in place, otherwise it comes from the read window
+    const char* page = _fh.readPageInPlace(next_rid.pageNum, _map_pin);
+    if(page == nullptr && (page = _windowPage(next_rid.pageNum)) == nullptr)
         return ScanCODE::OVERPAGE;
-    // std::cout << "[scan ] slot len "<<DataPage::getSlotTableLen(pagebuf) << std::endl;
-    if(DataPage::getSlotTableLen(pagebuf)  <= next_rid.slotNum * sizeof(SlotItem))
+    // std::cout << "[scan ] slot len "<<DataPage::getSlotTableLen(page) << std::endl;
+    if(DataPage::getSlotTableLen(page)  <= next_rid.slotNum * sizeof(SlotItem))
         return ScanCODE::OVERSLOT;
 
-    SlotItem& slotref = *(SlotItem*)(pagebuf + PAGEHEADSIZE + next_rid.slotNum * sizeof(SlotItem));
+    const SlotItem& slotref = *(const SlotItem*)(page + PAGEHEADSIZE + next_rid.slotNum * sizeof(SlotItem));
     if(slotref.offset <= 0)
         return ScanCODE::INVALID_RECORD;
     
-    char* data_start = pagebuf + slotref.offset;
+    const char* data_start = page + slotref.offset;
     int indicator_len = getIndicatorLen(slotref.field_num);
-    char* indicator_start = data_start + slotref.data_size + sizeof(TypeSlotNum) + sizeof(TypeSchemaVersion) + sizeof(TypeOffset) * slotref.field_num;
+    const char* indicator_start = data_start + slotref.data_size + sizeof(TypeSlotNum) + sizeof(TypeSchemaVersion) + sizeof(TypeOffset) * slotref.field_num;
     std::vector<char> databuf;
     if(_compOp != NO_OP){ // check comparision condition
         if (testBit(indicator_start, _field_dict[_conditionAttribute])){ // isNULL
@@ -11,6 +11,7 @@
 #include "pfm.h"
 // definitions
 #define OFFTSIZE 2 // 2bytes:2 ** 16 - 1 or 2 ** 15 - 1
+#define APPEND_BATCH_PAGES 64 // new pages insertRecords appends with one write
 typedef int16_t TypeOffset;
 typedef uint8_t TypeSlotNum;
 typedef uint8_t TypeSchemaVersion;
@@ -89,6 +90,7 @@ enum class ScanCODE {
     OVERPAGE = -1,
     OVERSLOT = -2,
     INVALID_RECORD = -3,
+    RESTART = -4, // index scans: the leaf changed while it was read
     SUCC = 0
 };
 
@@ -103,6 +105,9 @@ public:
     // a satisfying record needs to be fetched from the file.
     // "data" follows the same format as RecordBasedFileManager::insertRecord().
     RC getNextRecord(RID &rid, void *data);
+    // Reads up to maxRecords records, page by page, and calls func with each one: the fields of attributeNames as
+    // pointers into the page and lengths, a varchar without its length, nullptr for NULL. RBFM_EOF when none is left.
+    RC getNextRecords(unsigned maxRecords, const std::function<void(const char *const *, const unsigned *)> &func);
     RC close();
 
     void setParams(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
@@ -114,10 +119,15 @@ public:
 private:
     ScanCODE _getNextRecord(void* data);
     void _copyMembers(const RBFM_ScanIterator&);
+    const char* _windowPage(PageNum pageNum); // page of the read window, loading the window if needed
     
     std::string _conditionAttribute;
     CompOp _compOp;
-    char pagebuf[PAGE_SIZE];
+    std::vector<char> _window; // SCAN_WINDOW_PAGES pages read at once
+    PageNum _window_first = 0;
+    unsigned _window_count = 0;
+    unsigned _window_version = 0; // write version of the file when the window was read
+    MapPin _map_pin; // keeps the mapping of the page read in place
     std::unordered_map<std::string, int> _field_dict;
     FileHandle _fh;
     std::vector<Attribute> _recordDescriptor;
@@ -162,9 +172,18 @@ public:
         return insertRecord(fileHandle, recordDescriptor, data, rid, 0);
     }
 
+    // Insert many records, one RID each. Pages are filled in memory before they are written,
+    // and new pages are appended APPEND_BATCH_PAGES at a time.
+    RC insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                     const std::vector<const void *> &data, std::vector<RID> &rids, char version = 0);
+
     // Read a record identified by the given rid.
     RC readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid, void *data);
     RC readRawRecord(FileHandle& file, const RID& rid, char* databuf, int& from_version, SlotItem& slot);
+    // Read the raw records of rids, which come grouped by page: each page is read once and func gets
+    // (i, raw record, version, slot) for rids[i]. Records moved by an update are followed one by one.
+    RC readRawRecords(FileHandle &fileHandle, const std::vector<RID> &rids,
+                      const std::function<void(size_t, char *, int, const SlotItem &)> &func);
     
     // Print the record that is passed to this utility method.
     // This method will be mainly used for debugging/testing.
@@ -204,7 +223,8 @@ public:
             RBFM_ScanIterator &rbfm_ScanIterator);
 
     int getVersion(const RID &rid, FileHandle &fileHandle);
-    void convertVersion(char* from_data, char* to_data, std::vector<Attribute>& from_attrs, std::vector<Attribute>& to_attrs, const SlotItem&);
+    // returns the length of to_data
+    int convertVersion(char* from_data, char* to_data, std::vector<Attribute>& from_attrs, std::vector<Attribute>& to_attrs, const SlotItem&);
 protected:
     RecordBasedFileManager();                                                   // Prevent construction
     ~RecordBasedFileManager();                                                  // Prevent unwanted destruction
@@ -263,23 +283,23 @@ public:
 
     TypeOffset writeSlot(int slotidx, const SlotItem &);
 
-    static TypeOffset getSlotTableLen(char *page) {
-        return *(TypeOffset *) page;
+    static TypeOffset getSlotTableLen(const char *page) {
+        return *(const TypeOffset *) page;
     }
 
-    static TypeOffset getSlotNum(char *page) {
-        return *(TypeOffset *) page / sizeof(SlotItem);
+    static TypeOffset getSlotNum(const char *page) {
+        return *(const TypeOffset *) page / sizeof(SlotItem);
     }
 
-    static TypeOffset getDataStackLen(char *page) {
-        return PAGE_SIZE - *(TypeOffset *) (page + sizeof(TypeOffset));
+    static TypeOffset getDataStackLen(const char *page) {
+        return PAGE_SIZE - *(const TypeOffset *) (page + sizeof(TypeOffset));
     }
 
-    static TypeOffset getDataStackTop(char *page) {
-        return *(TypeOffset *) (page + sizeof(TypeOffset));
+    static TypeOffset getDataStackTop(const char *page) {
+        return *(const TypeOffset *) (page + sizeof(TypeOffset));
     }
 
-    static TypeOffset getEmptySize(char *page) {
+    static TypeOffset getEmptySize(const char *page) {
         return getDataStackTop(page) - PAGEHEADSIZE - getSlotTableLen(page);
     }
 };
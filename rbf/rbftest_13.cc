@@ -0,0 +1,132 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+int RBFTest_13(RecordBasedFileManager &rbfm) {
+    // Functions Tested:
+    // 1. Create File - RBFM
+    // 2. Open File
+    // 3. insertRecord() / deleteRecord() - the free-space map remembers the room freed by
+    //                     a delete, also after reopening, and an insert goes to that page.
+    // 4. Close File
+    // 5. Destroy File
+    std::cout << std::endl << "***** In RBF Test Case 13 *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test13";
+
+    unsigned readPageCount = 0;
+    unsigned writePageCount = 0;
+    unsigned appendPageCount = 0;
+    unsigned readPageCount1 = 0;
+    unsigned writePageCount1 = 0;
+    unsigned appendPageCount1 = 0;
+
+    // Create a file named "test13"
+    rc = rbfm.createFile(fileName);
+    assert(rc == success && "Creating a file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating a file failed.");
+
+    // Open the file "test13"
+    FileHandle fileHandle;
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    RID rid;
+    RID freedRid;
+    int recordSize = 0;
+    void *record = malloc(3000);
+
+    std::vector<Attribute> recordDescriptor;
+    createLargeRecordDescriptor4(recordDescriptor);
+
+    // NULL field indicator
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char nullsIndicator[nullFieldsIndicatorActualSize];
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    int numRecords = 50;
+
+    // Insert 50 records into the file, each page can only contain one record
+    for (int i = 0; i < numRecords; i++) {
+        memset(record, 0, 3000);
+        prepareLargeRecord4(recordDescriptor.size(), nullsIndicator, 2060 + i, record, &recordSize);
+
+        rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        if (i == 10) {
+            freedRid = rid;
+        }
+    }
+
+    // Free a page in the middle of the file
+    rc = rbfm.deleteRecord(fileHandle, recordDescriptor, freedRid);
+    assert(rc == success && "Deleting a record should not fail.");
+
+    // The map is persistent: reopen the file before inserting again
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    rc = fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    assert(rc == success && "Collecting counters should not fail.");
+
+    memset(record, 0, 3000);
+    prepareLargeRecord4(recordDescriptor.size(), nullsIndicator, 2160, record, &recordSize);
+    rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rid);
+    assert(rc == success && "Inserting a record should not fail.");
+
+    rc = fileHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1);
+    assert(rc == success && "Collecting counters should not fail.");
+
+    std::cout << "before:R W A - " << readPageCount << " " << writePageCount << " " << appendPageCount
+              << " after:R W A - "
+              << readPageCount1 << " " << writePageCount1 << " " << appendPageCount1 << std::endl;
+
+    // The record should reuse the freed page, reading only that page
+    if (rid.pageNum != freedRid.pageNum || readPageCount1 - readPageCount > 1 ||
+        appendPageCount1 != appendPageCount) {
+        std::cout << "The free-space map did not lead insertRecord() to the freed page." << std::endl;
+        std::cout << "***** [FAIL] Test Case 13 Failed! *****" << std::endl << std::endl;
+        rbfm.closeFile(fileHandle);
+        rbfm.destroyFile(fileName);
+        free(record);
+        return -1;
+    }
+
+    // Close the file "test13"
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy File
+    rc = rbfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+
+    std::cout << "RBF Test Case 13 Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+
+    remove("test13");
+
+    return RBFTest_13(rbfm);
+}
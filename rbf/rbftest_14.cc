@@ -0,0 +1,105 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstdio>
+#include <stdexcept>
+
+#include "pfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// read the counters stored in the hidden page of a file
+static void readStoredCounters(const string &fileName, unsigned counter[3]) {
+    FILE *fp = fopen(fileName.c_str(), "r");
+    assert(fp != NULL && "The file should exist.");
+    assert(fread(counter, sizeof(unsigned), 3, fp) == 3 && "The hidden page should hold the counters.");
+    fclose(fp);
+}
+
+int RBFTest_14(PagedFileManager &pfm) {
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File
+    // 3. Append / Write / Read Page - counters stay in memory between checkpoints
+    // 4. Checkpoint - persists the counters
+    // 5. Close File - persists the counters
+    // 6. Destroy File
+    cout << endl << "***** In RBF Test Case 14 *****" << endl;
+
+    RC rc;
+    string fileName = "test14";
+
+    rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *data = malloc(PAGE_SIZE);
+    for (unsigned i = 0; i < PAGE_SIZE; i++) {
+        *((char *) data + i) = i % 94 + 32;
+    }
+    for (unsigned i = 0; i < 10; i++) {
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+        rc = fileHandle.writePage(i, data);
+        assert(rc == success && "Writing a page should not fail.");
+        rc = fileHandle.readPage(i, data);
+        assert(rc == success && "Reading a page should not fail.");
+    }
+
+    unsigned readPageCount = 0;
+    unsigned writePageCount = 0;
+    unsigned appendPageCount = 0;
+    rc = fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    assert(rc == success && "Collecting counters should not fail.");
+    assert(readPageCount == 10 && writePageCount == 10 && appendPageCount == 10);
+
+    // appendPageCounter defines the file length, so it is always on disk
+    unsigned stored[3];
+    readStoredCounters(fileName, stored);
+    assert(stored[2] == appendPageCount && "The appendPageCounter should be persisted at once.");
+
+    rc = fileHandle.checkpoint();
+    assert(rc == success && "Checkpoint should not fail.");
+    readStoredCounters(fileName, stored);
+    if (stored[0] != readPageCount || stored[1] != writePageCount || stored[2] != appendPageCount) {
+        cout << "[FAIL] checkpoint() did not persist the counters. Test Case 14 failed." << endl;
+        pfm.closeFile(fileHandle);
+        pfm.destroyFile(fileName);
+        free(data);
+        return -1;
+    }
+
+    rc = fileHandle.readPage(0, data);
+    assert(rc == success && "Reading a page should not fail.");
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    readStoredCounters(fileName, stored);
+    if (stored[0] != readPageCount + 1) {
+        cout << "[FAIL] closeFile() did not persist the counters. Test Case 14 failed." << endl;
+        pfm.destroyFile(fileName);
+        free(data);
+        return -1;
+    }
+
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(data);
+
+    cout << "RBF Test Case 14 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager &pfm = PagedFileManager::instance();
+
+    remove("test14");
+
+    return RBFTest_14(pfm);
+}
@@ -0,0 +1,119 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "pfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+static const unsigned numThreads = 4;
+static const unsigned pagesPerThread = 64;
+
+// every thread owns the pages i with i % numThreads == tid and uses its own FileHandle
+static void rwWorker(PagedFileManager &pfm, const string &fileName, unsigned tid, bool &ok) {
+    FileHandle fileHandle;
+    if (pfm.openFile(fileName, fileHandle) != success) {
+        ok = false;
+        return;
+    }
+    char data[PAGE_SIZE];
+    char buffer[PAGE_SIZE];
+    for (unsigned round = 0; round < 3 && ok; round++) {
+        for (unsigned i = tid; i < numThreads * pagesPerThread; i += numThreads) {
+            memset(data, (char) (i + round), PAGE_SIZE);
+            if (fileHandle.writePage(i, data) != success ||
+                fileHandle.readPage(i, buffer) != success ||
+                memcmp(data, buffer, PAGE_SIZE) != 0) {
+                ok = false;
+                break;
+            }
+        }
+    }
+    pfm.closeFile(fileHandle);
+}
+
+int RBFTest_15(PagedFileManager &pfm) {
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File - several handles on the same file
+    // 3. Append / Write / Read Page - from several threads at the same time
+    // 4. Get Counter Values
+    // 5. Close File
+    // 6. Destroy File
+    cout << endl << "***** In RBF Test Case 15 *****" << endl;
+
+    RC rc;
+    string fileName = "test15";
+
+    rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // Append the pages from every thread, each append gets its own page number
+    vector<thread> threads;
+    for (unsigned t = 0; t < numThreads; t++) {
+        threads.emplace_back([&fileHandle]() {
+            char data[PAGE_SIZE];
+            memset(data, 0, PAGE_SIZE);
+            for (unsigned i = 0; i < pagesPerThread; i++) {
+                RC rc = fileHandle.appendPage(data);
+                assert(rc == success && "Appending a page should not fail.");
+            }
+        });
+    }
+    for (auto &th: threads) th.join();
+    threads.clear();
+    assert(fileHandle.getNumberOfPages() == numThreads * pagesPerThread && "Every append should get a page.");
+
+    // Write and read disjoint pages through different handles
+    bool results[numThreads];
+    for (unsigned t = 0; t < numThreads; t++) {
+        results[t] = true;
+        threads.emplace_back(rwWorker, std::ref(pfm), std::cref(fileName), t, std::ref(results[t]));
+    }
+    for (auto &th: threads) th.join();
+    for (unsigned t = 0; t < numThreads; t++) {
+        if (!results[t]) {
+            cout << "[FAIL] Thread " << t << " read back a wrong page. Test Case 15 failed." << endl;
+            pfm.closeFile(fileHandle);
+            pfm.destroyFile(fileName);
+            return -1;
+        }
+    }
+
+    unsigned readPageCount = 0;
+    unsigned writePageCount = 0;
+    unsigned appendPageCount = 0;
+    rc = fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    assert(rc == success && "Collecting counters should not fail.");
+    cout << "R W A - " << readPageCount << " " << writePageCount << " " << appendPageCount << endl;
+    assert(readPageCount == 3 * numThreads * pagesPerThread && "No read should be lost.");
+    assert(writePageCount == 3 * numThreads * pagesPerThread && "No write should be lost.");
+
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 15 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager &pfm = PagedFileManager::instance();
+
+    remove("test15");
+
+    return RBFTest_15(pfm);
+}
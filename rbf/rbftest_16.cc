@@ -0,0 +1,147 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+int RBFTest_16(RecordBasedFileManager &rbfm) {
+    // Functions Tested:
+    // 1. Create File - RBFM
+    // 2. Open File - mmap mode
+    // 3. Insert / Update / Delete Record - the mapping sees every change, also on appended pages
+    // 4. Read Page In Place
+    // 5. Scan
+    // 6. Close File
+    // 7. Destroy File
+    std::cout << std::endl << "***** In RBF Test Case 16 *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test16";
+
+    rc = rbfm.createFile(fileName);
+    assert(rc == success && "Creating a file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = fileHandle.setMmapMode(true);
+    assert(rc == success && fileHandle.isMapped() && "Mapping the file should not fail.");
+
+    std::vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char nullsIndicator[nullFieldsIndicatorActualSize];
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    int recordSize = 0;
+    int numRecords = 2000;
+    std::vector<RID> rids;
+
+    // Insert records, which appends pages while the file is mapped
+    for (int i = 0; i < numRecords; i++) {
+        RID rid;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Peters" + std::to_string(i % 90 + 10), i,
+                      177.8, i * 10, record, &recordSize);
+        rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+    assert(fileHandle.getNumberOfPages() > 1 && "The records should take several pages.");
+
+    // A page handed out in place is the same as a copied one
+    char pagebuf[PAGE_SIZE];
+    MapPin pin;
+    for (unsigned i = 0; i < fileHandle.getNumberOfPages(); i++) {
+        const char *page = fileHandle.readPageInPlace(i, pin);
+        rc = fileHandle.readPage(i, pagebuf);
+        assert(rc == success && page != nullptr && "Reading a page should not fail.");
+        assert(memcmp(page, pagebuf, PAGE_SIZE) == 0 && "The mapping should hold the latest page.");
+    }
+
+    // Update the even records and delete every third one
+    for (int i = 0; i < numRecords; i += 2) {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Updated" + std::to_string(i % 9), i,
+                      177.8, -i, record, &recordSize);
+        rc = rbfm.updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Updating a record should not fail.");
+    }
+    for (int i = 0; i < numRecords; i += 3) {
+        rc = rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]);
+        assert(rc == success && "Deleting a record should not fail.");
+    }
+
+    // Scan reads the pages in place and has to see every change
+    std::vector<std::string> attributes{"Age", "Salary"};
+    RBFM_ScanIterator rbfmScanIterator;
+    rc = rbfm.scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributes, rbfmScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+    RID rid;
+    int count = 0;
+    while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+        int age = *(int *) ((char *) returnedData + 1);
+        int salary = *(int *) ((char *) returnedData + 5);
+        int expected = age % 2 == 0 ? -age : age * 10;
+        if (age % 3 == 0 || salary != expected) {
+            std::cout << "[FAIL] The scan returned a stale record: " << age << " " << salary << std::endl;
+            std::cout << "***** [FAIL] Test Case 16 Failed! *****" << std::endl << std::endl;
+            rbfmScanIterator.close();
+            rbfm.closeFile(fileHandle);
+            rbfm.destroyFile(fileName);
+            free(record);
+            free(returnedData);
+            return -1;
+        }
+        count++;
+    }
+    rbfmScanIterator.close();
+    int expectedCount = numRecords - (numRecords + 2) / 3;
+    if (count != expectedCount) {
+        std::cout << "[FAIL] The scan returned " << count << " records instead of " << expectedCount << std::endl;
+        std::cout << "***** [FAIL] Test Case 16 Failed! *****" << std::endl << std::endl;
+        rbfm.closeFile(fileHandle);
+        rbfm.destroyFile(fileName);
+        free(record);
+        free(returnedData);
+        return -1;
+    }
+
+    // Reopen the file: everything was written through to it
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = rbfm.readRecord(fileHandle, recordDescriptor, rids[1], returnedData);
+    assert(rc == success && "Reading a record should not fail.");
+    prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Peters11", 1, 177.8, 10, record, &recordSize);
+    assert(memcmp(record, returnedData, recordSize) == 0 && "The record should survive reopening.");
+
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+
+    std::cout << "RBF Test Case 16 Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+
+    remove("test16");
+
+    return RBFTest_16(rbfm);
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+int RBFTest_17(RecordBasedFileManager &rbfm) {
+    // Functions Tested:
+    // 1. Create File - RBFM
+    // 2. Open File
+    // 3. Read Pages - several pages at once, cached pages included
+    // 4. Scan - through its read window while the records are updated
+    // 5. Close File
+    // 6. Destroy File
+    std::cout << std::endl << "***** In RBF Test Case 17 *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test17";
+
+    rc = rbfm.createFile(fileName);
+    assert(rc == success && "Creating a file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    std::vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char nullsIndicator[nullFieldsIndicatorActualSize];
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    int recordSize = 0;
+    int numRecords = 3000;
+    std::vector<RID> rids;
+
+    for (int i = 0; i < numRecords; i++) {
+        RID rid;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Window" + std::to_string(i % 90 + 10), i,
+                      170.5, i, record, &recordSize);
+        rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+    unsigned numPages = fileHandle.getNumberOfPages();
+    assert(numPages > SCAN_WINDOW_PAGES && "The records should take more pages than one window.");
+
+    // readPages returns the same bytes as readPage, one page after another
+    char *pages = (char *) malloc((size_t) PAGE_SIZE * numPages);
+    char pagebuf[PAGE_SIZE];
+    unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+    unsigned readPageCount1 = 0, writePageCount1 = 0, appendPageCount1 = 0;
+    rc = fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    assert(rc == success && "Collecting counters should not fail.");
+    rc = fileHandle.readPages(0, numPages, pages);
+    assert(rc == success && "Reading pages should not fail.");
+    rc = fileHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1);
+    assert(rc == success && "Collecting counters should not fail.");
+    assert(readPageCount1 - readPageCount == numPages && "Every page read should be counted.");
+    for (unsigned i = 0; i < numPages; i++) {
+        rc = fileHandle.readPage(i, pagebuf);
+        assert(rc == success && "Reading a page should not fail.");
+        assert(memcmp(pages + (size_t) PAGE_SIZE * i, pagebuf, PAGE_SIZE) == 0 && "readPages should match readPage.");
+    }
+    assert(fileHandle.readPages(numPages - 1, 2, pages) != success && "Reading past the last page should fail.");
+    assert(fileHandle.readPages(0, 0, pages) != success && "Reading no page should fail.");
+    free(pages);
+
+    // Update the record after the current one while scanning: the window must not hide the change
+    std::vector<std::string> attributes{"Age", "Salary"};
+    RBFM_ScanIterator rbfmScanIterator;
+    rc = rbfm.scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributes, rbfmScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+    RID rid;
+    int count = 0;
+    bool ok = true;
+    while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+        int age = *(int *) ((char *) returnedData + 1);
+        int salary = *(int *) ((char *) returnedData + 5);
+        if (age != count || salary != (age == 0 ? 0 : -age)) {
+            ok = false;
+            break;
+        }
+        count++;
+        if (count < numRecords) {
+            prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Window" + std::to_string(count % 90 + 10),
+                          count, 170.5, -count, record, &recordSize);
+            rc = rbfm.updateRecord(fileHandle, recordDescriptor, record, rids[count]);
+            assert(rc == success && "Updating a record should not fail.");
+        }
+    }
+    rbfmScanIterator.close();
+    if (!ok || count != numRecords) {
+        std::cout << "[FAIL] The scan returned a stale record after " << count << " records." << std::endl;
+        std::cout << "***** [FAIL] Test Case 17 Failed! *****" << std::endl << std::endl;
+        rbfm.closeFile(fileHandle);
+        rbfm.destroyFile(fileName);
+        free(record);
+        free(returnedData);
+        return -1;
+    }
+
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+
+    std::cout << "RBF Test Case 17 Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+
+    remove("test17");
+
+    return RBFTest_17(rbfm);
+}
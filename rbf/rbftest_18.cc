@@ -0,0 +1,140 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+// Submit a read for every page (plus one past the end) and compare against readPage
+static bool checkAsyncReads(FileHandle &fileHandle, unsigned numPages) {
+    std::vector<char> pages((size_t) PAGE_SIZE * (numPages + 1));
+    std::vector<PageRead> reads(numPages + 1);
+    // read backwards, so the engine sees an unordered batch
+    for (unsigned i = 0; i <= numPages; i++) {
+        reads[i].pageNum = numPages - i;
+        reads[i].data = pages.data() + (size_t) PAGE_SIZE * i;
+    }
+    if (fileHandle.submitReads(reads) != success) return false;
+    // the first page can be consumed before the whole batch is done
+    if (fileHandle.waitReads(reads, 1) < 1) return false;
+    if (fileHandle.waitReads(reads, reads.size()) != reads.size()) return false;
+
+    char pagebuf[PAGE_SIZE];
+    for (unsigned i = 0; i <= numPages; i++) {
+        if (!reads[i].done) return false;
+        if (reads[i].pageNum == numPages) {
+            if (reads[i].rc == success) return false;
+            continue;
+        }
+        if (reads[i].rc != success || fileHandle.readPage(reads[i].pageNum, pagebuf) != success) return false;
+        if (memcmp(reads[i].data, pagebuf, PAGE_SIZE) != 0) return false;
+    }
+    return true;
+}
+
+int RBFTest_18(RecordBasedFileManager &rbfm) {
+    // Functions Tested:
+    // 1. Create File - RBFM
+    // 2. Open File
+    // 3. Submit Reads / Wait Reads - io_uring and the thread pool, dirty cached pages included
+    //    **the engine is swapped while other threads read through it**
+    // 4. Close File
+    // 5. Destroy File
+    std::cout << std::endl << "***** In RBF Test Case 18 *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test18";
+
+    rc = rbfm.createFile(fileName);
+    assert(rc == success && "Creating a file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    std::vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char nullsIndicator[nullFieldsIndicatorActualSize];
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    int recordSize = 0;
+    int numRecords = 20000;
+
+    for (int i = 0; i < numRecords; i++) {
+        RID rid;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 5, "Async", i, 170.5, i, record, &recordSize);
+        rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    unsigned numPages = fileHandle.getNumberOfPages();
+    assert(numPages > AIO_QUEUE_DEPTH && "The batch should be larger than the submission queue.");
+
+    // A write that may only live in the buffer pool yet
+    char pagebuf[PAGE_SIZE];
+    rc = fileHandle.readPage(1, pagebuf);
+    assert(rc == success && "Reading a page should not fail.");
+    memset(pagebuf + PAGE_SIZE / 2, 'x', 16);
+    rc = fileHandle.writePage(1, pagebuf);
+    assert(rc == success && "Writing a page should not fail.");
+
+    bool ringOk = checkAsyncReads(fileHandle, numPages);
+    std::cout << "io_uring " << (PagedFileManager::ioEngine().usesRing() ? "enabled" : "unavailable") << std::endl;
+
+    rc = PagedFileManager::instance().setIOEngine(false);
+    assert(rc == success && !PagedFileManager::ioEngine().usesRing() && "Switching the engine should not fail.");
+    bool poolOk = checkAsyncReads(fileHandle, numPages);
+    PagedFileManager::instance().setIOEngine(true);
+
+    std::atomic<int> swapFailures{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; t++) {
+        readers.emplace_back([&]() {
+            for (int n = 0; n < 10; n++) {
+                if (!checkAsyncReads(fileHandle, numPages)) swapFailures++;
+            }
+        });
+    }
+    for (int n = 0; n < 10; n++) PagedFileManager::instance().setIOEngine(n % 2 == 1);
+    for (auto &reader: readers) reader.join();
+    PagedFileManager::instance().setIOEngine(true);
+    if (swapFailures > 0) std::cout << "[FAIL] Reads failed while the engine was swapped." << std::endl;
+
+    if (!ringOk || !poolOk || swapFailures > 0) {
+        std::cout << "[FAIL] Asynchronous reads did not match readPage." << std::endl;
+        std::cout << "***** [FAIL] Test Case 18 Failed! *****" << std::endl << std::endl;
+        rbfm.closeFile(fileHandle);
+        rbfm.destroyFile(fileName);
+        free(record);
+        return -1;
+    }
+
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+
+    std::cout << "RBF Test Case 18 Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+
+    remove("test18");
+
+    return RBFTest_18(rbfm);
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+int RBFTest_19(RecordBasedFileManager &rbfm) {
+    // Functions Tested:
+    // 1. Create File - RBFM
+    // 2. Open File
+    // 3. Insert Records - space freed by deletes is reused, new pages are appended in batches
+    // 4. Read Record
+    // 5. Close File
+    // 6. Destroy File
+    std::cout << std::endl << "***** In RBF Test Case 19 *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test19";
+
+    rc = rbfm.createFile(fileName);
+    assert(rc == success && "Creating a file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    std::vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char nullsIndicator[nullFieldsIndicatorActualSize];
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *returnedData = malloc(100);
+    int numRecords = 10000;
+    std::vector<std::vector<char>> records(numRecords, std::vector<char>(100));
+    std::vector<int> sizes(numRecords);
+    std::vector<const void *> data;
+    for (int i = 0; i < numRecords; i++) {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 5 + i % 20, std::string(5 + i % 20, 'a' + i % 26),
+                      i, 170.5, i * 2, records[i].data(), &sizes[i]);
+        data.push_back(records[i].data());
+    }
+
+    // A page with a hole, which the batch should fill first
+    std::vector<RID> firstRids;
+    std::vector<const void *> firstData(data.begin(), data.begin() + 100);
+    rc = rbfm.insertRecords(fileHandle, recordDescriptor, firstData, firstRids);
+    assert(rc == success && firstRids.size() == 100 && "Inserting records should not fail.");
+    rc = rbfm.deleteRecord(fileHandle, recordDescriptor, firstRids[0]);
+    assert(rc == success && "Deleting a record should not fail.");
+    unsigned pagesBefore = fileHandle.getNumberOfPages();
+
+    unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+    unsigned readPageCount1 = 0, writePageCount1 = 0, appendPageCount1 = 0;
+    rc = fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    assert(rc == success && "Collecting counters should not fail.");
+    std::vector<RID> rids;
+    rc = rbfm.insertRecords(fileHandle, recordDescriptor, data, rids);
+    assert(rc == success && rids.size() == (size_t) numRecords && "Inserting records should not fail.");
+    rc = fileHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1);
+    assert(rc == success && "Collecting counters should not fail.");
+    unsigned newPages = fileHandle.getNumberOfPages() - pagesBefore;
+    std::cout << "new pages: " << newPages << " R W A - " << readPageCount1 - readPageCount << " "
+              << writePageCount1 - writePageCount << " " << appendPageCount1 - appendPageCount << std::endl;
+
+    bool reused = false;
+    for (auto &rid: rids)
+        reused = reused || rid.pageNum < pagesBefore;
+    // every page is written once: the old pages with writePage, the new ones with appendPages
+    bool writesOk = writePageCount1 - writePageCount <= pagesBefore && appendPageCount1 - appendPageCount == newPages;
+
+    bool same = true;
+    for (int i = 0; i < numRecords && same; i++) {
+        rc = rbfm.readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        same = rc == success && memcmp(returnedData, records[i].data(), sizes[i]) == 0;
+    }
+
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(returnedData);
+
+    if (!reused || !writesOk || !same) {
+        std::cout << "[FAIL] insertRecords reused space: " << reused << ", wrote each page once: " << writesOk
+                  << ", read back the records: " << same << std::endl;
+        std::cout << "***** [FAIL] Test Case 19 Failed! *****" << std::endl << std::endl;
+        return -1;
+    }
+
+    std::cout << "RBF Test Case 19 Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+
+    remove("test19");
+
+    return RBFTest_19(rbfm);
+}
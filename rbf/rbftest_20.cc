@@ -0,0 +1,119 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+static const unsigned numPages = 64;
+static const unsigned numFrames = 8;
+
+// page i holds i in its first bytes and (i % 251) everywhere else
+static void fillPage(unsigned pageNum, char *page) {
+    memset(page, pageNum % 251, PAGE_SIZE);
+    memcpy(page, &pageNum, sizeof(unsigned));
+}
+
+static bool checkPage(unsigned pageNum, const char *page) {
+    char expected[PAGE_SIZE];
+    fillPage(pageNum, expected);
+    return memcmp(page, expected, PAGE_SIZE) == 0;
+}
+
+int RBFTest_20(PagedFileManager &pfm) {
+    // Functions Tested:
+    // 1. Create File - PFM
+    // 2. Open File
+    // 3. Read Page / Read Pages / Write Page from several threads through a pool much smaller than the file
+    //    **a page read from disk doesn't hold the pool, others pin, evict and write meanwhile**
+    // 4. Close File
+    // 5. Destroy File
+    std::cout << std::endl << "***** In RBF Test Case 20 *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test20";
+
+    rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating a file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    char page[PAGE_SIZE];
+    for (unsigned i = 0; i < numPages; i++) {
+        fillPage(i, page);
+        rc = fileHandle.appendPage(page);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    unsigned poolSize = PagedFileManager::bufferPool().size();
+    rc = pfm.setBufferPoolSize(numFrames);
+    assert(rc == success && "Resizing the buffer pool should not fail.");
+
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            char data[PAGE_SIZE];
+            unsigned seed = t + 1;
+            for (int n = 0; n < 5000; n++) {
+                unsigned pageNum = rand_r(&seed) % numPages;
+                if (fileHandle.readPage(pageNum, data) != success || !checkPage(pageNum, data)) failures++;
+            }
+        });
+    }
+    // windows of pages, overlaid with the frames
+    threads.emplace_back([&]() {
+        std::vector<char> window((size_t) PAGE_SIZE * 16);
+        for (int n = 0; n < 500; n++) {
+            unsigned first = n * 7 % (numPages - 16);
+            if (fileHandle.readPages(first, 16, window.data()) != success) failures++;
+            for (unsigned i = 0; i < 16; i++) {
+                if (!checkPage(first + i, window.data() + (size_t) PAGE_SIZE * i)) failures++;
+            }
+        }
+    });
+    // rewrites pages with their own content, so dirty frames get evicted and written back
+    threads.emplace_back([&]() {
+        char data[PAGE_SIZE];
+        for (int n = 0; n < 2000; n++) {
+            unsigned pageNum = n * 13 % numPages;
+            fillPage(pageNum, data);
+            if (fileHandle.writePage(pageNum, data) != success) failures++;
+        }
+    });
+    for (auto &thread: threads) thread.join();
+
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    pfm.setBufferPoolSize(poolSize);
+
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    if (failures > 0) {
+        std::cout << "[FAIL] " << failures << " reads returned the wrong page." << std::endl;
+        std::cout << "***** [FAIL] Test Case 20 Failed! *****" << std::endl << std::endl;
+        return -1;
+    }
+
+    std::cout << "RBF Test Case 20 Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager &pfm = PagedFileManager::instance();
+
+    remove("test20");
+
+    return RBFTest_20(pfm);
+}
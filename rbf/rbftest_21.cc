@@ -0,0 +1,113 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+static const int numRecords = FSM_CAPACITY + 40;
+
+// deletes the record on page freed, inserts another and checks it went to that page without an append
+static int reuseFreedPage(RecordBasedFileManager &rbfm, FileHandle &fileHandle,
+                          const std::vector<Attribute> &recordDescriptor, std::vector<RID> &rids,
+                          unsigned freed, bool reopen, const std::string &fileName) {
+    RC rc = rbfm.deleteRecord(fileHandle, recordDescriptor, rids[freed]);
+    assert(rc == success && "Deleting a record should not fail.");
+    if (reopen) {
+        rc = rbfm.closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+        rc = rbfm.openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+    }
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char nullsIndicator[nullFieldsIndicatorActualSize];
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    char record[3000];
+    int recordSize = 0;
+    prepareLargeRecord4(recordDescriptor.size(), nullsIndicator, 2060, record, &recordSize);
+
+    unsigned pages = fileHandle.getNumberOfPages();
+    RID rid;
+    rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rid);
+    assert(rc == success && "Inserting a record should not fail.");
+    std::cout << "freed page " << rids[freed].pageNum << (reopen ? " after reopening" : "")
+              << ", insert went to page " << rid.pageNum << std::endl;
+    if (rid.pageNum != rids[freed].pageNum || fileHandle.getNumberOfPages() != pages) return -1;
+    rids[freed] = rid;
+    return 0;
+}
+
+int RBFTest_21(RecordBasedFileManager &rbfm) {
+    // Functions Tested:
+    // 1. Create File - RBFM
+    // 2. Open File
+    // 3. insertRecord() / deleteRecord() - room freed on a page past the saved free-space map
+    //                     is reused, also after reopening the file
+    // 4. Close File
+    // 5. Destroy File
+    std::cout << std::endl << "***** In RBF Test Case 21 *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test21";
+
+    rc = rbfm.createFile(fileName);
+    assert(rc == success && "Creating a file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    std::vector<Attribute> recordDescriptor;
+    createLargeRecordDescriptor4(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char nullsIndicator[nullFieldsIndicatorActualSize];
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    char record[3000];
+    int recordSize = 0;
+
+    // each page can only contain one record
+    std::vector<RID> rids(numRecords);
+    for (int i = 0; i < numRecords; i++) {
+        prepareLargeRecord4(recordDescriptor.size(), nullsIndicator, 2060, record, &recordSize);
+        rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    assert(rids[numRecords - 1].pageNum >= FSM_CAPACITY && "The file should outgrow the saved map.");
+
+    if (reuseFreedPage(rbfm, fileHandle, recordDescriptor, rids, numRecords - 10, false, fileName) != 0 ||
+        reuseFreedPage(rbfm, fileHandle, recordDescriptor, rids, numRecords - 20, true, fileName) != 0) {
+        std::cout << "The room freed past the saved free-space map was not reused." << std::endl;
+        std::cout << "***** [FAIL] Test Case 21 Failed! *****" << std::endl << std::endl;
+        rbfm.closeFile(fileHandle);
+        rbfm.destroyFile(fileName);
+        return -1;
+    }
+
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    std::cout << "RBF Test Case 21 Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+
+    remove("test21");
+
+    return RBFTest_21(rbfm);
+}
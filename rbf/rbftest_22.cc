@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+static const int numRecords = 2000;
+
+// scans every record, checking that the age and the salary belong together; -1 on a wrong record
+static int scanAll(RecordBasedFileManager &rbfm, FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor) {
+    std::vector<std::string> attributes{"Age", "Salary"};
+    RBFM_ScanIterator rbfmScanIterator;
+    if (rbfm.scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributes, rbfmScanIterator) != success) return -1;
+    RID rid;
+    char returnedData[100];
+    int count = 0;
+    while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+        int age = *(int *) (returnedData + 1);
+        int salary = *(int *) (returnedData + 5);
+        if (salary != age * 10) count = -numRecords;
+        count++;
+    }
+    rbfmScanIterator.close();
+    return count == numRecords ? 0 : -1;
+}
+
+int RBFTest_22(RecordBasedFileManager &rbfm) {
+    // Functions Tested:
+    // 1. Create File - RBFM
+    // 2. Open File - mmap mode
+    // 3. Scan from several threads while the mapping is switched off and on
+    //    **a scan holding a page in place keeps the mapping until it moves on**
+    // 4. Close File
+    // 5. Destroy File
+    std::cout << std::endl << "***** In RBF Test Case 22 *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test22";
+
+    rc = rbfm.createFile(fileName);
+    assert(rc == success && "Creating a file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    std::vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char nullsIndicator[nullFieldsIndicatorActualSize];
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    char record[100];
+    int recordSize = 0;
+    for (int i = 0; i < numRecords; i++) {
+        RID rid;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Peters" + std::to_string(i % 90 + 10), i,
+                      177.8, i * 10, record, &recordSize);
+        rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    rc = fileHandle.setMmapMode(true);
+    assert(rc == success && fileHandle.isMapped() && "Mapping the file should not fail.");
+
+    // the scanners share the file with the handle whose mapping is switched
+    std::atomic<bool> switching(true);
+    std::atomic<int> failures(0), scans(0);
+    std::vector<std::thread> scanners;
+    for (int t = 0; t < 2; t++) {
+        scanners.emplace_back([&]() {
+            while (switching) {
+                if (scanAll(rbfm, fileHandle, recordDescriptor) != 0) failures++;
+                scans++;
+            }
+        });
+    }
+    for (int n = 0; n < 400; n++) {
+        rc = fileHandle.setMmapMode(n % 2 == 1);
+        assert(rc == success && "Switching the mapping should not fail.");
+        std::this_thread::yield();
+    }
+    switching = false;
+    for (auto &scanner: scanners) scanner.join();
+    std::cout << "scans while switching: " << scans << std::endl;
+
+    rc = rbfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    if (failures > 0) {
+        std::cout << "[FAIL] " << failures << " scans returned wrong records." << std::endl;
+        std::cout << "***** [FAIL] Test Case 22 Failed! *****" << std::endl << std::endl;
+        return -1;
+    }
+
+    std::cout << "RBF Test Case 22 Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+
+    remove("test22");
+
+    return RBFTest_22(rbfm);
+}
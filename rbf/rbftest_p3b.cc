@@ -14,7 +14,7 @@ int RBFTest_private_3b(RecordBasedFileManager &rbfm) {
     // 1. Create File - RBFM
     // 2. Open File
     // 3. insertRecord() - checks if we can't find an enough space in the last page,
-    //                     the system checks from the beginning of the file.
+    //                     the system appends a page without reading the whole file.
     // 4. Close File
     // 5. Destroy File
     std::cout << "***** In RBF Test Case Private 3b *****" << std::endl;
@@ -132,9 +132,9 @@ int RBFTest_private_3b(RecordBasedFileManager &rbfm) {
             return -1;
         }
     } else {
-        // Each page can only contain one record. So, readPageCountDiff should be greater than 50
-        // since the system needs to go through all pages from the beginning.
-        if (readPageCountDiff < numRecords) {
+        // Each page can only contain one record. The free-space map tells that no page has room,
+        // so the insert should append a new page without going through all pages.
+        if (readPageCountDiff >= numRecords || appendPageCountDiff < 1) {
             std::cout << "The implementation regarding insertRecord() is not correct." << std::endl;
             std::cout << "***** [FAIL] Test Case Private 3b Failed! *****" << std::endl;
             rbfm.closeFile(fileHandle);
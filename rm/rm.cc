@@ -1,4 +1,5 @@
 #include "rm.h"
+#include <algorithm>
 
 const std::vector<Attribute> &getCatalogTableAttribute() {
     static std::vector<Attribute> res;
@@ -28,12 +29,13 @@ const std::vector<Attribute> &getCatalogColumnAttribute() {
 
 const std::vector<Attribute> &getCatalogIndexAttribute() {
     static std::vector<Attribute> res;
-    if (res.size() == 3)
+    if (res.size() == 4)
         return res;
     res.clear();
     res.emplace_back(Attribute{"table-id", TypeInt, 4});
     res.emplace_back(Attribute{"column-position", TypeInt, 4});
     res.emplace_back(Attribute{"file-name", TypeVarChar, 120});
+    res.emplace_back(Attribute{"index-kind", TypeInt, 4});
     return res;
 }
 
@@ -65,13 +67,15 @@ void prepareCatalogColumnData(std::vector<char> &databuf, const std::vector<Attr
 }
 
 void prepareCatalogIndexData(std::vector<char> &databuf, const std::vector<Attribute> &recordDescriptor, int table_id,
-                                int column_position,  std::string file_name) {
+                                int column_position,  std::string file_name, IndexKind kind) {
     databuf.resize(getIndicatorLen(recordDescriptor.size()), 0);
     pushBackTo(databuf, (const char *) &table_id, 4);
     pushBackTo(databuf, (const char *) &column_position, 4);
     int varlen = file_name.size();
     pushBackTo(databuf, (const char *) &varlen, 4);
     pushBackTo(databuf, file_name.data(), varlen);
+    int index_kind = (int) kind;
+    pushBackTo(databuf, (const char *) &index_kind, 4);
 }
 
 Attribute catalogColumnToAttribute(const char *data, int *pos = nullptr, int *version = nullptr) {
@@ -98,6 +102,18 @@ Attribute catalogColumnToAttribute(const char *data, int *pos = nullptr, int *ve
     return res;
 }
 
+// field idx of a tuple in the caller format, nullptr if it is null
+const char *tupleField(const char *data, const std::vector<Attribute> &attrs, int idx) {
+    if (testBit(data, idx))
+        return nullptr;
+    int offset = getIndicatorLen(attrs.size());
+    for (int i = 0; i < idx; ++i) {
+        if (testBit(data, i)) continue;
+        offset += attrs[i].type == TypeVarChar ? sizeof(int) + *(int *) (data + offset) : 4;
+    }
+    return data + offset;
+}
+
 std::vector<char> stringToClientData(const std::string &s) {
     std::vector<char> res;
     int varlen = s.size();
@@ -122,6 +138,44 @@ RelationManager::RelationManager(const RelationManager &) = default;
 
 RelationManager &RelationManager::operator=(const RelationManager &) = default;
 
+std::shared_ptr<FileHandle> RelationManager::_openFile(const std::string &fileName, bool isIndex) {
+    auto it = open_files_.find(fileName);
+    if (it != open_files_.end()) {
+        file_lru_.splice(file_lru_.begin(), file_lru_, it->second.first);
+        return it->second.second;
+    }
+    std::shared_ptr<FileHandle> file;
+    if (isIndex) {
+        auto ixfile = std::make_shared<IXFileHandle>();
+        if (IndexManager::instance().openFile(fileName, *ixfile) == 0)
+            file = ixfile;
+    } else {
+        file = std::make_shared<FileHandle>();
+        if (RecordBasedFileManager::instance().openFile(fileName, *file) < 0)
+            return nullptr; // a table file is never expected to be missing, don't remember it
+    }
+    if (open_files_.size() >= OPEN_FILE_CACHE_SIZE) {
+        // handles still held by a caller or a scan iterator stay open until they are released
+        open_files_.erase(file_lru_.back());
+        file_lru_.pop_back();
+    }
+    file_lru_.push_front(fileName);
+    open_files_[fileName] = OpenFile(file_lru_.begin(), file);
+    return file;
+}
+
+void RelationManager::_closeFile(const std::string &fileName) {
+    auto it = open_files_.find(fileName);
+    if (it == open_files_.end()) return;
+    file_lru_.erase(it->second.first);
+    open_files_.erase(it);
+}
+
+void RelationManager::_closeAllFiles() {
+    open_files_.clear();
+    file_lru_.clear();
+}
+
 RC RelationManager::createCatalog() {
     auto &rbfm = RecordBasedFileManager::instance();
     if (rbfm.createFile(CATALOG_TABLE) < 0)
@@ -130,43 +184,47 @@ RC RelationManager::createCatalog() {
         return -1;
     if(rbfm.createFile(CATALOG_INDEX) < 0)
         return -1;
-    
+    _closeAllFiles(); // nothing opened or read before belongs to this catalog
+    catalog_.clear();
+
     // make catalog data
-    FileHandle file;
     std::vector<char> databuf;
     RID rid;
-    if (rbfm.openFile(CATALOG_TABLE, file) < 0)
+    auto file = _openTable(CATALOG_TABLE);
+    if (!file)
         return -1;
     // insert to Tables
     prepareCatalogTableData(databuf, getCatalogTableAttribute(), 1, "Tables", CATALOG_TABLE, 0);
-    rbfm.insertRecord(file, getCatalogTableAttribute(), databuf.data(), rid);
+    rbfm.insertRecord(*file, getCatalogTableAttribute(), databuf.data(), rid);
     prepareCatalogTableData(databuf, getCatalogColumnAttribute(), 2, "Columns", CATALOG_COLUMN, 0);
-    rbfm.insertRecord(file, getCatalogTableAttribute(), databuf.data(), rid);
+    rbfm.insertRecord(*file, getCatalogTableAttribute(), databuf.data(), rid);
     prepareCatalogTableData(databuf, getCatalogIndexAttribute(), 3, "Indexs", CATALOG_INDEX, 0);
-    rbfm.insertRecord(file, getCatalogTableAttribute(), databuf.data(), rid);
-    file.setTableID(3);
+    rbfm.insertRecord(*file, getCatalogTableAttribute(), databuf.data(), rid);
+    file->setTableID(3);
     // insert to Columns
-    if (rbfm.openFile(CATALOG_COLUMN, file) < 0)
+    if (!(file = _openTable(CATALOG_COLUMN)))
         return -1;
     auto recordDescriptor = getCatalogColumnAttribute();
     auto attrs = getCatalogTableAttribute();
     for (int i = 0; i < attrs.size(); ++i) { // Tables column
         prepareCatalogColumnData(databuf, recordDescriptor, 1, attrs[i], i + 1, 0);
-        rbfm.insertRecord(file, recordDescriptor, databuf.data(), rid);
+        rbfm.insertRecord(*file, recordDescriptor, databuf.data(), rid);
     }
     for (int i = 0; i < recordDescriptor.size(); ++i) { // Columns column
         prepareCatalogColumnData(databuf, recordDescriptor, 2, recordDescriptor[i], i + 1, 0);
-        rbfm.insertRecord(file, recordDescriptor, databuf.data(), rid);
+        rbfm.insertRecord(*file, recordDescriptor, databuf.data(), rid);
     }
     attrs = getCatalogIndexAttribute();
     for (int i = 0; i < attrs.size(); ++i) { // Indexs Columns
         prepareCatalogColumnData(databuf, recordDescriptor, 3, attrs[i], i + 1, 0);
-        rbfm.insertRecord(file, recordDescriptor, databuf.data(), rid);
+        rbfm.insertRecord(*file, recordDescriptor, databuf.data(), rid);
     }
     return 0;
 }
 
 RC RelationManager::deleteCatalog() {
+    _closeAllFiles();
+    catalog_.clear();
     if (RecordBasedFileManager::instance().destroyFile(CATALOG_COLUMN) < 0)
         return -1;
     if (RecordBasedFileManager::instance().destroyFile(CATALOG_TABLE) < 0)
@@ -178,39 +236,45 @@ RC RelationManager::deleteCatalog() {
 
 RC RelationManager::createTable(const std::string &tableName, const std::vector<Attribute> &attrs) {
     auto &rbfm = RecordBasedFileManager::instance();
+    _closeFile(tableName + postfix); // a handle of an older file of the name is stale
     if (rbfm.createFile(tableName+postfix) < 0) {
         return -1;
     }
 
-    FileHandle file;
     //modify catlog table
-    if (rbfm.openFile(CATALOG_TABLE, file) < 0) {
+    auto file = _openTable(CATALOG_TABLE);
+    if (!file) {
         return -1;
     }
     RID rid;
     std::vector<char> databuf;
-    int table_id = file.getTableID() + 1;
+    int table_id = file->getTableID() + 1;
     auto recordDescriptor = getCatalogTableAttribute();
     prepareCatalogTableData(databuf, recordDescriptor, table_id, tableName, tableName + postfix, 0);
-    rbfm.insertRecord(file, recordDescriptor, databuf.data(), rid);
-    file.setTableID(table_id);
+    rbfm.insertRecord(*file, recordDescriptor, databuf.data(), rid);
+    file->setTableID(table_id);
+    TableInfo info;
+    info.id = table_id;
+    info.rid = rid;
+    info.attrs[0] = attrs;
+    info.indexes_loaded = true;
 
     //modify catlog column
-    if (rbfm.openFile(CATALOG_COLUMN, file) < 0) {
+    if (!(file = _openTable(CATALOG_COLUMN))) {
         return -1;
     }
     recordDescriptor = getCatalogColumnAttribute();
     for (int i = 0; i < attrs.size(); ++i) {
         prepareCatalogColumnData(databuf, recordDescriptor, table_id, attrs[i], i + 1, 0);
-        rbfm.insertRecord(file, recordDescriptor, databuf.data(), rid);
+        rbfm.insertRecord(*file, recordDescriptor, databuf.data(), rid);
     }
+    catalog_[tableName] = info;
     return 0;
 }
 
 RC RelationManager::deleteTable(const std::string &tableName) {
     
     auto &rbfm = RecordBasedFileManager::instance();
-    FileHandle file;
     std::vector<Attribute> recordDescriptor;
     if(getAttributes(tableName,recordDescriptor) < 0)
         return -1;
@@ -218,97 +282,148 @@ RC RelationManager::deleteTable(const std::string &tableName) {
     // check for system table
     int table_id = getTableIdVersion(tableName);
     if(table_id  <= MaxCatalogID) return -1;
-    if (rbfm.openFile(CATALOG_COLUMN,file)<0)
+    // the indexes go with the table
+    auto indexes = _indexedColumns(tableName, *_tableInfo(tableName));
+    for (auto &attr: indexes)
+        destroyIndex(tableName, attr);
+    auto file = _openTable(CATALOG_COLUMN);
+    if (!file)
     {
         return -1;
     }
     
     mapRIDs("Columns", "table-id", EQ_OP, &table_id, {"table-id"}, [](RID &rid, char* data, FileHandle& fh){
         RecordBasedFileManager::instance().deleteRecord(fh, getCatalogColumnAttribute(), rid);
-    }, file);
+    }, *file);
 
-    if (rbfm.openFile(CATALOG_TABLE,file)<0)
+    if (!(file = _openTable(CATALOG_TABLE)))
     {
         return -1;
     }
     
     mapRIDs("Tables", "table-id", EQ_OP, &table_id, {"table-id"}, [](RID &rid, char* data, FileHandle& fh){
         RecordBasedFileManager::instance().deleteRecord(fh, getCatalogTableAttribute(), rid);
-    }, file);
+    }, *file);
 
+    _closeFile(tableName + postfix);
+    catalog_.erase(tableName);
     rbfm.destroyFile(tableName + postfix);
 
     return 0;
 }
 
-RC RelationManager::createIndex(const std::string &tableName, const std::string &attributeName){
+RC RelationManager::createIndex(const std::string &tableName, const std::string &attributeName, IndexKind kind){
     auto &ix = IndexManager::instance();
     std::string file_name = makeIndexFileName(tableName, attributeName);
-    if (ix.createFile(file_name) < 0) {
+    if (ix.createFile(file_name, kind) < 0) {
         return -1;
     }
+    _closeFile(file_name); // forget that it did not exist
     // find tableid and column position
     int table_id = getTableIdVersion(tableName);
     if(table_id < 0) return -1;
     Attribute attr; int position;
-    if(getAttribute(table_id, attributeName, attr, &position) < 0) return -1;
+    if(getAttribute(tableName, attributeName, attr, &position) < 0) return -1;
     // insert into catalog Table
-    FileHandle file;
     std::vector<char> indexbuf;
     auto& rbfm = RecordBasedFileManager::instance();
-    if (rbfm.openFile(CATALOG_INDEX, file) < 0) {
+    auto file = _openTable(CATALOG_INDEX);
+    if (!file) {
         return -1;
     }
     auto recordDescriptor = getCatalogIndexAttribute();
-    prepareCatalogIndexData(indexbuf, recordDescriptor, table_id, position, file_name);
+    prepareCatalogIndexData(indexbuf, recordDescriptor, table_id, position, file_name, kind);
     RID rid;
-    rbfm.insertRecord(file, recordDescriptor, indexbuf.data(), rid);
+    rbfm.insertRecord(*file, recordDescriptor, indexbuf.data(), rid);
     // insert index into index file
-    IXFileHandle ixfile;
-    if(ix.openFile(file_name, ixfile) < 0) return -1;
-    mapRIDs(tableName, "", NO_OP, NULL, {attributeName}, [&attr](RID& rid, char* data, FileHandle& fh){
-        IXFileHandle *ixfile = (IXFileHandle*)&fh;
-        auto& ix = IndexManager::instance();
-        // skip null indicator
-        ix.insertEntry(*ixfile, attr, data+1, rid);
-    }, ixfile);
+    auto ixfile = _openIndex(file_name);
+    if(!ixfile) return -1;
+    RM_ScanIterator scanner;
+    if(scan(tableName, "", NO_OP, NULL, {attributeName}, scanner) < 0) return -1;
+    char data[PAGE_SIZE];
+    RC rc = ix.bulkLoad(*ixfile, attr, [&scanner, &data](const void *&key, RID &rid){
+        while(scanner.getNextTuple(rid, data) != RM_EOF) {
+            if(testBit(data, 0)) continue; // ignore null value
+            key = data + 1; // skip null indicator
+            return true;
+        }
+        return false;
+    });
+    scanner.close();
+    if(rc < 0) return -1;
+    auto info = _tableInfo(tableName);
+    if (info != nullptr && info->indexes_loaded)
+        info->indexes.insert(attributeName);
     return 0;
 }
 
 RC RelationManager::destroyIndex(const std::string &tableName, const std::string &attributeName) {
     std::string file_name = makeIndexFileName(tableName, attributeName);
+    _closeFile(file_name);
     if(IndexManager::instance().destroyFile(file_name) < 0)
         return -1;
+    auto it = catalog_.find(tableName);
+    if (it != catalog_.end())
+        it->second.indexes.erase(attributeName);
 
     std::vector<char> caller_format;
     int varlen = file_name.size();
     pushBackTo(caller_format, (char*)&varlen, 4); pushBackTo(caller_format, file_name.data(), varlen);
-    FileHandle fh;
-    if(RecordBasedFileManager::instance().openFile(CATALOG_INDEX, fh) < 0)
+    auto fh = _openTable(CATALOG_INDEX);
+    if(!fh)
         return -1;
 
     mapRIDs("Indexs", "file-name", EQ_OP, caller_format.data(), {"table-id"}, [](RID &rid, char* data, FileHandle& fh){
         RecordBasedFileManager::instance().deleteRecord(fh, getCatalogIndexAttribute(), rid);
-    }, fh);
+    }, *fh);
     
     return 0;
 }
 
-int RelationManager::getTableIdVersion(const std::string &tableName, int *version, RID* rt_rid) {
+RelationManager::TableInfo *RelationManager::_tableInfo(const std::string &tableName) {
+    auto it = catalog_.find(tableName);
+    if (it != catalog_.end())
+        return &it->second;
     RM_ScanIterator scanner;
     if (scan("Tables", "table-name", EQ_OP, stringToClientData(tableName).data(), {"table-id", "version"}, scanner) < 0)
-        return -1;
+        return nullptr;
     RID rid;
     char databuf[9]; // 1 + 4 + 4
 
-    if (scanner.getNextTuple(rid, databuf) == RM_EOF)
-        return -1;
+    bool found = scanner.getNextTuple(rid, databuf) != RM_EOF;
     scanner.close();
+    if (!found)
+        return nullptr;
+    TableInfo &info = catalog_[tableName];
+    info.id = *(int *) (databuf + 1);
+    info.version = *(int *) (databuf + 1 + sizeof(int));
+    info.rid = rid;
+    return &info;
+}
+
+const std::set<std::string> &RelationManager::_indexedColumns(const std::string &tableName, TableInfo &info) {
+    if (!info.indexes_loaded) {
+        info.indexes.clear();
+        int table_id = info.id;
+        size_t prefix_len = makeIndexFileName(tableName, "").size() - 4; // "<table>_", then "_idx"
+        mapRIDs("Indexs", "table-id", EQ_OP, &table_id, {"file-name"}, [&info, prefix_len](RID &rid, char *data) {
+            int varlen = *(int *) (data + 1);
+            info.indexes.insert(std::string(data + 5 + prefix_len, data + 5 + varlen - 4));
+        });
+        info.indexes_loaded = true;
+    }
+    return info.indexes;
+}
+
+int RelationManager::getTableIdVersion(const std::string &tableName, int *version, RID* rt_rid) {
+    TableInfo *info = _tableInfo(tableName);
+    if (info == nullptr)
+        return -1;
     if (version != nullptr)
-        *version = *(int *) (databuf + 1 + sizeof(int));
+        *version = info->version;
     if(rt_rid != nullptr)
-        *rt_rid = rid;
-    return *(int *) (databuf + 1);
+        *rt_rid = info->rid;
+    return info->id;
 }
 
 RC RelationManager::mapRIDs(const std::string &tableName, const std::string &conditionAttribute, const CompOp compOp,
@@ -351,19 +466,27 @@ RC RelationManager::getAttributes(const std::string &tableName, std::vector<Attr
 }
 
 RC RelationManager::getAttributes(const std::string &tableName, std::vector<Attribute> &attrs, int version) {
-    int table_id;
-    if ((table_id = getTableIdVersion(tableName)) < 0)
-        return -1;
-    auto func = [&attrs, version](RID &rid, char *data){
-        int pos, this_version;
-        auto attrres = catalogColumnToAttribute(data, &pos, &this_version);
-        if(this_version != version)
-            return;
-        if (pos > attrs.size()) attrs.resize(pos);
-        attrs[pos - 1] = attrres;
-    };
-
-    return mapRIDs("Columns", "table-id", EQ_OP, &table_id, CatalogColumnTupleNames, func);
+    TableInfo *info = _tableInfo(tableName);
+    if (info == nullptr)
+        return -1;
+    auto it = info->attrs.find(version);
+    if (it == info->attrs.end()) {
+        std::vector<Attribute> loaded;
+        int table_id = info->id;
+        auto func = [&loaded, version](RID &rid, char *data){
+            int pos, this_version;
+            auto attrres = catalogColumnToAttribute(data, &pos, &this_version);
+            if(this_version != version)
+                return;
+            if (pos > loaded.size()) loaded.resize(pos);
+            loaded[pos - 1] = attrres;
+        };
+        if (mapRIDs("Columns", "table-id", EQ_OP, &table_id, CatalogColumnTupleNames, func) < 0)
+            return -1;
+        it = info->attrs.emplace(version, std::move(loaded)).first;
+    }
+    attrs = it->second;
+    return 0;
 }
 
 
@@ -373,54 +496,87 @@ RC RelationManager::insertTuple(const std::string &tableName, const void *data,
     int table_id;
     std::vector<Attribute> recordDescriptor;
     if (getAttributes(tableName, recordDescriptor) < 0) return -1;
-    FileHandle file;
     auto &rbfm = RecordBasedFileManager::instance();
-    if (rbfm.openFile(tableName + postfix, file) < 0) return -1; // hard code filename
+    auto file = _openTable(tableName + postfix); // hard code filename
+    if (!file) return -1;
     int version;
     if(table_id = getTableIdVersion(tableName, &version) <= MaxCatalogID)
         return -1;
-    if( rbfm.insertRecord(file, recordDescriptor, data, rid, version) <0 ) return -1;
+    if( rbfm.insertRecord(*file, recordDescriptor, data, rid, version) <0 ) return -1;
 
     char databuf[PAGE_SIZE];
+    const auto &indexes = _indexedColumns(tableName, *_tableInfo(tableName));
     for(int i=0;i<recordDescriptor.size();i++) {
         std::string attributeName =  recordDescriptor[i].name;
+        if(indexes.count(attributeName) == 0) continue;
         auto &ix = IndexManager::instance();
-        std::string file_name = makeIndexFileName(tableName, attributeName);
-        IXFileHandle ixfile;
-        if(ix.openFile(file_name, ixfile) < 0) continue;
+        auto ixfile = _openIndex(makeIndexFileName(tableName, attributeName));
+        if(!ixfile) continue;
         if(testBit((const char*)data, i)) continue; // ignore null value
-        rbfm.readAttribute(file,recordDescriptor,rid,attributeName,databuf);
+        rbfm.readAttribute(*file,recordDescriptor,rid,attributeName,databuf);
         // skip null indicator
         int indicator_len = getIndicatorLen(recordDescriptor.size());
-        ix.insertEntry(ixfile,recordDescriptor[i],(databuf + indicator_len),rid);
+        ix.insertEntry(*ixfile,recordDescriptor[i],(databuf + indicator_len),rid);
     }
 
     return 0;
 }
 
+RC RelationManager::insertTuples(const std::string &tableName, const std::vector<const void *> &tuples,
+                                 std::vector<RID> &rids) {
+    std::vector<Attribute> recordDescriptor;
+    if (getAttributes(tableName, recordDescriptor) < 0) return -1;
+    int version;
+    if (getTableIdVersion(tableName, &version) <= MaxCatalogID)
+        return -1;
+    auto file = _openTable(tableName + postfix);
+    if (!file) return -1;
+    auto &rbfm = RecordBasedFileManager::instance();
+    if (rbfm.insertRecords(*file, recordDescriptor, tuples, rids, version) < 0) return -1;
+
+    // the keys are taken from the given tuples, no record is read back
+    const auto &indexes = _indexedColumns(tableName, *_tableInfo(tableName));
+    for (int i = 0; i < recordDescriptor.size(); i++) {
+        if (indexes.count(recordDescriptor[i].name) == 0) continue;
+        auto ixfile = _openIndex(makeIndexFileName(tableName, recordDescriptor[i].name));
+        if (!ixfile) continue;
+        std::vector<const void *> keys;
+        std::vector<RID> keyRids;
+        for (size_t j = 0; j < tuples.size(); ++j) {
+            const char *key = tupleField((const char *) tuples[j], recordDescriptor, i);
+            if (key == nullptr) continue; // ignore null value
+            keys.push_back(key);
+            keyRids.push_back(rids[j]);
+        }
+        if (IndexManager::instance().insertEntries(*ixfile, recordDescriptor[i], keys, keyRids) < 0) return -1;
+    }
+    return 0;
+}
+
 RC RelationManager::deleteTuple(const std::string &tableName, const RID &rid) {
     if(getTableIdVersion(tableName) <= MaxCatalogID)
         return -1;
     std::vector<Attribute> recordDescriptor;
     if (getAttributes(tableName, recordDescriptor) < 0) return -1;
-    FileHandle file;
     auto &rbfm = RecordBasedFileManager::instance();
-    if (rbfm.openFile(tableName + postfix, file) < 0) return -1;
+    auto file = _openTable(tableName + postfix);
+    if (!file) return -1;
     
     char databuf[PAGE_SIZE];
+    const auto &indexes = _indexedColumns(tableName, *_tableInfo(tableName));
     for(int i=0;i<recordDescriptor.size();i++) {
         std::string attributeName =  recordDescriptor[i].name;
+        if(indexes.count(attributeName) == 0) continue;
         auto &ix = IndexManager::instance();
-        std::string file_name = makeIndexFileName(tableName, attributeName);
-        IXFileHandle ixfile;
-        if(ix.openFile(file_name, ixfile) < 0) continue;
-        rbfm.readAttribute(file,recordDescriptor,rid,attributeName,databuf);
+        auto ixfile = _openIndex(makeIndexFileName(tableName, attributeName));
+        if(!ixfile) continue;
+        rbfm.readAttribute(*file,recordDescriptor,rid,attributeName,databuf);
         // skip null indicator
         int indicator_len = getIndicatorLen(recordDescriptor.size());
-        ix.deleteEntry(ixfile,recordDescriptor[i],databuf+indicator_len,rid);
+        ix.deleteEntry(*ixfile,recordDescriptor[i],databuf+indicator_len,rid);
     }
 
-    return rbfm.deleteRecord(file,recordDescriptor,rid);
+    return rbfm.deleteRecord(*file,recordDescriptor,rid);
 
 }
 
@@ -428,13 +584,13 @@ RC RelationManager::updateTuple(const std::string &tableName, const void *data,
     //update 默认用最新的attrs
     std::vector<Attribute> to_attrs;
     if(getAttributes(tableName, to_attrs) < 0) return -1;
-    FileHandle file;
     auto &rbfm = RecordBasedFileManager::instance();
-    if (rbfm.openFile(tableName + postfix, file) < 0) return -1;
+    auto file = _openTable(tableName + postfix);
+    if (!file) return -1;
     int version;
     int table_id = getTableIdVersion(tableName,&version);
     if(table_id <= MaxCatalogID) return -1;
-    return rbfm.updateRecord(file,to_attrs,data,rid, version);
+    return rbfm.updateRecord(*file,to_attrs,data,rid, version);
 }
 
 
@@ -445,13 +601,13 @@ RC RelationManager::readTuple(const std::string &tableName, const RID &rid, void
     auto &rbfm = RecordBasedFileManager::instance();
     if (rbfm.openFile(tableName + postfix, file) < 0) return -1; // hard code filename
     return rbfm.readRecord(file, recordDescriptor, rid, data); */
-    FileHandle file;
     auto &rbfm = RecordBasedFileManager::instance();
-    if (rbfm.openFile(tableName + postfix, file) < 0) return -1; // hard code filename
+    auto file = _openTable(tableName + postfix); // hard code filename
+    if (!file) return -1;
     char databuf[PAGE_SIZE];
     int from_version;
     SlotItem slot; // not beautiful
-    if(rbfm.readRawRecord(file, rid, databuf, from_version, slot) < 0)
+    if(rbfm.readRawRecord(*file, rid, databuf, from_version, slot) < 0)
         return -1;
 
     std::vector<Attribute> from_attrs, to_attrs;
@@ -461,19 +617,50 @@ RC RelationManager::readTuple(const std::string &tableName, const RID &rid, void
     return 0;
 }
 
+RC RelationManager::readTuples(const std::string &tableName, const std::vector<RID> &rids,
+                               const std::function<void(size_t, const void *, unsigned)> &func) {
+    auto &rbfm = RecordBasedFileManager::instance();
+    auto file = _openTable(tableName + postfix); // hard code filename
+    if (!file) return -1;
+    std::vector<size_t> order(rids.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&rids](size_t a, size_t b) {
+        return rids[a].pageNum < rids[b].pageNum || (rids[a].pageNum == rids[b].pageNum && rids[a].slotNum < rids[b].slotNum);
+    });
+    std::vector<RID> sorted(rids.size());
+    for (size_t i = 0; i < order.size(); ++i) sorted[i] = rids[order[i]];
+
+    std::vector<Attribute> to_attrs;
+    if (getAttributes(tableName, to_attrs) < 0) return -1;
+    std::map<int, std::vector<Attribute>> from_attrs; // schemas of the versions met so far
+    char databuf[PAGE_SIZE];
+    bool failed = false;
+    RC rc = rbfm.readRawRecords(*file, sorted, [&](size_t i, char *raw, int from_version, const SlotItem &slot) {
+        auto it = from_attrs.find(from_version);
+        if (it == from_attrs.end()) {
+            it = from_attrs.emplace(from_version, std::vector<Attribute>()).first;
+            failed = failed || getAttributes(tableName, it->second, from_version) < 0;
+        }
+        if (failed) return;
+        unsigned size = rbfm.convertVersion(raw, databuf, it->second, to_attrs, slot);
+        func(order[i], databuf, size);
+    });
+    return rc < 0 || failed ? -1 : 0;
+}
+
 RC RelationManager::printTuple(const std::vector<Attribute> &attrs, const void *data) {
     return RecordBasedFileManager::instance().printRecord(attrs, data);
 }
 
 RC RelationManager::readAttribute(const std::string &tableName, const RID &rid, const std::string &attributeName,
                                   void *data) {
-    FileHandle file;
     auto &rbfm = RecordBasedFileManager::instance();
-    if (rbfm.openFile(tableName + postfix, file) < 0) return -1; // hard code filename
+    auto file = _openTable(tableName + postfix); // hard code filename
+    if (!file) return -1;
     char databuf[PAGE_SIZE];
     int from_version;
     SlotItem slot; // not beautiful
-    if(rbfm.readRawRecord(file, rid, databuf, from_version, slot) < 0)
+    if(rbfm.readRawRecord(*file, rid, databuf, from_version, slot) < 0)
         return -1;
 
     std::vector<Attribute> from_attrs, to_attrs;
@@ -487,7 +674,7 @@ RC RelationManager::readAttribute(const std::string &tableName, const RID &rid,
         memcpy(data, databuf + slot.data_size + sizeof(TypeSchemaVersion) + sizeof(TypeSlotNum) + slot.field_num * sizeof(TypeOffset), indicator_len);
         return 0;
     }
-    return rbfm.readAttribute(file,from_attrs,rid,attributeName,data);
+    return rbfm.readAttribute(*file,from_attrs,rid,attributeName,data);
 }
 
 RC RelationManager::scan(const std::string &tableName,
@@ -498,17 +685,17 @@ RC RelationManager::scan(const std::string &tableName,
                          RM_ScanIterator &rm_ScanIterator) {
     auto &rbfm = RecordBasedFileManager::instance();
     if (tableName == "Tables") {
-        FileHandle file;
-        rbfm.openFile(CATALOG_TABLE, file);
+        auto file = _openTable(CATALOG_TABLE);
+        if (!file) return -1;
         RBFM_ScanIterator scanner;
-        rbfm.scan(file, getCatalogTableAttribute(), conditionAttribute, compOp, value, attributeNames, scanner);
+        rbfm.scan(*file, getCatalogTableAttribute(), conditionAttribute, compOp, value, attributeNames, scanner);
         rm_ScanIterator.setScanner(scanner);
         return 0;
     } else if (tableName == "Columns") {
-        FileHandle file;
-        rbfm.openFile(CATALOG_COLUMN, file);
+        auto file = _openTable(CATALOG_COLUMN);
+        if (!file) return -1;
         RBFM_ScanIterator scanner;
-        rbfm.scan(file, getCatalogColumnAttribute(), conditionAttribute, compOp, value, attributeNames, scanner);
+        rbfm.scan(*file, getCatalogColumnAttribute(), conditionAttribute, compOp, value, attributeNames, scanner);
         rm_ScanIterator.setScanner(scanner);
         return 0;
     }
@@ -519,50 +706,43 @@ RC RelationManager::scan(const std::string &tableName,
         return -1;
     }
     RBFM_ScanIterator scanner;
-    FileHandle file;
-    if (rbfm.openFile(tableName + postfix, file) < 0) return -1; // hard code filename
-    if (rbfm.scan(file, recordDescriptor, conditionAttribute, compOp, value, attributeNames, scanner) < 0) return -1;
+    auto file = _openTable(tableName + postfix); // hard code filename
+    if (!file) return -1;
+    if (rbfm.scan(*file, recordDescriptor, conditionAttribute, compOp, value, attributeNames, scanner) < 0) return -1;
     rm_ScanIterator.setScanner(scanner);
     return 0;
 }
 
 RC RelationManager::indexScan(const std::string &tableName, const std::string &attributeName, const void *lowKey, const void *highKey,
                  bool lowKeyInclusive, bool highKeyInclusive, RM_IndexScanIterator &rm_IndexScanIterator) {
-    IXFileHandle ixfile;
     auto& ix = IndexManager::instance();
-    if(ix.openFile(makeIndexFileName(tableName, attributeName), ixfile) < 0){
+    auto ixfile = _openIndex(makeIndexFileName(tableName, attributeName));
+    if(!ixfile){
         return -1;
     }
     // attribute
     Attribute attr;
-    int table_id = getTableIdVersion(tableName);
-    if(table_id < 0) return -1;
-    if(getAttribute(table_id, attributeName, attr) < 0) return -1;
+    if(getAttribute(tableName, attributeName, attr) < 0) return -1;
     IX_ScanIterator scanner;
-    if(ix.scan(ixfile, attr, lowKey, highKey, lowKeyInclusive, highKey, scanner) < 0)
+    if(ix.scan(*ixfile, attr, lowKey, highKey, lowKeyInclusive, highKeyInclusive, scanner) < 0)
         return -1;
     
     rm_IndexScanIterator.setScanner(scanner);
     return 0;
 }
 
-RC RelationManager::getAttribute(int table_id, const std::string& attrName, Attribute& attr, int* posi){
-    bool hit = false;
-    RM_ScanIterator rm_scanner;
-    if (scan("Columns", "table-id", EQ_OP, &table_id, CatalogColumnTupleNames, rm_scanner) < 0)
+RC RelationManager::getAttribute(const std::string &tableName, const std::string& attrName, Attribute& attr, int* posi){
+    // the cached schema of the current version, positions in Columns start at 1
+    std::vector<Attribute> attrs;
+    if (getAttributes(tableName, attrs) < 0)
         return -1;
-    RID rid;
-    char databuf[240];
-    while ((rm_scanner.getNextTuple(rid, databuf)) != RM_EOF) {
-        attr = catalogColumnToAttribute(databuf, posi);
-        if(attr.name == attrName){
-            hit = true;
-            break;
-        }
+    for (size_t i = 0; i < attrs.size(); ++i) {
+        if (attrs[i].name != attrName) continue;
+        attr = attrs[i];
+        if (posi != nullptr) *posi = i + 1;
+        return 0;
     }
-    rm_scanner.close();
-    if(!hit) return -1;
-    return 0;
+    return -1;
 }
 // Extra credit work
 RC RelationManager::dropAttribute(const std::string &tableName, const std::string &attributeName) {
@@ -572,18 +752,18 @@ RC RelationManager::dropAttribute(const std::string &tableName, const std::strin
     //version ++;
     
     auto &rbfm = RecordBasedFileManager::instance();
-    FileHandle file;
     //modify catlog table
-    if (rbfm.openFile(CATALOG_TABLE, file) < 0) {
+    auto file = _openTable(CATALOG_TABLE);
+    if (!file) {
         return -1;
     }
 
     std::vector<char> databuf;
     auto recordDescriptor = getCatalogTableAttribute();
     prepareCatalogTableData(databuf, recordDescriptor, table_id, tableName, tableName + postfix, version+1);
-    rbfm.updateRecord(file, recordDescriptor, databuf.data(), rid);
+    rbfm.updateRecord(*file, recordDescriptor, databuf.data(), rid);
 
-    if (rbfm.openFile(CATALOG_COLUMN, file) < 0) {
+    if (!(file = _openTable(CATALOG_COLUMN))) {
         return -1;
     }
     recordDescriptor = getCatalogColumnAttribute();
@@ -597,9 +777,9 @@ RC RelationManager::dropAttribute(const std::string &tableName, const std::strin
     }
     for (int i = 0; i < attrs.size(); ++i) {
         prepareCatalogColumnData(databuf, recordDescriptor, table_id, attrs[i], i + 1, version+1);
-        rbfm.insertRecord(file, recordDescriptor, databuf.data(), rid);
+        rbfm.insertRecord(*file, recordDescriptor, databuf.data(), rid);
     }
-    
+    catalog_.erase(tableName); // read the new version back when it is used
     return 0;
 }
 
@@ -611,19 +791,19 @@ RC RelationManager::addAttribute(const std::string &tableName, const Attribute &
     //version ++;
     
     auto &rbfm = RecordBasedFileManager::instance();
-    FileHandle file;
     //modify catlog table
-    if (rbfm.openFile(CATALOG_TABLE, file) < 0) {
+    auto file = _openTable(CATALOG_TABLE);
+    if (!file) {
         return -1;
     }
 
     std::vector<char> databuf;
     auto recordDescriptor = getCatalogTableAttribute();
     prepareCatalogTableData(databuf, recordDescriptor, table_id, tableName, tableName + postfix, version+1);
-    rbfm.updateRecord(file, recordDescriptor, databuf.data(), rid);
+    rbfm.updateRecord(*file, recordDescriptor, databuf.data(), rid);
 
 
-    if (rbfm.openFile(CATALOG_COLUMN, file) < 0) {
+    if (!(file = _openTable(CATALOG_COLUMN))) {
         return -1;
     }
     recordDescriptor = getCatalogColumnAttribute();
@@ -632,8 +812,8 @@ RC RelationManager::addAttribute(const std::string &tableName, const Attribute &
     attrs.push_back(attr);
     for (int i = 0; i < attrs.size(); ++i) {
         prepareCatalogColumnData(databuf, recordDescriptor, table_id, attrs[i], i + 1, version+1);
-        rbfm.insertRecord(file, recordDescriptor, databuf.data(), rid);
+        rbfm.insertRecord(*file, recordDescriptor, databuf.data(), rid);
     }
-    
+    catalog_.erase(tableName); // read the new version back when it is used
     return 0;
 }
@@ -4,10 +4,16 @@
 #include <string>
 #include <vector>
 #include <memory.h>
+#include <memory>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
 #include "../rbf/rbfm.h"
 #include "../ix/ix.h"
 
 # define RM_EOF (-1)  // end of a scan operator
+# define OPEN_FILE_CACHE_SIZE 64 // table, catalog and index files RelationManager keeps open
 const int MaxCatalogID = 3;
 constexpr char CATALOG_TABLE[] = "Tables.tbl";
 constexpr char CATALOG_COLUMN[] = "Columns.tbl";
@@ -16,7 +22,7 @@ constexpr char CATALOG_INDEX[] = "Indexs.tbl";
 const std::string postfix = ".tbl";
 const std::vector<std::string> CatalogColumnTupleNames{"table-id", "column-name", "column-type", "column-length", "column-position", "version"};
 const std::vector<std::string> CatalogTableTupleNames{"table-id", "table-name", "file-name", "version"};
-const std::vector<std::string> CatalogIndexTupleNames{"table-id", "column-position", "file-name"};
+const std::vector<std::string> CatalogIndexTupleNames{"table-id", "column-position", "file-name", "index-kind"};
 
 const std::vector<Attribute>& getCatalogTableAttribute();
 const std::vector<Attribute>& getCatalogColumnAttribute();
@@ -36,6 +42,11 @@ public:
     // "data" follows the same format as RelationManager::insertTuple()
     RC getNextTuple(RID &rid, void *data) { return _scanner.getNextRecord(rid, data);};
 
+    // up to maxTuples tuples as fields in the page, see RBFM_ScanIterator::getNextRecords()
+    RC getNextTuples(unsigned maxTuples, const std::function<void(const char *const *, const unsigned *)> &func) {
+        return _scanner.getNextRecords(maxTuples, func);
+    };
+
     RC close() { return _scanner.close(); };
 
     void setScanner(RBFM_ScanIterator scanner){
@@ -71,19 +82,26 @@ public:
 
     RC deleteTable(const std::string &tableName);
 
-    RC getAttribute(int table_id, const std::string& attrName, Attribute& attr, int* posi=nullptr);
+    RC getAttribute(const std::string &tableName, const std::string& attrName, Attribute& attr, int* posi=nullptr);
     RC getAttributes(const std::string &tableName, std::vector<Attribute> &attrs);
 
     RC getAttributes(const std::string &tableName, std::vector<Attribute> &attrs, int version);
 
     RC insertTuple(const std::string &tableName, const void *data, RID &rid);
 
+    // Insert tuples in batch, rids[i] is the RID of tuples[i]. Indexes get their entries sorted by key.
+    RC insertTuples(const std::string &tableName, const std::vector<const void *> &tuples, std::vector<RID> &rids);
+
     RC deleteTuple(const std::string &tableName, const RID &rid);
 
     RC updateTuple(const std::string &tableName, const void *data, const RID &rid);
 
     RC readTuple(const std::string &tableName, const RID &rid, void *data);
 
+    // Read the tuples of rids, each data page once: func gets (i, tuple, its length) for rids[i], in page order.
+    RC readTuples(const std::string &tableName, const std::vector<RID> &rids,
+                  const std::function<void(size_t, const void *, unsigned)> &func);
+
     // Print a tuple that is passed to this utility method.
     // The format is the same as printRecord().
     RC printTuple(const std::vector<Attribute> &attrs, const void *data);
@@ -109,7 +127,9 @@ public:
     RC mapRIDs(const std::string &tableName, const std::string &conditionAttribute, const CompOp compOp, const void *value, const std::vector<std::string> &attributeNames, std::function<void(RID&, char*)> func);
     RC mapRIDs(const std::string &tableName, const std::string &conditionAttribute, const CompOp compOp, const void *value, const std::vector<std::string> &attributeNames, std::function<void(RID&, char*, FileHandle&)> func, FileHandle&);
     // QE IX related
-    RC createIndex(const std::string &tableName, const std::string &attributeName);
+    // kind is kept in the Indexs catalog; a hash index serves equality scans, as INLJoin makes them
+    RC createIndex(const std::string &tableName, const std::string &attributeName,
+                   IndexKind kind = IndexKind::BTREE);
 
     RC destroyIndex(const std::string &tableName, const std::string &attributeName);
 
@@ -130,6 +150,33 @@ protected:
 
 private:
     static RelationManager *_relation_manager;
+
+    // LRU cache of open files by file name. A nullptr entry records that an index file does not exist.
+    std::shared_ptr<FileHandle> _openFile(const std::string &fileName, bool isIndex);
+    std::shared_ptr<FileHandle> _openTable(const std::string &fileName) { return _openFile(fileName, false); }
+    std::shared_ptr<IXFileHandle> _openIndex(const std::string &fileName) {
+        return std::static_pointer_cast<IXFileHandle>(_openFile(fileName, true));
+    }
+    void _closeFile(const std::string &fileName);                      // drop it before the file is destroyed
+    void _closeAllFiles();
+
+    // Catalog data of one table, filled from Tables/Columns/Indexs on first use and kept up to date by DDL
+    struct TableInfo {
+        int id = -1;
+        int version = 0;                                                // current schema version
+        RID rid;                                                        // row in Tables
+        std::map<int, std::vector<Attribute>> attrs;                    // schema of each version read so far
+        bool indexes_loaded = false;
+        std::set<std::string> indexes;                                  // names of the indexed columns
+    };
+    TableInfo *_tableInfo(const std::string &tableName);                // nullptr if there is no such table
+    const std::set<std::string> &_indexedColumns(const std::string &tableName, TableInfo &info);
+
+    std::unordered_map<std::string, TableInfo> catalog_;
+
+    typedef std::pair<std::list<std::string>::iterator, std::shared_ptr<FileHandle>> OpenFile;
+    std::list<std::string> file_lru_;                                   // most recently used first
+    std::unordered_map<std::string, OpenFile> open_files_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "rm_test_util.h"
+
+static int countIndexEntries(const std::string &tableName, const std::string &attributeName) {
+    RM_IndexScanIterator rmisi;
+    if (rm.indexScan(tableName, attributeName, NULL, NULL, true, true, rmisi) != success)
+        return -1;
+    RID rid;
+    char key[PAGE_SIZE];
+    int count = 0;
+    while (rmisi.getNextEntry(rid, key) != RM_EOF)
+        count++;
+    rmisi.close();
+    return count;
+}
+
+static int countTuples(const std::string &tableName) {
+    RM_ScanIterator rmsi;
+    std::vector<std::string> attributes{"Age"};
+    if (rm.scan(tableName, "", NO_OP, NULL, attributes, rmsi) != success)
+        return -1;
+    RID rid;
+    char returnedData[PAGE_SIZE];
+    int count = 0;
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+        count++;
+    rmsi.close();
+    return count;
+}
+
+RC TEST_RM_16(const std::string &tableName) {
+    // Functions Tested:
+    // 1. Insert Tuple - through the cached file handles
+    // 2. Create Index / Destroy Index - cached index handles are dropped
+    // 3. Delete Table / Create Table - a table of the same name starts empty
+    std::cout << std::endl << "***** In RM Test Case 16 *****" << std::endl;
+
+    createTable(tableName);
+
+    std::vector<Attribute> attrs;
+    RC rc = rm.getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    auto *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    void *tuple = malloc(200);
+    unsigned tupleSize = 0;
+    RID rid;
+    int numTuples = 100;
+
+    for (int i = 0; i < numTuples; i++) {
+        prepareTuple(attrs.size(), nullsIndicator, 6, "Cached", i, 170.1, i * 10, tuple, &tupleSize);
+        rc = rm.insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+
+    // the insert before createIndex learned that there is no index on Age
+    rc = rm.createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Cached", numTuples, 170.1, 0, tuple, &tupleSize);
+    rc = rm.insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    int indexed = countIndexEntries(tableName, "Age");
+    if (indexed != numTuples + 1) {
+        std::cout << "The index has " << indexed << " entries instead of " << numTuples + 1 << std::endl;
+        std::cout << "***** [FAIL] Test Case 16 failed *****" << std::endl;
+        free(tuple);
+        free(nullsIndicator);
+        return -1;
+    }
+
+    rc = rm.destroyIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::destroyIndex() should not fail.");
+    rc = rm.insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail after destroyIndex().");
+    assert(countIndexEntries(tableName, "Age") < 0 && "Scanning a destroyed index should fail.");
+
+    // the new table must not see the records of the old file
+    rc = rm.deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    createTable(tableName);
+    int count = countTuples(tableName);
+    rc = rm.insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    void *returnedData = malloc(200);
+    rc = rm.readTuple(tableName, rid, returnedData);
+    assert(rc == success && "RelationManager::readTuple() should not fail.");
+    bool same = memcmp(tuple, returnedData, tupleSize) == 0;
+
+    rc = rm.deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    free(tuple);
+    free(returnedData);
+    free(nullsIndicator);
+
+    if (count != 0 || !same) {
+        std::cout << "The table created again returned " << count << " old tuples." << std::endl;
+        std::cout << "***** [FAIL] Test Case 16 failed *****" << std::endl;
+        return -1;
+    }
+
+    std::cout << "***** Test Case 16 Finished. The result will be examined. *****" << std::endl;
+    return success;
+}
+
+int main() {
+    return TEST_RM_16("tbl_cache");
+}
@@ -0,0 +1,73 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_17(const std::string &tableName) {
+    // Functions Tested:
+    // 1. Get Attributes - after every schema change, answered from the catalog cache
+    // 2. Drop Attribute / Add Attribute - tuples are read with the new schema
+    // 3. Delete Table - drops the indexes of the table, so they can be created again
+    std::cout << std::endl << "***** In RM Test Case 17 *****" << std::endl;
+
+    createTable(tableName);
+    RC rc = rm.createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    std::vector<Attribute> attrs;
+    rc = rm.getAttributes(tableName, attrs);
+    assert(rc == success && attrs.size() == 4 && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    auto *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+    unsigned tupleSize = 0;
+    RID rid;
+    prepareTuple(attrs.size(), nullsIndicator, 6, "Peters", 24, 170.1, 5000, tuple, &tupleSize);
+    rc = rm.insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+
+    rc = rm.dropAttribute(tableName, "Height");
+    assert(rc == success && "RelationManager::dropAttribute() should not fail.");
+    rc = rm.getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    bool dropped = attrs.size() == 3 && attrs[2].name == "Salary";
+
+    // EmpName, Age and Salary are left
+    rc = rm.readTuple(tableName, rid, returnedData);
+    assert(rc == success && "RelationManager::readTuple() should not fail.");
+    int salary = *(int *) ((char *) returnedData + 1 + 4 + 6 + 4);
+    dropped = dropped && salary == 5000;
+
+    Attribute attr{"SSN", TypeInt, 4};
+    rc = rm.addAttribute(tableName, attr);
+    assert(rc == success && "RelationManager::addAttribute() should not fail.");
+    rc = rm.getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    bool added = attrs.size() == 4 && attrs[3].name == "SSN";
+
+    rc = rm.deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    assert(rm.getAttributes(tableName, attrs) != success && "A deleted table should have no attributes.");
+    createTable(tableName);
+    rc = rm.createIndex(tableName, "Age");
+    assert(rc == success && "Creating the index of a table created again should not fail.");
+    rc = rm.deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(tuple);
+    free(returnedData);
+    free(nullsIndicator);
+
+    if (!dropped || !added) {
+        std::cout << "The schema did not follow dropAttribute() and addAttribute()." << std::endl;
+        std::cout << "***** [FAIL] Test Case 17 failed *****" << std::endl;
+        return -1;
+    }
+
+    std::cout << "***** Test Case 17 Finished. The result will be examined. *****" << std::endl;
+    return success;
+}
+
+int main() {
+    return TEST_RM_17("tbl_catalog_cache");
+}
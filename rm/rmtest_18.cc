@@ -0,0 +1,80 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_18(const std::string &tableName) {
+    // Functions Tested:
+    // 1. Insert Tuples - a batch of tuples, some with a NULL key, into a table with an index
+    // 2. Read Tuple
+    // 3. Index Scan - every non-NULL key of the batch is in the index
+    std::cout << std::endl << "***** In RM Test Case 18 *****" << std::endl;
+
+    createTable(tableName);
+    RC rc = rm.createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    std::vector<Attribute> attrs;
+    rc = rm.getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    auto *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    auto *nullAgeIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    memset(nullAgeIndicator, 0, nullAttributesIndicatorActualSize);
+    nullAgeIndicator[0] = 1 << 6; // Age is the second field
+
+    int numTuples = 5000, numNulls = 0;
+    std::vector<std::vector<char>> tuples(numTuples, std::vector<char>(200));
+    std::vector<unsigned> sizes(numTuples);
+    std::vector<const void *> data;
+    for (int i = 0; i < numTuples; i++) {
+        bool nullAge = i % 100 == 0;
+        numNulls += nullAge;
+        // keys in descending order, so the index has to sort them
+        prepareTuple(attrs.size(), nullAge ? nullAgeIndicator : nullsIndicator, 6, "Batch" + std::to_string(i % 10),
+                     numTuples - i, 170.1, i, tuples[i].data(), &sizes[i]);
+        data.push_back(tuples[i].data());
+    }
+    std::vector<RID> rids;
+    rc = rm.insertTuples(tableName, data, rids);
+    assert(rc == success && rids.size() == (size_t) numTuples && "RelationManager::insertTuples() should not fail.");
+
+    bool same = true;
+    char returnedData[200];
+    for (int i = 0; i < numTuples && same; i++) {
+        rc = rm.readTuple(tableName, rids[i], returnedData);
+        same = rc == success && memcmp(returnedData, tuples[i].data(), sizes[i]) == 0;
+    }
+
+    RM_IndexScanIterator rmisi;
+    rc = rm.indexScan(tableName, "Age", NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    RID rid;
+    int key, lastKey = 0, count = 0;
+    bool ordered = true;
+    while (rmisi.getNextEntry(rid, &key) != RM_EOF) {
+        ordered = ordered && key >= lastKey && rid.pageNum == rids[numTuples - key].pageNum &&
+                  rid.slotNum == rids[numTuples - key].slotNum;
+        lastKey = key;
+        count++;
+    }
+    rmisi.close();
+
+    rc = rm.deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    free(nullsIndicator);
+    free(nullAgeIndicator);
+
+    if (!same || !ordered || count != numTuples - numNulls) {
+        std::cout << "Read back: " << same << ", index entries: " << count << " of " << numTuples - numNulls
+                  << ", in order: " << ordered << std::endl;
+        std::cout << "***** [FAIL] Test Case 18 failed *****" << std::endl;
+        return -1;
+    }
+
+    std::cout << "***** Test Case 18 Finished. The result will be examined. *****" << std::endl;
+    return success;
+}
+
+int main() {
+    return TEST_RM_18("tbl_batch");
+}
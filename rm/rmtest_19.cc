@@ -0,0 +1,90 @@
+#include "rm_test_util.h"
+
+// counts the index entries of age, checking that they point at tuples of that age
+static int countAge(const std::string &tableName, int age) {
+    RM_IndexScanIterator rmisi;
+    RC rc = rm.indexScan(tableName, "Age", &age, &age, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    RID rid;
+    int key, count = 0;
+    char returnedData[200];
+    while (rmisi.getNextEntry(rid, &key) != RM_EOF) {
+        // the null indicator, the length and 6 letters of EmpName come before Age
+        if (key != age || rm.readTuple(tableName, rid, returnedData) != success ||
+            *(int *) (returnedData + 1 + 4 + 6) != age)
+            count = -1;
+        if (count >= 0) count++;
+    }
+    rmisi.close();
+    return count;
+}
+
+RC TEST_RM_19(const std::string &tableName) {
+    // Functions Tested:
+    // 1. Create Index - a hash index over tuples inserted before, its kind is kept in the catalog
+    // 2. Insert Tuple / Delete Tuple - the hash index is kept up to date
+    // 3. Index Scan - an equality scan of the hash index
+    std::cout << std::endl << "***** In RM Test Case 19 *****" << std::endl;
+
+    createTable(tableName);
+    std::vector<Attribute> attrs;
+    RC rc = rm.getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    auto *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    char tuple[200];
+    unsigned tupleSize = 0;
+    int numTuples = 3000;
+    std::vector<RID> rids(numTuples);
+    // tuple i is aged i % 50, the first half goes in before the index
+    for (int i = 0; i < numTuples; i++) {
+        if (i == numTuples / 2) {
+            rc = rm.createIndex(tableName, "Age", IndexKind::HASH);
+            assert(rc == success && "RelationManager::createIndex() should not fail.");
+        }
+        prepareTuple(attrs.size(), nullsIndicator, 6, "Hashed", i % 50, 170.1, i, tuple, &tupleSize);
+        rc = rm.insertTuple(tableName, tuple, rids[i]);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+
+    // the Indexs catalog knows the index is a hash index
+    RM_ScanIterator rmsi;
+    std::vector<std::string> kindAttr{"index-kind"};
+    rc = rm.scan("Indexs", "", NO_OP, NULL, kindAttr, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    RID rid;
+    char returnedData[200];
+    int hashIndexes = 0;
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+        hashIndexes += *(int *) (returnedData + 1) == (int) IndexKind::HASH;
+    rmsi.close();
+
+    int before = countAge(tableName, 7);
+    // delete the tuples aged 7 of the first half
+    for (int i = 7; i < numTuples / 2; i += 50) {
+        rc = rm.deleteTuple(tableName, rids[i]);
+        assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+    }
+    int after = countAge(tableName, 7);
+    int missing = countAge(tableName, 50);
+
+    rc = rm.deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    free(nullsIndicator);
+
+    if (hashIndexes != 1 || before != numTuples / 50 || after != numTuples / 100 || missing != 0) {
+        std::cout << "Hash indexes in the catalog: " << hashIndexes << ", entries of age 7: " << before
+                  << ", after deletion: " << after << ", of age 50: " << missing << std::endl;
+        std::cout << "***** [FAIL] Test Case 19 failed *****" << std::endl;
+        return -1;
+    }
+
+    std::cout << "***** Test Case 19 Finished. The result will be examined. *****" << std::endl;
+    return success;
+}
+
+int main() {
+    return TEST_RM_19("tbl_hash");
+}